@@ -116,6 +116,10 @@ nvme_list_opts () {
 			--nphndls= -n --nsze-si= -S --ncap-si= -C --azr -z --rar= -r \
 			--ror= -O --rnumzrwa= -u --phndls= -p --endg-id= -e"
 			;;
+		"provision")
+		opts+=" --spec= -s --jobs= -j --dry-run -d --no-rescan -R \
+			--timeout= -t"
+			;;
 		"delete-ns")
 		opts+=" -namespace-id= -n --timeout= -t"
 			;;
@@ -210,6 +214,16 @@ nvme_list_opts () {
 		"device-self-test")
 		opts+=" --namespace-id= -n --self-test-code= -s --timeout= -t"
 			;;
+		"fleet-self-test")
+		opts+=" --devices= -d --model= -m --namespace-id= -n \
+			--self-test-code= -s --jobs= -j --output-format= -o \
+			--timeout= -t"
+		case $opt in
+			--self-test-code|-s)
+			vals+=" short extended"
+				;;
+		esac
+			;;
 		"self-test-log")
 		opts+=" --dst-entries= -e --output-format= -o \
 			--verbose -v"
@@ -233,7 +247,14 @@ nvme_list_opts () {
 		opts+=" --slot= -s --action= -a --bpid= -b --timeout= -t"
 			;;
 		"fw-download")
-		opts+=" --fw= -f --xfer= -x --offset= -O --timeout= -t"
+		opts+=" --fw= -f --xfer= -x --offset= -O --progress -p \
+			--ignore-ovr -i --jobs= -j --resume= -R --crc= -C \
+			--timeout= -t"
+			;;
+		"fw-rollout")
+		opts+=" --fw= -f --devices= -d --model= -m --firmware-rev= -r \
+			--xfer= -x --slot= -s --action= -a --bpid= -b --jobs= -j \
+			--output-format= -o --timeout= -t"
 			;;
 		"capacity-mgmt")
 		opts+=" --operation= -O --element-id= -i --cap-lower= -l \
@@ -369,6 +390,17 @@ nvme_list_opts () {
 		opts+=" --rae -r --output-format= -o --human-readable -H \
 			--raw-binary -b"
 			;;
+		"wipe")
+		opts+=" --devices= -d --model= -m --action= -a --ses= -s \
+			--no-dealloc -D --ause -u --owpass= -n --ovrpat= -p \
+			--interval= -i --jobs= -j --force --timeout= -t \
+			--output-format= -o"
+		case $opt in
+			--action|-a)
+			vals+=" format block-erase overwrite crypto-erase"
+				;;
+		esac
+			;;
 		"reset")
 		opts+=$NO_OPTS
 			;;
@@ -1313,13 +1345,20 @@ plugin_zns_opts () {
 			--descs= -d --state= -S --output-format= -o \
 			--human-readable -H --extended -e --partial -p"
 			;;
+		"zone-summary")
+		opts+=" --namespace-id= -n --top= -N --output-format= -o"
+			;;
 		"close-zone")
 		opts+=" --namespace-id= -n --start-lba= -s \
-			--select-all -a --timeout= -t"
+			--select-all -a --timeout= -t --end-lba= -e \
+			--state= -S --min-fill= --max-fill= --jobs= -j \
+			--dry-run"
 			;;
 		"finish-zone")
 		opts+=" --namespace-id= -n --start-lba= -s \
-			--select-all -a --timeout= -t"
+			--select-all -a --timeout= -t --end-lba= -e \
+			--state= -S --min-fill= --max-fill= --jobs= -j \
+			--dry-run"
 			;;
 		"open-zone")
 		opts+=" --namespace-id= -n --start-lba= -s \
@@ -1327,11 +1366,15 @@ plugin_zns_opts () {
 			;;
 		"reset-zone")
 		opts+=" --namespace-id= -n --start-lba= -s \
-			--select-all -a --timeout= -t"
+			--select-all -a --timeout= -t --end-lba= -e \
+			--state= -S --min-fill= --max-fill= --jobs= -j \
+			--dry-run"
 			;;
 		"offline-zone")
 		opts+=" --namespace-id= -n --start-lba= -s \
-			--select-all -a --timeout= -t"
+			--select-all -a --timeout= -t --end-lba= -e \
+			--state= -S --min-fill= --max-fill= --jobs= -j \
+			--dry-run"
 			;;
 		"set-zone-desc")
 		opts+=" --namespace-id= -n --start-lba= -s \
@@ -1345,7 +1388,8 @@ plugin_zns_opts () {
 			--metadata-size= -y --data= -d --metadata= -M \
 			--limited-retry -l --force-unit-access -f --ref-tag= -r
 			--app-tag-mask= -m --app-tag= -a --prinfo= -p \
-			--piremap -P --latency -t"
+			--piremap -P --latency -t --zones= -Z \
+			--queue-depth= -q --extent-log= -L"
 			;;
 		"changed-zone-list")
 		opts+=" --namespace-id= -n --output-format= -o --rae -r"
@@ -1606,7 +1650,8 @@ _nvme_subcmds () {
 		[zns]="id-ctrl id-ns zone-mgmt-recv \
 			zone-mgmt-send report-zones close-zone \
 			finish-zone open-zone reset-zone offline-zone \
-			set-zone-desc zone-append changed-zone-list"
+			set-zone-desc zone-append changed-zone-list \
+			zone-summary"
 		[nvidia]="id-ctrl"
 		[ymtc]="smart-log-add"
 		[inspur]="nvme-vendor-log"
@@ -1652,20 +1697,20 @@ _nvme_subcmds () {
 		id-ns-lba-format nvm-id-ns nvm-id-ns-lba-format \
 		nvm-id-ctrl primary-ctrl-caps list-secondary \
 		ns-descs id-nvmset id-uuid id-iocs id-domain create-ns \
-		delete-ns get-ns-id get-log telemetry-log \
+		provision delete-ns get-ns-id get-log telemetry-log \
 		fw-log changed-ns-list-log smart-log ana-log \
 		error-log effects-log endurance-log \
 		predictable-lat-log pred-lat-event-agg-log \
 		persistent-event-log endurance-agg-log \
 		lba-status-log resv-notif-log get-feature \
-		device-self-test self-test-log set-feature \
+		device-self-test fleet-self-test self-test-log set-feature \
 		set-property get-property format fw-commit \
-		fw-download admin-passthru io-passthru \
+		fw-download fw-rollout admin-passthru io-passthru \
 		security-send security-recv get-lba-status \
 		resv-acquire resv-register resv-release \
 		resv-report dsm copy flush compare read \
 		write write-zeroes write-uncor verify \
-		sanitize sanitize-log reset subsystem-reset \
+		sanitize sanitize-log wipe reset subsystem-reset \
 		ns-rescan show-regs discover connect-all \
 		connect disconnect disconnect-all gen-hostnqn \
 		show-hostnqn tls-key dir-receive dir-send virt-mgmt \
@@ -0,0 +1,191 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Discovery log cache.
+ *
+ * The last discovery log page retrieved from a discovery controller is
+ * kept in the run directory, one file per host and discovery controller.
+ * While the generation counter reported by the controller matches the
+ * cached one the records are taken from the cache and only the log page
+ * header needs to be fetched.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <libnvme.h>
+
+#include "common.h"
+#include "discovery-cache.h"
+#include "util/cleanup.h"
+
+#define DISC_CACHE_DIR		RUNDIR "/nvme/discovery"
+#define DISC_CACHE_MAGIC	"nvme-discovery-cache"
+#define DISC_CACHE_VERSION	1
+#define DISC_CACHE_MAX_SIZE	(64 * 1024 * 1024)
+
+static const char *disc_cache_field(const char *s)
+{
+	return s && *s ? s : "";
+}
+
+static char *disc_cache_key(nvme_ctrl_t c)
+{
+	nvme_subsystem_t s = nvme_ctrl_get_subsystem(c);
+	nvme_host_t h = s ? nvme_subsystem_get_host(s) : NULL;
+	char *key;
+
+	if (!h)
+		return NULL;
+
+	if (asprintf(&key, "%s\t%s\t%s\t%s\t%s\t%s\t%s",
+		     disc_cache_field(nvme_host_get_hostnqn(h)),
+		     disc_cache_field(nvme_ctrl_get_subsysnqn(c)),
+		     disc_cache_field(nvme_ctrl_get_transport(c)),
+		     disc_cache_field(nvme_ctrl_get_traddr(c)),
+		     disc_cache_field(nvme_ctrl_get_trsvcid(c)),
+		     disc_cache_field(nvme_ctrl_get_host_traddr(c)),
+		     disc_cache_field(nvme_ctrl_get_host_iface(c))) < 0)
+		return NULL;
+
+	return key;
+}
+
+/* FNV-1a, the full key is stored in the file and compared on load */
+static char *disc_cache_path(const char *key)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	char *path;
+
+	for (; *key; key++) {
+		hash ^= (unsigned char)*key;
+		hash *= 0x100000001b3ULL;
+	}
+
+	if (asprintf(&path, "%s/%016" PRIx64 ".log", DISC_CACHE_DIR, hash) < 0)
+		return NULL;
+
+	return path;
+}
+
+static size_t disc_cache_log_size(struct nvmf_discovery_log *log)
+{
+	return sizeof(*log) +
+		le64_to_cpu(log->numrec) * sizeof(struct nvmf_disc_log_entry);
+}
+
+struct nvmf_discovery_log *disc_cache_load(nvme_ctrl_t c)
+{
+	_cleanup_free_ char *key = NULL;
+	_cleanup_free_ char *path = NULL;
+	_cleanup_free_ char *buf = NULL;
+	_cleanup_fd_ int fd = -1;
+	struct nvmf_discovery_log *log;
+	char magic[32];
+	size_t hdr_len;
+	struct stat st;
+	ssize_t len;
+	char *p;
+
+	key = disc_cache_key(c);
+	if (!key)
+		return NULL;
+	path = disc_cache_path(key);
+	if (!path)
+		return NULL;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+
+	if (fstat(fd, &st) || !st.st_size || st.st_size > DISC_CACHE_MAX_SIZE)
+		return NULL;
+
+	buf = malloc(st.st_size);
+	if (!buf)
+		return NULL;
+
+	len = read(fd, buf, st.st_size);
+	if (len != st.st_size)
+		return NULL;
+
+	/* "<magic> <version>\n<key>\n" followed by the raw log page */
+	p = memchr(buf, '\n', len);
+	if (!p)
+		return NULL;
+	p = memchr(p + 1, '\n', len - (p + 1 - buf));
+	if (!p)
+		return NULL;
+	*p = '\0';
+	hdr_len = p + 1 - buf;
+
+	p = strchr(buf, '\n');
+	*p = '\0';
+	snprintf(magic, sizeof(magic), "%s %d", DISC_CACHE_MAGIC,
+		 DISC_CACHE_VERSION);
+	if (strcmp(buf, magic) || strcmp(p + 1, key))
+		return NULL;
+
+	len -= hdr_len;
+	if (len < (ssize_t)sizeof(*log) ||
+	    (size_t)len != disc_cache_log_size((void *)(buf + hdr_len)))
+		return NULL;
+
+	log = malloc(len);
+	if (!log)
+		return NULL;
+	memcpy(log, buf + hdr_len, len);
+
+	return log;
+}
+
+int disc_cache_save(nvme_ctrl_t c, struct nvmf_discovery_log *log)
+{
+	_cleanup_free_ char *key = NULL;
+	_cleanup_free_ char *path = NULL;
+	_cleanup_free_ char *tmp = NULL;
+	_cleanup_file_ FILE *f = NULL;
+	int fd;
+
+	key = disc_cache_key(c);
+	if (!key)
+		return -ENOMEM;
+	path = disc_cache_path(key);
+	if (!path)
+		return -ENOMEM;
+
+	if (mkdir(RUNDIR "/nvme", 0755) && errno != EEXIST)
+		return -errno;
+	if (mkdir(DISC_CACHE_DIR, 0700) && errno != EEXIST)
+		return -errno;
+
+	if (asprintf(&tmp, "%s.%d", path, getpid()) < 0)
+		return -ENOMEM;
+
+	fd = open(tmp, O_CREAT | O_WRONLY | O_TRUNC, 0600);
+	if (fd < 0)
+		return -errno;
+
+	f = fdopen(fd, "w");
+	if (!f) {
+		close(fd);
+		unlink(tmp);
+		return -errno;
+	}
+
+	fprintf(f, "%s %d\n%s\n", DISC_CACHE_MAGIC, DISC_CACHE_VERSION, key);
+	fwrite(log, disc_cache_log_size(log), 1, f);
+
+	if (fflush(f) || ferror(f) || rename(tmp, path)) {
+		unlink(tmp);
+		return -EIO;
+	}
+
+	return 0;
+}
@@ -0,0 +1,10 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+#ifndef _DISCOVERY_CACHE_H
+#define _DISCOVERY_CACHE_H
+
+#include <libnvme.h>
+
+struct nvmf_discovery_log *disc_cache_load(nvme_ctrl_t c);
+int disc_cache_save(nvme_ctrl_t c, struct nvmf_discovery_log *log);
+
+#endif /* _DISCOVERY_CACHE_H */
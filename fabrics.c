@@ -22,12 +22,15 @@
 #include <errno.h>
 #include <getopt.h>
 #include <fcntl.h>
+#include <fnmatch.h>
+#include <regex.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <unistd.h>
 #include <dirent.h>
+#include <limits.h>
 #include <inttypes.h>
 #include <libgen.h>
 #include <sys/stat.h>
@@ -35,9 +38,14 @@
 #include <syslog.h>
 #include <time.h>
 
+#include <sys/random.h>
 #include <sys/types.h>
 #include <linux/types.h>
 
+#include <ccan/ccan/htable/htable_type.h>
+#include <ccan/ccan/htable/htable.h>
+#include <ccan/ccan/hash/hash.h>
+
 #include <libnvme.h>
 
 #include "common.h"
@@ -45,8 +53,16 @@
 #include "nbft.h"
 #include "nvme-print.h"
 #include "fabrics.h"
+#include "discovery-cache.h"
+#include "topology-cache.h"
 #include "util/cleanup.h"
 #include "util/logging.h"
+#include "util/parallel.h"
+#include "util/ratelimit.h"
+
+#ifdef CONFIG_JSONC
+#include <json.h>
+#endif
 
 #define PATH_NVMF_DISC		SYSCONFDIR "/nvme/discovery.conf"
 #define PATH_NVMF_CONFIG	SYSCONFDIR "/nvme/config.json"
@@ -55,12 +71,29 @@
 #define MAX_DISC_RETRIES	10
 
 #define NVMF_DEF_DISC_TMO	30
+#define NVMF_DEF_CONNECT_JOBS	8
+#define NVMF_TIMING_WAIT_MS	10000
+#define NVMF_DEF_BACKOFF_MS	500
+#define NVMF_DEF_BACKOFF_MAX_MS	30000
 
 /* Name of file to output log pages in their raw format */
 static char *raw;
 static bool persistent;
 static bool quiet;
 static bool dump_config;
+static struct topo_cache *topo_cache;
+static unsigned int connect_jobs = NVMF_DEF_CONNECT_JOBS;
+static const char *connect_config;
+static unsigned int discovery_tmo;
+static bool incremental;
+static bool prune_removed;
+static struct nvmf_timing *timing;
+static unsigned int connect_rate;
+static unsigned int connect_burst;
+static unsigned int connect_retries;
+static unsigned int connect_backoff_ms = NVMF_DEF_BACKOFF_MS;
+static unsigned int connect_backoff_max_ms = NVMF_DEF_BACKOFF_MAX_MS;
+static struct ratelimit connect_rl;
 
 static const char *nvmf_tport		= "transport type";
 static const char *nvmf_traddr		= "transport address";
@@ -93,6 +126,20 @@ static const char *nvmf_tls		= "enable TLS";
 static const char *nvmf_concat		= "enable secure concatenation";
 static const char *nvmf_config_file	= "Use specified JSON configuration file or 'none' to disable";
 static const char *nvmf_context		= "execution context identification string";
+static const char *nvmf_jobs		= "maximum number of concurrent connects (connect-all, config --apply)";
+static const char *nvmf_discovery_tmo	= "discovery log page timeout in seconds";
+static const char *nvmf_incremental	= "reuse cached discovery log while its generation counter is unchanged";
+static const char *nvmf_prune_removed	= "with --incremental, disconnect controllers whose records were removed from the discovery logs";
+static const char *nvmf_timing		= "report the time spent in each connect phase";
+static const char *nvmf_connect_rate	= "maximum number of connects per second (connect-all, 0: unlimited)";
+static const char *nvmf_connect_burst	= "number of connects allowed at once before rate limiting";
+static const char *nvmf_connect_retries	= "number of retries of failed connects (connect-all)";
+static const char *nvmf_connect_backoff	= "initial retry backoff in milliseconds, doubled per retry";
+static const char *nvmf_disconnect_jobs	= "maximum number of concurrent disconnects";
+static const char *nvmf_apply		= "connect and disconnect controllers to match the JSON configuration";
+static const char *nvmf_dry_run		= "print the --apply plan without connecting or disconnecting";
+static const char *nvmf_prune		= "with --apply, also disconnect I/O controllers which are not configured";
+static const char *nvmf_regex		= "match --nqn and --traddr as extended regular expressions instead of globs";
 
 #define NVMF_ARGS(n, c, ...)                                                                     \
 	struct argconfig_commandline_options n[] = {                                             \
@@ -139,7 +186,7 @@ static bool is_persistent_discovery_ctrl(nvme_host_t h, nvme_ctrl_t c)
 nvme_ctrl_t lookup_ctrl(nvme_host_t h, struct tr_config *trcfg)
 {
 	nvme_subsystem_t s;
-	nvme_ctrl_t c;
+	nvme_ctrl_t c, cached, found = NULL;
 
 	nvme_for_each_subsystem(h, s) {
 		c = nvme_ctrl_find(s,
@@ -149,14 +196,27 @@ nvme_ctrl_t lookup_ctrl(nvme_host_t h, struct tr_config *trcfg)
 				   trcfg->subsysnqn,
 				   trcfg->host_traddr,
 				   trcfg->host_iface);
-		if (c)
+		if (c && (!topo_cache || nvme_ctrl_get_name(c)))
 			return c;
+		if (c && !found)
+			found = c;
 	}
 
-	return NULL;
+	/*
+	 * The tree has not been scanned when a valid topology snapshot
+	 * was loaded, only controllers from the configuration or created
+	 * by this invocation are known. Consult the snapshot for live ones.
+	 */
+	if (topo_cache) {
+		cached = topo_cache_lookup(topo_cache, h, trcfg);
+		if (cached)
+			return cached;
+	}
+
+	return found;
 }
 
-static int set_discovery_kato(struct nvme_fabrics_config *cfg)
+static int set_discovery_kato(struct nvme_fabrics_config *cfg, bool persistent)
 {
 	int tmo = cfg->keep_alive_tmo;
 
@@ -172,7 +232,8 @@ static int set_discovery_kato(struct nvme_fabrics_config *cfg)
 
 static nvme_ctrl_t __create_discover_ctrl(nvme_root_t r, nvme_host_t h,
 					  struct nvme_fabrics_config *cfg,
-					  struct tr_config *trcfg)
+					  struct tr_config *trcfg,
+					  bool persistent)
 {
 	nvme_ctrl_t c;
 	int tmo, ret;
@@ -186,7 +247,7 @@ static nvme_ctrl_t __create_discover_ctrl(nvme_root_t r, nvme_host_t h,
 	nvme_ctrl_set_discovery_ctrl(c, true);
 	nvme_ctrl_set_unique_discovery_ctrl(c,
 		     strcmp(trcfg->subsysnqn, NVME_DISC_SUBSYS_NAME));
-	tmo = set_discovery_kato(cfg);
+	tmo = set_discovery_kato(cfg, persistent);
 
 	errno = 0;
 	ret = nvmf_add_ctrl(h, c, cfg);
@@ -200,14 +261,15 @@ static nvme_ctrl_t __create_discover_ctrl(nvme_root_t r, nvme_host_t h,
 	return c;
 }
 
-nvme_ctrl_t nvmf_create_discover_ctrl(nvme_root_t r, nvme_host_t h,
-				      struct nvme_fabrics_config *cfg,
-				       struct tr_config *trcfg)
+static nvme_ctrl_t create_discover_ctrl(nvme_root_t r, nvme_host_t h,
+					struct nvme_fabrics_config *cfg,
+					struct tr_config *trcfg,
+					bool persistent)
 {
 	_cleanup_free_ struct nvme_id_ctrl *id = NULL;
 	nvme_ctrl_t c;
 
-	c = __create_discover_ctrl(r, h, cfg, trcfg);
+	c = __create_discover_ctrl(r, h, cfg, trcfg, persistent);
 	if (!c)
 		return NULL;
 
@@ -238,7 +300,14 @@ nvme_ctrl_t nvmf_create_discover_ctrl(nvme_root_t r, nvme_host_t h,
 	nvme_free_ctrl(c);
 
 	trcfg->subsysnqn = id->subnqn;
-	return __create_discover_ctrl(r, h, cfg, trcfg);
+	return __create_discover_ctrl(r, h, cfg, trcfg, persistent);
+}
+
+nvme_ctrl_t nvmf_create_discover_ctrl(nvme_root_t r, nvme_host_t h,
+				      struct nvme_fabrics_config *cfg,
+				       struct tr_config *trcfg)
+{
+	return create_discover_ctrl(r, h, cfg, trcfg, persistent);
 }
 
 static void save_discovery_log(char *raw, struct nvmf_discovery_log *log)
@@ -252,137 +321,885 @@ static void save_discovery_log(char *raw, struct nvmf_discovery_log *log)
 		return;
 	}
 
-	len = sizeof(struct nvmf_discovery_log) + numrec * sizeof(struct nvmf_disc_log_entry);
+	len = sizeof(struct nvmf_discovery_log) + numrec * sizeof(struct nvmf_disc_log_entry);
+
+	ret = write(fd, log, len);
+	if (ret < 0)
+		fprintf(stderr, "failed to write to %s: %s\n",
+			raw, strerror(errno));
+	else
+		printf("Discovery log is saved to %s\n", raw);
+
+	close(fd);
+}
+
+static int nvme_read_volatile_config(nvme_root_t r)
+{
+	char *filename, *ext;
+	struct dirent *dir;
+	DIR *d;
+	int ret = -ENOENT;
+
+	d = opendir(PATH_NVMF_RUNDIR);
+	if (!d)
+		return -ENOTDIR;
+
+	while ((dir = readdir(d))) {
+		if (dir->d_type != DT_REG)
+			continue;
+
+		ext = strchr(dir->d_name, '.');
+		if (!ext || strcmp("json", ext + 1))
+			continue;
+
+		if (asprintf(&filename, "%s/%s", PATH_NVMF_RUNDIR, dir->d_name) < 0) {
+			ret = -ENOMEM;
+			break;
+		}
+
+		if (nvme_read_config(r, filename))
+			ret = 0;
+
+		free(filename);
+	}
+	closedir(d);
+
+	return ret;
+}
+
+static int nvme_read_config_checked(nvme_root_t r, const char *filename)
+{
+	if (access(filename, F_OK))
+		return -errno;
+	if (nvme_read_config(r, filename))
+		return -errno;
+	return 0;
+}
+
+static const char * const timing_phase_str[] = {
+	[NVMF_TIMING_DISC_CONNECT]	= "discovery_connect",
+	[NVMF_TIMING_DISC_LOG]		= "discovery_log",
+	[NVMF_TIMING_CONNECT]		= "connect",
+	[NVMF_TIMING_LIVE]		= "ctrl_live",
+	[NVMF_TIMING_NS_LIVE]		= "ns_live",
+};
+
+const char *nvmf_timing_phase_str(enum nvmf_timing_phase phase)
+{
+	if (phase < ARRAY_SIZE(timing_phase_str))
+		return timing_phase_str[phase];
+	return "unknown";
+}
+
+static uint64_t timing_now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void timing_entry_init(struct nvmf_timing_entry *te,
+			      const char *transport, const char *traddr,
+			      const char *trsvcid, const char *subsysnqn,
+			      bool discovery)
+{
+	int i;
+
+	memset(te, 0, sizeof(*te));
+	for (i = 0; i < NVMF_TIMING_NR_PHASES; i++)
+		te->phase_us[i] = NVMF_TIMING_UNSET;
+
+	snprintf(te->transport, sizeof(te->transport), "%s", transport ? : "");
+	snprintf(te->traddr, sizeof(te->traddr), "%s", traddr ? : "");
+	snprintf(te->trsvcid, sizeof(te->trsvcid), "%s", trsvcid ? : "");
+	snprintf(te->subsysnqn, sizeof(te->subsysnqn), "%s", subsysnqn ? : "");
+	te->discovery = discovery;
+}
+
+static bool timing_ctrl_live(const char *name)
+{
+	char path[PATH_MAX], state[16] = { 0 };
+	_cleanup_fd_ int fd = -1;
+
+	snprintf(path, sizeof(path), "/sys/class/nvme/%s/state", name);
+	fd = open(path, O_RDONLY);
+	if (fd < 0 || read(fd, state, sizeof(state) - 1) < 0)
+		return false;
+
+	return !strncmp(state, "live", 4);
+}
+
+/* Counts the namespace block devices (nvmeXnY or nvmeXcYnZ) of a controller */
+static int timing_sysfs_ns(const char *name)
+{
+	char path[PATH_MAX];
+	struct dirent *de;
+	unsigned int a, b, n;
+	int nr = 0;
+	DIR *d;
+
+	snprintf(path, sizeof(path), "/sys/class/nvme/%s", name);
+	d = opendir(path);
+	if (!d)
+		return 0;
+
+	while ((de = readdir(d)))
+		if (sscanf(de->d_name, "nvme%uc%un%u", &a, &b, &n) == 3 ||
+		    sscanf(de->d_name, "nvme%un%u", &a, &n) == 2)
+			nr++;
+	closedir(d);
+
+	return nr;
+}
+
+static int timing_active_ns(nvme_ctrl_t c)
+{
+	_cleanup_free_ struct nvme_ns_list *list = NULL;
+	int fd, i;
+
+	fd = nvme_ctrl_get_fd(c);
+	if (fd < 0)
+		return -errno;
+
+	list = nvme_alloc(sizeof(*list));
+	if (!list)
+		return -ENOMEM;
+
+	if (nvme_identify_active_ns_list(fd, 0, list))
+		return -EIO;
+
+	for (i = 0; i < NVME_ID_NS_LIST_MAX; i++)
+		if (!list->ns[i])
+			break;
+
+	return i;
+}
+
+/*
+ * The kernel sets up the transport, performs the TLS handshake and
+ * authentication and creates the admin and I/O queues while the write
+ * to /dev/nvme-fabrics is pending. These are reported as a single
+ * connect phase. Afterwards the controller is polled until it is live
+ * and all of its active namespaces are registered, each of the phases
+ * measured from the end of the previous one.
+ */
+static void timing_connected(struct nvmf_timing_entry *te, nvme_host_t h,
+			     nvme_ctrl_t c, uint64_t start, int err)
+{
+	struct nvme_fabrics_config *cfg;
+	uint64_t now = timing_now_us(), deadline;
+	int nr;
+
+	te->phase_us[te->discovery ? NVMF_TIMING_DISC_CONNECT :
+		     NVMF_TIMING_CONNECT] = now - start;
+	te->err = err;
+	if (!c)
+		return;
+
+	snprintf(te->device, sizeof(te->device), "%s", nvme_ctrl_get_name(c));
+	cfg = nvme_ctrl_get_config(c);
+	te->tls = cfg && (cfg->tls || cfg->concat);
+	te->dhchap = nvme_ctrl_get_dhchap_host_key(c) ||
+		nvme_host_get_dhchap_key(h);
+
+	start = now;
+	deadline = start + NVMF_TIMING_WAIT_MS * 1000;
+	while (!timing_ctrl_live(te->device)) {
+		if (timing_now_us() > deadline)
+			return;
+		usleep(1000);
+	}
+	now = timing_now_us();
+	te->phase_us[NVMF_TIMING_LIVE] = now - start;
+
+	if (te->discovery)
+		return;
+
+	nr = timing_active_ns(c);
+	if (nr < 0)
+		return;
+	te->nr_ns = nr;
+
+	start = now;
+	deadline = start + NVMF_TIMING_WAIT_MS * 1000;
+	while (timing_sysfs_ns(te->device) < nr) {
+		if (timing_now_us() > deadline)
+			return;
+		usleep(1000);
+	}
+	te->phase_us[NVMF_TIMING_NS_LIVE] = timing_now_us() - start;
+}
+
+static void timing_add(struct nvmf_timing_entry *te)
+{
+	struct nvmf_timing_entry *entry;
+
+	if (!timing)
+		return;
+
+	entry = realloc(timing->entry, (timing->nr + 1) * sizeof(*entry));
+	if (!entry)
+		return;
+
+	timing->entry = entry;
+	timing->entry[timing->nr++] = *te;
+}
+
+static int timing_cmp(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+int nvmf_timing_stats(struct nvmf_timing *t, enum nvmf_timing_phase phase,
+		      struct nvmf_timing_stats *stats)
+{
+	_cleanup_free_ uint64_t *val = NULL;
+	uint64_t sum = 0;
+	unsigned int i, nr = 0;
+
+	memset(stats, 0, sizeof(*stats));
+	if (!t->nr)
+		return 0;
+
+	val = calloc(t->nr, sizeof(*val));
+	if (!val)
+		return -ENOMEM;
+
+	for (i = 0; i < t->nr; i++) {
+		if (t->entry[i].phase_us[phase] == NVMF_TIMING_UNSET)
+			continue;
+		val[nr++] = t->entry[i].phase_us[phase];
+		sum += t->entry[i].phase_us[phase];
+	}
+	if (!nr)
+		return 0;
+
+	qsort(val, nr, sizeof(*val), timing_cmp);
+	stats->count = nr;
+	stats->min_us = val[0];
+	stats->max_us = val[nr - 1];
+	stats->avg_us = sum / nr;
+	stats->p50_us = val[(nr - 1) / 2];
+	stats->p99_us = val[(nr - 1) * 99 / 100];
+
+	return nr;
+}
+
+static void timing_report(uint64_t start, nvme_print_flags_t flags)
+{
+	if (!timing)
+		return;
+
+	timing->elapsed_us = timing_now_us() - start;
+	nvme_show_connect_timing(timing, flags);
+	free(timing->entry);
+	free(timing);
+	timing = NULL;
+}
+
+/*
+ * Connect scheduler for connect-all. After a fabric outage many hosts
+ * reconnect at the same time, so besides the number of connects in
+ * flight (--jobs) the connect rate is limited by a token bucket, and
+ * connects failing with a transient error are retried after a jittered
+ * exponential backoff. The parameters can also be set per host in the
+ * JSON configuration file:
+ *
+ *   "connect_scheduler": {
+ *     "max_inflight": 8, "rate": 20, "burst": 40,
+ *     "retries": 5, "backoff_ms": 500, "backoff_max_ms": 30000
+ *   }
+ *
+ * Command line options take precedence. libnvme does not know the key,
+ * so 'nvme config --update' does not write it back.
+ */
+#ifdef CONFIG_JSONC
+static void connect_sched_config_uint(struct json_object *sc, const char *key,
+				      struct argconfig_commandline_options *opts,
+				      const char *opt, unsigned int *val)
+{
+	struct json_object *o;
+	int64_t v;
+
+	if (!json_object_object_get_ex(sc, key, &o))
+		return;
+	if (opt && argconfig_parse_seen(opts, opt))
+		return;
+
+	v = json_object_get_int64(o);
+	if (!json_object_is_type(o, json_type_int) || v < 0 || v > UINT_MAX) {
+		fprintf(stderr, "ignoring invalid connect_scheduler %s\n", key);
+		return;
+	}
+	*val = v;
+}
+
+static void connect_sched_read_config(const char *file, const char *hostnqn,
+				      struct argconfig_commandline_options *opts)
+{
+	struct json_object *root, *host, *sc, *nqn;
+	size_t i;
+
+	if (!file)
+		return;
+
+	root = json_object_from_file(file);
+	if (!root)
+		return;
+
+	if (!json_object_is_type(root, json_type_array))
+		goto out;
+
+	for (i = 0; i < json_object_array_length(root); i++) {
+		host = json_object_array_get_idx(root, i);
+		if (!json_object_object_get_ex(host, "connect_scheduler", &sc))
+			continue;
+		if (hostnqn && json_object_object_get_ex(host, "hostnqn", &nqn) &&
+		    strcmp(json_object_get_string(nqn), hostnqn))
+			continue;
+
+		connect_sched_config_uint(sc, "max_inflight", opts, "jobs",
+					  &connect_jobs);
+		connect_sched_config_uint(sc, "rate", opts, "connect-rate",
+					  &connect_rate);
+		connect_sched_config_uint(sc, "burst", opts, "connect-burst",
+					  &connect_burst);
+		connect_sched_config_uint(sc, "retries", opts, "connect-retries",
+					  &connect_retries);
+		connect_sched_config_uint(sc, "backoff_ms", opts, "connect-backoff",
+					  &connect_backoff_ms);
+		connect_sched_config_uint(sc, "backoff_max_ms", opts, NULL,
+					  &connect_backoff_max_ms);
+		break;
+	}
+out:
+	json_object_put(root);
+}
+#else /* CONFIG_JSONC */
+static void connect_sched_read_config(const char *file, const char *hostnqn,
+				      struct argconfig_commandline_options *opts)
+{
+}
+#endif /* CONFIG_JSONC */
+
+static unsigned int connect_sched_seed(unsigned int idx)
+{
+	unsigned int seed;
+
+	/* Hosts started together must not share the retry schedule */
+	if (getrandom(&seed, sizeof(seed), GRND_NONBLOCK) != sizeof(seed))
+		seed = getpid() ^ timing_now_us();
+
+	return seed ^ idx;
+}
+
+/*
+ * Sleeps before the next attempt when @err is a transient connect
+ * failure and retries are left. Returns false when giving up.
+ */
+static bool connect_sched_backoff(int err, unsigned int attempt,
+				  unsigned int *seed)
+{
+	struct timespec ts;
+	uint64_t delay;
+
+	switch (err) {
+	case ENVME_CONNECT_WRITE:
+	case ENVME_CONNECT_CONNREFUSED:
+	case ENVME_CONNECT_ADDRNOTAVAIL:
+		break;
+	default:
+		return false;
+	}
+
+	if (attempt >= connect_retries)
+		return false;
+
+	delay = backoff_jitter_us(attempt, connect_backoff_ms * 1000ULL,
+				  connect_backoff_max_ms * 1000ULL, seed);
+	if (log_level >= LOG_INFO)
+		fprintf(stderr, "connect failed: %s, retrying in %" PRIu64 " ms\n",
+			nvme_strerror(err), delay / 1000);
+
+	ts.tv_sec = delay / 1000000;
+	ts.tv_nsec = (delay % 1000000) * 1000;
+	nanosleep(&ts, NULL);
+
+	return true;
+}
+
+/*
+ * An entry of the discovery log connected from the connect-all worker
+ * pool. libnvme trees are not thread safe, so concurrent connects each
+ * work on a private tree set up like the shared one. The resulting
+ * controllers are moved to the shared tree once the pool is done.
+ */
+struct disc_connect {
+	struct nvmf_disc_log_entry *e;
+	bool discovery;
+	bool disconnect;
+	bool discover;
+	nvme_root_t r;
+	nvme_ctrl_t child;
+	int err;
+	struct nvmf_timing_entry timing;
+};
+
+struct disc_connect_ctx {
+	nvme_host_t h;
+	const char *app;
+	const struct nvme_fabrics_config *defcfg;
+	struct disc_connect *dc;
+	bool private;
+};
+
+static nvme_host_t nvmf_private_host(nvme_host_t h, const char *app,
+				     nvme_root_t *rp)
+{
+	nvme_root_t r;
+	nvme_host_t ph;
+
+	r = nvme_create_root(stderr, log_level);
+	if (!r)
+		return NULL;
+
+	if (app)
+		nvme_root_set_application(r, app);
+	if (connect_config)
+		nvme_read_config_checked(r, connect_config);
+	nvme_read_volatile_config(r);
+
+	ph = nvme_lookup_host(r, nvme_host_get_hostnqn(h),
+			      nvme_host_get_hostid(h));
+	if (!ph) {
+		nvme_free_tree(r);
+		return NULL;
+	}
+
+	if (nvme_host_get_dhchap_key(h))
+		nvme_host_set_dhchap_key(ph, nvme_host_get_dhchap_key(h));
+	if (nvme_host_get_hostsymname(h))
+		nvme_host_set_hostsymname(ph, nvme_host_get_hostsymname(h));
+	nvme_host_set_pdc_enabled(ph,
+		nvme_host_is_pdc_enabled(h, DEFAULT_PDC_ENABLED));
+
+	*rp = r;
+	return ph;
+}
+
+static void disc_connect_one(unsigned int idx, void *arg)
+{
+	struct disc_connect_ctx *ctx = arg;
+	struct disc_connect *dc = &ctx->dc[idx];
+	struct nvme_fabrics_config cfg = *ctx->defcfg;
+	unsigned int attempt, seed = connect_sched_seed(idx);
+	nvme_host_t h = ctx->h;
+	uint64_t start = 0;
+
+	if (timing)
+		timing_entry_init(&dc->timing, nvmf_trtype_str(dc->e->trtype),
+				  dc->e->traddr, dc->e->trsvcid, dc->e->subnqn,
+				  dc->discovery);
+
+	if (ctx->private) {
+		h = nvmf_private_host(ctx->h, ctx->app, &dc->r);
+		if (!h) {
+			dc->err = errno ? errno : ENOMEM;
+			if (timing)
+				dc->timing.err = dc->err;
+			return;
+		}
+	}
+
+	if (dc->discovery)
+		set_discovery_kato(&cfg, persistent);
+
+	for (attempt = 0;; attempt++) {
+		ratelimit_wait(&connect_rl);
+		start = timing_now_us();
+
+		errno = 0;
+		dc->child = nvmf_connect_disc_entry(h, dc->e, &cfg,
+						    &dc->discover);
+		dc->err = dc->child ? 0 : errno;
+		if (dc->child || !connect_sched_backoff(dc->err, attempt, &seed))
+			break;
+	}
+
+	if (timing)
+		timing_connected(&dc->timing, h, dc->child, start, dc->err);
+}
+
+static bool disc_entry_equal(struct nvmf_disc_log_entry *a,
+			     struct nvmf_disc_log_entry *b)
+{
+	return a->trtype == b->trtype &&
+		!strncmp(a->traddr, b->traddr, sizeof(a->traddr)) &&
+		!strncmp(a->trsvcid, b->trsvcid, sizeof(a->trsvcid)) &&
+		!strncmp(a->subnqn, b->subnqn, sizeof(a->subnqn));
+}
+
+static struct nvmf_discovery_log *get_discovery_log(nvme_ctrl_t c)
+{
+	struct nvme_get_discovery_args args = {
+		.c = c,
+		.args_size = sizeof(args),
+		.max_retries = MAX_DISC_RETRIES,
+		.result = 0,
+		.timeout = NVME_DEFAULT_IOCTL_TIMEOUT,
+		.lsp = 0,
+	};
+
+	if (discovery_tmo)
+		args.timeout = discovery_tmo * 1000;
+
+	return nvmf_get_discovery_wargs(&args);
+}
+
+static int get_discovery_genctr(nvme_ctrl_t c, uint64_t *genctr)
+{
+	_cleanup_free_ struct nvmf_discovery_log *hdr = NULL;
+	int ret;
+
+	hdr = nvme_alloc(sizeof(*hdr));
+	if (!hdr)
+		return -ENOMEM;
+
+	struct nvme_get_log_args args = {
+		.args_size	= sizeof(args),
+		.fd		= nvme_ctrl_get_fd(c),
+		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
+		.lid		= NVME_LOG_LID_DISCOVER,
+		.nsid		= NVME_NSID_NONE,
+		.csi		= NVME_CSI_NVM,
+		.lsi		= NVME_LOG_LSI_NONE,
+		.lsp		= NVME_LOG_LSP_NONE,
+		.uuidx		= NVME_UUID_NONE,
+		.len		= sizeof(*hdr),
+		.log		= hdr,
+		.result		= NULL,
+	};
+
+	if (discovery_tmo)
+		args.timeout = discovery_tmo * 1000;
+
+	ret = nvme_get_log(&args);
+	if (ret)
+		return ret < 0 ? -errno : -EIO;
+
+	*genctr = le64_to_cpu(hdr->genctr);
+	return 0;
+}
+
+/*
+ * Returns the discovery log page of @c. With --incremental the log page
+ * retrieved by the previous run is reused as long as the generation
+ * counter is unchanged, which only costs fetching the header. When it
+ * changed, @prev receives the previous log page so that the caller can
+ * act on the records which disappeared, and @update is set: the caller
+ * saves the new log page with disc_cache_update() once it did so.
+ */
+static struct nvmf_discovery_log *fetch_discovery_log(nvme_ctrl_t c,
+					struct nvmf_discovery_log **prev,
+					bool *update)
+{
+	struct nvmf_discovery_log *cached = NULL, *log;
+	uint64_t genctr;
+
+	*prev = NULL;
+	*update = false;
+	if (!incremental)
+		return get_discovery_log(c);
+
+	cached = disc_cache_load(c);
+	if (cached && !get_discovery_genctr(c, &genctr) &&
+	    genctr == le64_to_cpu(cached->genctr))
+		return cached;
+
+	log = get_discovery_log(c);
+	if (!log) {
+		free(cached);
+		return NULL;
+	}
+
+	*prev = cached;
+	*update = true;
+	return log;
+}
+
+/*
+ * Replaces the cached log page of @c by @log. While records removed
+ * since the cached log page @prev were not pruned the old one is kept,
+ * so that a later run with --prune-removed still acts on them.
+ */
+static void disc_cache_update(nvme_ctrl_t c, struct nvmf_discovery_log *log,
+			      struct nvmf_discovery_log *prev, bool pruned)
+{
+	if (prev && !pruned)
+		return;
+
+	disc_cache_save(c, log);
+}
+
+static bool disc_record_reported(struct nvmf_discovery_log **logs,
+				 unsigned int nr_logs,
+				 struct nvmf_disc_log_entry *e)
+{
+	unsigned int i;
+	uint64_t j;
+
+	for (i = 0; i < nr_logs; i++) {
+		if (!logs[i])
+			continue;
+		for (j = 0; j < le64_to_cpu(logs[i]->numrec); j++)
+			if (disc_entry_equal(&logs[i]->entries[j], e))
+				return true;
+	}
+
+	return false;
+}
+
+/*
+ * Disconnects the I/O controllers of the records of @prev which none of
+ * the current discovery log pages in @logs reports any longer. Referrals
+ * are not followed, the records they returned are handled by their own
+ * discovery log pages. Only called with --prune-removed: the controller
+ * may as well have been connected manually or from the configuration.
+ */
+static void disconnect_removed_entries(nvme_ctrl_t c,
+				       struct nvmf_discovery_log **logs,
+				       unsigned int nr_logs,
+				       struct nvmf_discovery_log *prev,
+				       const struct nvme_fabrics_config *defcfg)
+{
+	nvme_subsystem_t s = nvme_ctrl_get_subsystem(c);
+	nvme_host_t h = nvme_subsystem_get_host(s);
+	uint64_t i;
+	int nr = 0;
+
+	for (i = 0; i < le64_to_cpu(prev->numrec); i++) {
+		struct nvmf_disc_log_entry *e = &prev->entries[i];
+		nvme_ctrl_t cl;
+
+		if (e->subtype != NVME_NQN_NVME)
+			continue;
+
+		if (disc_record_reported(logs, nr_logs, e))
+			continue;
+
+		struct tr_config trcfg = {
+			.subsysnqn	= e->subnqn,
+			.transport	= nvmf_trtype_str(e->trtype),
+			.traddr		= e->traddr,
+			.host_traddr	= defcfg->host_traddr,
+			.host_iface	= defcfg->host_iface,
+			.trsvcid	= e->trsvcid,
+		};
+
+		cl = lookup_ctrl(h, &trcfg);
+		if (!cl || !nvme_ctrl_get_name(cl))
+			continue;
 
-	ret = write(fd, log, len);
-	if (ret < 0)
-		fprintf(stderr, "failed to write to %s: %s\n",
-			raw, strerror(errno));
-	else
-		printf("Discovery log is saved to %s\n", raw);
+		if (nvme_disconnect_ctrl(cl)) {
+			fprintf(stderr, "failed to disconnect %s: %s\n",
+				nvme_ctrl_get_name(cl), nvme_strerror(errno));
+			continue;
+		}
+		if (!quiet)
+			printf("disconnected %s, record removed from discovery log\n",
+			       e->subnqn);
+		nr++;
+	}
 
-	close(fd);
+	if (nr)
+		topo_cache_invalidate();
 }
 
-static int __discover(nvme_ctrl_t c, struct nvme_fabrics_config *defcfg,
-		      char *raw, bool connect, bool persistent,
-		      nvme_print_flags_t flags)
+static int __discover(nvme_root_t r, nvme_ctrl_t c,
+		      struct nvme_fabrics_config *defcfg, char *raw,
+		      bool connect, bool persistent, nvme_print_flags_t flags,
+		      struct nvmf_timing_entry *te);
+
+static void connect_disc_log(nvme_root_t r, nvme_ctrl_t c,
+			     struct nvmf_discovery_log *log, uint64_t numrec,
+			     struct nvme_fabrics_config *defcfg, char *raw,
+			     bool persistent, nvme_print_flags_t flags)
 {
-	struct nvmf_discovery_log *log = NULL;
 	nvme_subsystem_t s = nvme_ctrl_get_subsystem(c);
 	nvme_host_t h = nvme_subsystem_get_host(s);
-	uint64_t numrec;
-
-	struct nvme_get_discovery_args args = {
-		.c = c,
-		.args_size = sizeof(args),
-		.max_retries = MAX_DISC_RETRIES,
-		.result = 0,
-		.timeout = NVME_DEFAULT_IOCTL_TIMEOUT,
-		.lsp = 0,
+	_cleanup_free_ struct disc_connect *dc = NULL;
+	struct disc_connect_ctx ctx = {
+		.h = h,
+		.app = nvme_root_get_application(r),
+		.defcfg = defcfg,
 	};
+	unsigned int nr = 0, i, j;
 
-	log = nvmf_get_discovery_wargs(&args);
-	if (!log) {
-		fprintf(stderr, "failed to get discovery log: %s\n",
-			nvme_strerror(errno));
-		return -errno;
+	dc = calloc(numrec ? numrec : 1, sizeof(*dc));
+	if (!dc) {
+		fprintf(stderr, "failed to allocate connect list\n");
+		return;
 	}
 
-	numrec = le64_to_cpu(log->numrec);
-	if (raw)
-		save_discovery_log(raw, log);
-	else if (!connect) {
-		nvme_show_discovery_log(log, numrec, flags);
-	} else if (connect) {
-		int i;
-
-		for (i = 0; i < numrec; i++) {
-			struct nvmf_disc_log_entry *e = &log->entries[i];
-			nvme_ctrl_t cl;
-			bool discover = false;
-			bool disconnect;
-			nvme_ctrl_t child;
-			int tmo = defcfg->keep_alive_tmo;
-
-			struct tr_config trcfg = {
-				.subsysnqn	= e->subnqn,
-				.transport	= nvmf_trtype_str(e->trtype),
-				.traddr		= e->traddr,
-				.host_traddr	= defcfg->host_traddr,
-				.host_iface	= defcfg->host_iface,
-				.trsvcid	= e->trsvcid,
-			};
-
-			/* Already connected ? */
-			cl = lookup_ctrl(h, &trcfg);
-			if (cl && nvme_ctrl_get_name(cl))
-				continue;
+	for (i = 0; i < numrec; i++) {
+		struct nvmf_disc_log_entry *e = &log->entries[i];
+		bool discovery = false, disconnect;
+		nvme_ctrl_t cl;
+
+		struct tr_config trcfg = {
+			.subsysnqn	= e->subnqn,
+			.transport	= nvmf_trtype_str(e->trtype),
+			.traddr		= e->traddr,
+			.host_traddr	= defcfg->host_traddr,
+			.host_iface	= defcfg->host_iface,
+			.trsvcid	= e->trsvcid,
+		};
+
+		/* Already connected ? */
+		cl = lookup_ctrl(h, &trcfg);
+		if (cl && nvme_ctrl_get_name(cl))
+			continue;
 
-			/* Skip connect if the transport types don't match */
-			if (strcmp(nvme_ctrl_get_transport(c),
-				   nvmf_trtype_str(e->trtype)))
+		/* Skip connect if the transport types don't match */
+		if (strcmp(nvme_ctrl_get_transport(c),
+			   nvmf_trtype_str(e->trtype)))
+			continue;
+
+		if (e->subtype == NVME_NQN_DISC ||
+		    e->subtype == NVME_NQN_CURR) {
+			__u16 eflags = le16_to_cpu(e->eflags);
+			/*
+			 * Does this discovery controller return the
+			 * same information?
+			 */
+			if (eflags & NVMF_DISC_EFLAGS_DUPRETINFO)
 				continue;
 
-			if (e->subtype == NVME_NQN_DISC ||
-			    e->subtype == NVME_NQN_CURR) {
-				__u16 eflags = le16_to_cpu(e->eflags);
+			/* Are we supposed to keep the discovery controller around? */
+			disconnect = !persistent;
+
+			if (strcmp(e->subnqn, NVME_DISC_SUBSYS_NAME)) {
 				/*
-				 * Does this discovery controller return the
-				 * same information?
+				 * Does this discovery controller doesn't
+				 * support explicit persistent connection?
 				 */
-				if (eflags & NVMF_DISC_EFLAGS_DUPRETINFO)
-					continue;
+				if (!(eflags & NVMF_DISC_EFLAGS_EPCSD))
+					disconnect = true;
+				else
+					disconnect = false;
+			}
 
-				/* Are we supposed to keep the discovery controller around? */
-				disconnect = !persistent;
-
-				if (strcmp(e->subnqn, NVME_DISC_SUBSYS_NAME)) {
-					/*
-					 * Does this discovery controller doesn't
-					 * support explicit persistent connection?
-					 */
-					if (!(eflags & NVMF_DISC_EFLAGS_EPCSD))
-						disconnect = true;
-					else
-						disconnect = false;
-				}
+			discovery = true;
+		} else {
+			/* NVME_NQN_NVME */
+			disconnect = false;
+		}
 
-				set_discovery_kato(defcfg);
-			} else {
-				/* NVME_NQN_NVME */
-				disconnect = false;
-			}
+		/*
+		 * A repeated entry is found connected by the lookup above
+		 * when connecting serially, concurrent connects would race.
+		 */
+		for (j = 0; j < nr; j++)
+			if (disc_entry_equal(dc[j].e, e))
+				break;
+		if (j < nr)
+			continue;
 
-			errno = 0;
-			child = nvmf_connect_disc_entry(h, e, defcfg,
-							&discover);
+		dc[nr].e = e;
+		dc[nr].discovery = discovery;
+		dc[nr].disconnect = disconnect;
+		nr++;
+	}
 
-			defcfg->keep_alive_tmo = tmo;
+	ctx.dc = dc;
+	/* The configuration dump needs the connect parameters in the tree */
+	ctx.private = connect_jobs > 1 && nr > 1 && !dump_config;
+	parallel_for_each(nr, ctx.private ? connect_jobs : 1,
+			  disc_connect_one, &ctx);
 
-			if (child) {
-				if (discover)
-					__discover(child, defcfg, raw,
-						   true, persistent, flags);
+	for (i = 0; i < nr; i++) {
+		struct nvmf_disc_log_entry *e = dc[i].e;
+		nvme_ctrl_t child = dc[i].child, sc;
 
-				if (disconnect) {
-					nvme_disconnect_ctrl(child);
-					nvme_free_ctrl(child);
-				}
-			} else if (errno == ENVME_CONNECT_ALREADY && !quiet) {
-				const char *subnqn = log->entries[i].subnqn;
-				const char *trtype = nvmf_trtype_str(log->entries[i].trtype);
-				const char *traddr = log->entries[i].traddr;
-				const char *trsvcid = log->entries[i].trsvcid;
+		if (child && dc[i].r) {
+			/*
+			 * Referrals and later lookups work on the shared
+			 * tree, rescan the new controller into it.
+			 */
+			sc = nvme_scan_ctrl(r, nvme_ctrl_get_name(child));
+			if (sc)
+				child = sc;
+		}
 
+		if (child) {
+			if (dc[i].discover)
+				__discover(r, child, defcfg, raw, true,
+					   persistent, flags,
+					   timing ? &dc[i].timing : NULL);
+			else
+				timing_add(&dc[i].timing);
+
+			if (dc[i].disconnect) {
+				nvme_disconnect_ctrl(child);
+				nvme_free_ctrl(child);
+			}
+		} else {
+			if (dc[i].err == ENVME_CONNECT_ALREADY && !quiet)
 				fprintf(stderr,
 					"already connected to hostnqn=%s,nqn=%s,transport=%s,traddr=%s,trsvcid=%s\n",
-					nvme_host_get_hostnqn(h), subnqn,
-					trtype, traddr, trsvcid);
-			}
+					nvme_host_get_hostnqn(h), e->subnqn,
+					nvmf_trtype_str(e->trtype), e->traddr,
+					e->trsvcid);
+			timing_add(&dc[i].timing);
+		}
+
+		if (dc[i].r)
+			nvme_free_tree(dc[i].r);
+	}
+}
+
+static int __discover(nvme_root_t r, nvme_ctrl_t c,
+		      struct nvme_fabrics_config *defcfg, char *raw,
+		      bool connect, bool persistent, nvme_print_flags_t flags,
+		      struct nvmf_timing_entry *te)
+{
+	struct nvmf_discovery_log *log = NULL, *prev = NULL;
+	uint64_t numrec, start = timing_now_us();
+	bool update, pruned = false;
+
+	log = fetch_discovery_log(c, &prev, &update);
+	if (te) {
+		te->phase_us[NVMF_TIMING_DISC_LOG] = timing_now_us() - start;
+		if (!log)
+			te->err = errno;
+		timing_add(te);
+	}
+	if (!log) {
+		fprintf(stderr, "failed to get discovery log: %s\n",
+			nvme_strerror(errno));
+		return -errno;
+	}
+
+	numrec = le64_to_cpu(log->numrec);
+	if (raw)
+		save_discovery_log(raw, log);
+	else if (!connect)
+		nvme_show_discovery_log(log, numrec, flags);
+	else {
+		connect_disc_log(r, c, log, numrec, defcfg, raw, persistent,
+				 flags);
+		if (prev && prune_removed) {
+			disconnect_removed_entries(c, &log, 1, prev, defcfg);
+			pruned = true;
 		}
 	}
+	if (update)
+		disc_cache_update(c, log, prev, pruned);
 
+	free(prev);
 	free(log);
 	return 0;
 }
@@ -405,8 +1222,315 @@ char *nvmf_get_default_trsvcid(const char *transport, bool discovery_ctrl)
 	return NULL;
 }
 
-static int discover_from_conf_file(nvme_root_t r, nvme_host_t h,
-				   const char *desc, bool connect,
+/*
+ * A discovery controller from the JSON configuration or discovery.conf.
+ * The discovery log pages of all configured controllers are fetched
+ * concurrently and processed in configuration order afterwards, so a
+ * slow or unreachable controller no longer delays the others.
+ */
+struct disc_job {
+	nvme_host_t h;
+	struct nvme_fabrics_config cfg;
+	struct tr_config trcfg;
+	char *str[6];
+	bool persistent;
+	bool json;
+	nvme_ctrl_t c;		/* controller in the shared tree */
+	nvme_ctrl_t pc;		/* controller created in the private tree */
+	nvme_root_t r;
+	bool created;
+	struct nvmf_discovery_log *log;
+	struct nvmf_discovery_log *prev;
+	bool update;
+	int err;
+	struct nvmf_timing_entry timing;
+};
+
+struct disc_jobs {
+	nvme_root_t r;
+	const char *app;
+	bool private;
+	struct disc_job *job;
+	unsigned int nr;
+};
+
+static bool tr_config_str_equal(const char *a, const char *b)
+{
+	if (!a || !b)
+		return a == b;
+	return !strcmp(a, b);
+}
+
+static char *disc_job_strdup(struct disc_job *job, int i, const char *str)
+{
+	if (!str)
+		return NULL;
+	job->str[i] = strdup(str);
+	return job->str[i];
+}
+
+/*
+ * Queues a discovery controller unless it is already queued. An already
+ * connected controller @c is reused and never disconnected.
+ */
+static int disc_jobs_add(struct disc_jobs *jobs, nvme_host_t h, nvme_ctrl_t c,
+			 const struct nvme_fabrics_config *cfg,
+			 struct tr_config *trcfg, bool persistent, bool json)
+{
+	struct disc_job *job;
+	unsigned int i;
+
+	for (i = 0; i < jobs->nr; i++) {
+		job = &jobs->job[i];
+		if (job->h == h &&
+		    tr_config_str_equal(job->trcfg.subsysnqn, trcfg->subsysnqn) &&
+		    tr_config_str_equal(job->trcfg.transport, trcfg->transport) &&
+		    tr_config_str_equal(job->trcfg.traddr, trcfg->traddr) &&
+		    tr_config_str_equal(job->trcfg.host_traddr, trcfg->host_traddr) &&
+		    tr_config_str_equal(job->trcfg.host_iface, trcfg->host_iface) &&
+		    tr_config_str_equal(job->trcfg.trsvcid, trcfg->trsvcid))
+			return 0;
+	}
+
+	job = realloc(jobs->job, (jobs->nr + 1) * sizeof(*job));
+	if (!job)
+		return -ENOMEM;
+	jobs->job = job;
+
+	job = &jobs->job[jobs->nr++];
+	memset(job, 0, sizeof(*job));
+	job->h = h;
+	job->c = c;
+	job->persistent = persistent;
+	job->json = json;
+	memcpy(&job->cfg, cfg, sizeof(job->cfg));
+
+	/* The conf file parser reuses its line buffer */
+	job->trcfg.subsysnqn = disc_job_strdup(job, 0, trcfg->subsysnqn);
+	job->trcfg.transport = disc_job_strdup(job, 1, trcfg->transport);
+	job->trcfg.traddr = disc_job_strdup(job, 2, trcfg->traddr);
+	job->trcfg.host_traddr = disc_job_strdup(job, 3, trcfg->host_traddr);
+	job->trcfg.host_iface = disc_job_strdup(job, 4, trcfg->host_iface);
+	job->trcfg.trsvcid = disc_job_strdup(job, 5, trcfg->trsvcid);
+	job->cfg.host_traddr = job->str[3];
+	job->cfg.host_iface = job->str[4];
+
+	return 0;
+}
+
+static void disc_jobs_free(struct disc_jobs *jobs)
+{
+	unsigned int i, j;
+
+	for (i = 0; i < jobs->nr; i++) {
+		for (j = 0; j < ARRAY_SIZE(jobs->job[i].str); j++)
+			free(jobs->job[i].str[j]);
+		free(jobs->job[i].log);
+		free(jobs->job[i].prev);
+		if (jobs->job[i].r)
+			nvme_free_tree(jobs->job[i].r);
+	}
+	free(jobs->job);
+	jobs->job = NULL;
+	jobs->nr = 0;
+}
+
+static void disc_job_fetch(unsigned int idx, void *arg)
+{
+	struct disc_jobs *jobs = arg;
+	struct disc_job *job = &jobs->job[idx];
+	struct tr_config trcfg = job->trcfg;
+	unsigned int attempt, seed = connect_sched_seed(idx);
+	nvme_ctrl_t c = job->c;
+	nvme_host_t h = job->h;
+	uint64_t start = 0;
+
+	if (timing) {
+		timing_entry_init(&job->timing, trcfg.transport, trcfg.traddr,
+				  trcfg.trsvcid, trcfg.subsysnqn, true);
+		if (c)
+			snprintf(job->timing.device, sizeof(job->timing.device),
+				 "%s", nvme_ctrl_get_name(c));
+	}
+
+	if (!c) {
+		errno = 0;
+		if (jobs->private) {
+			h = nvmf_private_host(job->h, jobs->app, &job->r);
+			if (!h) {
+				job->err = -(errno ? errno : ENOMEM);
+				return;
+			}
+		}
+		for (attempt = 0;; attempt++) {
+			ratelimit_wait(&connect_rl);
+			start = timing_now_us();
+
+			trcfg = job->trcfg;
+			errno = 0;
+			c = create_discover_ctrl(jobs->private ? job->r : jobs->r,
+						 h, &job->cfg, &trcfg,
+						 job->persistent);
+			if (c || !connect_sched_backoff(errno, attempt, &seed))
+				break;
+		}
+		if (jobs->private)
+			job->pc = c;
+		else
+			job->c = c;
+		if (timing)
+			timing_connected(&job->timing, h, c, start, c ? 0 : errno);
+		if (!c) {
+			job->err = -(errno ? errno : EIO);
+			return;
+		}
+		job->created = true;
+	}
+
+	start = timing_now_us();
+	job->log = fetch_discovery_log(c, &job->prev, &job->update);
+	if (!job->log)
+		job->err = -errno;
+	if (timing)
+		job->timing.phase_us[NVMF_TIMING_DISC_LOG] = timing_now_us() - start;
+}
+
+/* Appends the entries of @log to @merged which are not in it yet */
+static void merge_discovery_log(struct nvmf_discovery_log *merged,
+				struct nvmf_discovery_log *log)
+{
+	uint64_t numrec = le64_to_cpu(merged->numrec);
+	uint64_t i, j;
+
+	if (!numrec && !merged->genctr)
+		merged->genctr = log->genctr;
+
+	for (i = 0; i < le64_to_cpu(log->numrec); i++) {
+		for (j = 0; j < numrec; j++)
+			if (disc_entry_equal(&merged->entries[j], &log->entries[i]))
+				break;
+		if (j < numrec)
+			continue;
+		merged->entries[numrec++] = log->entries[i];
+	}
+
+	merged->numrec = cpu_to_le64(numrec);
+}
+
+static int disc_jobs_run(struct disc_jobs *jobs, bool connect,
+			 nvme_print_flags_t flags)
+{
+	_cleanup_free_ struct nvmf_discovery_log *merged = NULL;
+	_cleanup_free_ struct nvmf_discovery_log **logs = NULL;
+	bool merge = raw || !connect;
+	uint64_t total = 0;
+	unsigned int i;
+	int ret = 0;
+
+	if (!jobs->nr)
+		return 0;
+
+	jobs->app = nvme_root_get_application(jobs->r);
+	jobs->private = connect_jobs > 1 && jobs->nr > 1 && !dump_config;
+	parallel_for_each(jobs->nr, jobs->private ? connect_jobs : 1,
+			  disc_job_fetch, jobs);
+
+	/* Without connecting the log pages are reported as a single one */
+	if (merge) {
+		for (i = 0; i < jobs->nr; i++)
+			if (jobs->job[i].log)
+				total += le64_to_cpu(jobs->job[i].log->numrec);
+		merged = calloc(1, sizeof(*merged) + total * sizeof(merged->entries[0]));
+		if (!merged)
+			ret = -ENOMEM;
+	} else if (prune_removed) {
+		/*
+		 * A removed record may still be reported by another
+		 * discovery controller. Unless every log page could be
+		 * retrieved nothing is pruned.
+		 */
+		logs = calloc(jobs->nr, sizeof(*logs));
+		for (i = 0; logs && i < jobs->nr; i++) {
+			logs[i] = jobs->job[i].log;
+			if (!logs[i]) {
+				free(logs);
+				logs = NULL;
+			}
+		}
+	}
+
+	for (i = 0; i < jobs->nr; i++) {
+		struct disc_job *job = &jobs->job[i];
+		nvme_ctrl_t c = job->c, created = job->pc ? job->pc : job->c;
+		bool keep = true, pruned = false;
+
+		if (job->pc) {
+			/* Move the controller to the shared tree */
+			c = nvme_scan_ctrl(jobs->r, nvme_ctrl_get_name(job->pc));
+			if (!c)
+				c = job->pc;
+		}
+		if (job->created)
+			keep = job->persistent ||
+				is_persistent_discovery_ctrl(job->h, created);
+
+		if (timing) {
+			job->timing.err = -job->err;
+			timing_add(&job->timing);
+		}
+
+		/*
+		 * Failures are reported but, as before, do not fail the
+		 * command as a whole since the other controllers may
+		 * still have been reached.
+		 */
+		if (job->err) {
+			if (created)
+				fprintf(stderr, "failed to get discovery log: %s\n",
+					nvme_strerror(-job->err));
+			else if (job->json)
+				fprintf(stderr,
+					"failed to connect to hostnqn=%s,nqn=%s,transport=%s,traddr=%s,trsvcid=%s: %s\n",
+					nvme_host_get_hostnqn(job->h),
+					job->trcfg.subsysnqn, job->trcfg.transport,
+					job->trcfg.traddr, job->trcfg.trsvcid,
+					nvme_strerror(-job->err));
+		} else if (merge) {
+			if (merged)
+				merge_discovery_log(merged, job->log);
+		} else {
+			connect_disc_log(jobs->r, c, job->log,
+					 le64_to_cpu(job->log->numrec), &job->cfg,
+					 raw, job->persistent, flags);
+			if (job->prev && logs) {
+				disconnect_removed_entries(c, logs, jobs->nr,
+							   job->prev, &job->cfg);
+				pruned = true;
+			}
+		}
+		if (!job->err && job->update)
+			disc_cache_update(c, job->log, job->prev, pruned);
+
+		if (c && !keep) {
+			nvme_disconnect_ctrl(c);
+			if (c != job->pc)
+				nvme_free_ctrl(c);
+		}
+	}
+
+	if (merged) {
+		if (raw)
+			save_discovery_log(raw, merged);
+		else
+			nvme_show_discovery_log(merged,
+				le64_to_cpu(merged->numrec), flags);
+	}
+
+	return ret;
+}
+
+static int discover_from_conf_file(struct disc_jobs *jobs, nvme_host_t h,
+				   const char *desc,
 				   const struct nvme_fabrics_config *defcfg)
 {
 	char *transport = NULL, *traddr = NULL, *trsvcid = NULL;
@@ -417,7 +1541,6 @@ static int discover_from_conf_file(nvme_root_t r, nvme_host_t h,
 	int argc, ret = 0;
 	unsigned int verbose = 0;
 	_cleanup_file_ FILE *f = NULL;
-	nvme_print_flags_t flags;
 	char *format = "normal";
 	struct nvme_fabrics_config cfg;
 	bool force = false;
@@ -432,12 +1555,6 @@ static int discover_from_conf_file(nvme_root_t r, nvme_host_t h,
 
 	nvmf_default_config(&cfg);
 
-	ret = validate_output_format(format, &flags);
-	if (ret < 0) {
-		nvme_show_error("Invalid output format");
-		return ret;
-	}
-
 	f = fopen(PATH_NVMF_DISC, "r");
 	if (f == NULL) {
 		fprintf(stderr, "No params given and no %s\n", PATH_NVMF_DISC);
@@ -451,7 +1568,7 @@ static int discover_from_conf_file(nvme_root_t r, nvme_host_t h,
 	argv[0] = "discover";
 	memset(line, 0, sizeof(line));
 	while (fgets(line, sizeof(line), f) != NULL) {
-		nvme_ctrl_t c;
+		nvme_ctrl_t c = NULL;
 
 		if (line[0] == '#' || line[0] == '\n')
 			continue;
@@ -482,23 +1599,13 @@ static int discover_from_conf_file(nvme_root_t r, nvme_host_t h,
 			.trsvcid	= trsvcid,
 		};
 
-		if (!force) {
+		if (!force)
 			c = lookup_ctrl(h, &trcfg);
-			if (c) {
-				__discover(c, &cfg, raw, connect,
-					   true, flags);
-				goto next;
-			}
-		}
-
-		c = nvmf_create_discover_ctrl(r, h, &cfg, &trcfg);
-		if (!c)
-			goto next;
 
-		__discover(c, &cfg, raw, connect, persistent, flags);
-		if (!(persistent || is_persistent_discovery_ctrl(h, c)))
-			ret = nvme_disconnect_ctrl(c);
-		nvme_free_ctrl(c);
+		ret = disc_jobs_add(jobs, h, c, &cfg, &trcfg,
+				    c ? true : persistent, false);
+		if (ret)
+			break;
 
 next:
 		memset(&cfg, 0, sizeof(cfg));
@@ -508,17 +1615,14 @@ next:
 	return ret;
 }
 
-static int _discover_from_json_config_file(nvme_root_t r, nvme_host_t h,
-					   nvme_ctrl_t c, const char *desc, bool connect,
-					  const struct nvme_fabrics_config *defcfg,
-					  nvme_print_flags_t flags,
-					  bool force)
+static int _discover_from_json_config_file(struct disc_jobs *jobs,
+					   nvme_host_t h, nvme_ctrl_t c,
+					   const struct nvme_fabrics_config *defcfg,
+					   bool force)
 {
 	const char *transport, *traddr, *host_traddr;
 	const char *host_iface, *trsvcid, *subsysnqn;
-	struct nvme_fabrics_config cfg;
-	nvme_ctrl_t cn;
-	int ret = 0;
+	nvme_ctrl_t cn = NULL;
 
 	transport = nvme_ctrl_get_transport(c);
 	traddr = nvme_ctrl_get_traddr(c);
@@ -563,8 +1667,6 @@ static int _discover_from_json_config_file(nvme_root_t r, nvme_host_t h,
 	if (nvme_ctrl_is_persistent(c))
 		persistent = true;
 
-	memcpy(&cfg, defcfg, sizeof(cfg));
-
 	struct tr_config trcfg = {
 		.subsysnqn = subsysnqn,
 		.transport = transport,
@@ -574,40 +1676,26 @@ static int _discover_from_json_config_file(nvme_root_t r, nvme_host_t h,
 		.trsvcid = trsvcid,
 	};
 
-	if (!force) {
+	if (!force)
 		cn = lookup_ctrl(h, &trcfg);
-		if (cn) {
-			__discover(cn, &cfg, raw, connect, true, flags);
-			return 0;
-		}
-	}
-
-	cn = nvmf_create_discover_ctrl(r, h, &cfg, &trcfg);
-	if (!cn)
-		return 0;
-
-	__discover(cn, &cfg, raw, connect, persistent, flags);
-	if (!(persistent || is_persistent_discovery_ctrl(h, cn)))
-		ret = nvme_disconnect_ctrl(cn);
-	nvme_free_ctrl(cn);
 
-	return ret;
+	return disc_jobs_add(jobs, h, cn, defcfg, &trcfg,
+			     cn ? true : persistent, true);
 }
 
-static int discover_from_json_config_file(nvme_root_t r, const char *hostnqn,
-					  const char *hostid, const char *desc,
-					  bool connect,
+static int discover_from_json_config_file(struct disc_jobs *jobs,
+					  const char *hostnqn,
+					  const char *hostid,
 					  const struct nvme_fabrics_config *defcfg,
-					  nvme_print_flags_t flags,
 					  bool force)
 {
 	const char *hnqn, *hid;
 	nvme_host_t h;
 	nvme_subsystem_t s;
 	nvme_ctrl_t c;
-	int ret = 0, err;
+	int ret;
 
-	nvme_for_each_host(r, h) {
+	nvme_for_each_host(jobs->r, h) {
 		nvme_for_each_subsystem(h, s) {
 			hnqn = nvme_host_get_hostnqn(h);
 			if (hostnqn && hnqn && strcmp(hostnqn, hnqn))
@@ -617,67 +1705,14 @@ static int discover_from_json_config_file(nvme_root_t r, const char *hostnqn,
 				continue;
 
 			nvme_subsystem_for_each_ctrl(s, c) {
-				err = _discover_from_json_config_file(
-					r, h, c, desc, connect, defcfg,
-					flags, force);
-
-				if (err) {
-					fprintf(stderr,
-						"failed to connect to hostnqn=%s,nqn=%s,%s\n",
-						nvme_host_get_hostnqn(h),
-						nvme_subsystem_get_name(s),
-						nvme_ctrl_get_address(c));
-
-					if (!ret)
-						ret = err;
-				}
+				ret = _discover_from_json_config_file(jobs, h,
+						c, defcfg, force);
+				if (ret)
+					return ret;
 			}
 		}
 	}
 
-	return ret;
-}
-
-static int nvme_read_volatile_config(nvme_root_t r)
-{
-	char *filename, *ext;
-	struct dirent *dir;
-	DIR *d;
-	int ret = -ENOENT;
-
-	d = opendir(PATH_NVMF_RUNDIR);
-	if (!d)
-		return -ENOTDIR;
-
-	while ((dir = readdir(d))) {
-		if (dir->d_type != DT_REG)
-			continue;
-
-		ext = strchr(dir->d_name, '.');
-		if (!ext || strcmp("json", ext + 1))
-			continue;
-
-		if (asprintf(&filename, "%s/%s", PATH_NVMF_RUNDIR, dir->d_name) < 0) {
-			ret = -ENOMEM;
-			break;
-		}
-
-		if (nvme_read_config(r, filename))
-			ret = 0;
-
-		free(filename);
-	}
-	closedir(d);
-
-	return ret;
-}
-
-static int nvme_read_config_checked(nvme_root_t r, const char *filename)
-{
-	if (access(filename, F_OK))
-		return -errno;
-	if (nvme_read_config(r, filename))
-		return -errno;
 	return 0;
 }
 
@@ -706,6 +1741,10 @@ int nvmf_discover(const char *desc, int argc, char **argv, bool connect)
 	bool json_config = false;
 	bool nbft = false, nonbft = false;
 	char *nbft_path = NBFT_SYSFS_PATH;
+	char gen[TOPO_CACHE_GEN_LEN];
+	bool show_timing = false;
+	struct nvmf_timing_entry te;
+	uint64_t start = timing_now_us(), t;
 
 	NVMF_ARGS(opts, cfg,
 		  OPT_STRING("device",     'd', "DEV", &device,       "use existing discovery controller device"),
@@ -720,7 +1759,16 @@ int nvmf_discover(const char *desc, int argc, char **argv, bool connect)
 		  OPT_FLAG("nbft",           0, &nbft,                "Only look at NBFT tables"),
 		  OPT_FLAG("no-nbft",        0, &nonbft,              "Do not look at NBFT tables"),
 		  OPT_STRING("nbft-path",    0, "STR", &nbft_path,    "user-defined path for NBFT tables"),
-		  OPT_STRING("context",      0, "STR", &context,       nvmf_context));
+		  OPT_STRING("context",      0, "STR", &context,       nvmf_context),
+		  OPT_UINT("jobs",         'j', &connect_jobs,        nvmf_jobs),
+		  OPT_UINT("discovery-tmo",  0, &discovery_tmo,       nvmf_discovery_tmo),
+		  OPT_FLAG("incremental",    0, &incremental,         nvmf_incremental),
+		  OPT_FLAG("prune-removed",  0, &prune_removed,       nvmf_prune_removed),
+		  OPT_FLAG("timing",         0, &show_timing,         nvmf_timing),
+		  OPT_UINT("connect-rate",   0, &connect_rate,        nvmf_connect_rate),
+		  OPT_UINT("connect-burst",  0, &connect_burst,       nvmf_connect_burst),
+		  OPT_UINT("connect-retries", 0, &connect_retries,    nvmf_connect_retries),
+		  OPT_UINT("connect-backoff", 0, &connect_backoff_ms, nvmf_connect_backoff));
 
 	nvmf_default_config(&cfg);
 
@@ -736,6 +1784,7 @@ int nvmf_discover(const char *desc, int argc, char **argv, bool connect)
 
 	if (!strcmp(config_file, "none"))
 		config_file = NULL;
+	connect_config = config_file;
 
 	log_level = map_log_level(verbose, quiet);
 
@@ -754,11 +1803,16 @@ int nvmf_discover(const char *desc, int argc, char **argv, bool connect)
 		json_config = true;
 
 	nvme_root_skip_namespaces(r);
-	ret = nvme_scan_topology(r, NULL, NULL);
-	if (ret < 0) {
-		fprintf(stderr, "Failed to scan topology: %s\n",
-			nvme_strerror(errno));
-		return -errno;
+	if (!dump_config)
+		topo_cache = topo_cache_load(r, gen);
+	if (!topo_cache) {
+		ret = nvme_scan_topology(r, NULL, NULL);
+		if (ret < 0) {
+			fprintf(stderr, "Failed to scan topology: %s\n",
+				nvme_strerror(errno));
+			return -errno;
+		}
+		topo_cache_save(r, gen);
 	}
 
 	ret = nvme_host_get_ids(r, hostnqn, hostid, &hnqn, &hid);
@@ -771,6 +1825,18 @@ int nvmf_discover(const char *desc, int argc, char **argv, bool connect)
 		goto out_free;
 	}
 
+	connect_sched_read_config(config_file, hnqn, opts);
+	ratelimit_init(&connect_rl, connect_rate,
+		       connect_burst ? connect_burst : connect_rate);
+
+	if (show_timing) {
+		timing = calloc(1, sizeof(*timing));
+		if (!timing) {
+			ret = -ENOMEM;
+			goto out_free;
+		}
+	}
+
 	if (device) {
 		if (!strcmp(device, "none"))
 			device = NULL;
@@ -781,6 +1847,9 @@ int nvmf_discover(const char *desc, int argc, char **argv, bool connect)
 		nvme_host_set_dhchap_key(h, hostkey);
 
 	if (!device && !transport && !traddr) {
+		struct disc_jobs jobs = { .r = r };
+		int err;
+
 		if (!nonbft)
 			ret = discover_from_nbft(r, hostnqn, hostid,
 						  hnqn, hid, desc, connect,
@@ -788,14 +1857,22 @@ int nvmf_discover(const char *desc, int argc, char **argv, bool connect)
 		if (nbft)
 			goto out_free;
 
+		/*
+		 * The configuration walk also covers the live controllers,
+		 * which are not in the tree when the snapshot was loaded.
+		 */
+		if (json_config && topo_cache)
+			topo_cache_scan_fabrics(topo_cache);
 		if (json_config)
-			ret = discover_from_json_config_file(r, hostnqn, hostid,
-							     desc, connect, &cfg,
-							     flags, force);
-		if (ret || access(PATH_NVMF_DISC, F_OK))
-			goto out_free;
-
-		ret = discover_from_conf_file(r, h, desc, connect, &cfg);
+			ret = discover_from_json_config_file(&jobs, hostnqn,
+							     hostid, &cfg, force);
+		if (!ret && !access(PATH_NVMF_DISC, F_OK))
+			ret = discover_from_conf_file(&jobs, h, desc, &cfg);
+
+		err = disc_jobs_run(&jobs, connect, flags);
+		if (!ret)
+			ret = err;
+		disc_jobs_free(&jobs);
 		goto out_free;
 	}
 
@@ -868,8 +1945,16 @@ int nvmf_discover(const char *desc, int argc, char **argv, bool connect)
 		if (c)
 			persistent = true;
 	}
+	if (timing) {
+		timing_entry_init(&te, transport, traddr, trsvcid, subsysnqn,
+				  true);
+		if (c)
+			snprintf(te.device, sizeof(te.device), "%s",
+				 nvme_ctrl_get_name(c));
+	}
 	if (!c) {
 		/* No device or non-matching device, create a new controller */
+		t = timing_now_us();
 		c = nvmf_create_discover_ctrl(r, h, &cfg, &trcfg);
 		if (!c) {
 			if (errno != ENVME_CONNECT_IGNORED)
@@ -877,11 +1962,18 @@ int nvmf_discover(const char *desc, int argc, char **argv, bool connect)
 					"failed to add controller, error %s\n",
 					nvme_strerror(errno));
 			ret = -errno;
+			if (timing) {
+				timing_connected(&te, h, NULL, t, -ret);
+				timing_add(&te);
+			}
 			goto out_free;
 		}
+		if (timing)
+			timing_connected(&te, h, c, t, 0);
 	}
 
-	ret = __discover(c, &cfg, raw, connect, persistent, flags);
+	ret = __discover(r, c, &cfg, raw, connect, persistent, flags,
+			 timing ? &te : NULL);
 	if (!(persistent || is_persistent_discovery_ctrl(h, c)))
 		nvme_disconnect_ctrl(c);
 	nvme_free_ctrl(c);
@@ -889,6 +1981,9 @@ int nvmf_discover(const char *desc, int argc, char **argv, bool connect)
 out_free:
 	if (dump_config)
 		nvme_dump_config(r);
+	timing_report(start, flags);
+	topo_cache_free(topo_cache);
+	topo_cache = NULL;
 
 	return ret;
 }
@@ -989,6 +2084,9 @@ int nvmf_connect(const char *desc, int argc, char **argv)
 	nvme_print_flags_t flags;
 	struct nvme_fabrics_config cfg = { 0 };
 	char *format = "normal";
+	bool show_timing = false;
+	struct nvmf_timing_entry te;
+	uint64_t start = timing_now_us(), t;
 
 	NVMF_ARGS(opts, cfg,
 		  OPT_STRING("dhchap-ctrl-secret", 'C', "STR", &ctrlkey,      nvmf_ctrlkey),
@@ -996,7 +2094,8 @@ int nvmf_connect(const char *desc, int argc, char **argv)
 		  OPT_INCR("verbose",              'v', &verbose,             "Increase logging verbosity"),
 		  OPT_FLAG("dump-config",          'O', &dump_config,             "Dump JSON configuration to stdout"),
 		  OPT_FMT("output-format",         'o', &format,       "Output format: normal|json"),
-		  OPT_STRING("context",              0, "STR", &context,  nvmf_context));
+		  OPT_STRING("context",              0, "STR", &context,  nvmf_context),
+		  OPT_FLAG("timing",                 0, &show_timing,     nvmf_timing));
 
 	nvmf_default_config(&cfg);
 
@@ -1102,8 +2201,26 @@ do_connect:
 
 	nvme_parse_tls_args(keyring, tls_key, tls_key_identity, &cfg, c);
 
+	if (show_timing) {
+		timing = calloc(1, sizeof(*timing));
+		if (!timing) {
+			errno = ENOMEM;
+			goto out_free;
+		}
+		timing_entry_init(&te, transport, traddr, trsvcid, subsysnqn,
+				  false);
+	}
+
 	errno = 0;
+	t = timing_now_us();
 	ret = nvmf_add_ctrl(h, c, &cfg);
+	if (timing) {
+		int err = ret ? errno : 0;
+
+		timing_connected(&te, h, ret ? NULL : c, t, err);
+		timing_add(&te);
+		errno = err;
+	}
 	if (ret)
 		fprintf(stderr, "could not add new controller: %s\n",
 			nvme_strerror(errno));
@@ -1113,6 +2230,12 @@ do_connect:
 			nvme_show_connect_msg(c, flags);
 	}
 
+	if (timing) {
+		ret = errno;
+		timing_report(start, flags);
+		errno = ret;
+	}
+
 out_free:
 	if (dump_config)
 		nvme_dump_config(r);
@@ -1136,39 +2259,168 @@ static nvme_ctrl_t lookup_nvme_ctrl(nvme_root_t r, const char *name)
 	return NULL;
 }
 
-static void nvmf_disconnect_nqn(nvme_root_t r, char *nqn)
+struct ctrl_match {
+	const char *pattern;
+	bool regex;
+	regex_t re;
+};
+
+static int ctrl_match_init(struct ctrl_match *m, const char *pattern,
+			   bool regex)
+{
+	char msg[128];
+	int ret;
+
+	m->pattern = pattern;
+	m->regex = regex && pattern;
+	if (!m->regex)
+		return 0;
+
+	ret = regcomp(&m->re, pattern, REG_EXTENDED | REG_NOSUB);
+	if (ret) {
+		regerror(ret, &m->re, msg, sizeof(msg));
+		fprintf(stderr, "invalid regular expression '%s': %s\n",
+			pattern, msg);
+		m->regex = false;
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static bool ctrl_match(struct ctrl_match *m, const char *s)
+{
+	if (!m->pattern)
+		return true;
+	if (!s)
+		return false;
+	if (m->regex)
+		return !regexec(&m->re, s, 0, NULL, 0);
+	return !fnmatch(m->pattern, s, 0);
+}
+
+static void ctrl_match_free(struct ctrl_match *m)
+{
+	if (m->regex)
+		regfree(&m->re);
+}
+
+struct disconnect_ctx {
+	nvme_ctrl_t *ctrls;
+	int *err;
+};
+
+static void disconnect_one(unsigned int idx, void *arg)
+{
+	struct disconnect_ctx *ctx = arg;
+
+	ctx->err[idx] = nvme_disconnect_ctrl(ctx->ctrls[idx]) ? errno : 0;
+}
+
+static int disconnect_add(nvme_ctrl_t **ctrls, int *nr, nvme_ctrl_t c)
+{
+	nvme_ctrl_t *tmp;
+	int i;
+
+	/* The same controller may be selected by several patterns */
+	for (i = 0; i < *nr; i++)
+		if ((*ctrls)[i] == c)
+			return 0;
+
+	tmp = realloc(*ctrls, (*nr + 1) * sizeof(*tmp));
+	if (!tmp)
+		return -ENOMEM;
+	tmp[(*nr)++] = c;
+	*ctrls = tmp;
+
+	return 0;
+}
+
+/*
+ * Deleting a controller blocks until the kernel has torn down its
+ * queues, so the controllers are deleted from up to connect_jobs
+ * threads. Every controller is a separate sysfs object, the shared tree
+ * is only modified for the controller being disconnected. Returns the
+ * number of controllers disconnected.
+ */
+static int disconnect_ctrls(nvme_ctrl_t *ctrls, int nr)
+{
+	_cleanup_free_ int *err = NULL;
+	struct disconnect_ctx ctx;
+	int i, done = 0;
+
+	if (!nr)
+		return 0;
+
+	err = calloc(nr, sizeof(*err));
+	if (!err)
+		return -ENOMEM;
+
+	ctx.ctrls = ctrls;
+	ctx.err = err;
+	parallel_for_each(nr, connect_jobs ? connect_jobs : 1,
+			  disconnect_one, &ctx);
+
+	for (i = 0; i < nr; i++) {
+		if (err[i]) {
+			fprintf(stderr, "Failed to disconnect %s: %s\n",
+				nvme_ctrl_get_name(ctrls[i]),
+				nvme_strerror(err[i]));
+			continue;
+		}
+		done++;
+	}
+
+	if (done)
+		topo_cache_invalidate();
+
+	return done;
+}
+
+static int nvmf_disconnect_nqn(nvme_root_t r, char *nqn)
 {
-	int i = 0;
+	_cleanup_free_ nvme_ctrl_t *ctrls = NULL;
+	struct ctrl_match m;
 	char *n = nqn;
 	char *p;
 	nvme_host_t h;
 	nvme_subsystem_t s;
 	nvme_ctrl_t c;
+	int nr = 0, ret;
 
 	while ((p = strsep(&n, ",")) != NULL) {
 		if (!strlen(p))
 			continue;
+		ctrl_match_init(&m, p, false);
 		nvme_for_each_host(r, h) {
 			nvme_for_each_subsystem(h, s) {
-				if (strcmp(nvme_subsystem_get_nqn(s), p))
+				if (!ctrl_match(&m, nvme_subsystem_get_nqn(s)))
 					continue;
 				nvme_subsystem_for_each_ctrl(s, c) {
-					if (!nvme_disconnect_ctrl(c))
-						i++;
+					ret = disconnect_add(&ctrls, &nr, c);
+					if (ret)
+						return ret;
 				}
 			}
 		}
 	}
-	printf("NQN:%s disconnected %d controller(s)\n", nqn, i);
+
+	ret = disconnect_ctrls(ctrls, nr);
+	if (ret < 0)
+		return ret;
+	printf("NQN:%s disconnected %d controller(s)\n", nqn, ret);
+
+	return 0;
 }
 
 int nvmf_disconnect(const char *desc, int argc, char **argv)
 {
 	const char *device = "nvme device handle";
 	_cleanup_nvme_root_ nvme_root_t r = NULL;
+	_cleanup_free_ nvme_ctrl_t *ctrls = NULL;
 	nvme_ctrl_t c;
 	char *p;
-	int ret;
+	int nr = 0, ret;
 
 	struct config {
 		char *nqn;
@@ -1181,6 +2433,7 @@ int nvmf_disconnect(const char *desc, int argc, char **argv)
 	OPT_ARGS(opts) = {
 		OPT_STRING("nqn",        'n', "NAME", &cfg.nqn,    nvmf_nqn),
 		OPT_STRING("device",     'd', "DEV",  &cfg.device, device),
+		OPT_UINT("jobs",         'j', &connect_jobs, nvmf_disconnect_jobs),
 		OPT_INCR("verbose",      'v', &cfg.verbose, "Increase logging verbosity"),
 		OPT_END()
 	};
@@ -1224,8 +2477,11 @@ int nvmf_disconnect(const char *desc, int argc, char **argv)
 		return -errno;
 	}
 
-	if (cfg.nqn)
-		nvmf_disconnect_nqn(r, cfg.nqn);
+	if (cfg.nqn) {
+		ret = nvmf_disconnect_nqn(r, cfg.nqn);
+		if (ret)
+			return ret;
+	}
 
 	if (cfg.device) {
 		char *d;
@@ -1240,12 +2496,14 @@ int nvmf_disconnect(const char *desc, int argc, char **argv)
 					"Did not find device %s\n", p);
 				return -errno;
 			}
-			ret = nvme_disconnect_ctrl(c);
+			ret = disconnect_add(&ctrls, &nr, c);
 			if (ret)
-				fprintf(stderr,
-					"Failed to disconnect %s: %s\n",
-					p, nvme_strerror(errno));
+				return ret;
 		}
+
+		ret = disconnect_ctrls(ctrls, nr);
+		if (ret < 0)
+			return ret;
 	}
 
 	return 0;
@@ -1254,13 +2512,18 @@ int nvmf_disconnect(const char *desc, int argc, char **argv)
 int nvmf_disconnect_all(const char *desc, int argc, char **argv)
 {
 	_cleanup_nvme_root_ nvme_root_t r = NULL;
+	_cleanup_free_ nvme_ctrl_t *ctrls = NULL;
+	struct ctrl_match nqn_match, traddr_match;
 	nvme_host_t h;
 	nvme_subsystem_t s;
 	nvme_ctrl_t c;
-	int ret;
+	int nr = 0, ret;
 
 	struct config {
 		char *transport;
+		char *nqn;
+		char *traddr;
+		bool regex;
 		unsigned int verbose;
 	};
 
@@ -1268,6 +2531,10 @@ int nvmf_disconnect_all(const char *desc, int argc, char **argv)
 
 	OPT_ARGS(opts) = {
 		OPT_STRING("transport", 'r', "STR", (char *)&cfg.transport, nvmf_tport),
+		OPT_STRING("nqn",       'n', "PATTERN", &cfg.nqn,    nvmf_nqn),
+		OPT_STRING("traddr",    'a', "PATTERN", &cfg.traddr, nvmf_traddr),
+		OPT_FLAG("regex",       'E', &cfg.regex,             nvmf_regex),
+		OPT_UINT("jobs",        'j', &connect_jobs,          nvmf_disconnect_jobs),
 		OPT_INCR("verbose",  'v', &cfg.verbose, "Increase logging verbosity"),
 		OPT_END()
 	};
@@ -1278,11 +2545,21 @@ int nvmf_disconnect_all(const char *desc, int argc, char **argv)
 
 	log_level = map_log_level(cfg.verbose, false);
 
+	ret = ctrl_match_init(&nqn_match, cfg.nqn, cfg.regex);
+	if (ret)
+		return ret;
+	ret = ctrl_match_init(&traddr_match, cfg.traddr, cfg.regex);
+	if (ret) {
+		ctrl_match_free(&nqn_match);
+		return ret;
+	}
+
 	r = nvme_create_root(stderr, log_level);
 	if (!r) {
 		fprintf(stderr, "Failed to create topology root: %s\n",
 			nvme_strerror(errno));
-		return -errno;
+		ret = -errno;
+		goto out;
 	}
 	nvme_root_skip_namespaces(r);
 	ret = nvme_scan_topology(r, NULL, NULL);
@@ -1292,12 +2569,15 @@ int nvmf_disconnect_all(const char *desc, int argc, char **argv)
 		 * loaded, this allows the user to unconditionally call
 		 * disconnect.
 		 */
-		if (errno == ENOENT)
-			return 0;
+		if (errno == ENOENT) {
+			ret = 0;
+			goto out;
+		}
 
 		fprintf(stderr, "Failed to scan topology: %s\n",
 			nvme_strerror(errno));
-		return -errno;
+		ret = -errno;
+		goto out;
 	}
 
 	nvme_for_each_host(r, h) {
@@ -1310,10 +2590,211 @@ int nvmf_disconnect_all(const char *desc, int argc, char **argv)
 				else if (!strcmp(nvme_ctrl_get_transport(c),
 						 "pcie"))
 					continue;
-				if (nvme_disconnect_ctrl(c))
-					fprintf(stderr,
-						"failed to disconnect %s\n",
-						nvme_ctrl_get_name(c));
+				if (!ctrl_match(&nqn_match,
+						nvme_ctrl_get_subsysnqn(c)) ||
+				    !ctrl_match(&traddr_match,
+						nvme_ctrl_get_traddr(c)))
+					continue;
+				ret = disconnect_add(&ctrls, &nr, c);
+				if (ret)
+					goto out;
+			}
+		}
+	}
+
+	ret = disconnect_ctrls(ctrls, nr);
+	if (ret > 0)
+		ret = 0;
+out:
+	ctrl_match_free(&traddr_match);
+	ctrl_match_free(&nqn_match);
+	return ret;
+}
+
+/*
+ * Desired and live controllers for nvme config --apply. Controllers are
+ * hashed on host NQN, subsystem NQN, transport, traddr and trsvcid. The
+ * host side address and interface are compared within a bucket, unset
+ * values in the configuration match any live controller like
+ * lookup_ctrl() does.
+ */
+struct apply_ctrl {
+	char *key;
+	nvme_host_t h;
+	nvme_ctrl_t c;
+	const char *hostnqn;
+	const char *subsysnqn;
+	const char *transport;
+	const char *traddr;
+	const char *trsvcid;
+	const char *host_traddr;
+	const char *host_iface;
+	bool discovery;
+	bool keep;
+	int err;
+};
+
+static const char *apply_ctrl_key(const struct apply_ctrl *ac)
+{
+	return ac->key;
+}
+
+static bool apply_ctrl_cmp(const struct apply_ctrl *ac, const char *key)
+{
+	return !strcmp(ac->key, key);
+}
+
+HTABLE_DEFINE_TYPE(struct apply_ctrl, apply_ctrl_key, hash_string,
+		   apply_ctrl_cmp, htable_apply);
+
+struct apply_plan {
+	struct apply_ctrl *live;
+	int nr_live;
+	struct apply_ctrl *want;
+	int nr_want;
+	struct htable_apply ht;
+	const char *config_file;
+};
+
+static bool apply_transport(const char *transport)
+{
+	/* Same transports as nvme_connect_config() */
+	return transport && (!strcmp(transport, "tcp") ||
+			     !strcmp(transport, "rdma") ||
+			     !strcmp(transport, "fc"));
+}
+
+static const char *apply_field(const char *s)
+{
+	return s && *s ? s : NULL;
+}
+
+static int apply_add(struct apply_ctrl **acs, int *nr, nvme_host_t h,
+		     nvme_ctrl_t c, const char *subsysnqn, const char *trsvcid)
+{
+	struct apply_ctrl *ac, *tmp;
+
+	tmp = realloc(*acs, (*nr + 1) * sizeof(*tmp));
+	if (!tmp)
+		return -ENOMEM;
+	*acs = tmp;
+
+	ac = &tmp[*nr];
+	memset(ac, 0, sizeof(*ac));
+	ac->h = h;
+	ac->c = c;
+	ac->hostnqn = nvme_host_get_hostnqn(h);
+	ac->subsysnqn = subsysnqn;
+	ac->transport = nvme_ctrl_get_transport(c);
+	ac->traddr = apply_field(nvme_ctrl_get_traddr(c));
+	ac->trsvcid = apply_field(trsvcid);
+	ac->host_traddr = apply_field(nvme_ctrl_get_host_traddr(c));
+	ac->host_iface = apply_field(nvme_ctrl_get_host_iface(c));
+	ac->discovery = !strcmp(subsysnqn, NVME_DISC_SUBSYS_NAME);
+
+	if (asprintf(&ac->key, "%s\t%s\t%s\t%s\t%s",
+		     ac->hostnqn, ac->subsysnqn, ac->transport,
+		     ac->traddr ? : "", ac->trsvcid ? : "") < 0) {
+		ac->key = NULL;
+		return -ENOMEM;
+	}
+	(*nr)++;
+
+	return 0;
+}
+
+static bool apply_host_match(const char *hostnqn, nvme_host_t h)
+{
+	return !hostnqn || !strcmp(hostnqn, nvme_host_get_hostnqn(h));
+}
+
+static int apply_scan_live(struct apply_plan *plan, nvme_root_t r,
+			   const char *hostnqn)
+{
+	nvme_host_t h;
+	nvme_subsystem_t s;
+	nvme_ctrl_t c;
+	int i, ret;
+
+	nvme_for_each_host(r, h) {
+		if (!apply_host_match(hostnqn, h))
+			continue;
+		nvme_for_each_subsystem(h, s) {
+			nvme_subsystem_for_each_ctrl(s, c) {
+				if (!nvme_ctrl_get_name(c) ||
+				    !nvme_ctrl_get_subsysnqn(c) ||
+				    !apply_transport(nvme_ctrl_get_transport(c)))
+					continue;
+				ret = apply_add(&plan->live, &plan->nr_live, h, c,
+						nvme_ctrl_get_subsysnqn(c),
+						nvme_ctrl_get_trsvcid(c));
+				if (ret)
+					return ret;
+				/* Unique discovery NQNs are not well known */
+				if (nvme_ctrl_is_discovery_ctrl(c))
+					plan->live[plan->nr_live - 1].discovery = true;
+			}
+		}
+	}
+
+	/* The array is final, entries can be hashed now */
+	for (i = 0; i < plan->nr_live; i++)
+		htable_apply_add(&plan->ht, &plan->live[i]);
+
+	return 0;
+}
+
+static bool apply_opt_match(const char *want, const char *live)
+{
+	return !want || (live && !strcmp(want, live));
+}
+
+static struct apply_ctrl *apply_lookup(struct apply_plan *plan,
+				       struct apply_ctrl *want)
+{
+	struct htable_apply_iter it;
+	struct apply_ctrl *ac;
+
+	for (ac = htable_apply_getfirst(&plan->ht, want->key, &it); ac;
+	     ac = htable_apply_getnext(&plan->ht, want->key, &it)) {
+		if (ac->keep)
+			continue;
+		if (apply_opt_match(want->host_traddr, ac->host_traddr) &&
+		    apply_opt_match(want->host_iface, ac->host_iface))
+			return ac;
+	}
+
+	return NULL;
+}
+
+static int apply_scan_want(struct apply_plan *plan, nvme_root_t r,
+			   const char *hostnqn)
+{
+	const char *transport, *trsvcid, *subsysnqn;
+	nvme_host_t h;
+	nvme_subsystem_t s;
+	nvme_ctrl_t c;
+	int ret;
+
+	nvme_for_each_host(r, h) {
+		if (!apply_host_match(hostnqn, h))
+			continue;
+		nvme_for_each_subsystem(h, s) {
+			subsysnqn = nvme_subsystem_get_nqn(s);
+			nvme_subsystem_for_each_ctrl(s, c) {
+				transport = nvme_ctrl_get_transport(c);
+				if (!apply_transport(transport))
+					continue;
+
+				trsvcid = apply_field(nvme_ctrl_get_trsvcid(c));
+				if (!trsvcid)
+					trsvcid = nvmf_get_default_trsvcid(transport,
+						!strcmp(subsysnqn, NVME_DISC_SUBSYS_NAME));
+
+				ret = apply_add(&plan->want, &plan->nr_want, h, c,
+						subsysnqn, trsvcid);
+				if (ret)
+					return ret;
 			}
 		}
 	}
@@ -1321,6 +2802,208 @@ int nvmf_disconnect_all(const char *desc, int argc, char **argv)
 	return 0;
 }
 
+static void apply_print(const char *op, const char *name,
+			struct apply_ctrl *ac)
+{
+	printf("%-10s %-8s hostnqn=%s nqn=%s transport=%s", op,
+	       name ? : "-", ac->hostnqn, ac->subsysnqn, ac->transport);
+	if (ac->traddr)
+		printf(" traddr=%s", ac->traddr);
+	if (ac->trsvcid)
+		printf(" trsvcid=%s", ac->trsvcid);
+	if (ac->host_traddr)
+		printf(" host_traddr=%s", ac->host_traddr);
+	if (ac->host_iface)
+		printf(" host_iface=%s", ac->host_iface);
+	printf("\n");
+}
+
+struct apply_connect_ctx {
+	struct apply_ctrl **acs;
+	const char *config_file;
+};
+
+/*
+ * The connect parameters (keys, queue counts, timeouts) live in the
+ * configuration tree. libnvme trees are not thread safe, so every worker
+ * connects from a private copy of the configuration. Discovery
+ * controllers are created like discover --persistent does, they are
+ * meant to stay connected.
+ */
+static void apply_connect_one(unsigned int idx, void *arg)
+{
+	struct apply_connect_ctx *ctx = arg;
+	struct apply_ctrl *ac = ctx->acs[idx];
+	nvme_root_t r;
+	nvme_host_t h;
+	nvme_subsystem_t s;
+	nvme_ctrl_t c = NULL;
+
+	r = nvme_create_root(stderr, log_level);
+	if (!r) {
+		ac->err = errno ? errno : ENOMEM;
+		return;
+	}
+	nvme_read_config(r, ctx->config_file);
+
+	h = nvme_lookup_host(r, ac->hostnqn, nvme_host_get_hostid(ac->h));
+	s = h ? nvme_lookup_subsystem(h, NULL, ac->subsysnqn) : NULL;
+	if (s)
+		c = nvme_lookup_ctrl(s, ac->transport,
+				     nvme_ctrl_get_traddr(ac->c),
+				     nvme_ctrl_get_host_traddr(ac->c),
+				     nvme_ctrl_get_host_iface(ac->c),
+				     nvme_ctrl_get_trsvcid(ac->c), NULL);
+
+	if (!c) {
+		ac->err = errno ? errno : ENOENT;
+	} else if (ac->discovery) {
+		struct nvme_fabrics_config cfg = *nvme_ctrl_get_config(c);
+		struct tr_config trcfg = {
+			.subsysnqn	= ac->subsysnqn,
+			.transport	= ac->transport,
+			.traddr		= ac->traddr,
+			.host_traddr	= ac->host_traddr,
+			.host_iface	= ac->host_iface,
+			.trsvcid	= ac->trsvcid,
+		};
+
+		errno = 0;
+		if (!create_discover_ctrl(r, h, &cfg, &trcfg, true) &&
+		    errno != ENVME_CONNECT_ALREADY)
+			ac->err = errno ? errno : EIO;
+	} else if (nvmf_connect_ctrl(c) && errno != ENVME_CONNECT_ALREADY) {
+		ac->err = errno;
+	}
+
+	nvme_free_tree(r);
+}
+
+static void apply_free(struct apply_plan *plan)
+{
+	int i;
+
+	htable_apply_clear(&plan->ht);
+	for (i = 0; i < plan->nr_live; i++)
+		free(plan->live[i].key);
+	for (i = 0; i < plan->nr_want; i++)
+		free(plan->want[i].key);
+	free(plan->live);
+	free(plan->want);
+}
+
+/*
+ * Brings the live topology in line with the configuration read into
+ * @want: controllers missing from the live topology are connected. With
+ * @prune, live I/O controllers which are not configured are disconnected
+ * afterwards; connect-all and nvmf-autoconnect create I/O controllers the
+ * configuration does not list, so this is never the default. Discovery
+ * controllers are only ever connected.
+ */
+static int nvmf_config_apply(nvme_root_t want, const char *config_file,
+			     const char *hostnqn, bool prune, bool dry_run)
+{
+	_cleanup_nvme_root_ nvme_root_t r = NULL;
+	_cleanup_free_ struct apply_ctrl **connect = NULL;
+	_cleanup_free_ nvme_ctrl_t *disconnect = NULL;
+	struct apply_plan plan = { .config_file = config_file };
+	struct apply_connect_ctx ctx;
+	int nr_connect = 0, nr_disconnect = 0, unchanged = 0;
+	int i, ret, failed = 0;
+	struct apply_ctrl *ac;
+
+	htable_apply_init(&plan.ht);
+
+	r = nvme_create_root(stderr, log_level);
+	if (!r) {
+		fprintf(stderr, "Failed to create topology root: %s\n",
+			nvme_strerror(errno));
+		return -errno;
+	}
+	nvme_root_skip_namespaces(r);
+	/* Without the fabrics modules loaded nothing is connected yet */
+	if (nvme_scan_topology(r, NULL, NULL) < 0 && errno != ENOENT) {
+		fprintf(stderr, "Failed to scan topology: %s\n",
+			nvme_strerror(errno));
+		ret = -errno;
+		goto out;
+	}
+
+	ret = apply_scan_live(&plan, r, hostnqn);
+	if (ret)
+		goto out;
+	ret = apply_scan_want(&plan, want, hostnqn);
+	if (ret)
+		goto out;
+	if (!plan.nr_want) {
+		fprintf(stderr, "no controllers configured in %s%s%s\n",
+			config_file, hostnqn ? " for " : "", hostnqn ? : "");
+		ret = -ENOENT;
+		goto out;
+	}
+
+	connect = calloc(plan.nr_want + 1, sizeof(*connect));
+	disconnect = calloc(plan.nr_live + 1, sizeof(*disconnect));
+	if (!connect || !disconnect) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	for (i = 0; i < plan.nr_want; i++) {
+		ac = apply_lookup(&plan, &plan.want[i]);
+		if (ac) {
+			ac->keep = true;
+			unchanged++;
+			continue;
+		}
+		connect[nr_connect++] = &plan.want[i];
+		apply_print("connect", NULL, &plan.want[i]);
+	}
+
+	for (i = 0; i < plan.nr_live; i++) {
+		ac = &plan.live[i];
+		if (!prune || ac->keep || ac->discovery)
+			continue;
+		disconnect[nr_disconnect++] = ac->c;
+		apply_print("disconnect", nvme_ctrl_get_name(ac->c), ac);
+	}
+
+	printf("%d to connect, %d to disconnect, %d unchanged\n",
+	       nr_connect, nr_disconnect, unchanged);
+
+	if (dry_run)
+		goto out;
+
+	/* Connect before disconnecting so that moved paths stay available */
+	ctx.acs = connect;
+	ctx.config_file = config_file;
+	parallel_for_each(nr_connect, connect_jobs ? connect_jobs : 1,
+			  apply_connect_one, &ctx);
+
+	for (i = 0; i < nr_connect; i++) {
+		ac = connect[i];
+		if (!ac->err)
+			continue;
+		fprintf(stderr, "failed to connect to hostnqn=%s,nqn=%s: %s\n",
+			ac->hostnqn, ac->subsysnqn, nvme_strerror(ac->err));
+		if (!failed)
+			ret = -ac->err;
+		failed++;
+	}
+	if (failed < nr_connect)
+		topo_cache_invalidate();
+
+	i = disconnect_ctrls(disconnect, nr_disconnect);
+	if (i < 0 && !ret)
+		ret = i;
+	else if (i < nr_disconnect && !ret)
+		ret = -EIO;
+
+out:
+	apply_free(&plan);
+	return ret;
+}
+
 int nvmf_config(const char *desc, int argc, char **argv)
 {
 	char *subsysnqn = NULL;
@@ -1336,6 +3019,7 @@ int nvmf_config(const char *desc, int argc, char **argv)
 	int ret;
 	struct nvme_fabrics_config cfg;
 	bool scan_tree = false, modify_config = false, update_config = false;
+	bool apply = false, dry_run = false, prune = false;
 
 	NVMF_ARGS(opts, cfg,
 		  OPT_STRING("dhchap-ctrl-secret", 'C', "STR", &ctrlkey,      nvmf_ctrlkey),
@@ -1344,7 +3028,11 @@ int nvmf_config(const char *desc, int argc, char **argv)
 		  OPT_FLAG("scan",                 'R', &scan_tree,           "Scan current NVMeoF topology"),
 		  OPT_FLAG("modify",               'M', &modify_config,       "Modify JSON configuration file"),
 		  OPT_FLAG("dump",                 'O', &dump_config,         "Dump JSON configuration to stdout"),
-		  OPT_FLAG("update",               'U', &update_config,       "Update JSON configuration file"));
+		  OPT_FLAG("update",               'U', &update_config,       "Update JSON configuration file"),
+		  OPT_FLAG("apply",                'A', &apply,               nvmf_apply),
+		  OPT_FLAG("dry-run",                0, &dry_run,             nvmf_dry_run),
+		  OPT_FLAG("prune",                  0, &prune,               nvmf_prune),
+		  OPT_UINT("jobs",                 'j', &connect_jobs,        nvmf_jobs));
 
 	nvmf_default_config(&cfg);
 
@@ -1364,6 +3052,28 @@ int nvmf_config(const char *desc, int argc, char **argv)
 		return -errno;
 	}
 
+	if (apply) {
+		if (scan_tree || modify_config || update_config ||
+		    dump_config) {
+			fprintf(stderr,
+				"--apply can't be combined with --scan, --modify, --update or --dump\n");
+			return -EINVAL;
+		}
+		if (!config_file) {
+			fprintf(stderr, "--apply needs a JSON configuration file\n");
+			return -EINVAL;
+		}
+		/* An unreadable file must not disconnect everything */
+		ret = nvme_read_config_checked(r, config_file);
+		if (ret) {
+			fprintf(stderr, "Failed to read %s: %s\n",
+				config_file, nvme_strerror(-ret));
+			return ret;
+		}
+		return nvmf_config_apply(r, config_file, hostnqn, prune,
+					 dry_run);
+	}
+
 	nvme_read_config(r, config_file);
 
 	if (scan_tree) {
@@ -11,6 +11,46 @@ struct tr_config {
 	const char *trsvcid;
 };
 
+enum nvmf_timing_phase {
+	NVMF_TIMING_DISC_CONNECT,	/* discovery controller creation */
+	NVMF_TIMING_DISC_LOG,		/* discovery log page retrieval */
+	NVMF_TIMING_CONNECT,		/* fabrics connect, incl. TLS and authentication */
+	NVMF_TIMING_LIVE,		/* until the controller state is live */
+	NVMF_TIMING_NS_LIVE,		/* until all active namespaces are registered */
+	NVMF_TIMING_NR_PHASES,
+};
+
+#define NVMF_TIMING_UNSET	UINT64_MAX
+
+struct nvmf_timing_entry {
+	char device[32];
+	char transport[8];
+	char traddr[NVMF_TRADDR_SIZE];
+	char trsvcid[NVMF_TRSVCID_SIZE];
+	char subsysnqn[NVMF_NQN_SIZE + 1];
+	bool discovery;
+	bool tls;
+	bool dhchap;
+	int nr_ns;
+	int err;
+	uint64_t phase_us[NVMF_TIMING_NR_PHASES];
+};
+
+struct nvmf_timing {
+	struct nvmf_timing_entry *entry;
+	unsigned int nr;
+	uint64_t elapsed_us;
+};
+
+struct nvmf_timing_stats {
+	unsigned int count;
+	uint64_t min_us;
+	uint64_t avg_us;
+	uint64_t p50_us;
+	uint64_t p99_us;
+	uint64_t max_us;
+};
+
 extern nvme_ctrl_t lookup_ctrl(nvme_host_t h, struct tr_config *trcfg);
 extern int nvmf_discover(const char *desc, int argc, char **argv, bool connect);
 extern int nvmf_connect(const char *desc, int argc, char **argv);
@@ -23,6 +63,10 @@ extern nvme_ctrl_t nvmf_create_discover_ctrl(nvme_root_t r, nvme_host_t h,
 					     struct tr_config *trcfg);
 extern char *nvmf_get_default_trsvcid(const char *transport,
 				      bool discovery_ctrl);
+extern const char *nvmf_timing_phase_str(enum nvmf_timing_phase phase);
+extern int nvmf_timing_stats(struct nvmf_timing *t,
+			     enum nvmf_timing_phase phase,
+			     struct nvmf_timing_stats *stats);
 
 
 #endif
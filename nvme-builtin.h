@@ -29,6 +29,7 @@ COMMAND_LIST(
 	ENTRY("id-domain", "Send NVMe Identify Domain List, display structure", id_domain)
 	ENTRY("list-endgrp", "Send NVMe Identify Endurance Group List, display structure", id_endurance_grp_list)
 	ENTRY("create-ns", "Creates a namespace with the provided parameters", create_ns)
+	ENTRY("provision", "Creates and attaches namespaces from a spec file", provision)
 	ENTRY("delete-ns", "Deletes a namespace from the controller", delete_ns)
 	ENTRY("attach-ns", "Attaches a namespace to requested controller(s)", attach_ns)
 	ENTRY("detach-ns", "Detaches a namespace from requested controller(s)", detach_ns)
@@ -52,6 +53,7 @@ COMMAND_LIST(
 	ENTRY("phy-rx-eom-log", "Retrieve Physical Interface Receiver Eye Opening Measurement, show it", get_phy_rx_eom_log)
 	ENTRY("get-feature", "Get feature and show the resulting value", get_feature)
 	ENTRY("device-self-test", "Perform the necessary tests to observe the performance", device_self_test)
+	ENTRY("fleet-self-test", "Run a device self-test on a set of controllers", fleet_self_test)
 	ENTRY("self-test-log", "Retrieve the SELF-TEST Log, show it", self_test_log)
 	ENTRY("supported-log-pages", "Retrieve the Supported Log pages details, show it", get_supported_log_pages)
 	ENTRY("fid-support-effects-log", "Retrieve FID Support and Effects log and show it", get_fid_support_effects_log)
@@ -66,6 +68,7 @@ COMMAND_LIST(
 	ENTRY("format", "Format namespace with new block format", format_cmd)
 	ENTRY("fw-commit", "Verify and commit firmware to a specific slot (fw-activate in old version < 1.2)", fw_commit, "fw-activate")
 	ENTRY("fw-download", "Download new firmware", fw_download)
+	ENTRY("fw-rollout", "Download and commit firmware on a set of controllers", fw_rollout)
 	ENTRY("admin-passthru", "Submit an arbitrary admin command, return results", admin_passthru)
 	ENTRY("io-passthru", "Submit an arbitrary IO command, return results", io_passthru)
 	ENTRY("security-send", "Submit a Security Send command, return results", sec_send)
@@ -87,6 +90,7 @@ COMMAND_LIST(
 	ENTRY("verify", "Submit a verify command, return results", verify_cmd)
 	ENTRY("sanitize", "Submit a sanitize command", sanitize_cmd)
 	ENTRY("sanitize-log", "Retrieve sanitize log, show it", sanitize_log)
+	ENTRY("wipe", "Format or sanitize a set of controllers concurrently", wipe)
 	ENTRY("reset", "Resets the controller", reset)
 	ENTRY("subsystem-reset", "Resets the subsystem", subsystem_reset)
 	ENTRY("ns-rescan", "Rescans the NVME namespaces", ns_rescan)
@@ -8,8 +8,82 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <errno.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/mman.h>
 #include "nvme-models.h"
 
+/*
+ * Compiled pci.ids index. Scanning the 1+ MB text file for every
+ * controller is slow, so the file is compiled once into sorted tables
+ * which are cached on disk, mmap'd by later invocations and searched
+ * with bsearch(). The text scan below remains as fallback.
+ */
+#define PCI_IDS_INDEX_DIR	"/var/cache/nvme"
+#define PCI_IDS_INDEX_FILE	PCI_IDS_INDEX_DIR "/pci.ids.idx"
+#define PCI_IDS_INDEX_MAGIC	0x5844494943504d4eULL /* "NMPCIIDX" */
+#define PCI_IDS_INDEX_VERSION	1
+
+struct pci_ids_index_hdr {
+	uint64_t magic;
+	uint32_t version;
+	uint32_t size;
+	uint64_t src_size;
+	int64_t src_mtime_sec;
+	int64_t src_mtime_nsec;
+	uint32_t src_path;
+	uint32_t nr_vendors;
+	uint32_t vendors;
+	uint32_t nr_devices;
+	uint32_t devices;
+	uint32_t nr_subsystems;
+	uint32_t subsystems;
+	uint32_t nr_classes;
+	uint32_t classes;
+	uint32_t strings;
+	uint32_t strings_len;
+	uint32_t rsvd;
+};
+
+struct pci_ids_vendor {
+	uint16_t vendor;
+	uint16_t rsvd;
+	uint32_t name;
+};
+
+struct pci_ids_device {
+	uint16_t vendor;
+	uint16_t device;
+	uint32_t name;
+};
+
+struct pci_ids_subsystem {
+	uint16_t vendor;
+	uint16_t device;
+	uint16_t subvendor;
+	uint16_t subdevice;
+	uint32_t name;
+};
+
+struct pci_ids_class {
+	uint16_t class; /* base class << 8 | sub class */
+	uint16_t rsvd;
+	uint32_t name;
+};
+
+struct pci_ids_table {
+	void *data;
+	size_t nr;
+	size_t alloc;
+	size_t size;
+};
+
+static struct {
+	const struct pci_ids_index_hdr *hdr;
+	size_t len;
+	bool mapped;
+} pci_ids_index;
+
 static char *_fmt1 = "/sys/class/nvme/nvme%d/device/subsystem_vendor";
 static char *_fmt2 = "/sys/class/nvme/nvme%d/device/subsystem_device";
 static char *_fmt3 = "/sys/class/nvme/nvme%d/device/vendor";
@@ -261,13 +335,13 @@ static int read_sys_node(char *where, char *save, size_t savesz)
 	return ret;
 }
 
-static FILE *open_pci_ids(void)
+static FILE *open_pci_ids(const char **path)
 {
 	int i;
 	char *pci_ids_path;
 	FILE *fp;
 
-	const char* pci_ids[] = {
+	static const char * const pci_ids[] = {
 		"/usr/share/hwdata/pci.ids",  /* RHEL */
 		"/usr/share/pci.ids",		  /* SLES */
 		"/usr/share/misc/pci.ids",	  /* Ubuntu */
@@ -277,6 +351,7 @@ static FILE *open_pci_ids(void)
 	/* First check if user gave pci ids in environment */
 	if ((pci_ids_path = getenv("PCI_IDS_PATH")) != NULL) {
 		if ((fp = fopen(pci_ids_path, "r")) != NULL) {
+			*path = pci_ids_path;
 			return fp;
 		} else {
 			/* fail if user provided environment variable but could not open */
@@ -287,14 +362,494 @@ static FILE *open_pci_ids(void)
 
 	/* NO environment, check in predefined places */
 	for (i = 0; pci_ids[i] != NULL; i++) {
-		if ((fp = fopen(pci_ids[i], "r")) != NULL)
+		if ((fp = fopen(pci_ids[i], "r")) != NULL) {
+			*path = pci_ids[i];
 			return fp;
+		}
 	}
 
 	fprintf(stderr, "Could not find pci.ids file\n");
 	return NULL;
 }
 
+static const char *pci_ids_str(uint32_t off)
+{
+	return (const char *)pci_ids_index.hdr + pci_ids_index.hdr->strings + off;
+}
+
+/*
+ * Every name is an offset into the string section, a corrupted index
+ * must not make pci_ids_str() read past the mapping.
+ */
+static bool pci_ids_names_valid(const struct pci_ids_index_hdr *hdr,
+				uint32_t section, uint32_t nr, size_t size,
+				size_t name)
+{
+	const char *e = (const char *)hdr + section;
+	uint32_t i, off;
+
+	for (i = 0; i < nr; i++, e += size) {
+		memcpy(&off, e + name, sizeof(off));
+		if (off >= hdr->strings_len)
+			return false;
+	}
+
+	return true;
+}
+
+static bool pci_ids_index_valid(const struct pci_ids_index_hdr *hdr, size_t len,
+				const char *path, const struct stat *st)
+{
+	if (len < sizeof(*hdr) || hdr->magic != PCI_IDS_INDEX_MAGIC ||
+	    hdr->version != PCI_IDS_INDEX_VERSION || hdr->size != len)
+		return false;
+
+	if (hdr->vendors + (uint64_t)hdr->nr_vendors * sizeof(struct pci_ids_vendor) > len ||
+	    hdr->devices + (uint64_t)hdr->nr_devices * sizeof(struct pci_ids_device) > len ||
+	    hdr->subsystems + (uint64_t)hdr->nr_subsystems * sizeof(struct pci_ids_subsystem) > len ||
+	    hdr->classes + (uint64_t)hdr->nr_classes * sizeof(struct pci_ids_class) > len ||
+	    (uint64_t)hdr->strings + hdr->strings_len != len ||
+	    !hdr->strings_len || ((const char *)hdr)[len - 1] != '\0' ||
+	    hdr->src_path >= hdr->strings_len)
+		return false;
+
+	if (!pci_ids_names_valid(hdr, hdr->vendors, hdr->nr_vendors,
+				 sizeof(struct pci_ids_vendor),
+				 offsetof(struct pci_ids_vendor, name)) ||
+	    !pci_ids_names_valid(hdr, hdr->devices, hdr->nr_devices,
+				 sizeof(struct pci_ids_device),
+				 offsetof(struct pci_ids_device, name)) ||
+	    !pci_ids_names_valid(hdr, hdr->subsystems, hdr->nr_subsystems,
+				 sizeof(struct pci_ids_subsystem),
+				 offsetof(struct pci_ids_subsystem, name)) ||
+	    !pci_ids_names_valid(hdr, hdr->classes, hdr->nr_classes,
+				 sizeof(struct pci_ids_class),
+				 offsetof(struct pci_ids_class, name)))
+		return false;
+
+	/* Recompile whenever the pci.ids file got updated */
+	return hdr->src_size == st->st_size &&
+	       hdr->src_mtime_sec == st->st_mtim.tv_sec &&
+	       hdr->src_mtime_nsec == st->st_mtim.tv_nsec &&
+	       !strcmp((const char *)hdr + hdr->strings + hdr->src_path, path);
+}
+
+static int pci_ids_index_map(const char *path, const struct stat *st)
+{
+	struct stat ist;
+	void *map;
+	int fd;
+
+	fd = open(PCI_IDS_INDEX_FILE, O_RDONLY);
+	if (fd < 0)
+		return -errno;
+
+	if (fstat(fd, &ist) || ist.st_size < sizeof(struct pci_ids_index_hdr)) {
+		close(fd);
+		return -EINVAL;
+	}
+
+	map = mmap(NULL, ist.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return -errno;
+
+	if (!pci_ids_index_valid(map, ist.st_size, path, st)) {
+		munmap(map, ist.st_size);
+		return -ESTALE;
+	}
+
+	pci_ids_index.hdr = map;
+	pci_ids_index.len = ist.st_size;
+	pci_ids_index.mapped = true;
+
+	return 0;
+}
+
+static void *pci_ids_table_add(struct pci_ids_table *t)
+{
+	void *p;
+
+	if (t->nr == t->alloc) {
+		size_t alloc = t->alloc ? t->alloc * 2 : 256;
+
+		p = realloc(t->data, alloc * t->size);
+		if (!p)
+			return NULL;
+		t->data = p;
+		t->alloc = alloc;
+	}
+
+	p = (char *)t->data + t->nr++ * t->size;
+	memset(p, 0, t->size);
+	return p;
+}
+
+static int pci_ids_string_add(struct pci_ids_table *strings, const char *str,
+			      uint32_t *off)
+{
+	size_t len = strlen(str) + 1;
+
+	while (strings->nr + len > strings->alloc) {
+		size_t alloc = strings->alloc ? strings->alloc * 2 : 64 * 1024;
+		char *p = realloc(strings->data, alloc);
+
+		if (!p)
+			return -ENOMEM;
+		strings->data = p;
+		strings->alloc = alloc;
+	}
+
+	*off = strings->nr;
+	memcpy((char *)strings->data + strings->nr, str, len);
+	strings->nr += len;
+
+	return 0;
+}
+
+static int pci_ids_cmp_vendor(const void *a, const void *b)
+{
+	const struct pci_ids_vendor *x = a, *y = b;
+
+	return x->vendor - y->vendor;
+}
+
+static int pci_ids_cmp_device(const void *a, const void *b)
+{
+	const struct pci_ids_device *x = a, *y = b;
+
+	if (x->vendor != y->vendor)
+		return x->vendor - y->vendor;
+	return x->device - y->device;
+}
+
+static int pci_ids_cmp_subsystem(const void *a, const void *b)
+{
+	const struct pci_ids_subsystem *x = a, *y = b;
+
+	if (x->vendor != y->vendor)
+		return x->vendor - y->vendor;
+	if (x->device != y->device)
+		return x->device - y->device;
+	if (x->subvendor != y->subvendor)
+		return x->subvendor - y->subvendor;
+	return x->subdevice - y->subdevice;
+}
+
+static int pci_ids_cmp_class(const void *a, const void *b)
+{
+	const struct pci_ids_class *x = a, *y = b;
+
+	return x->class - y->class;
+}
+
+/* Splits "<hex id>  <name>" into the id and the name */
+static char *pci_ids_parse_id(char *line, int digits, unsigned int *id)
+{
+	char *end;
+
+	*id = strtoul(line, &end, 16);
+	if (end != line + digits || *end != ' ')
+		return NULL;
+
+	while (*end == ' ')
+		end++;
+
+	return *end ? end : NULL;
+}
+
+static int pci_ids_parse(FILE *file, struct pci_ids_table *vendors,
+			 struct pci_ids_table *devices,
+			 struct pci_ids_table *subsystems,
+			 struct pci_ids_table *classes,
+			 struct pci_ids_table *strings)
+{
+	unsigned int vendor = 0, device = 0, class = 0, id, subid;
+	bool have_vendor = false, have_device = false, in_classes = false;
+	struct pci_ids_subsystem *ss;
+	struct pci_ids_device *dev;
+	struct pci_ids_vendor *ven;
+	struct pci_ids_class *cls;
+	char *line = NULL, *name;
+	size_t size = 0;
+	ssize_t amnt;
+	int err = 0;
+
+	while ((amnt = getline(&line, &size, file)) != -1) {
+		if (amnt && line[amnt - 1] == '\n')
+			line[amnt - 1] = '\0';
+		if (line[0] == '#' || line[0] == '\0')
+			continue;
+
+		if (line[0] == 'C' && line[1] == ' ') {
+			in_classes = true;
+			name = pci_ids_parse_id(&line[2], 2, &class);
+			continue;
+		}
+
+		if (in_classes) {
+			/* Only the sub class names are of interest */
+			if (line[0] != '\t' || line[1] == '\t')
+				continue;
+			name = pci_ids_parse_id(&line[1], 2, &id);
+			if (!name)
+				continue;
+			cls = pci_ids_table_add(classes);
+			if (!cls)
+				goto enomem;
+			cls->class = class << 8 | id;
+			if (pci_ids_string_add(strings, name, &cls->name))
+				goto enomem;
+			continue;
+		}
+
+		if (line[0] != '\t') {
+			name = pci_ids_parse_id(line, 4, &vendor);
+			have_vendor = name;
+			have_device = false;
+			if (!name)
+				continue;
+			ven = pci_ids_table_add(vendors);
+			if (!ven)
+				goto enomem;
+			ven->vendor = vendor;
+			if (pci_ids_string_add(strings, name, &ven->name))
+				goto enomem;
+		} else if (line[1] != '\t') {
+			if (!have_vendor)
+				continue;
+			name = pci_ids_parse_id(&line[1], 4, &device);
+			have_device = name;
+			if (!name)
+				continue;
+			dev = pci_ids_table_add(devices);
+			if (!dev)
+				goto enomem;
+			dev->vendor = vendor;
+			dev->device = device;
+			if (pci_ids_string_add(strings, name, &dev->name))
+				goto enomem;
+		} else {
+			if (!have_device)
+				continue;
+			name = pci_ids_parse_id(&line[2], 4, &id);
+			if (!name)
+				continue;
+			name = pci_ids_parse_id(name, 4, &subid);
+			if (!name)
+				continue;
+			ss = pci_ids_table_add(subsystems);
+			if (!ss)
+				goto enomem;
+			ss->vendor = vendor;
+			ss->device = device;
+			ss->subvendor = id;
+			ss->subdevice = subid;
+			if (pci_ids_string_add(strings, name, &ss->name))
+				goto enomem;
+		}
+	}
+
+out:
+	free(line);
+	return err;
+enomem:
+	err = -ENOMEM;
+	goto out;
+}
+
+static void pci_ids_index_save(const struct pci_ids_index_hdr *hdr)
+{
+	char tmp[sizeof(PCI_IDS_INDEX_FILE) + 16];
+	ssize_t ret;
+	int fd;
+
+	if (mkdir(PCI_IDS_INDEX_DIR, 0755) && errno != EEXIST)
+		return;
+
+	snprintf(tmp, sizeof(tmp), "%s.%d", PCI_IDS_INDEX_FILE, getpid());
+	fd = open(tmp, O_CREAT | O_WRONLY | O_TRUNC, 0644);
+	if (fd < 0)
+		return;
+
+	ret = write(fd, hdr, hdr->size);
+	close(fd);
+	if (ret != hdr->size || rename(tmp, PCI_IDS_INDEX_FILE))
+		unlink(tmp);
+}
+
+static void *pci_ids_index_copy(struct pci_ids_index_hdr *hdr, uint32_t *off,
+				const struct pci_ids_table *t,
+				int (*cmp)(const void *, const void *))
+{
+	void *dst = (char *)hdr + *off;
+
+	if (t->nr) {
+		memcpy(dst, t->data, t->nr * t->size);
+		if (cmp)
+			qsort(dst, t->nr, t->size, cmp);
+	}
+	*off += t->nr * t->size;
+
+	return dst;
+}
+
+/* Compiles the text file into a single index buffer and caches it */
+static int pci_ids_index_build(FILE *file, const char *path,
+			       const struct stat *st)
+{
+	struct pci_ids_table vendors = { .size = sizeof(struct pci_ids_vendor) };
+	struct pci_ids_table devices = { .size = sizeof(struct pci_ids_device) };
+	struct pci_ids_table subsystems = { .size = sizeof(struct pci_ids_subsystem) };
+	struct pci_ids_table classes = { .size = sizeof(struct pci_ids_class) };
+	struct pci_ids_table strings = { .size = 1 };
+	struct pci_ids_index_hdr *hdr;
+	uint32_t src_path, off;
+	size_t len;
+	int err;
+
+	err = pci_ids_parse(file, &vendors, &devices, &subsystems, &classes,
+			    &strings);
+	if (!err)
+		err = pci_ids_string_add(&strings, path, &src_path);
+	if (err)
+		goto out;
+
+	len = sizeof(*hdr) + vendors.nr * vendors.size +
+		devices.nr * devices.size + subsystems.nr * subsystems.size +
+		classes.nr * classes.size + strings.nr;
+	if (len > UINT32_MAX) {
+		err = -EFBIG;
+		goto out;
+	}
+
+	hdr = calloc(1, len);
+	if (!hdr) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	hdr->magic = PCI_IDS_INDEX_MAGIC;
+	hdr->version = PCI_IDS_INDEX_VERSION;
+	hdr->size = len;
+	hdr->src_size = st->st_size;
+	hdr->src_mtime_sec = st->st_mtim.tv_sec;
+	hdr->src_mtime_nsec = st->st_mtim.tv_nsec;
+	hdr->src_path = src_path;
+
+	off = sizeof(*hdr);
+	hdr->vendors = off;
+	hdr->nr_vendors = vendors.nr;
+	pci_ids_index_copy(hdr, &off, &vendors, pci_ids_cmp_vendor);
+	hdr->devices = off;
+	hdr->nr_devices = devices.nr;
+	pci_ids_index_copy(hdr, &off, &devices, pci_ids_cmp_device);
+	hdr->subsystems = off;
+	hdr->nr_subsystems = subsystems.nr;
+	pci_ids_index_copy(hdr, &off, &subsystems, pci_ids_cmp_subsystem);
+	hdr->classes = off;
+	hdr->nr_classes = classes.nr;
+	pci_ids_index_copy(hdr, &off, &classes, pci_ids_cmp_class);
+	hdr->strings = off;
+	hdr->strings_len = strings.nr;
+	pci_ids_index_copy(hdr, &off, &strings, NULL);
+
+	pci_ids_index_save(hdr);
+
+	pci_ids_index.hdr = hdr;
+	pci_ids_index.len = len;
+	pci_ids_index.mapped = false;
+out:
+	free(vendors.data);
+	free(devices.data);
+	free(subsystems.data);
+	free(classes.data);
+	free(strings.data);
+	return err;
+}
+
+/* The index stays loaded for the lifetime of the process */
+static int pci_ids_index_get(FILE *file, const char *path)
+{
+	struct stat st;
+
+	if (pci_ids_index.hdr)
+		return 0;
+
+	if (fstat(fileno(file), &st))
+		return -errno;
+
+	if (!pci_ids_index_map(path, &st))
+		return 0;
+
+	return pci_ids_index_build(file, path, &st);
+}
+
+static const char *pci_ids_lookup(const void *key, uint32_t off, uint32_t nr,
+				  size_t size, int (*cmp)(const void *, const void *))
+{
+	const void *base = (const char *)pci_ids_index.hdr + off;
+	const uint32_t *entry;
+
+	entry = bsearch(key, base, nr, size, cmp);
+	if (!entry)
+		return NULL;
+
+	/* The name offset is the last member of every table entry */
+	return pci_ids_str(*(const uint32_t *)((const char *)entry + size -
+					       sizeof(uint32_t)));
+}
+
+static char *pci_ids_index_product_name(char *vendor, char *device,
+					char *sub_vendor, char *sub_device,
+					char *class)
+{
+	const struct pci_ids_index_hdr *hdr = pci_ids_index.hdr;
+	const char *ven_name, *dev_name, *ss_name, *cls_name;
+	struct pci_ids_subsystem ss = { 0 };
+	struct pci_ids_device dev = { 0 };
+	struct pci_ids_vendor ven = { 0 };
+	struct pci_ids_class cls = { 0 };
+	char *save;
+
+	save = malloc(1024);
+	if (!save)
+		return NULL;
+
+	ven.vendor = strtoul(vendor, NULL, 16);
+	dev.vendor = ss.vendor = ven.vendor;
+	dev.device = ss.device = strtoul(device, NULL, 16);
+	ss.subvendor = strtoul(sub_vendor, NULL, 16);
+	ss.subdevice = strtoul(sub_device, NULL, 16);
+	cls.class = strtoul(class, NULL, 16) >> 8;
+
+	ven_name = pci_ids_lookup(&ven, hdr->vendors, hdr->nr_vendors,
+				  sizeof(ven), pci_ids_cmp_vendor);
+	dev_name = pci_ids_lookup(&dev, hdr->devices, hdr->nr_devices,
+				  sizeof(dev), pci_ids_cmp_device);
+	ss_name = pci_ids_lookup(&ss, hdr->subsystems, hdr->nr_subsystems,
+				 sizeof(ss), pci_ids_cmp_subsystem);
+	cls_name = pci_ids_lookup(&cls, hdr->classes, hdr->nr_classes,
+				  sizeof(cls), pci_ids_cmp_class);
+
+	if (ven_name && dev_name) {
+		snprintf(save, 1024, "%s%s%s %s%s%s",
+			 cls_name ? cls_name : "", cls_name ? ": " : "",
+			 ven_name, dev_name,
+			 ss_name ? " " : "", ss_name ? ss_name : "");
+	} else if (ven_name && cls_name) {
+		snprintf(save, 1024, "%s: %s Device %s", cls_name, ven_name,
+			 device);
+	} else if (!ven_name && cls_name) {
+		snprintf(save, 1024, "%s: Vendor %s Device %s", cls_name,
+			 vendor, device);
+	} else {
+		snprintf(save, 1024, "Unknown device");
+	}
+
+	return save;
+}
+
 char *nvme_product_name(int id)
 {
 	char *line = NULL;
@@ -306,7 +861,8 @@ char *nvme_product_name(int id)
 	char class[13] = { 0 };
 	size_t size = 1024;
 	char ret;
-	FILE *file = open_pci_ids();
+	const char *path = NULL;
+	FILE *file = open_pci_ids(&path);
 
 	if (!file)
 		goto error1;
@@ -325,6 +881,17 @@ char *nvme_product_name(int id)
 	if (ret)
 		goto error0;
 
+	if (!pci_ids_index_get(file, path)) {
+		line = pci_ids_index_product_name(vendor, device, sub_vendor,
+						  sub_device, class);
+		if (line) {
+			fclose(file);
+			return line;
+		}
+	}
+
+	/* Fall back to scanning the text file */
+	rewind(file);
 	line = malloc(1024);
 	if (!line) {
 		fprintf(stderr, "malloc: %s\n", strerror(errno));
@@ -389,9 +389,11 @@ static struct print_ops binary_print_ops = {
 	/* libnvme tree print functions */
 	.list_item			= NULL,
 	.list_items			= NULL,
+	.list_event			= NULL,
 	.print_nvme_subsystem_list	= NULL,
 	.topology_ctrl			= NULL,
 	.topology_namespace		= NULL,
+	.connect_timing			= NULL,
 
 	/* status and error messages */
 	.connect_msg			= NULL,
@@ -9,6 +9,7 @@
 #include "util/json.h"
 #include "nvme.h"
 #include "common.h"
+#include "fabrics.h"
 
 #define ERROR_MSG_LEN 100
 #define NAME_LEN 128
@@ -23,6 +24,7 @@
 #define array_add_str json_array_add_value_string
 
 #define obj_add_array json_object_add_value_array
+#define obj_add_double json_object_add_value_double
 #define obj_add_int json_object_add_value_int
 #define obj_add_obj json_object_add_value_object
 #define obj_add_uint json_object_add_value_uint
@@ -181,6 +183,29 @@ static void obj_print(struct json_object *o)
 		json_print(o);
 }
 
+/*
+ * Per-namespace objects printed between show_init and show_finish, as
+ * done by the --all identify sweeps, are collected in a "namespaces"
+ * array instead of being printed one document at a time.
+ */
+static void obj_print_ns(struct json_object *o, unsigned int nsid)
+{
+	struct json_object *array;
+
+	if (!json_r) {
+		json_print(o);
+		return;
+	}
+
+	if (!json_object_object_get_ex(json_r, "namespaces", &array)) {
+		array = json_create_array();
+		obj_add_array(json_r, "namespaces", array);
+	}
+
+	obj_add_uint(o, "nsid", nsid);
+	array_add_obj(array, o);
+}
+
 static void json_id_iocs(struct nvme_id_iocs *iocs)
 {
 	struct json_object *r = json_create_object();
@@ -290,7 +315,7 @@ static void json_nvme_id_ns(struct nvme_id_ns *ns, unsigned int nsid,
 	d_json(ns->vs, strnlen((const char *)ns->vs, sizeof(ns->vs)), 16, 1, vs);
 	obj_add_array(r, "vs", vs);
 
-	json_print(r);
+	obj_print_ns(r, nsid);
 }
 
 void json_nvme_id_ctrl(struct nvme_id_ctrl *ctrl,
@@ -2351,6 +2376,30 @@ static void json_nvme_fdp_stats(struct nvme_fdp_stats_log *log)
 	json_print(r);
 }
 
+static struct json_object *json_fdp_event_obj(struct nvme_fdp_event *event)
+{
+	struct json_object *obj_event = json_create_object();
+
+	obj_add_uint(obj_event, "type", event->type);
+	obj_add_uint(obj_event, "fdpef", event->flags);
+	obj_add_uint(obj_event, "pid", le16_to_cpu(event->pid));
+	obj_add_uint64(obj_event, "timestamp", le64_to_cpu(*(uint64_t *)&event->ts));
+	obj_add_uint(obj_event, "nsid", le32_to_cpu(event->nsid));
+
+	if (event->type == NVME_FDP_EVENT_REALLOC) {
+		struct nvme_fdp_event_realloc *mr;
+
+		mr = (struct nvme_fdp_event_realloc *)&event->type_specific;
+
+		obj_add_uint(obj_event, "nlbam", le16_to_cpu(mr->nlbam));
+
+		if (mr->flags & NVME_FDP_EVENT_REALLOC_F_LBAV)
+			obj_add_uint64(obj_event, "lba", le64_to_cpu(mr->lba));
+	}
+
+	return obj_event;
+}
+
 static void json_nvme_fdp_events(struct nvme_fdp_events_log *log)
 {
 	struct json_object *r, *obj_events;
@@ -2363,34 +2412,66 @@ static void json_nvme_fdp_events(struct nvme_fdp_events_log *log)
 
 	obj_add_uint(r, "n", n);
 
-	for (unsigned int i = 0; i < n; i++) {
-		struct nvme_fdp_event *event = &log->events[i];
+	for (unsigned int i = 0; i < n; i++)
+		array_add_obj(obj_events, json_fdp_event_obj(&log->events[i]));
 
-		struct json_object *obj_event = json_create_object();
+	obj_add_array(r, "events", obj_events);
 
-		obj_add_uint(obj_event, "type", event->type);
-		obj_add_uint(obj_event, "fdpef", event->flags);
-		obj_add_uint(obj_event, "pid", le16_to_cpu(event->pid));
-		obj_add_uint64(obj_event, "timestamp", le64_to_cpu(*(uint64_t *)&event->ts));
-		obj_add_uint(obj_event, "nsid", le32_to_cpu(event->nsid));
+	json_print(r);
+}
 
-		if (event->type == NVME_FDP_EVENT_REALLOC) {
-			struct nvme_fdp_event_realloc *mr;
+static struct json_object *json_fdp_ruh_events_obj(struct nvme_fdp_ruh_events *ruh)
+{
+	struct json_object *obj_ruh = json_create_object();
 
-			mr = (struct nvme_fdp_event_realloc *)&event->type_specific;
+	if (ruh->lv) {
+		obj_add_uint(obj_ruh, "rgid", ruh->rgid);
+		obj_add_uint(obj_ruh, "ruhid", ruh->ruhid);
+	}
+	obj_add_uint64(obj_ruh, "events", ruh->events);
+	obj_add_uint64(obj_ruh, "runfw", ruh->runfw);
+	obj_add_uint64(obj_ruh, "realloc", ruh->realloc);
+	obj_add_uint64(obj_ruh, "modify", ruh->modify);
+	obj_add_uint64(obj_ruh, "nlbam", ruh->nlbam);
 
-			obj_add_uint(obj_event, "nlbam", le16_to_cpu(mr->nlbam));
+	return obj_ruh;
+}
 
-			if (mr->flags & NVME_FDP_EVENT_REALLOC_F_LBAV)
-				obj_add_uint64(obj_event, "lba", le64_to_cpu(mr->lba));
-		}
+/*
+ * Watched events are streamed as one compact object per line, each with
+ * the running counts of its reclaim unit handle.
+ */
+static void json_fdp_event(struct nvme_fdp_event *event, struct nvme_fdp_ruh_events *ruh)
+{
+	struct json_object *r = json_fdp_event_obj(event);
 
-		array_add_obj(obj_events, obj_event);
+	obj_add_str(r, "event", nvme_fdp_event_to_string(event->type));
+	if (event->flags & NVME_FDP_EVENT_F_LV) {
+		obj_add_uint(r, "rgid", le16_to_cpu(event->rgid));
+		obj_add_uint(r, "ruhid", event->ruhid);
 	}
+	if (ruh)
+		obj_add_obj(r, "ruh", json_fdp_ruh_events_obj(ruh));
 
-	obj_add_array(r, "events", obj_events);
+	printf("%s\n", json_object_to_json_string_ext(r,
+		JSON_C_TO_STRING_PLAIN | JSON_C_TO_STRING_NOSLASHESCAPE));
+	fflush(stdout);
+	json_free_object(r);
+}
 
-	json_print(r);
+static void json_fdp_ruh_events(struct nvme_fdp_ruh_events *ruhs, int nr)
+{
+	struct json_object *r = json_create_object();
+	struct json_object *obj_ruhs = json_create_array();
+
+	for (int i = 0; i < nr; i++)
+		array_add_obj(obj_ruhs, json_fdp_ruh_events_obj(&ruhs[i]));
+	obj_add_array(r, "ruhs", obj_ruhs);
+
+	printf("%s\n", json_object_to_json_string_ext(r,
+		JSON_C_TO_STRING_PLAIN | JSON_C_TO_STRING_NOSLASHESCAPE));
+	fflush(stdout);
+	json_free_object(r);
 }
 
 static void json_nvme_fdp_ruh_status(struct nvme_fdp_ruh_status *status, size_t len)
@@ -2423,6 +2504,70 @@ static void json_nvme_fdp_ruh_status(struct nvme_fdp_ruh_status *status, size_t
 	json_print(r);
 }
 
+static void json_nvme_fdp_workload(struct nvme_fdp_workload *res)
+{
+	struct json_object *r = json_create_object();
+	struct json_object *obj_written = json_create_array();
+	int i;
+
+	obj_add_uint(r, "nsid", res->nsid);
+	obj_add_uint(r, "egid", res->egid);
+	obj_add_str(r, "mode", res->mode);
+	obj_add_uint64(r, "writes", res->writes);
+	obj_add_uint64(r, "bytes", res->bytes);
+	obj_add_double(r, "seconds", res->seconds);
+
+	for (i = 0; i < res->nr_pids; i++) {
+		struct json_object *obj_pid = json_create_object();
+
+		obj_add_uint(obj_pid, "pid", res->pids[i]);
+		obj_add_uint64(obj_pid, "bytes", res->written[i]);
+		array_add_obj(obj_written, obj_pid);
+	}
+	obj_add_array(r, "placement", obj_written);
+
+	obj_add_double(r, "hbmw", res->hbmw);
+	obj_add_double(r, "mbmw", res->mbmw);
+	obj_add_double(r, "mbe", res->mbe);
+	if (res->hbmw > 0)
+		obj_add_double(r, "waf", res->mbmw / res->hbmw);
+
+	json_print(r);
+}
+
+static void json_fdp_ruh_trend(struct nvme_fdp_ruh_trend *t)
+{
+	struct json_object *r = json_create_object();
+	struct json_object *obj_ruhs = json_create_array();
+
+	obj_add_uint(r, "nsid", t->nsid);
+	obj_add_uint(r, "samples", t->samples);
+	obj_add_double(r, "seconds", t->seconds);
+
+	for (int i = 0; i < t->nr; i++) {
+		struct nvme_fdp_ruh_usage *u = &t->ruhs[i];
+		struct json_object *obj_ruh = json_create_object();
+
+		obj_add_uint(obj_ruh, "pid", u->pid);
+		obj_add_uint(obj_ruh, "ruhid", u->ruhid);
+		obj_add_uint64(obj_ruh, "ruamw", u->ruamw);
+		obj_add_uint(obj_ruh, "earutr", u->earutr);
+		obj_add_uint64(obj_ruh, "written", u->written);
+		obj_add_uint(obj_ruh, "switches", u->switches);
+		obj_add_double(obj_ruh, "rate", u->rate);
+		if (u->ttl >= 0)
+			obj_add_double(obj_ruh, "time_to_switch", u->ttl);
+		array_add_obj(obj_ruhs, obj_ruh);
+	}
+	obj_add_array(r, "ruhs", obj_ruhs);
+
+	obj_add_double(r, "mean_rate", t->mean_rate);
+	obj_add_double(r, "imbalance", t->imbalance);
+	obj_add_double(r, "spread", t->spread);
+
+	json_print(r);
+}
+
 static unsigned int json_print_nvme_subsystem_multipath(nvme_subsystem_t s, json_object *paths)
 {
 	nvme_ns_t n;
@@ -2961,7 +3106,7 @@ static void json_nvme_id_ns_descs(void *data, unsigned int nsid)
 	if (json_array)
 		obj_add_array(r, "ns-descs", json_array);
 
-	json_print(r);
+	obj_print_ns(r, nsid);
 }
 
 static void json_nvme_id_ctrl_nvm(struct nvme_id_ctrl_nvm *ctrl_nvm)
@@ -3023,7 +3168,7 @@ static void json_nvme_nvm_id_ns(struct nvme_nvm_id_ns *nvm_ns,
 	obj_add_uint(r, "lbapss", le32_to_cpu(nvm_ns->lbapss));
 	obj_add_uint(r, "tlbaag", le32_to_cpu(nvm_ns->tlbaag));
 
-	json_print(r);
+	obj_print_ns(r, nsid);
 }
 
 static void json_nvme_zns_id_ctrl(struct nvme_zns_id_ctrl *ctrl)
@@ -3093,9 +3238,26 @@ static void json_nvme_list_ns(struct nvme_ns_list *ns_list)
 	json_print(r);
 }
 
+/*
+ * The report zones list is streamed: every chunk of descriptors is printed
+ * as it arrives, one compact object per zone, so the output does not have
+ * to be kept in memory for drives with a large number of zones. json_print()
+ * only prints complete objects, hence the document is written around the
+ * zones here. Output collected in json_r is not streamed, the zones are
+ * added to a @zone_list array instead.
+ */
+static bool json_zone_list_empty;
+
 static void json_zns_start_zone_list(__u64 nr_zones, struct json_object **zone_list)
 {
-	*zone_list = json_create_array();
+	if (json_r) {
+		*zone_list = json_create_array();
+		return;
+	}
+
+	*zone_list = NULL;
+	json_zone_list_empty = true;
+	printf("{\n  \"nr_zones\":%"PRIu64",\n  \"zone_list\":[", (uint64_t)nr_zones);
 }
 
 static void json_zns_changed(struct nvme_zns_changed_zone_log *log)
@@ -3121,12 +3283,17 @@ static void json_zns_changed(struct nvme_zns_changed_zone_log *log)
 static void json_zns_finish_zone_list(__u64 nr_zones,
 				      struct json_object *zone_list)
 {
-	struct json_object *r = json_create_object();
+	struct json_object *r;
 
-	obj_add_uint(r, "nr_zones", nr_zones);
-	obj_add_array(r, "zone_list", zone_list);
+	if (!zone_list) {
+		printf("\n  ]\n}\n");
+		return;
+	}
 
-	json_print(r);
+	r = obj_create("report_zones");
+	obj_add_uint64(r, "nr_zones", nr_zones);
+	obj_add_array(r, "zone_list", zone_list);
+	obj_print(r);
 }
 
 static void json_nvme_zns_report_zones(void *report, __u32 descs,
@@ -3163,8 +3330,87 @@ static void json_nvme_zns_report_zones(void *report, __u32 descs,
 			}
 		}
 
-		array_add_obj(zone_list, zone);
+		if (zone_list) {
+			array_add_obj(zone_list, zone);
+			continue;
+		}
+
+		printf("%s\n    %s", json_zone_list_empty ? "" : ",",
+		       json_object_to_json_string_ext(zone,
+			JSON_C_TO_STRING_PLAIN | JSON_C_TO_STRING_NOSLASHESCAPE));
+		json_zone_list_empty = false;
+		json_free_object(zone);
+	}
+}
+
+static void json_zns_zone_fill(struct json_object *r, const char *k,
+			       struct nvme_zns_zone_fill *z, int nr)
+{
+	struct json_object *zones = json_create_array();
+	struct json_object *zone;
+	int i;
+
+	for (i = 0; i < nr; i++) {
+		zone = json_create_object();
+		obj_add_uint64(zone, "slba", z[i].zslba);
+		obj_add_str(zone, "state", nvme_zone_state_to_string(z[i].state));
+		obj_add_uint64(zone, "written", z[i].written);
+		obj_add_uint64(zone, "cap", z[i].cap);
+		array_add_obj(zones, zone);
 	}
+
+	obj_add_array(r, k, zones);
+}
+
+static void json_zns_zone_summary(struct nvme_zns_zone_summary *s)
+{
+	static const __u8 states[] = {
+		NVME_ZNS_ZS_EMPTY, NVME_ZNS_ZS_IMPL_OPEN, NVME_ZNS_ZS_EXPL_OPEN,
+		NVME_ZNS_ZS_CLOSED, NVME_ZNS_ZS_READ_ONLY, NVME_ZNS_ZS_FULL,
+		NVME_ZNS_ZS_OFFLINE,
+	};
+	struct json_object *r = json_create_object();
+	struct json_object *state = json_create_object();
+	struct json_object *fill = json_create_array();
+	struct json_object *bucket;
+	__u64 open = s->state[NVME_ZNS_ZS_IMPL_OPEN] + s->state[NVME_ZNS_ZS_EXPL_OPEN];
+	__u64 active = open + s->state[NVME_ZNS_ZS_CLOSED];
+	int i;
+
+	obj_add_uint(r, "nsid", s->nsid);
+	obj_add_uint64(r, "nr_zones", s->nr_zones);
+	obj_add_uint64(r, "zone_size", s->zsze);
+
+	for (i = 0; i < ARRAY_SIZE(states); i++)
+		obj_add_uint64(state, nvme_zone_state_to_string(states[i]),
+			       s->state[states[i]]);
+	obj_add_obj(r, "states", state);
+
+	obj_add_uint64(r, "open_zones", open);
+	if (s->mor != 0xffffffff)
+		obj_add_uint64(r, "max_open_zones", (__u64)s->mor + 1);
+	obj_add_uint64(r, "active_zones", active);
+	if (s->mar != 0xffffffff)
+		obj_add_uint64(r, "max_active_zones", (__u64)s->mar + 1);
+
+	obj_add_uint64(r, "written", s->written);
+	obj_add_uint64(r, "capacity", s->capacity);
+
+	for (i = 0; i < NVME_ZNS_FILL_BUCKETS; i++) {
+		bucket = json_create_object();
+		obj_add_uint(bucket, "min_percent", i * 100 / NVME_ZNS_FILL_BUCKETS);
+		obj_add_uint(bucket, "max_percent", (i + 1) * 100 / NVME_ZNS_FILL_BUCKETS);
+		obj_add_uint64(bucket, "zones", s->fill[i]);
+		array_add_obj(fill, bucket);
+	}
+	obj_add_array(r, "fill_histogram", fill);
+
+	if (s->nr_top) {
+		json_zns_zone_fill(r, "emptiest", s->emptiest, s->nr_top);
+		json_zns_zone_fill(r, "fullest", s->fullest, s->nr_top);
+	}
+
+	json_print(r);
 }
 
 static void json_feature_show_fields_arbitration(struct json_object *r, unsigned int result)
@@ -4189,6 +4435,37 @@ static void json_list_item(nvme_ns_t n)
 	json_print(r);
 }
 
+/*
+ * Events are streamed as one compact object per line so that consumers
+ * can process them as they arrive.
+ */
+static void json_list_event(const char *action, const char *name,
+			    nvme_ctrl_t c, nvme_ns_t n)
+{
+	struct json_object *r;
+
+	if (n) {
+		r = json_list_item_obj(n);
+	} else {
+		r = json_create_object();
+		if (c) {
+			obj_add_str(r, "Controller", name);
+			obj_add_str(r, "Transport", nvme_ctrl_get_transport(c));
+			obj_add_str(r, "Address", nvme_ctrl_get_address(c));
+			obj_add_str(r, "State", nvme_ctrl_get_state(c));
+			obj_add_str(r, "SubsystemNQN", nvme_ctrl_get_subsysnqn(c));
+		} else {
+			obj_add_str(r, "Device", name);
+		}
+	}
+	obj_add_str(r, "Event", action);
+
+	printf("%s\n", json_object_to_json_string_ext(r,
+		JSON_C_TO_STRING_PLAIN | JSON_C_TO_STRING_NOSLASHESCAPE));
+	fflush(stdout);
+	json_free_object(r);
+}
+
 static void json_print_list_items(nvme_root_t t)
 {
 	json_detail_list(t);
@@ -4472,6 +4749,174 @@ static void json_connect_msg(nvme_ctrl_t c)
 	json_print(r);
 }
 
+static void json_connect_timing(struct nvmf_timing *t)
+{
+	struct json_object *r = json_create_object();
+	struct json_object *conns = json_create_array();
+	struct json_object *summary = json_create_object();
+	struct nvmf_timing_stats stats;
+	unsigned int i;
+	int p;
+
+	obj_add_uint64(r, "elapsed_us", t->elapsed_us);
+
+	for (i = 0; i < t->nr; i++) {
+		struct nvmf_timing_entry *e = &t->entry[i];
+		struct json_object *conn = json_create_object();
+		struct json_object *phases = json_create_object();
+
+		if (*e->device)
+			obj_add_str(conn, "device", e->device);
+		obj_add_str(conn, "type", e->discovery ? "discovery" : "io");
+		obj_add_str(conn, "transport", e->transport);
+		obj_add_str(conn, "traddr", e->traddr);
+		obj_add_str(conn, "trsvcid", e->trsvcid);
+		obj_add_str(conn, "subsysnqn", e->subsysnqn);
+		obj_add_int(conn, "tls", e->tls);
+		obj_add_int(conn, "dhchap", e->dhchap);
+		if (!e->discovery)
+			obj_add_int(conn, "namespaces", e->nr_ns);
+		obj_add_str(conn, "result", e->err ? nvme_strerror(e->err) : "success");
+
+		for (p = 0; p < NVMF_TIMING_NR_PHASES; p++)
+			if (e->phase_us[p] != NVMF_TIMING_UNSET)
+				obj_add_uint64(phases, nvmf_timing_phase_str(p),
+					       e->phase_us[p]);
+		obj_add_obj(conn, "phases_us", phases);
+
+		array_add_obj(conns, conn);
+	}
+	obj_add_array(r, "connections", conns);
+
+	for (p = 0; p < NVMF_TIMING_NR_PHASES; p++) {
+		struct json_object *phase;
+
+		if (nvmf_timing_stats(t, p, &stats) <= 0)
+			continue;
+
+		phase = json_create_object();
+		obj_add_uint(phase, "count", stats.count);
+		obj_add_uint64(phase, "min_us", stats.min_us);
+		obj_add_uint64(phase, "avg_us", stats.avg_us);
+		obj_add_uint64(phase, "p50_us", stats.p50_us);
+		obj_add_uint64(phase, "p99_us", stats.p99_us);
+		obj_add_uint64(phase, "max_us", stats.max_us);
+		obj_add_obj(summary, nvmf_timing_phase_str(p), phase);
+	}
+	obj_add_obj(r, "summary", summary);
+
+	json_print(r);
+}
+
+static void json_fw_rollout(struct nvme_fw_rollout *fr)
+{
+	struct json_object *r = json_create_object();
+	struct json_object *ctrls = json_create_array();
+	int i, failed = 0;
+
+	obj_add_str(r, "firmware", fr->fw);
+	obj_add_uint(r, "slot", fr->slot);
+	obj_add_uint(r, "action", fr->action);
+	obj_add_uint64(r, "elapsed_us", fr->elapsed_us);
+
+	for (i = 0; i < fr->nr; i++) {
+		struct nvme_fw_rollout_entry *e = &fr->entry[i];
+		struct json_object *c = json_create_object();
+
+		obj_add_str(c, "device", e->fleet.device);
+		obj_add_str(c, "model", e->fleet.model);
+		obj_add_str(c, "serial", e->fleet.serial);
+		obj_add_str(c, "firmware_before", e->fw_before);
+		if (*e->slot_fw)
+			obj_add_str(c, "slot_firmware", e->slot_fw);
+		obj_add_uint(c, "active_slot", e->active_slot);
+		obj_add_uint(c, "next_slot", e->next_slot);
+		obj_add_uint64(c, "download_us", e->download_us);
+		obj_add_uint64(c, "commit_us", e->commit_us);
+		if (e->mud)
+			obj_add_uint(c, "mud", e->mud);
+		obj_add_str(c, "result", e->fleet.result);
+		if (e->reset)
+			obj_add_str(c, "reset", e->reset);
+		if (*e->fleet.error)
+			obj_add_str(c, "error", e->fleet.error);
+		array_add_obj(ctrls, c);
+
+		if (e->fleet.failed)
+			failed++;
+	}
+	obj_add_array(r, "controllers", ctrls);
+	obj_add_int(r, "succeeded", fr->nr - failed);
+	obj_add_int(r, "failed", failed);
+
+	json_print(r);
+}
+
+static struct json_object *json_fleet_entry(struct nvme_fleet_entry *e)
+{
+	struct json_object *c = json_create_object();
+
+	obj_add_str(c, "device", e->device);
+	obj_add_str(c, "model", e->model);
+	obj_add_str(c, "serial", e->serial);
+	obj_add_uint64(c, "elapsed_us", e->elapsed_us);
+	obj_add_uint(c, "polls", e->polls);
+	obj_add_str(c, "result", e->result);
+	if (*e->error)
+		obj_add_str(c, "error", e->error);
+
+	return c;
+}
+
+static void json_wipe(struct nvme_wipe *w)
+{
+	struct json_object *r = json_create_object();
+	struct json_object *ctrls = json_create_array();
+	int i, failed = 0;
+
+	obj_add_str(r, "action", w->action);
+	obj_add_uint64(r, "elapsed_us", w->elapsed_us);
+
+	for (i = 0; i < w->nr; i++) {
+		array_add_obj(ctrls, json_fleet_entry(&w->entry[i]));
+		if (w->entry[i].failed)
+			failed++;
+	}
+	obj_add_array(r, "controllers", ctrls);
+	obj_add_int(r, "succeeded", w->nr - failed);
+	obj_add_int(r, "failed", failed);
+
+	json_print(r);
+}
+
+static void json_self_test_fleet(struct nvme_self_test_fleet *f)
+{
+	struct json_object *r = json_create_object();
+	struct json_object *ctrls = json_create_array();
+	int i, failed = 0;
+
+	obj_add_uint(r, "self_test_code", f->stc);
+	obj_add_uint64(r, "elapsed_us", f->elapsed_us);
+
+	for (i = 0; i < f->nr; i++) {
+		struct nvme_self_test_fleet_entry *e = &f->entry[i];
+		struct json_object *c = json_fleet_entry(&e->fleet);
+
+		obj_add_uint(c, "dsts", e->dsts);
+		if ((e->dsts & NVME_ST_RESULT_MASK) == NVME_ST_RESULT_KNOWN_SEG_FAIL)
+			obj_add_uint(c, "segment", e->seg);
+		array_add_obj(ctrls, c);
+
+		if (e->fleet.failed)
+			failed++;
+	}
+	obj_add_array(r, "controllers", ctrls);
+	obj_add_int(r, "passed", f->nr - failed);
+	obj_add_int(r, "failed", failed);
+
+	json_print(r);
+}
+
 static void json_output_object(struct json_object *r)
 {
 	json_print(r);
@@ -4669,12 +5114,19 @@ static struct print_ops json_print_ops = {
 	.endurance_log			= json_endurance_log,
 	.error_log			= json_error_log,
 	.fdp_config_log			= json_nvme_fdp_configs,
+	.fdp_event			= json_fdp_event,
 	.fdp_event_log			= json_nvme_fdp_events,
+	.fdp_ruh_events			= json_fdp_ruh_events,
 	.fdp_ruh_status			= json_nvme_fdp_ruh_status,
+	.fdp_ruh_trend			= json_fdp_ruh_trend,
 	.fdp_stats_log			= json_nvme_fdp_stats,
 	.fdp_usage_log			= json_nvme_fdp_usage,
+	.fdp_workload			= json_nvme_fdp_workload,
 	.fid_supported_effects_log	= json_fid_support_effects_log,
 	.fw_log				= json_fw_log,
+	.fw_rollout			= json_fw_rollout,
+	.wipe				= json_wipe,
+	.self_test_fleet		= json_self_test_fleet,
 	.id_ctrl			= json_nvme_id_ctrl,
 	.id_ctrl_nvm			= json_nvme_id_ctrl_nvm,
 	.id_domain_list			= json_id_domain_list,
@@ -4712,6 +5164,7 @@ static struct print_ops json_print_ops = {
 	.zns_id_ctrl			= json_nvme_zns_id_ctrl,
 	.zns_id_ns			= json_nvme_zns_id_ns,
 	.zns_report_zones		= json_nvme_zns_report_zones,
+	.zns_zone_summary		= json_zns_zone_summary,
 	.show_feature			= json_feature_show,
 	.show_feature_fields		= json_feature_show_fields,
 	.id_ctrl_rpmbs			= json_id_ctrl_rpmbs,
@@ -4726,9 +5179,11 @@ static struct print_ops json_print_ops = {
 	/* libnvme tree print functions */
 	.list_item			= json_list_item,
 	.list_items			= json_print_list_items,
+	.list_event			= json_list_event,
 	.print_nvme_subsystem_list	= json_print_nvme_subsystem_list,
 	.topology_ctrl			= json_simple_topology,
 	.topology_namespace		= json_simple_topology,
+	.connect_timing			= json_connect_timing,
 
 	/* status and error messages */
 	.connect_msg			= json_connect_msg,
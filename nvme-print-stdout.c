@@ -19,6 +19,7 @@
 #include "util/suffix.h"
 #include "util/types.h"
 #include "common.h"
+#include "fabrics.h"
 
 static const uint8_t zero_uuid[16] = { 0 };
 static const uint8_t invalid_uuid[16] = {[0 ... 15] = 0xff };
@@ -940,53 +941,140 @@ static void stdout_fdp_stats(struct nvme_fdp_stats_log *log)
 		uint128_t_to_l10n_string(le128_to_cpu(log->mbe)));
 }
 
-static void stdout_fdp_events(struct nvme_fdp_events_log *log)
+static void stdout_fdp_ruh_trend(struct nvme_fdp_ruh_trend *t)
+{
+	char ttl[32];
+
+	printf("Namespace %u: %u samples over %.1f s\n", t->nsid, t->samples, t->seconds);
+	printf("%-5s %-5s %14s %8s %14s %8s %12s %14s\n", "PID", "RUHID", "RUAMW",
+	       "EARUTR", "Written", "Switches", "LBAs/s", "To switch (s)");
+
+	for (int i = 0; i < t->nr; i++) {
+		struct nvme_fdp_ruh_usage *u = &t->ruhs[i];
+
+		if (u->ttl >= 0)
+			snprintf(ttl, sizeof(ttl), "%.1f", u->ttl);
+		else
+			snprintf(ttl, sizeof(ttl), "-");
+
+		printf("%-5u %-5u %14"PRIu64" %8u %14"PRIu64" %8u %12.1f %14s\n",
+		       u->pid, u->ruhid, (uint64_t)u->ruamw, u->earutr,
+		       (uint64_t)u->written, u->switches, u->rate, ttl);
+	}
+
+	printf("Mean fill rate: %.1f LBAs/s, imbalance (max/mean): %.2f, "
+	       "spread ((max-min)/mean): %.2f\n", t->mean_rate, t->imbalance, t->spread);
+}
+
+static void stdout_fdp_workload(struct nvme_fdp_workload *res)
+{
+	int i;
+
+	printf("Namespace %u, endurance group %u: %s", res->nsid, res->egid, res->mode);
+	if (res->nr_pids)
+		printf(" over %d placement identifiers\n", res->nr_pids);
+	else
+		printf(" without placement directive\n");
+
+	printf("Written: %"PRIu64" bytes in %"PRIu64" writes, %.1f s (%.1f MiB/s)\n",
+	       (uint64_t)res->bytes, (uint64_t)res->writes, res->seconds,
+	       res->seconds ? res->bytes / res->seconds / (1 << 20) : 0);
+	for (i = 0; i < res->nr_pids; i++)
+		printf("  PID %u: %"PRIu64" bytes (%.1f%%)\n", res->pids[i],
+		       (uint64_t)res->written[i],
+		       res->bytes ? 100.0 * res->written[i] / res->bytes : 0);
+
+	printf("Host Bytes with Metadata Written (HBMW) delta: %.0Lf\n", res->hbmw);
+	printf("Media Bytes with Metadata Written (MBMW) delta: %.0Lf\n", res->mbmw);
+	printf("Media Bytes Erased (MBE) delta: %.0Lf\n", res->mbe);
+	if (res->hbmw > 0)
+		printf("Write Amplification (MBMW/HBMW): %.3Lf\n", res->mbmw / res->hbmw);
+	else
+		printf("Write Amplification (MBMW/HBMW): n/a\n");
+}
+
+static void stdout_fdp_event_fields(struct nvme_fdp_event *event)
 {
 	struct tm *tm;
 	char buffer[320];
 	time_t ts;
-	uint32_t n = le32_to_cpu(log->n);
 
-	for (unsigned int i = 0; i < n; i++) {
-		struct nvme_fdp_event *event = &log->events[i];
+	ts = int48_to_long(event->ts.timestamp) / 1000;
+	tm = localtime(&ts);
 
-		ts = int48_to_long(event->ts.timestamp) / 1000;
-		tm = localtime(&ts);
+	printf("  Event Type: %#"PRIx8" (%s)\n", event->type,
+	       nvme_fdp_event_to_string(event->type));
+	printf("  Event Timestamp: %"PRIu64" (%s)\n", int48_to_long(event->ts.timestamp),
+		strftime(buffer, sizeof(buffer), "%c %Z", tm) ? buffer : "-");
 
-		printf("Event[%u]\n", i);
-		printf("  Event Type: %#"PRIx8" (%s)\n", event->type,
-		       nvme_fdp_event_to_string(event->type));
-		printf("  Event Timestamp: %"PRIu64" (%s)\n", int48_to_long(event->ts.timestamp),
-			strftime(buffer, sizeof(buffer), "%c %Z", tm) ? buffer : "-");
+	if (event->flags & NVME_FDP_EVENT_F_PIV)
+		printf("  Placement Identifier (PID): %#"PRIx16"\n",
+		       le16_to_cpu(event->pid));
 
-		if (event->flags & NVME_FDP_EVENT_F_PIV)
-			printf("  Placement Identifier (PID): %#"PRIx16"\n",
-			       le16_to_cpu(event->pid));
+	if (event->flags & NVME_FDP_EVENT_F_NSIDV)
+		printf("  Namespace Identifier (NSID): %"PRIu32"\n", le32_to_cpu(event->nsid));
 
-		if (event->flags & NVME_FDP_EVENT_F_NSIDV)
-			printf("  Namespace Identifier (NSID): %"PRIu32"\n", le32_to_cpu(event->nsid));
+	if (event->type == NVME_FDP_EVENT_REALLOC) {
+		struct nvme_fdp_event_realloc *mr;
 
-		if (event->type == NVME_FDP_EVENT_REALLOC) {
-			struct nvme_fdp_event_realloc *mr;
+		mr = (struct nvme_fdp_event_realloc *)&event->type_specific;
 
-			mr = (struct nvme_fdp_event_realloc *)&event->type_specific;
+		printf("  Number of LBAs Moved (NLBAM): %"PRIu16"\n", le16_to_cpu(mr->nlbam));
 
-			printf("  Number of LBAs Moved (NLBAM): %"PRIu16"\n", le16_to_cpu(mr->nlbam));
+		if (mr->flags & NVME_FDP_EVENT_REALLOC_F_LBAV)
+			printf("  Logical Block Address (LBA): %#"PRIx64"\n",
+			       le64_to_cpu(mr->lba));
+	}
 
-			if (mr->flags & NVME_FDP_EVENT_REALLOC_F_LBAV)
-				printf("  Logical Block Address (LBA): %#"PRIx64"\n",
-				       le64_to_cpu(mr->lba));
-		}
+	if (event->flags & NVME_FDP_EVENT_F_LV) {
+		printf("  Reclaim Group Identifier: %"PRIu16"\n", le16_to_cpu(event->rgid));
+		printf("  Reclaim Unit Handle Identifier %"PRIu8"\n", event->ruhid);
+	}
+}
 
-		if (event->flags & NVME_FDP_EVENT_F_LV) {
-			printf("  Reclaim Group Identifier: %"PRIu16"\n", le16_to_cpu(event->rgid));
-			printf("  Reclaim Unit Handle Identifier %"PRIu8"\n", event->ruhid);
-		}
+static void stdout_fdp_events(struct nvme_fdp_events_log *log)
+{
+	uint32_t n = le32_to_cpu(log->n);
 
+	for (unsigned int i = 0; i < n; i++) {
+		printf("Event[%u]\n", i);
+		stdout_fdp_event_fields(&log->events[i]);
 		printf("\n");
 	}
 }
 
+static void stdout_fdp_ruh_events_counts(struct nvme_fdp_ruh_events *ruh)
+{
+	printf("%"PRIu64" events, %"PRIu64" not fully written, %"PRIu64" reallocated "
+	       "(%"PRIu64" LBAs moved), %"PRIu64" implicitly modified\n",
+	       (uint64_t)ruh->events, (uint64_t)ruh->runfw, (uint64_t)ruh->realloc,
+	       (uint64_t)ruh->nlbam, (uint64_t)ruh->modify);
+}
+
+static void stdout_fdp_event(struct nvme_fdp_event *event, struct nvme_fdp_ruh_events *ruh)
+{
+	printf("Event\n");
+	stdout_fdp_event_fields(event);
+	if (ruh) {
+		printf("  Reclaim Unit Handle so far: ");
+		stdout_fdp_ruh_events_counts(ruh);
+	}
+	printf("\n");
+	fflush(stdout);
+}
+
+static void stdout_fdp_ruh_events(struct nvme_fdp_ruh_events *ruhs, int nr)
+{
+	for (int i = 0; i < nr; i++) {
+		if (ruhs[i].lv)
+			printf("Reclaim Group %"PRIu16" Handle %"PRIu8": ",
+			       ruhs[i].rgid, ruhs[i].ruhid);
+		else
+			printf("Without location: ");
+		stdout_fdp_ruh_events_counts(&ruhs[i]);
+	}
+}
+
 static void stdout_fdp_ruh_status(struct nvme_fdp_ruh_status *status, size_t len)
 {
 	uint16_t nruhsd = le16_to_cpu(status->nruhsd);
@@ -3683,6 +3771,72 @@ static void stdout_zns_report_zones(void *report, __u32 descs,
 	}
 }
 
+static void stdout_zns_zone_fill(const char *title,
+				 struct nvme_zns_zone_fill *z, int nr)
+{
+	int i;
+
+	printf("%s:\n", title);
+	for (i = 0; i < nr; i++)
+		printf("  SLBA: %#-10"PRIx64" State: %-12s Written: %"PRIu64" of %"PRIu64" LBAs (%.1f%%)\n",
+		       (uint64_t)z[i].zslba, nvme_zone_state_to_string(z[i].state),
+		       (uint64_t)z[i].written, (uint64_t)z[i].cap,
+		       z[i].cap ? 100.0 * z[i].written / z[i].cap : 0);
+}
+
+static void stdout_zns_zone_limit(const char *title, __u64 nr, __u32 max)
+{
+	printf("%-14s: %"PRIu64, title, (uint64_t)nr);
+	if (max == 0xffffffff)
+		printf(" (no limit)\n");
+	else
+		printf(" of %"PRIu64"\n", (uint64_t)max + 1);
+}
+
+static void stdout_zns_zone_summary(struct nvme_zns_zone_summary *s)
+{
+	static const __u8 states[] = {
+		NVME_ZNS_ZS_EMPTY, NVME_ZNS_ZS_IMPL_OPEN, NVME_ZNS_ZS_EXPL_OPEN,
+		NVME_ZNS_ZS_CLOSED, NVME_ZNS_ZS_READ_ONLY, NVME_ZNS_ZS_FULL,
+		NVME_ZNS_ZS_OFFLINE,
+	};
+	__u64 open = s->state[NVME_ZNS_ZS_IMPL_OPEN] + s->state[NVME_ZNS_ZS_EXPL_OPEN];
+	__u64 fill_max = 0;
+	int i;
+
+	printf("Namespace %u: %"PRIu64" zones of %#"PRIx64" LBAs\n", s->nsid,
+	       (uint64_t)s->nr_zones, (uint64_t)s->zsze);
+
+	printf("Zone states:\n");
+	for (i = 0; i < ARRAY_SIZE(states); i++)
+		printf("  %-12s: %"PRIu64"\n", nvme_zone_state_to_string(states[i]),
+		       (uint64_t)s->state[states[i]]);
+
+	stdout_zns_zone_limit("Open zones", open, s->mor);
+	stdout_zns_zone_limit("Active zones", open + s->state[NVME_ZNS_ZS_CLOSED],
+			      s->mar);
+	printf("%-14s: %"PRIu64" of %"PRIu64" LBAs (%.1f%%)\n", "Written",
+	       (uint64_t)s->written, (uint64_t)s->capacity,
+	       s->capacity ? 100.0 * s->written / s->capacity : 0);
+
+	for (i = 0; i < NVME_ZNS_FILL_BUCKETS; i++)
+		fill_max = max(fill_max, s->fill[i]);
+
+	printf("Fill level histogram:\n");
+	for (i = 0; i < NVME_ZNS_FILL_BUCKETS; i++)
+		printf("  %3d-%3d%%: %10"PRIu64" %.*s\n",
+		       i * 100 / NVME_ZNS_FILL_BUCKETS,
+		       (i + 1) * 100 / NVME_ZNS_FILL_BUCKETS,
+		       (uint64_t)s->fill[i],
+		       fill_max ? (int)(s->fill[i] * 50 / fill_max) : 0,
+		       "##################################################");
+
+	if (s->nr_top) {
+		stdout_zns_zone_fill("Emptiest zones", s->emptiest, s->nr_top);
+		stdout_zns_zone_fill("Fullest zones", s->fullest, s->nr_top);
+	}
+}
+
 static void stdout_list_ctrl(struct nvme_ctrl_list *ctrl_list)
 {
 	__u16 num = le16_to_cpu(ctrl_list->num);
@@ -4007,6 +4161,85 @@ static void stdout_fw_log(struct nvme_firmware_slot *fw_log,
 	}
 }
 
+static void stdout_fw_rollout(struct nvme_fw_rollout *r)
+{
+	int i, failed = 0;
+
+	printf("Firmware rollout of %s action:%u slot:%u, %d controller(s), %.2f s\n",
+	       r->fw, r->action, r->slot, r->nr, r->elapsed_us / 1000000.0);
+	printf("%-10s %-24s %-20s %-8s %-8s %-6s %-4s %9s  %s\n", "Device",
+	       "Model", "Serial", "Before", "Slot FW", "Active", "Next",
+	       "Download", "Result");
+
+	for (i = 0; i < r->nr; i++) {
+		struct nvme_fw_rollout_entry *e = &r->entry[i];
+
+		printf("%-10s %-24.24s %-20s %-8s %-8s %-6u %-4u %8.2fs  %s",
+		       e->fleet.device, e->fleet.model, e->fleet.serial,
+		       e->fw_before,
+		       *e->slot_fw ? e->slot_fw : "-", e->active_slot,
+		       e->next_slot, e->download_us / 1000000.0, e->fleet.result);
+		if (e->reset)
+			printf(" (%s reset)", e->reset);
+		if (e->mud)
+			printf(" MUD:%#x", e->mud);
+		if (*e->fleet.error)
+			printf(": %s", e->fleet.error);
+		printf("\n");
+
+		if (e->fleet.failed)
+			failed++;
+	}
+
+	printf("%d succeeded, %d failed\n", r->nr - failed, failed);
+}
+
+static void stdout_fleet_entry(struct nvme_fleet_entry *e)
+{
+	printf("%-10s %-24.24s %-20s %9.2fs %6u  %s", e->device, e->model,
+	       e->serial, e->elapsed_us / 1000000.0, e->polls, e->result);
+	if (*e->error)
+		printf(": %s", e->error);
+	printf("\n");
+}
+
+static void stdout_wipe(struct nvme_wipe *w)
+{
+	int i, failed = 0;
+
+	printf("Wipe by %s, %d controller(s), %.2f s\n", w->action, w->nr,
+	       w->elapsed_us / 1000000.0);
+	printf("%-10s %-24s %-20s %10s %6s  %s\n", "Device", "Model", "Serial",
+	       "Elapsed", "Polls", "Result");
+
+	for (i = 0; i < w->nr; i++) {
+		stdout_fleet_entry(&w->entry[i]);
+		if (w->entry[i].failed)
+			failed++;
+	}
+
+	printf("%d succeeded, %d failed\n", w->nr - failed, failed);
+}
+
+static void stdout_self_test_fleet(struct nvme_self_test_fleet *f)
+{
+	int i, failed = 0;
+
+	printf("%s device self-test, %d controller(s), %.2f s\n",
+	       f->stc == NVME_ST_CODE_EXTENDED ? "Extended" : "Short", f->nr,
+	       f->elapsed_us / 1000000.0);
+	printf("%-10s %-24s %-20s %10s %6s  %s\n", "Device", "Model", "Serial",
+	       "Elapsed", "Polls", "Result");
+
+	for (i = 0; i < f->nr; i++) {
+		stdout_fleet_entry(&f->entry[i].fleet);
+		if (f->entry[i].fleet.failed)
+			failed++;
+	}
+
+	printf("%d passed, %d failed\n", f->nr - failed, failed);
+}
+
 static void stdout_changed_ns_list_log(struct nvme_ns_list *log,
 				       const char *devname)
 {
@@ -5165,6 +5398,28 @@ static void stdout_simple_list(nvme_root_t r)
 	nvme_resources_free(&res);
 }
 
+/*
+ * One line per uevent for nvme list --watch. Namespaces reuse the list
+ * columns, controllers show their transport, address and state. Removed
+ * devices are reported by name only.
+ */
+static void stdout_list_event(const char *action, const char *name,
+			      nvme_ctrl_t c, nvme_ns_t n)
+{
+	printf("%-7s ", action);
+
+	if (n)
+		stdout_list_item(n);
+	else if (c)
+		printf("%-21s %-8s %-40s %-12s %s\n", name,
+		       nvme_ctrl_get_transport(c), nvme_ctrl_get_address(c),
+		       nvme_ctrl_get_state(c), nvme_ctrl_get_subsysnqn(c));
+	else
+		printf("%s\n", name);
+
+	fflush(stdout);
+}
+
 static void stdout_ns_details(nvme_ns_t n)
 {
 	char usage[128] = { 0 }, format[128] = { 0 };
@@ -5539,6 +5794,45 @@ static void stdout_connect_msg(nvme_ctrl_t c)
 	printf("connecting to device: %s\n", nvme_ctrl_get_name(c));
 }
 
+static void stdout_connect_timing(struct nvmf_timing *t)
+{
+	struct nvmf_timing_stats stats;
+	unsigned int i;
+	int p;
+
+	printf("Connect timing, %u connection(s), elapsed %" PRIu64 " us\n",
+	       t->nr, t->elapsed_us);
+
+	for (i = 0; i < t->nr; i++) {
+		struct nvmf_timing_entry *e = &t->entry[i];
+
+		printf("%-8s %-9s %s %s:%s %s%s%s\n",
+		       *e->device ? e->device : "-",
+		       e->discovery ? "discovery" : "io", e->transport,
+		       e->traddr, e->trsvcid, e->subsysnqn,
+		       e->tls ? " tls" : "", e->dhchap ? " dhchap" : "");
+		for (p = 0; p < NVMF_TIMING_NR_PHASES; p++)
+			if (e->phase_us[p] != NVMF_TIMING_UNSET)
+				printf("  %-18s %10" PRIu64 " us\n",
+				       nvmf_timing_phase_str(p), e->phase_us[p]);
+		if (!e->discovery && e->phase_us[NVMF_TIMING_NS_LIVE] != NVMF_TIMING_UNSET)
+			printf("  %-18s %10d\n", "namespaces", e->nr_ns);
+		if (e->err)
+			printf("  %-18s %s\n", "result", nvme_strerror(e->err));
+	}
+
+	printf("\n%-18s %6s %10s %10s %10s %10s %10s\n", "phase (us)", "count",
+	       "min", "avg", "p50", "p99", "max");
+	for (p = 0; p < NVMF_TIMING_NR_PHASES; p++) {
+		if (nvmf_timing_stats(t, p, &stats) <= 0)
+			continue;
+		printf("%-18s %6u %10" PRIu64 " %10" PRIu64 " %10" PRIu64
+		       " %10" PRIu64 " %10" PRIu64 "\n",
+		       nvmf_timing_phase_str(p), stats.count, stats.min_us,
+		       stats.avg_us, stats.p50_us, stats.p99_us, stats.max_us);
+	}
+}
+
 static void stdout_mgmt_addr_list_log(struct nvme_mgmt_addr_list_log *ma_list)
 {
 	int i;
@@ -5593,12 +5887,19 @@ static struct print_ops stdout_print_ops = {
 	.endurance_log			= stdout_endurance_log,
 	.error_log			= stdout_error_log,
 	.fdp_config_log			= stdout_fdp_configs,
+	.fdp_event			= stdout_fdp_event,
 	.fdp_event_log			= stdout_fdp_events,
+	.fdp_ruh_events			= stdout_fdp_ruh_events,
 	.fdp_ruh_status			= stdout_fdp_ruh_status,
+	.fdp_ruh_trend			= stdout_fdp_ruh_trend,
 	.fdp_stats_log			= stdout_fdp_stats,
 	.fdp_usage_log			= stdout_fdp_usage,
+	.fdp_workload			= stdout_fdp_workload,
 	.fid_supported_effects_log	= stdout_fid_support_effects_log,
 	.fw_log				= stdout_fw_log,
+	.fw_rollout			= stdout_fw_rollout,
+	.wipe				= stdout_wipe,
+	.self_test_fleet		= stdout_self_test_fleet,
 	.id_ctrl			= stdout_id_ctrl,
 	.id_ctrl_nvm			= stdout_id_ctrl_nvm,
 	.id_domain_list			= stdout_id_domain_list,
@@ -5636,6 +5937,7 @@ static struct print_ops stdout_print_ops = {
 	.zns_id_ctrl			= stdout_zns_id_ctrl,
 	.zns_id_ns			= stdout_zns_id_ns,
 	.zns_report_zones		= stdout_zns_report_zones,
+	.zns_zone_summary		= stdout_zns_zone_summary,
 	.show_feature			= stdout_feature_show,
 	.show_feature_fields		= stdout_feature_show_fields,
 	.id_ctrl_rpmbs			= stdout_id_ctrl_rpmbs,
@@ -5650,9 +5952,11 @@ static struct print_ops stdout_print_ops = {
 	/* libnvme tree print functions */
 	.list_item			= stdout_list_item,
 	.list_items			= stdout_list_items,
+	.list_event			= stdout_list_event,
 	.print_nvme_subsystem_list	= stdout_subsystem_list,
 	.topology_ctrl			= stdout_topology_ctrl,
 	.topology_namespace		= stdout_topology_namespace,
+	.connect_timing			= stdout_connect_timing,
 
 	/* status and error messages */
 	.connect_msg			= stdout_connect_msg,
@@ -360,12 +360,36 @@ void nvme_show_fdp_events(struct nvme_fdp_events_log *log,
 	nvme_print(fdp_event_log, flags, log);
 }
 
+void nvme_show_fdp_event(struct nvme_fdp_event *event,
+		struct nvme_fdp_ruh_events *ruh, nvme_print_flags_t flags)
+{
+	nvme_print(fdp_event, flags, event, ruh);
+}
+
+void nvme_show_fdp_ruh_events(struct nvme_fdp_ruh_events *ruhs, int nr,
+		nvme_print_flags_t flags)
+{
+	nvme_print(fdp_ruh_events, flags, ruhs, nr);
+}
+
 void nvme_show_fdp_ruh_status(struct nvme_fdp_ruh_status *status, size_t len,
 		nvme_print_flags_t flags)
 {
 	nvme_print(fdp_ruh_status, flags, status, len);
 }
 
+void nvme_show_fdp_ruh_trend(struct nvme_fdp_ruh_trend *t,
+		nvme_print_flags_t flags)
+{
+	nvme_print(fdp_ruh_trend, flags, t);
+}
+
+void nvme_show_fdp_workload(struct nvme_fdp_workload *res,
+		nvme_print_flags_t flags)
+{
+	nvme_print(fdp_workload, flags, res);
+}
+
 void nvme_show_supported_cap_config_log(
 	struct nvme_supported_cap_config_list_log *cap,
 	nvme_print_flags_t flags)
@@ -652,6 +676,12 @@ void nvme_show_zns_report_zones(void *report, __u32 descs,
 		   report, descs, ext_size, report_size, zone_list);
 }
 
+void nvme_show_zns_zone_summary(struct nvme_zns_zone_summary *s,
+				nvme_print_flags_t flags)
+{
+	nvme_print(zns_zone_summary, flags, s);
+}
+
 void nvme_show_list_ctrl(struct nvme_ctrl_list *ctrl_list,
 	nvme_print_flags_t flags)
 {
@@ -740,6 +770,21 @@ void nvme_show_fw_log(struct nvme_firmware_slot *fw_log,
 	nvme_print(fw_log, flags, fw_log, devname);
 }
 
+void nvme_show_fw_rollout(struct nvme_fw_rollout *r, nvme_print_flags_t flags)
+{
+	nvme_print(fw_rollout, flags, r);
+}
+
+void nvme_show_wipe(struct nvme_wipe *w, nvme_print_flags_t flags)
+{
+	nvme_print(wipe, flags, w);
+}
+
+void nvme_show_self_test_fleet(struct nvme_self_test_fleet *f, nvme_print_flags_t flags)
+{
+	nvme_print(self_test_fleet, flags, f);
+}
+
 void nvme_show_changed_ns_list_log(struct nvme_ns_list *log,
 				   const char *devname,
 				   nvme_print_flags_t flags)
@@ -1435,6 +1480,12 @@ void nvme_show_list_items(nvme_root_t r, nvme_print_flags_t flags)
 	nvme_print(list_items, flags, r);
 }
 
+void nvme_show_list_event(const char *action, const char *name,
+			  nvme_ctrl_t c, nvme_ns_t n, nvme_print_flags_t flags)
+{
+	nvme_print(list_event, flags, action, name, c, n);
+}
+
 void nvme_show_topology(nvme_root_t r,
 			enum nvme_cli_topo_ranking ranking,
 			nvme_print_flags_t flags)
@@ -1483,6 +1534,11 @@ void nvme_show_connect_msg(nvme_ctrl_t c, nvme_print_flags_t flags)
 	nvme_print(connect_msg, flags, c);
 }
 
+void nvme_show_connect_timing(struct nvmf_timing *t, nvme_print_flags_t flags)
+{
+	nvme_print(connect_timing, flags, t);
+}
+
 void nvme_show_init(void)
 {
 	nvme_print_output_format(show_init);
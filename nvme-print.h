@@ -18,6 +18,8 @@ typedef struct nvme_effects_log_node {
 
 #define POWER_OF_TWO(exponent) (1 << (exponent))
 
+struct nvmf_timing;
+
 void d(unsigned char *buf, int len, int width, int group);
 void d_raw(unsigned char *buf, unsigned len);
 
@@ -37,12 +39,19 @@ struct print_ops {
 	void (*endurance_log)(struct nvme_endurance_group_log *endurance_group, __u16 group_id, const char *devname);
 	void (*error_log)(struct nvme_error_log_page *err_log, int entries, const char *devname);
 	void (*fdp_config_log)(struct nvme_fdp_config_log *log, size_t len);
+	void (*fdp_event)(struct nvme_fdp_event *event, struct nvme_fdp_ruh_events *ruh);
 	void (*fdp_event_log)(struct nvme_fdp_events_log *log);
+	void (*fdp_ruh_events)(struct nvme_fdp_ruh_events *ruhs, int nr);
 	void (*fdp_ruh_status)(struct nvme_fdp_ruh_status *status, size_t len);
+	void (*fdp_ruh_trend)(struct nvme_fdp_ruh_trend *t);
 	void (*fdp_stats_log)(struct nvme_fdp_stats_log *log);
 	void (*fdp_usage_log)(struct nvme_fdp_ruhu_log *log, size_t len);
+	void (*fdp_workload)(struct nvme_fdp_workload *res);
 	void (*fid_supported_effects_log)(struct nvme_fid_supported_effects_log *fid_log, const char *devname);
 	void (*fw_log)(struct nvme_firmware_slot *fw_log, const char *devname);
+	void (*fw_rollout)(struct nvme_fw_rollout *r);
+	void (*wipe)(struct nvme_wipe *w);
+	void (*self_test_fleet)(struct nvme_self_test_fleet *f);
 	void (*id_ctrl)(struct nvme_id_ctrl *ctrl, void (*vs)(__u8 *vs, struct json_object *root));
 	void (*id_ctrl_nvm)(struct nvme_id_ctrl_nvm *ctrl_nvm);
 	void (*id_domain_list)(struct nvme_id_domain_list *id_dom);
@@ -80,6 +89,7 @@ struct print_ops {
 	void (*zns_id_ctrl)(struct nvme_zns_id_ctrl *ctrl);
 	void (*zns_id_ns)(struct nvme_zns_id_ns *ns, struct nvme_id_ns *id_ns);
 	void (*zns_report_zones)(void *report, __u32 descs, __u8 ext_size, __u32 report_size, struct json_object *zone_list);
+	void (*zns_zone_summary)(struct nvme_zns_zone_summary *s);
 	void (*show_feature)(enum nvme_features_id fid, int sel, unsigned int result);
 	void (*show_feature_fields)(enum nvme_features_id fid, unsigned int result, unsigned char *buf);
 	void (*id_ctrl_rpmbs)(__le32 ctrl_rpmbs);
@@ -94,9 +104,12 @@ struct print_ops {
 	/* libnvme tree print functions */
 	void (*list_item)(nvme_ns_t n);
 	void (*list_items)(nvme_root_t t);
+	void (*list_event)(const char *action, const char *name,
+			   nvme_ctrl_t c, nvme_ns_t n);
 	void (*print_nvme_subsystem_list)(nvme_root_t r, bool show_ana);
 	void (*topology_ctrl)(nvme_root_t r);
 	void (*topology_namespace)(nvme_root_t r);
+	void (*connect_timing)(struct nvmf_timing *t);
 
 	/* status and error messages */
 	void (*connect_msg)(nvme_ctrl_t c);
@@ -170,6 +183,9 @@ void nvme_show_ana_log(struct nvme_ana_log *ana_log, const char *devname,
 		       size_t len, nvme_print_flags_t flags);
 void nvme_show_self_test_log(struct nvme_self_test_log *self_test, __u8 dst_entries,
 	__u32 size, const char *devname, nvme_print_flags_t flags);
+void nvme_show_fw_rollout(struct nvme_fw_rollout *r, nvme_print_flags_t flags);
+void nvme_show_wipe(struct nvme_wipe *w, nvme_print_flags_t flags);
+void nvme_show_self_test_fleet(struct nvme_self_test_fleet *f, nvme_print_flags_t flags);
 void nvme_show_fw_log(struct nvme_firmware_slot *fw_log, const char *devname,
 	nvme_print_flags_t flags);
 void nvme_print_effects_log_pages(struct list_head *list,
@@ -266,9 +282,13 @@ void nvme_show_zns_report_zones(void *report, __u32 descs,
 				__u8 ext_size, __u32 report_size,
 				struct json_object *zone_list,
 				nvme_print_flags_t flags);
+void nvme_show_zns_zone_summary(struct nvme_zns_zone_summary *s,
+				nvme_print_flags_t flags);
 void json_nvme_finish_zone_list(__u64 nr_zones, 
 	struct json_object *zone_list);
 void nvme_show_list_item(nvme_ns_t n);
+void nvme_show_list_event(const char *action, const char *name,
+			  nvme_ctrl_t c, nvme_ns_t n, nvme_print_flags_t flags);
 
 void nvme_show_fdp_configs(struct nvme_fdp_config_log *configs, size_t len,
 		nvme_print_flags_t flags);
@@ -276,14 +296,23 @@ void nvme_show_fdp_stats(struct nvme_fdp_stats_log *log,
 		nvme_print_flags_t flags);
 void nvme_show_fdp_events(struct nvme_fdp_events_log *log,
 		nvme_print_flags_t flags);
+void nvme_show_fdp_event(struct nvme_fdp_event *event,
+		struct nvme_fdp_ruh_events *ruh, nvme_print_flags_t flags);
+void nvme_show_fdp_ruh_events(struct nvme_fdp_ruh_events *ruhs, int nr,
+		nvme_print_flags_t flags);
 void nvme_show_fdp_usage(struct nvme_fdp_ruhu_log *log, size_t len,
 		nvme_print_flags_t flags);
 void nvme_show_fdp_ruh_status(struct nvme_fdp_ruh_status *status, size_t len,
 		nvme_print_flags_t flags);
+void nvme_show_fdp_ruh_trend(struct nvme_fdp_ruh_trend *t,
+		nvme_print_flags_t flags);
+void nvme_show_fdp_workload(struct nvme_fdp_workload *res,
+		nvme_print_flags_t flags);
 
 void nvme_show_discovery_log(struct nvmf_discovery_log *log, uint64_t numrec,
 			     nvme_print_flags_t flags);
 void nvme_show_connect_msg(nvme_ctrl_t c, nvme_print_flags_t flags);
+void nvme_show_connect_timing(struct nvmf_timing *t, nvme_print_flags_t flags);
 
 const char *nvme_ana_state_to_string(enum nvme_ana_state state);
 const char *nvme_cmd_to_string(int admin, __u8 opcode);
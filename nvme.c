@@ -42,6 +42,9 @@
 #include <dirent.h>
 #include <libgen.h>
 #include <signal.h>
+#include <fnmatch.h>
+#include <limits.h>
+#include <time.h>
 
 #include <linux/fs.h>
 
@@ -65,7 +68,10 @@
 #include "util/argconfig.h"
 #include "util/suffix.h"
 #include "util/logging.h"
+#include "util/parallel.h"
+#include "util/uevent.h"
 #include "fabrics.h"
+#include "topology-cache.h"
 #define CREATE_CMD
 #include "nvme-builtin.h"
 #include "malloc.h"
@@ -193,6 +199,7 @@ const char *output_format = "Output format: normal|binary";
 const char *timeout = "timeout value, in milliseconds";
 const char *verbose = "Increase output verbosity";
 
+static const char *all_ns = "sweep all active namespaces of the controller";
 static const char *app_tag = "app tag for end-to-end PI";
 static const char *app_tag_mask = "app tag mask for end-to-end PI";
 static const char *block_count = "number of blocks (zeroes based) on device to access";
@@ -211,6 +218,7 @@ static const char *human_readable_identify = "show identify in readable format";
 static const char *human_readable_info = "show info in readable format";
 static const char *human_readable_log = "show log in readable format";
 static const char *iekey = "ignore existing res. key";
+static const char *jobs = "maximum number of concurrent commands";
 static const char *latency = "output latency statistics";
 static const char *lba_format_index = "The index into the LBA Format list\n"
 	"identifying the LBA Format capabilities that are to be returned";
@@ -2985,6 +2993,29 @@ static int detach_ns(int argc, char **argv, struct command *cmd, struct plugin *
 	return nvme_attach_ns(argc, argv, 0, desc, cmd);
 }
 
+/*
+ * Converts @val to a number of LBAs of @lbas bytes. A plain number already
+ * is a number of LBAs, a size with an SI suffix is rounded up to @align
+ * bytes first.
+ */
+static int lba_num_si(const char *val, unsigned int lbas, __u32 align, __u64 *num)
+{
+	unsigned int remainder;
+	char *endptr;
+
+	if (suffix_si_parse(val, &endptr, (uint64_t *)num))
+		return -EINVAL;
+
+	if (endptr[0] != '\0') {
+		remainder = *num % align;
+		if (remainder)
+			*num += align - remainder;
+		*num /= lbas;
+	}
+
+	return 0;
+}
+
 static int parse_lba_num_si(struct nvme_dev *dev, const char *opt,
 			    const char *val, __u8 flbas, __u64 *num, __u32 align)
 {
@@ -2993,8 +3024,6 @@ static int parse_lba_num_si(struct nvme_dev *dev, const char *opt,
 	_cleanup_free_ struct nvme_id_ns *ns = NULL;
 	__u32 nsid = 1;
 	__u8 lbaf;
-	unsigned int remainder;
-	char *endptr;
 	int err = -EINVAL;
 	int lbas;
 
@@ -3064,22 +3093,38 @@ static int parse_lba_num_si(struct nvme_dev *dev, const char *opt,
 	nvme_id_ns_flbas_to_lbaf_inuse(flbas, &lbaf);
 	lbas = (1 << ns->lbaf[lbaf].ds) + le16_to_cpu(ns->lbaf[lbaf].ms);
 
-	if (suffix_si_parse(val, &endptr, (uint64_t *)num)) {
+	err = lba_num_si(val, lbas, align, num);
+	if (err)
 		nvme_show_error("Expected long suffixed integer argument for '%s-si' but got '%s'!",
 				opt, val);
-		return -errno;
-	}
 
-	if (endptr[0]) {
-		remainder = *num % align;
-		if (remainder)
-			*num += align - remainder;
-	}
+	return err;
+}
 
-	if (endptr[0] != '\0')
-		*num /= lbas;
+/* Lowers the size and capacity alignment to the granularity of @flbas */
+static void ns_granularity_align(struct nvme_id_ns_granularity_list *gr_list,
+				 __u8 flbas, __u32 *align_nsze, __u32 *align_ncap)
+{
+	struct nvme_id_ns_granularity_desc *desc;
+	int index = flbas;
 
-	return 0;
+	/* FIXME: add a proper bitmask to libnvme */
+	if (!(gr_list->attributes & 1)) {
+		/* Only the first descriptor is valid */
+		index = 0;
+	} else if (index > gr_list->num_descriptors) {
+		/*
+		 * The descriptor will contain only zeroes
+		 * so we don't need to read it.
+		 */
+		return;
+	}
+	desc = &gr_list->entry[index];
+
+	if (desc->nszegran && desc->nszegran < *align_nsze)
+		*align_nsze = desc->nszegran;
+	if (desc->ncapgran && desc->ncapgran < *align_ncap)
+		*align_ncap = desc->ncapgran;
 }
 
 static int create_ns(int argc, char **argv, struct command *cmd, struct plugin *plugin)
@@ -3257,31 +3302,10 @@ static int create_ns(int argc, char **argv, struct command *cmd, struct plugin *
 		if (!gr_list)
 			return -ENOMEM;
 
-		if (!nvme_identify_ns_granularity(dev_fd(dev), gr_list)) {
-			struct nvme_id_ns_granularity_desc *desc;
-			int index = cfg.flbas;
-
-			/* FIXME: add a proper bitmask to libnvme */
-			if (!(gr_list->attributes & 1)) {
-				/* Only the first descriptor is valid */
-				index = 0;
-			} else if (index > gr_list->num_descriptors) {
-				/*
-				 * The descriptor will contain only zeroes
-				 * so we don't need to read it.
-				 */
-				goto parse_lba;
-			}
-			desc = &gr_list->entry[index];
-
-			if (desc->nszegran && desc->nszegran < align_nsze)
-				align_nsze = desc->nszegran;
-			if (desc->ncapgran && desc->ncapgran < align_ncap)
-				align_ncap = desc->ncapgran;
-		}
+		if (!nvme_identify_ns_granularity(dev_fd(dev), gr_list))
+			ns_granularity_align(gr_list, cfg.flbas, &align_nsze, &align_ncap);
 	}
 
-parse_lba:
 	err = parse_lba_num_si(dev, "nsze", cfg.nsze_si, cfg.flbas, &cfg.nsze, align_nsze);
 	if (err)
 		return err;
@@ -3332,567 +3356,844 @@ parse_lba:
 	return err;
 }
 
-static bool nvme_match_device_filter(nvme_subsystem_t s,
-		nvme_ctrl_t c, nvme_ns_t ns, void *f_args)
+struct provision_entry {
+	struct nvme_ns_mgmt_host_sw_specified *data;
+	__u8 csi;
+	unsigned int count;
+	int nr_ctrls;
+	__u16 ctrls[NVME_ID_CTRL_LIST_MAX];
+};
+
+struct provision_ns {
+	struct provision_entry *entry;
+	__u32 nsid;
+	int err;
+	int attach_err;
+};
+
+struct provision {
+	struct nvme_dev *dev;
+	struct provision_entry *entries;
+	unsigned int nr_entries;
+	struct provision_ns *ns;
+	unsigned int nr;
+};
+
+static void provision_free(struct provision *p)
 {
-	int ret, instance, nsid, s_num;
-	char *devname = f_args;
+	unsigned int i;
 
-	if (!devname || !strlen(devname))
-		return true;
+	for (i = 0; i < p->nr_entries; i++)
+		free(p->entries[i].data);
+	free(p->entries);
+	free(p->ns);
+}
 
-	ret = sscanf(devname, "nvme%dn%d", &instance, &nsid);
-	if (ret != 2)
-		return true;
+#ifdef CONFIG_JSONC
+static struct json_object *provision_key(struct json_object *e,
+					 struct json_object *defs,
+					 const char *key)
+{
+	struct json_object *o;
 
-	if (s) {
-		ret = sscanf(nvme_subsystem_get_name(s), "nvme-subsys%d",
-			     &s_num);
-		if (ret == 1 && s_num == instance)
-			return true;
-	}
-	if (c) {
-		s = nvme_ctrl_get_subsystem(c);
+	if (json_object_object_get_ex(e, key, &o))
+		return o;
+	if (defs && json_object_object_get_ex(defs, key, &o))
+		return o;
 
-		ret = sscanf(nvme_subsystem_get_name(s), "nvme-subsys%d",
-			     &s_num);
-		if (ret == 1 && s_num == instance)
-			return true;
+	return NULL;
+}
+
+static int provision_uint(struct json_object *e, struct json_object *defs,
+			  unsigned int idx, const char *key, __u64 max,
+			  __u64 *val)
+{
+	struct json_object *o = provision_key(e, defs, key);
+	int64_t v;
+
+	if (!o)
+		return 0;
+
+	v = json_object_get_int64(o);
+	if (!json_object_is_type(o, json_type_int) || v < 0 || v > max) {
+		nvme_show_error("namespaces[%u]: invalid value for '%s'", idx, key);
+		return -EINVAL;
 	}
-	if (ns) {
-		if (!strcmp(devname, nvme_ns_get_name(ns)))
-			return true;
+	*val = v;
+
+	return 0;
+}
+
+/* Sizes are either a number of LBAs or a string with an SI suffix */
+static int provision_size(struct json_object *e, struct json_object *defs,
+			  unsigned int idx, const char *key, unsigned int lbas,
+			  __u32 align, __u64 *num)
+{
+	struct json_object *o = provision_key(e, defs, key);
+
+	if (!o || !json_object_is_type(o, json_type_string))
+		return provision_uint(e, defs, idx, key, INT64_MAX, num);
+
+	if (lba_num_si(json_object_get_string(o), lbas, align, num)) {
+		nvme_show_error("namespaces[%u]: invalid size '%s' for '%s'", idx,
+				json_object_get_string(o), key);
+		return -EINVAL;
 	}
 
-	return false;
+	return 0;
 }
 
-static int list_subsys(int argc, char **argv, struct command *cmd,
-		struct plugin *plugin)
+static int provision_list(struct json_object *e, struct json_object *defs,
+			  unsigned int idx, const char *key, __u16 *list,
+			  int max)
 {
-	_cleanup_nvme_root_ nvme_root_t r = NULL;
-	nvme_print_flags_t flags;
-	const char *desc = "Retrieve information for subsystems";
-	nvme_scan_filter_t filter = NULL;
-	char *devname;
-	int err;
-	int nsid = NVME_NSID_ALL;
+	struct json_object *o = provision_key(e, defs, key), *v;
+	int i, nr;
 
-	NVME_ARGS(opts);
+	if (!o)
+		return -ENOENT;
 
-	err = parse_args(argc, argv, desc, opts);
-	if (err)
-		return err;
+	if (!json_object_is_type(o, json_type_array))
+		goto invalid;
 
-	devname = NULL;
-	if (optind < argc)
-		devname = basename(argv[optind++]);
+	nr = json_object_array_length(o);
+	if (nr > max)
+		goto invalid;
 
-	err = validate_output_format(nvme_cfg.output_format, &flags);
-	if (err < 0 || (flags != JSON && flags != NORMAL)) {
-		nvme_show_error("Invalid output format");
-		return -EINVAL;
+	for (i = 0; i < nr; i++) {
+		v = json_object_array_get_idx(o, i);
+		if (!json_object_is_type(v, json_type_int) ||
+		    json_object_get_int64(v) < 0 ||
+		    json_object_get_int64(v) > UINT16_MAX)
+			goto invalid;
+		list[i] = json_object_get_int64(v);
 	}
 
-	if (argconfig_parse_seen(opts, "verbose"))
-		flags |= VERBOSE;
+	return nr;
 
+invalid:
+	nvme_show_error("namespaces[%u]: invalid list for '%s'", idx, key);
+	return -EINVAL;
+}
 
-	r = nvme_create_root(stderr, log_level);
-	if (!r) {
-		if (devname)
-			nvme_show_error("Failed to scan nvme subsystem for %s", devname);
-		else
-			nvme_show_error("Failed to scan nvme subsystem");
-		return -errno;
+static int provision_parse_entry(struct provision_entry *pe,
+				 struct json_object *e, struct json_object *defs,
+				 unsigned int idx, struct nvme_id_ctrl *id,
+				 struct nvme_id_ns *ns,
+				 struct nvme_id_ns_granularity_list *gr_list)
+{
+	__u64 count = 1, flbas = 0, bs = 0, dps = 0, nmic = 0, anagrpid = 0;
+	__u64 nvmsetid = 0, endgid = 0, csi = 0, lbstm = 0, nsze = 0, ncap = 0;
+	__u32 align_nsze = 1 << 20; /* Default 1 MiB */
+	__u32 align_ncap = align_nsze;
+	__u16 phndl[128];
+	unsigned int lbas;
+	int i, nr;
+	__u8 lbaf;
+
+	if (!json_object_is_type(e, json_type_object)) {
+		nvme_show_error("namespaces[%u]: expected an object", idx);
+		return -EINVAL;
 	}
 
-	if (devname) {
-		int subsys_num;
+	if (provision_uint(e, defs, idx, "count", NVME_ID_NS_LIST_MAX, &count) ||
+	    provision_uint(e, defs, idx, "flbas", UINT8_MAX, &flbas) ||
+	    provision_uint(e, defs, idx, "block-size", UINT32_MAX, &bs) ||
+	    provision_uint(e, defs, idx, "dps", UINT8_MAX, &dps) ||
+	    provision_uint(e, defs, idx, "nmic", UINT8_MAX, &nmic) ||
+	    provision_uint(e, defs, idx, "anagrpid", UINT32_MAX, &anagrpid) ||
+	    provision_uint(e, defs, idx, "nvmsetid", UINT16_MAX, &nvmsetid) ||
+	    provision_uint(e, defs, idx, "endgid", UINT16_MAX, &endgid) ||
+	    provision_uint(e, defs, idx, "csi", UINT8_MAX, &csi) ||
+	    provision_uint(e, defs, idx, "lbstm", INT64_MAX, &lbstm))
+		return -EINVAL;
 
-		if (sscanf(devname, "nvme%dn%d", &subsys_num, &nsid) != 2) {
-			nvme_show_error("Invalid device name %s", devname);
+	if (!count) {
+		nvme_show_error("namespaces[%u]: count must be at least 1", idx);
+		return -EINVAL;
+	}
+
+	if (bs) {
+		if (provision_key(e, defs, "flbas")) {
+			nvme_show_error("namespaces[%u]: specify only one of 'flbas' and 'block-size'",
+					idx);
 			return -EINVAL;
 		}
-		filter = nvme_match_device_filter;
+		for (i = 0; i <= ns->nlbaf; i++) {
+			if ((1ULL << ns->lbaf[i].ds) == bs && !ns->lbaf[i].ms)
+				break;
+		}
+		if (i > ns->nlbaf) {
+			nvme_show_error("namespaces[%u]: no FLBAS for block size %"PRIu64,
+					idx, (uint64_t)bs);
+			return -EINVAL;
+		}
+		flbas = i;
 	}
 
-	err = nvme_scan_topology(r, filter, (void *)devname);
-	if (err) {
-		nvme_show_error("Failed to scan topology: %s", nvme_strerror(errno));
-		return -errno;
+	if (gr_list)
+		ns_granularity_align(gr_list, flbas, &align_nsze, &align_ncap);
+
+	nvme_id_ns_flbas_to_lbaf_inuse(flbas, &lbaf);
+	lbas = (1 << ns->lbaf[lbaf].ds) + le16_to_cpu(ns->lbaf[lbaf].ms);
+
+	if (provision_size(e, defs, idx, "size", lbas, align_nsze, &nsze))
+		return -EINVAL;
+	if (!nsze) {
+		nvme_show_error("namespaces[%u]: 'size' is required", idx);
+		return -EINVAL;
 	}
 
-	nvme_show_subsystem_list(r, nsid != NVME_NSID_ALL, flags);
+	ncap = nsze;
+	if (provision_size(e, defs, idx, "capacity", lbas, align_ncap, &ncap))
+		return -EINVAL;
+
+	nr = provision_list(e, defs, idx, "phndls", phndl, ARRAY_SIZE(phndl));
+	if (nr == -EINVAL)
+		return nr;
+
+	pe->data = nvme_alloc(sizeof(*pe->data));
+	if (!pe->data)
+		return -ENOMEM;
+
+	pe->data->nsze = cpu_to_le64(nsze);
+	pe->data->ncap = cpu_to_le64(ncap);
+	pe->data->flbas = flbas;
+	pe->data->dps = dps;
+	pe->data->nmic = nmic;
+	pe->data->anagrpid = cpu_to_le32(anagrpid);
+	pe->data->nvmsetid = cpu_to_le16(nvmsetid);
+	pe->data->endgid = cpu_to_le16(endgid);
+	pe->data->lbstm = cpu_to_le64(lbstm);
+	for (i = 0; i < nr; i++)
+		pe->data->phndl[i] = cpu_to_le16(phndl[i]);
+	if (nr > 0)
+		pe->data->nphndls = cpu_to_le16(nr);
+
+	pe->csi = csi;
+	pe->count = count;
+
+	/* Attach to the controller we are talking to unless told otherwise */
+	pe->nr_ctrls = provision_list(e, defs, idx, "controllers", pe->ctrls,
+				      ARRAY_SIZE(pe->ctrls));
+	if (pe->nr_ctrls == -EINVAL)
+		return pe->nr_ctrls;
+	if (pe->nr_ctrls == -ENOENT) {
+		pe->ctrls[0] = le16_to_cpu(id->cntlid);
+		pe->nr_ctrls = 1;
+	}
 
 	return 0;
 }
 
-static int list(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+static int provision_read_spec(struct provision *p, const char *file,
+			       struct nvme_id_ctrl *id, struct nvme_id_ns *ns,
+			       struct nvme_id_ns_granularity_list *gr_list)
 {
-	const char *desc = "Retrieve basic information for all NVMe namespaces";
-	nvme_print_flags_t flags;
-	_cleanup_nvme_root_ nvme_root_t r = NULL;
-	int err = 0;
+	struct json_object *root, *defs = NULL, *list;
+	unsigned int i, j, n;
+	int err = -EINVAL;
 
-	NVME_ARGS(opts);
+	root = json_object_from_file(file);
+	if (!root) {
+		nvme_show_error("failed to read spec %s: %s", file,
+				json_util_get_last_err());
+		return -EINVAL;
+	}
 
-	err = parse_args(argc, argv, desc, opts);
-	if (err)
-		return err;
+	if (!json_object_is_type(root, json_type_object) ||
+	    !json_object_object_get_ex(root, "namespaces", &list) ||
+	    !json_object_is_type(list, json_type_array) ||
+	    !json_object_array_length(list)) {
+		nvme_show_error("%s: expected a non-empty 'namespaces' array", file);
+		goto out;
+	}
 
-	err = validate_output_format(nvme_cfg.output_format, &flags);
-	if (err < 0 || (flags != JSON && flags != NORMAL)) {
-		nvme_show_error("Invalid output format");
-		return -EINVAL;
+	if (json_object_object_get_ex(root, "defaults", &defs) &&
+	    !json_object_is_type(defs, json_type_object)) {
+		nvme_show_error("%s: 'defaults' must be an object", file);
+		goto out;
 	}
 
-	if (argconfig_parse_seen(opts, "verbose"))
-		flags |= VERBOSE;
+	p->nr_entries = json_object_array_length(list);
+	p->entries = calloc(p->nr_entries, sizeof(*p->entries));
+	if (!p->entries) {
+		err = -ENOMEM;
+		goto out;
+	}
 
-	r = nvme_create_root(stderr, log_level);
-	if (!r) {
-		nvme_show_error("Failed to create topology root: %s", nvme_strerror(errno));
-		return -errno;
+	for (i = 0; i < p->nr_entries; i++) {
+		err = provision_parse_entry(&p->entries[i],
+					    json_object_array_get_idx(list, i),
+					    defs, i, id, ns, gr_list);
+		if (err)
+			goto out;
+		p->nr += p->entries[i].count;
 	}
-	err = nvme_scan_topology(r, NULL, NULL);
-	if (err < 0) {
-		nvme_show_error("Failed to scan topology: %s", nvme_strerror(errno));
-		return err;
+
+	if (p->nr > NVME_ID_NS_LIST_MAX) {
+		nvme_show_error("%s: %u namespaces exceed the limit of %u", file,
+				p->nr, NVME_ID_NS_LIST_MAX);
+		err = -EINVAL;
+		goto out;
 	}
 
-	nvme_show_list_items(r, flags);
+	p->ns = calloc(p->nr, sizeof(*p->ns));
+	if (!p->ns) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	for (i = 0, n = 0; i < p->nr_entries; i++)
+		for (j = 0; j < p->entries[i].count; j++)
+			p->ns[n++].entry = &p->entries[i];
+out:
+	json_object_put(root);
 
 	return err;
 }
-
-int __id_ctrl(int argc, char **argv, struct command *cmd, struct plugin *plugin,
-		void (*vs)(__u8 *vs, struct json_object *root))
+#else /* CONFIG_JSONC */
+static int provision_read_spec(struct provision *p, const char *file,
+			       struct nvme_id_ctrl *id, struct nvme_id_ns *ns,
+			       struct nvme_id_ns_granularity_list *gr_list)
 {
-	const char *desc = "Send an Identify Controller command to "
-		"the given device and report information about the specified "
-		"controller in human-readable or "
-		"binary format. May also return vendor-specific "
-		"controller attributes in hex-dump if requested.";
-	const char *vendor_specific = "dump binary vendor field";
+	nvme_show_error("provision specs need json-c support");
+	return -ENOTSUP;
+}
+#endif /* CONFIG_JSONC */
 
-	_cleanup_free_ struct nvme_id_ctrl *ctrl = NULL;
-	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	nvme_print_flags_t flags;
+static void provision_create_one(unsigned int idx, void *arg)
+{
+	struct provision *p = arg;
+	struct provision_ns *pn = &p->ns[idx];
 	int err;
 
-	struct config {
-		bool	vendor_specific;
-		bool	raw_binary;
-		bool	human_readable;
-	};
-
-	struct config cfg = {
-		.vendor_specific	= false,
-		.raw_binary		= false,
-		.human_readable		= false,
-	};
+	errno = 0;
+	err = nvme_cli_ns_mgmt_create(p->dev, pn->entry->data, &pn->nsid,
+				      nvme_cfg.timeout, pn->entry->csi);
+	if (err < 0 && errno)
+		err = -errno;
+	pn->err = err;
+}
 
-	NVME_ARGS(opts,
-		  OPT_FLAG("vendor-specific", 'V', &cfg.vendor_specific, vendor_specific),
-		  OPT_FLAG("raw-binary",      'b', &cfg.raw_binary,      raw_identify),
-		  OPT_FLAG("human-readable",  'H', &cfg.human_readable,  human_readable_identify));
+static void provision_attach_one(unsigned int idx, void *arg)
+{
+	_cleanup_free_ struct nvme_ctrl_list *cntlist = NULL;
+	struct provision *p = arg;
+	struct provision_ns *pn = &p->ns[idx];
+	int err;
 
-	err = parse_and_open(&dev, argc, argv, desc, opts);
-	if (err)
-		return err;
+	if (pn->err || !pn->entry->nr_ctrls)
+		return;
 
-	err = validate_output_format(nvme_cfg.output_format, &flags);
-	if (err < 0) {
-		nvme_show_error("Invalid output format");
-		return err;
+	cntlist = nvme_alloc(sizeof(*cntlist));
+	if (!cntlist) {
+		pn->attach_err = -ENOMEM;
+		return;
 	}
 
-	if (cfg.raw_binary)
-		flags = BINARY;
+	/* All controllers of a namespace go into a single attach command */
+	nvme_init_ctrl_list(cntlist, pn->entry->nr_ctrls, pn->entry->ctrls);
 
-	if (cfg.vendor_specific)
-		flags |= VS;
+	errno = 0;
+	err = nvme_cli_ns_attach_ctrls(p->dev, pn->nsid, cntlist);
+	if (err < 0 && errno)
+		err = -errno;
+	pn->attach_err = err;
+}
 
-	if (cfg.human_readable || argconfig_parse_seen(opts, "verbose"))
-		flags |= VERBOSE;
-
-	ctrl = nvme_alloc(sizeof(*ctrl));
-	if (!ctrl)
-		return -ENOMEM;
-
-	err = nvme_cli_identify_ctrl(dev, ctrl);
-	if (!err)
-		nvme_show_id_ctrl(ctrl, flags, vs);
-	else if (err > 0)
-		nvme_show_status(err);
-	else
-		nvme_show_error("identify controller: %s", nvme_strerror(errno));
-
-	return err;
-}
-
-static int id_ctrl(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+static void provision_show_entry(struct provision_entry *pe, unsigned int idx)
 {
-	return __id_ctrl(argc, argv, cmd, plugin, NULL);
+	int i;
+
+	printf("namespaces[%u]: count:%u nsze:%"PRIu64" ncap:%"PRIu64" flbas:%u csi:%u controllers:",
+	       idx, pe->count, (uint64_t)le64_to_cpu(pe->data->nsze),
+	       (uint64_t)le64_to_cpu(pe->data->ncap), pe->data->flbas, pe->csi);
+	for (i = 0; i < pe->nr_ctrls; i++)
+		printf("%s%#x", i ? "," : "", pe->ctrls[i]);
+	printf("%s\n", pe->nr_ctrls ? "" : "none");
 }
 
-static int nvm_id_ctrl(int argc, char **argv, struct command *cmd,
-	struct plugin *plugin)
+static void provision_show_error(int err, const char *op, unsigned int idx)
 {
-	const char *desc = "Send an Identify Controller NVM Command Set "
-		"command to the given device and report information about "
-		"the specified controller in various formats.";
-
-	_cleanup_free_ struct nvme_id_ctrl_nvm *ctrl_nvm = NULL;
-	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	nvme_print_flags_t flags;
-	int err = -1;
-
-	NVME_ARGS(opts);
-
-	err = parse_and_open(&dev, argc, argv, desc, opts);
-	if (err)
-		return err;
-
-	err = validate_output_format(nvme_cfg.output_format, &flags);
-	if (err < 0) {
-		nvme_show_error("Invalid output format");
-		return err;
-	}
-
-	if (argconfig_parse_seen(opts, "verbose"))
-		flags |= VERBOSE;
-
-	ctrl_nvm = nvme_alloc(sizeof(*ctrl_nvm));
-	if (!ctrl_nvm)
-		return -ENOMEM;
-
-	err = nvme_nvm_identify_ctrl(dev_fd(dev), ctrl_nvm);
-	if (!err)
-		nvme_show_id_ctrl_nvm(ctrl_nvm, flags);
-	else if (err > 0)
-		nvme_show_status(err);
+	if (err > 0)
+		nvme_show_error_status(err, "%s namespace %u", op, idx);
 	else
-		nvme_show_error("nvm identify controller: %s", nvme_strerror(errno));
-
-	return err;
+		nvme_show_error("%s namespace %u: %s", op, idx, nvme_strerror(-err));
 }
 
-static int nvm_id_ns(int argc, char **argv, struct command *cmd,
-	struct plugin *plugin)
+static int provision(int argc, char **argv, struct command *cmd, struct plugin *plugin)
 {
-	const char *desc = "Send an Identify Namespace NVM Command Set "
-		"command to the given device and report information about "
-		"the specified namespace in various formats.";
+	const char *desc = "Create and attach the namespaces described by a JSON "
+		"spec file. Identify data is read once, the namespaces are created "
+		"and attached in parallel and a single namespace rescan is issued "
+		"at the end.";
+	const char *spec = "JSON file describing the namespaces to create";
+	const char *jobs = "number of concurrent namespace management commands";
+	const char *dry_run = "show the namespaces to create without creating them";
+	const char *no_rescan = "do not rescan the namespaces after attaching them";
 
-	_cleanup_free_ struct nvme_nvm_id_ns *id_ns = NULL;
+	_cleanup_free_ struct nvme_id_ns_granularity_list *gr_list = NULL;
+	_cleanup_free_ struct nvme_id_ctrl *id = NULL;
 	_cleanup_free_ struct nvme_id_ns *ns = NULL;
 	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	nvme_print_flags_t flags;
-	int err = -1;
+	struct provision p = { 0 };
+	unsigned int i, created = 0, attached = 0;
+	struct timeval start, end;
+	int err, ret = 0;
 
 	struct config {
-		__u32	namespace_id;
-		__u8	uuid_index;
+		char		*spec;
+		unsigned int	jobs;
+		bool		dry_run;
+		bool		no_rescan;
 	};
 
 	struct config cfg = {
-		.namespace_id	= 0,
-		.uuid_index	= NVME_UUID_NONE,
+		.spec		= NULL,
+		.jobs		= 8,
+		.dry_run	= false,
+		.no_rescan	= false,
 	};
 
+	nvme_cfg.timeout = 120000;
+
 	NVME_ARGS(opts,
-		  OPT_UINT("namespace-id", 'n', &cfg.namespace_id,    namespace_id_desired),
-		  OPT_BYTE("uuid-index",   'U', &cfg.uuid_index,      uuid_index));
+		  OPT_FILE("spec",      's', &cfg.spec,      spec),
+		  OPT_UINT("jobs",      'j', &cfg.jobs,      jobs),
+		  OPT_FLAG("dry-run",   'd', &cfg.dry_run,   dry_run),
+		  OPT_FLAG("no-rescan", 'R', &cfg.no_rescan, no_rescan));
 
 	err = parse_and_open(&dev, argc, argv, desc, opts);
 	if (err)
 		return err;
 
-	err = validate_output_format(nvme_cfg.output_format, &flags);
-	if (err < 0) {
-		nvme_show_error("Invalid output format");
-		return err;
-	}
-
-	if (argconfig_parse_seen(opts, "verbose"))
-		flags |= VERBOSE;
-
-	if (!cfg.namespace_id) {
-		err = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
-		if (err < 0) {
-			nvme_show_perror("get-namespace-id");
-			return err;
-		}
+	if (!cfg.spec) {
+		nvme_show_error("%s: spec file required", cmd->name);
+		return -EINVAL;
 	}
 
+	id = nvme_alloc(sizeof(*id));
 	ns = nvme_alloc(sizeof(*ns));
-	if (!ns)
+	if (!id || !ns)
 		return -ENOMEM;
 
-	err = nvme_cli_identify_ns(dev, cfg.namespace_id, ns);
+	err = nvme_cli_identify_ctrl(dev, id);
 	if (err) {
-		nvme_show_status(err);
+		if (err < 0)
+			nvme_show_error("identify controller: %s", nvme_strerror(errno));
+		else
+			nvme_show_status(err);
 		return err;
 	}
 
-	id_ns = nvme_alloc(sizeof(*id_ns));
-	if (!id_ns)
-		return -ENOMEM;
-
-	err = nvme_identify_ns_csi(dev_fd(dev), cfg.namespace_id,
-				   cfg.uuid_index,
-				   NVME_CSI_NVM, id_ns);
-	if (!err)
-		nvme_show_nvm_id_ns(id_ns, cfg.namespace_id, ns, 0, false, flags);
-	else if (err > 0)
-		nvme_show_status(err);
-	else
-		nvme_show_perror("nvm identify namespace");
-
-	return err;
-}
-
-static int nvm_id_ns_lba_format(int argc, char **argv, struct command *cmd, struct plugin *plugin)
-{
-	const char *desc = "Send an NVM Command Set specific Identify Namespace "
-		"command to the given device, returns capability field properties of "
-		"the specified LBA Format index in the specified namespace in various formats.";
-
-	_cleanup_free_ struct nvme_nvm_id_ns *nvm_ns = NULL;
-	_cleanup_free_ struct nvme_id_ns *ns = NULL;
-	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	nvme_print_flags_t flags;
-	int err = -1;
-
-	struct config {
-		__u16	lba_format_index;
-		__u8	uuid_index;
-	};
-
-	struct config cfg = {
-		.lba_format_index	= 0,
-		.uuid_index		= NVME_UUID_NONE,
-	};
-
-	NVME_ARGS(opts,
-		  OPT_UINT("lba-format-index", 'i', &cfg.lba_format_index, lba_format_index),
-		  OPT_BYTE("uuid-index",       'U', &cfg.uuid_index,       uuid_index));
-
-	err = parse_and_open(&dev, argc, argv, desc, opts);
-	if (err)
-		return err;
-
-	err = validate_output_format(nvme_cfg.output_format, &flags);
-	if (err < 0) {
-		nvme_show_error("Invalid output format");
-		return err;
+	if (!(le16_to_cpu(id->oacs) & NVME_CTRL_OACS_NS_MGMT)) {
+		nvme_show_error("NS management and attachment not supported");
+		return -ENOTSUP;
 	}
 
-	if (argconfig_parse_seen(opts, "verbose"))
-		flags |= VERBOSE;
-
-	ns = nvme_alloc(sizeof(*ns));
-	if (!ns)
-		return -ENOMEM;
-
 	err = nvme_cli_identify_ns(dev, NVME_NSID_ALL, ns);
 	if (err) {
-		ns->nlbaf = NVME_FEAT_LBA_RANGE_MAX - 1;
-		ns->nulbaf = 0;
+		if (err < 0)
+			nvme_show_error("identify namespace: %s", nvme_strerror(errno));
+		else
+			nvme_show_status(err);
+		return err;
 	}
 
-	nvm_ns = nvme_alloc(sizeof(*nvm_ns));
-	if (!nvm_ns)
-		return -ENOMEM;
-
-	err = nvme_identify_iocs_ns_csi_user_data_format(dev_fd(dev), cfg.lba_format_index,
-							 cfg.uuid_index, NVME_CSI_NVM, nvm_ns);
-	if (!err)
-		nvme_show_nvm_id_ns(nvm_ns, 0, ns, cfg.lba_format_index, true, flags);
-	else if (err > 0)
-		nvme_show_status(err);
-	else
-		nvme_show_perror("NVM identify namespace for specific LBA format");
+	if (dev->type == NVME_DEV_DIRECT &&
+	    le32_to_cpu(id->ctratt) & NVME_CTRL_CTRATT_NAMESPACE_GRANULARITY) {
+		gr_list = nvme_alloc(sizeof(*gr_list));
+		if (!gr_list)
+			return -ENOMEM;
 
-	return err;
-}
+		if (nvme_identify_ns_granularity(dev_fd(dev), gr_list)) {
+			free(gr_list);
+			gr_list = NULL;
+		}
+	}
 
-static int ns_descs(int argc, char **argv, struct command *cmd, struct plugin *plugin)
-{
-	const char *desc = "Send Namespace Identification Descriptors command to the "
-		"given device, returns the namespace identification descriptors "
-		"of the specific namespace in either human-readable or binary format.";
-	const char *raw = "show descriptors in binary format";
+	err = provision_read_spec(&p, cfg.spec, id, ns, gr_list);
+	if (err)
+		goto out;
 
-	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	_cleanup_free_ void *nsdescs = NULL;
-	nvme_print_flags_t flags;
-	int err;
+	if (cfg.dry_run) {
+		for (i = 0; i < p.nr_entries; i++)
+			provision_show_entry(&p.entries[i], i);
+		printf("%s: %u namespaces would be created\n", cmd->name, p.nr);
+		goto out;
+	}
 
-	struct config {
-		__u32	namespace_id;
-		bool	raw_binary;
-	};
+	p.dev = dev;
 
-	struct config cfg = {
-		.namespace_id	= 0,
-		.raw_binary	= false,
-	};
+	/* The MI transport serializes commands on the endpoint */
+	if (dev->type != NVME_DEV_DIRECT || !cfg.jobs)
+		cfg.jobs = 1;
 
-	NVME_ARGS(opts,
-		  OPT_UINT("namespace-id",  'n', &cfg.namespace_id,  namespace_id_desired),
-		  OPT_FLAG("raw-binary",    'b', &cfg.raw_binary,    raw));
+	gettimeofday(&start, NULL);
 
-	err = parse_and_open(&dev, argc, argv, desc, opts);
-	if (err)
-		return err;
+	parallel_for_each(p.nr, cfg.jobs, provision_create_one, &p);
+	parallel_for_each(p.nr, cfg.jobs, provision_attach_one, &p);
 
-	err = validate_output_format(nvme_cfg.output_format, &flags);
-	if (err < 0) {
-		nvme_show_error("Invalid output format");
-		return err;
-	}
+	for (i = 0; i < p.nr; i++) {
+		struct provision_ns *pn = &p.ns[i];
+		int j;
 
-	if (cfg.raw_binary)
-		flags = BINARY;
+		if (pn->err) {
+			provision_show_error(pn->err, "create", i);
+			if (!ret)
+				ret = pn->err;
+			continue;
+		}
+		created++;
+
+		if (pn->attach_err) {
+			provision_show_error(pn->attach_err, "attach", pn->nsid);
+			if (!ret)
+				ret = pn->attach_err;
+		} else if (pn->entry->nr_ctrls) {
+			attached++;
+		}
 
-	if (argconfig_parse_seen(opts, "verbose"))
-		flags |= VERBOSE;
+		printf("nsid:%u nsze:%"PRIu64" ncap:%"PRIu64" flbas:%u controllers:",
+		       pn->nsid, (uint64_t)le64_to_cpu(pn->entry->data->nsze),
+		       (uint64_t)le64_to_cpu(pn->entry->data->ncap),
+		       pn->entry->data->flbas);
+		for (j = 0; !pn->attach_err && j < pn->entry->nr_ctrls; j++)
+			printf("%s%#x", j ? "," : "", pn->entry->ctrls[j]);
+		printf("%s\n", !pn->attach_err && pn->entry->nr_ctrls ? "" : "none");
+	}
 
-	if (!cfg.namespace_id) {
-		err = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
+	if (attached && !cfg.no_rescan && dev->type == NVME_DEV_DIRECT) {
+		err = nvme_ns_rescan(dev_fd(dev));
 		if (err < 0) {
-			nvme_show_error("get-namespace-id: %s", nvme_strerror(errno));
-			return err;
+			nvme_show_error("namespace rescan: %s", nvme_strerror(errno));
+			if (!ret)
+				ret = err;
 		}
 	}
 
-	nsdescs = nvme_alloc(NVME_IDENTIFY_DATA_SIZE);
-	if (!nsdescs)
-		return -ENOMEM;
+	gettimeofday(&end, NULL);
 
-	err = nvme_cli_identify_ns_descs(dev, cfg.namespace_id, nsdescs);
-	if (!err)
-		nvme_show_id_ns_descs(nsdescs, cfg.namespace_id, flags);
-	else if (err > 0)
-		nvme_show_status(err);
-	else
-		nvme_show_error("identify namespace: %s", nvme_strerror(errno));
+	printf("%s: %u of %u namespaces created, %u attached in %.2f s\n",
+	       cmd->name, created, p.nr, attached,
+	       elapsed_utime(start, end) / 1000000.0);
+
+	err = ret;
+out:
+	provision_free(&p);
 
 	return err;
 }
 
-static int id_ns(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+static bool nvme_match_device_filter(nvme_subsystem_t s,
+		nvme_ctrl_t c, nvme_ns_t ns, void *f_args)
 {
-	const char *desc = "Send an Identify Namespace command to the "
-		"given device, returns properties of the specified namespace "
-		"in either human-readable or binary format. Can also return "
-		"binary vendor-specific namespace attributes.";
-	const char *force = "Return this namespace, even if not attached (1.2 devices only)";
-	const char *vendor_specific = "dump binary vendor fields";
+	int ret, instance, nsid, s_num;
+	char *devname = f_args;
 
-	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	_cleanup_free_ struct nvme_id_ns *ns = NULL;
+	if (!devname || !strlen(devname))
+		return true;
+
+	ret = sscanf(devname, "nvme%dn%d", &instance, &nsid);
+	if (ret != 2)
+		return true;
+
+	if (s) {
+		ret = sscanf(nvme_subsystem_get_name(s), "nvme-subsys%d",
+			     &s_num);
+		if (ret == 1 && s_num == instance)
+			return true;
+	}
+	if (c) {
+		s = nvme_ctrl_get_subsystem(c);
+
+		ret = sscanf(nvme_subsystem_get_name(s), "nvme-subsys%d",
+			     &s_num);
+		if (ret == 1 && s_num == instance)
+			return true;
+	}
+	if (ns) {
+		if (!strcmp(devname, nvme_ns_get_name(ns)))
+			return true;
+	}
+
+	return false;
+}
+
+static int list_subsys(int argc, char **argv, struct command *cmd,
+		struct plugin *plugin)
+{
+	_cleanup_nvme_root_ nvme_root_t r = NULL;
 	nvme_print_flags_t flags;
+	const char *desc = "Retrieve information for subsystems";
+	nvme_scan_filter_t filter = NULL;
+	char *devname;
+	char gen[TOPO_CACHE_GEN_LEN];
+	int err;
+	int nsid = NVME_NSID_ALL;
+
+	NVME_ARGS(opts);
+
+	err = parse_args(argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	devname = NULL;
+	if (optind < argc)
+		devname = basename(argv[optind++]);
+
+	err = validate_output_format(nvme_cfg.output_format, &flags);
+	if (err < 0 || (flags != JSON && flags != NORMAL)) {
+		nvme_show_error("Invalid output format");
+		return -EINVAL;
+	}
+
+	if (argconfig_parse_seen(opts, "verbose"))
+		flags |= VERBOSE;
+
+
+	r = nvme_create_root(stderr, log_level);
+	if (!r) {
+		if (devname)
+			nvme_show_error("Failed to scan nvme subsystem for %s", devname);
+		else
+			nvme_show_error("Failed to scan nvme subsystem");
+		return -errno;
+	}
+
+	if (devname) {
+		int subsys_num;
+
+		if (sscanf(devname, "nvme%dn%d", &subsys_num, &nsid) != 2) {
+			nvme_show_error("Invalid device name %s", devname);
+			return -EINVAL;
+		}
+		filter = nvme_match_device_filter;
+	}
+
+	if (filter || topo_cache_generation(gen, sizeof(gen)))
+		gen[0] = '\0';
+
+	err = nvme_scan_topology(r, filter, (void *)devname);
+	if (err) {
+		nvme_show_error("Failed to scan topology: %s", nvme_strerror(errno));
+		return -errno;
+	}
+
+	topo_cache_save(r, gen);
+	nvme_show_subsystem_list(r, nsid != NVME_NSID_ALL, flags);
+
+	return 0;
+}
+
+static nvme_ctrl_t list_watch_find_ctrl(nvme_root_t r, const char *name)
+{
+	nvme_host_t h;
+	nvme_subsystem_t s;
+	nvme_ctrl_t c;
+
+	nvme_for_each_host(r, h) {
+		nvme_for_each_subsystem(h, s) {
+			nvme_subsystem_for_each_ctrl(s, c) {
+				const char *cname = nvme_ctrl_get_name(c);
+
+				if (cname && !strcmp(cname, name))
+					return c;
+			}
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Applies a controller or namespace uevent to the topology and reports
+ * it. Controllers are added to or freed from @r individually, namespaces
+ * are scanned on their own, so the rest of the tree is never rescanned.
+ */
+static void list_watch_event(nvme_root_t r, struct uevent *ev,
+			     nvme_print_flags_t flags)
+{
+	const char *name = ev->devname;
+	bool remove = !strcmp(ev->action, "remove");
+	int instance, head_instance;
+	nvme_ctrl_t c;
+	nvme_ns_t n;
+
+	if (!name)
+		return;
+
+	if (!strcmp(ev->subsystem, "nvme")) {
+		if (sscanf(name, "nvme%d", &instance) != 1)
+			return;
+
+		c = list_watch_find_ctrl(r, name);
+		if (remove) {
+			nvme_show_list_event(ev->action, name, NULL, NULL, flags);
+			if (c)
+				nvme_free_ctrl(c);
+			return;
+		}
+
+		/*
+		 * The subsystem link of a new controller only shows up once
+		 * it is identified, retry on the following change events.
+		 */
+		if (!c)
+			c = nvme_scan_ctrl(r, name);
+		nvme_show_list_event(ev->action, name, c, NULL, flags);
+		return;
+	}
+
+	if (strcmp(ev->subsystem, "block") || !ev->devtype ||
+	    strcmp(ev->devtype, "disk"))
+		return;
+
+	/* Skips the hidden per-path devices (nvmeXcYnZ) */
+	if (sscanf(name, "nvme%dn%d", &instance, &head_instance) != 2)
+		return;
+
+	if (remove) {
+		nvme_show_list_event(ev->action, name, NULL, NULL, flags);
+		return;
+	}
+
+	n = nvme_scan_namespace(name);
+	if (!n)
+		return;
+	nvme_show_list_event(ev->action, name, NULL, n, flags);
+	nvme_free_ns(n);
+}
+
+static int list_watch(nvme_root_t r, int fd, nvme_print_flags_t flags)
+{
+	struct uevent ev;
 	int err;
 
+	while (true) {
+		err = uevent_recv(fd, &ev);
+		if (!err) {
+			list_watch_event(r, &ev, flags);
+			continue;
+		}
+
+		if (err == -EAGAIN || err == -EINTR)
+			continue;
+
+		if (err != -ENOBUFS) {
+			nvme_show_error("Failed to receive uevent: %s", nvme_strerror(-err));
+			return err;
+		}
+
+		/* Events were dropped, resynchronize with a full scan */
+		nvme_show_error("uevent queue overflow, rescanning topology");
+		err = nvme_refresh_topology(r);
+		if (err < 0) {
+			nvme_show_error("Failed to scan topology: %s", nvme_strerror(errno));
+			return err;
+		}
+		nvme_show_list_items(r, flags);
+	}
+}
+
+static int list(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Retrieve basic information for all NVMe namespaces";
+	const char *watch = "keep running and report devices as they are added, "
+		"changed or removed";
+	nvme_print_flags_t flags;
+	_cleanup_nvme_root_ nvme_root_t r = NULL;
+	_cleanup_fd_ int fd = -1;
+	char gen[TOPO_CACHE_GEN_LEN];
+	int err = 0;
+
 	struct config {
-		__u32	namespace_id;
-		bool	force;
-		bool	vendor_specific;
-		bool	raw_binary;
-		bool	human_readable;
+		bool	watch;
 	};
 
 	struct config cfg = {
-		.namespace_id		= 0,
-		.force			= false,
-		.vendor_specific	= false,
-		.raw_binary		= false,
-		.human_readable		= false,
+		.watch	= false,
 	};
 
 	NVME_ARGS(opts,
-		  OPT_UINT("namespace-id",    'n', &cfg.namespace_id,    namespace_id_desired),
-		  OPT_FLAG("force",             0, &cfg.force,           force),
-		  OPT_FLAG("vendor-specific", 'V', &cfg.vendor_specific, vendor_specific),
-		  OPT_FLAG("raw-binary",      'b', &cfg.raw_binary,      raw_identify),
-		  OPT_FLAG("human-readable",  'H', &cfg.human_readable,  human_readable_identify));
+		  OPT_FLAG("watch", 'w', &cfg.watch, watch));
 
-	err = parse_and_open(&dev, argc, argv, desc, opts);
+	err = parse_args(argc, argv, desc, opts);
 	if (err)
 		return err;
 
 	err = validate_output_format(nvme_cfg.output_format, &flags);
-	if (err < 0) {
+	if (err < 0 || (flags != JSON && flags != NORMAL)) {
 		nvme_show_error("Invalid output format");
-		return err;
+		return -EINVAL;
 	}
 
-	if (cfg.raw_binary)
-		flags = BINARY;
-
-	if (cfg.vendor_specific)
-		flags |= VS;
-
-	if (cfg.human_readable || argconfig_parse_seen(opts, "verbose"))
+	if (argconfig_parse_seen(opts, "verbose"))
 		flags |= VERBOSE;
 
-	if (!cfg.namespace_id) {
-		err = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
-		if (err < 0) {
-			nvme_show_error("get-namespace-id: %s", nvme_strerror(errno));
-			return err;
+	/* Subscribe before scanning so that no event is missed */
+	if (cfg.watch) {
+		fd = uevent_open();
+		if (fd < 0) {
+			nvme_show_error("Failed to open uevent socket: %s", nvme_strerror(-fd));
+			return fd;
 		}
 	}
 
-	ns = nvme_alloc(sizeof(*ns));
-	if (!ns)
-		return -ENOMEM;
+	r = nvme_create_root(stderr, log_level);
+	if (!r) {
+		nvme_show_error("Failed to create topology root: %s", nvme_strerror(errno));
+		return -errno;
+	}
+	if (topo_cache_generation(gen, sizeof(gen)))
+		gen[0] = '\0';
+	err = nvme_scan_topology(r, NULL, NULL);
+	if (err < 0) {
+		nvme_show_error("Failed to scan topology: %s", nvme_strerror(errno));
+		return err;
+	}
 
-	if (cfg.force)
-		err = nvme_cli_identify_allocated_ns(dev, cfg.namespace_id, ns);
-	else
-		err = nvme_cli_identify_ns(dev, cfg.namespace_id, ns);
+	topo_cache_save(r, gen);
+	nvme_show_list_items(r, flags);
 
-	if (!err)
-		nvme_show_id_ns(ns, cfg.namespace_id, 0, false, flags);
-	else if (err > 0)
-		nvme_show_status(err);
-	else
-		nvme_show_error("identify namespace: %s", nvme_strerror(errno));
+	if (cfg.watch) {
+		fflush(stdout);
+		err = list_watch(r, fd, flags);
+	}
 
 	return err;
 }
 
-static int cmd_set_independent_id_ns(int argc, char **argv, struct command *cmd,
-				     struct plugin *plugin)
+int __id_ctrl(int argc, char **argv, struct command *cmd, struct plugin *plugin,
+		void (*vs)(__u8 *vs, struct json_object *root))
 {
-	const char *desc = "Send an I/O Command Set Independent Identify "
-		"Namespace command to the given device, returns properties of the "
-		"specified namespace in human-readable or binary or json format.";
+	const char *desc = "Send an Identify Controller command to "
+		"the given device and report information about the specified "
+		"controller in human-readable or "
+		"binary format. May also return vendor-specific "
+		"controller attributes in hex-dump if requested.";
+	const char *vendor_specific = "dump binary vendor field";
 
-	_cleanup_free_ struct nvme_id_independent_id_ns *ns = NULL;
+	_cleanup_free_ struct nvme_id_ctrl *ctrl = NULL;
 	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
 	nvme_print_flags_t flags;
-	int err = -1;
+	int err;
 
 	struct config {
-		__u32	namespace_id;
+		bool	vendor_specific;
 		bool	raw_binary;
 		bool	human_readable;
 	};
 
 	struct config cfg = {
-		.namespace_id	= 0,
-		.raw_binary	= false,
-		.human_readable	= false,
+		.vendor_specific	= false,
+		.raw_binary		= false,
+		.human_readable		= false,
 	};
 
 	NVME_ARGS(opts,
-		  OPT_UINT("namespace-id",    'n', &cfg.namespace_id,    namespace_id_desired),
+		  OPT_FLAG("vendor-specific", 'V', &cfg.vendor_specific, vendor_specific),
 		  OPT_FLAG("raw-binary",      'b', &cfg.raw_binary,      raw_identify),
 		  OPT_FLAG("human-readable",  'H', &cfg.human_readable,  human_readable_identify));
 
@@ -3909,43 +4210,43 @@ static int cmd_set_independent_id_ns(int argc, char **argv, struct command *cmd,
 	if (cfg.raw_binary)
 		flags = BINARY;
 
+	if (cfg.vendor_specific)
+		flags |= VS;
+
 	if (cfg.human_readable || argconfig_parse_seen(opts, "verbose"))
 		flags |= VERBOSE;
 
-	if (!cfg.namespace_id) {
-		err = cfg.namespace_id = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
-		if (err < 0) {
-			nvme_show_perror("get-namespace-id");
-			return err;
-		}
-	}
-
-	ns = nvme_alloc(sizeof(*ns));
-	if (!ns)
+	ctrl = nvme_alloc(sizeof(*ctrl));
+	if (!ctrl)
 		return -ENOMEM;
 
-	err = nvme_identify_independent_identify_ns(dev_fd(dev), cfg.namespace_id, ns);
+	err = nvme_cli_identify_ctrl(dev, ctrl);
 	if (!err)
-		nvme_show_cmd_set_independent_id_ns(ns, cfg.namespace_id, flags);
+		nvme_show_id_ctrl(ctrl, flags, vs);
 	else if (err > 0)
 		nvme_show_status(err);
 	else
-		nvme_show_error("I/O command set independent identify namespace: %s",
-				nvme_strerror(errno));
+		nvme_show_error("identify controller: %s", nvme_strerror(errno));
 
 	return err;
 }
 
-static int id_ns_granularity(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+static int id_ctrl(int argc, char **argv, struct command *cmd, struct plugin *plugin)
 {
-	const char *desc = "Send an Identify Namespace Granularity List command to the "
-		"given device, returns namespace granularity list "
-		"in either human-readable or binary format.";
+	return __id_ctrl(argc, argv, cmd, plugin, NULL);
+}
 
-	_cleanup_free_ struct nvme_id_ns_granularity_list *granularity_list = NULL;
+static int nvm_id_ctrl(int argc, char **argv, struct command *cmd,
+	struct plugin *plugin)
+{
+	const char *desc = "Send an Identify Controller NVM Command Set "
+		"command to the given device and report information about "
+		"the specified controller in various formats.";
+
+	_cleanup_free_ struct nvme_id_ctrl_nvm *ctrl_nvm = NULL;
 	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
 	nvme_print_flags_t flags;
-	int err;
+	int err = -1;
 
 	NVME_ARGS(opts);
 
@@ -3959,44 +4260,209 @@ static int id_ns_granularity(int argc, char **argv, struct command *cmd, struct
 		return err;
 	}
 
-	granularity_list = nvme_alloc(NVME_IDENTIFY_DATA_SIZE);
-	if (!granularity_list)
+	if (argconfig_parse_seen(opts, "verbose"))
+		flags |= VERBOSE;
+
+	ctrl_nvm = nvme_alloc(sizeof(*ctrl_nvm));
+	if (!ctrl_nvm)
 		return -ENOMEM;
 
-	err = nvme_identify_ns_granularity(dev_fd(dev), granularity_list);
+	err = nvme_nvm_identify_ctrl(dev_fd(dev), ctrl_nvm);
 	if (!err)
-		nvme_show_id_ns_granularity_list(granularity_list, flags);
+		nvme_show_id_ctrl_nvm(ctrl_nvm, flags);
 	else if (err > 0)
 		nvme_show_status(err);
 	else
-		nvme_show_error("identify namespace granularity: %s", nvme_strerror(errno));
+		nvme_show_error("nvm identify controller: %s", nvme_strerror(errno));
 
 	return err;
 }
 
-static int id_nvmset(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+#define NS_SWEEP_JOBS	16
+
+/*
+ * Identify sweep over all namespaces of a controller. The commands are
+ * issued concurrently, one buffer per namespace, and the results are
+ * printed afterwards in namespace order.
+ */
+struct ns_sweep {
+	struct nvme_dev *dev;
+	size_t size;
+	void *priv;
+	int (*identify)(struct ns_sweep *sw, __u32 nsid, void *buf);
+	void (*show)(struct ns_sweep *sw, __u32 nsid, void *buf,
+		     nvme_print_flags_t flags);
+	__u32 *nsids;
+	int *errs;
+	void *bufs;
+};
+
+static int ns_sweep_list(struct nvme_dev *dev, bool allocated, __u32 **nsids,
+			 unsigned int *nr)
 {
-	const char *desc = "Send an Identify NVM Set List command to the "
-		"given device, returns entries for NVM Set identifiers greater "
-		"than or equal to the value specified CDW11.NVMSETID "
-		"in either binary format or json format";
-	const char *nvmset_id = "NVM Set Identify value";
+	_cleanup_free_ struct nvme_ns_list *ns_list = NULL;
+	__u32 *list = NULL, *tmp, nsid = 0;
+	unsigned int n = 0;
+	int i, j, err;
 
-	_cleanup_free_ struct nvme_id_nvmset_list *nvmset = NULL;
+	ns_list = nvme_alloc(sizeof(*ns_list));
+	if (!ns_list)
+		return -ENOMEM;
+
+	do {
+		if (allocated)
+			err = nvme_cli_identify_allocated_ns_list(dev, nsid, ns_list);
+		else
+			err = nvme_cli_identify_active_ns_list(dev, nsid, ns_list);
+		if (err) {
+			free(list);
+			return err;
+		}
+
+		for (i = 0; i < ARRAY_SIZE(ns_list->ns) && ns_list->ns[i]; i++)
+			;
+		if (!i)
+			break;
+
+		tmp = realloc(list, (n + i) * sizeof(*list));
+		if (!tmp) {
+			free(list);
+			return -ENOMEM;
+		}
+		list = tmp;
+
+		for (j = 0; j < i; j++)
+			list[n++] = le32_to_cpu(ns_list->ns[j]);
+		nsid = list[n - 1];
+	} while (i == ARRAY_SIZE(ns_list->ns));
+
+	*nsids = list;
+	*nr = n;
+
+	return 0;
+}
+
+static void ns_sweep_one(unsigned int idx, void *arg)
+{
+	struct ns_sweep *sw = arg;
+	int err;
+
+	errno = 0;
+	err = sw->identify(sw, sw->nsids[idx], sw->bufs + idx * sw->size);
+	if (err < 0 && errno)
+		err = -errno;
+	sw->errs[idx] = err;
+}
+
+static int ns_sweep(struct ns_sweep *sw, bool allocated, unsigned int jobs,
+		    nvme_print_flags_t flags)
+{
+	_cleanup_free_ __u32 *nsids = NULL;
+	_cleanup_free_ int *errs = NULL;
+	_cleanup_free_ void *bufs = NULL;
+	unsigned int nr, i;
+	int err, ret = 0;
+
+	err = ns_sweep_list(sw->dev, allocated, &nsids, &nr);
+	if (err > 0) {
+		nvme_show_status(err);
+		return err;
+	}
+	if (err < 0) {
+		nvme_show_error("identify namespace list: %s", nvme_strerror(-err));
+		return err;
+	}
+
+	if (!nr)
+		return 0;
+
+	errs = calloc(nr, sizeof(*errs));
+	bufs = nvme_alloc(nr * sw->size);
+	if (!errs || !bufs)
+		return -ENOMEM;
+
+	sw->nsids = nsids;
+	sw->errs = errs;
+	sw->bufs = bufs;
+
+	/* The MI transport serializes commands on the endpoint */
+	if (sw->dev->type != NVME_DEV_DIRECT || !jobs)
+		jobs = 1;
+
+	parallel_for_each(nr, jobs, ns_sweep_one, sw);
+
+	nvme_show_init();
+
+	for (i = 0; i < nr; i++) {
+		err = errs[i];
+		if (!err)
+			sw->show(sw, nsids[i], bufs + i * sw->size, flags);
+		else if (err > 0)
+			nvme_show_error_status(err, "identify namespace %u", nsids[i]);
+		else
+			nvme_show_error("identify namespace %u: %s", nsids[i],
+					nvme_strerror(-err));
+		if (err && !ret)
+			ret = err;
+	}
+
+	nvme_show_finish();
+
+	return ret;
+}
+
+static int nvm_id_ns_identify(struct ns_sweep *sw, __u32 nsid, void *buf)
+{
+	__u8 *uuid_index = sw->priv;
+	int err;
+
+	err = nvme_cli_identify_ns(sw->dev, nsid, buf);
+	if (err)
+		return err;
+
+	return nvme_identify_ns_csi(dev_fd(sw->dev), nsid, *uuid_index,
+				    NVME_CSI_NVM, buf + sizeof(struct nvme_id_ns));
+}
+
+static void nvm_id_ns_show(struct ns_sweep *sw, __u32 nsid, void *buf,
+			   nvme_print_flags_t flags)
+{
+	nvme_show_nvm_id_ns(buf + sizeof(struct nvme_id_ns), nsid, buf, 0,
+			    false, flags);
+}
+
+static int nvm_id_ns(int argc, char **argv, struct command *cmd,
+	struct plugin *plugin)
+{
+	const char *desc = "Send an Identify Namespace NVM Command Set "
+		"command to the given device and report information about "
+		"the specified namespace in various formats.";
+
+	_cleanup_free_ struct nvme_nvm_id_ns *id_ns = NULL;
+	_cleanup_free_ struct nvme_id_ns *ns = NULL;
 	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
 	nvme_print_flags_t flags;
-	int err;
+	int err = -1;
 
 	struct config {
-		__u16	nvmset_id;
+		__u32	namespace_id;
+		__u8	uuid_index;
+		bool	all;
+		__u32	jobs;
 	};
 
 	struct config cfg = {
-		.nvmset_id	= 0,
+		.namespace_id	= 0,
+		.uuid_index	= NVME_UUID_NONE,
+		.all		= false,
+		.jobs		= NS_SWEEP_JOBS,
 	};
 
 	NVME_ARGS(opts,
-		  OPT_SHRT("nvmset_id",    'i', &cfg.nvmset_id,     nvmset_id));
+		  OPT_UINT("namespace-id", 'n', &cfg.namespace_id,    namespace_id_desired),
+		  OPT_BYTE("uuid-index",   'U', &cfg.uuid_index,      uuid_index),
+		  OPT_FLAG("all",          'a', &cfg.all,             all_ns),
+		  OPT_UINT("jobs",         'j', &cfg.jobs,            jobs));
 
 	err = parse_and_open(&dev, argc, argv, desc, opts);
 	if (err)
@@ -4008,47 +4474,81 @@ static int id_nvmset(int argc, char **argv, struct command *cmd, struct plugin *
 		return err;
 	}
 
-	nvmset = nvme_alloc(sizeof(*nvmset));
-	if (!nvmset)
+	if (argconfig_parse_seen(opts, "verbose"))
+		flags |= VERBOSE;
+
+	if (cfg.all) {
+		struct ns_sweep sw = {
+			.dev		= dev,
+			.size		= sizeof(*ns) + sizeof(*id_ns),
+			.priv		= &cfg.uuid_index,
+			.identify	= nvm_id_ns_identify,
+			.show		= nvm_id_ns_show,
+		};
+
+		return ns_sweep(&sw, false, cfg.jobs, flags);
+	}
+
+	if (!cfg.namespace_id) {
+		err = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
+		if (err < 0) {
+			nvme_show_perror("get-namespace-id");
+			return err;
+		}
+	}
+
+	ns = nvme_alloc(sizeof(*ns));
+	if (!ns)
 		return -ENOMEM;
 
-	err = nvme_identify_nvmset_list(dev_fd(dev), cfg.nvmset_id, nvmset);
+	err = nvme_cli_identify_ns(dev, cfg.namespace_id, ns);
+	if (err) {
+		nvme_show_status(err);
+		return err;
+	}
+
+	id_ns = nvme_alloc(sizeof(*id_ns));
+	if (!id_ns)
+		return -ENOMEM;
+
+	err = nvme_identify_ns_csi(dev_fd(dev), cfg.namespace_id,
+				   cfg.uuid_index,
+				   NVME_CSI_NVM, id_ns);
 	if (!err)
-		nvme_show_id_nvmset(nvmset, cfg.nvmset_id, flags);
+		nvme_show_nvm_id_ns(id_ns, cfg.namespace_id, ns, 0, false, flags);
 	else if (err > 0)
 		nvme_show_status(err);
 	else
-		nvme_show_error("identify nvm set list: %s", nvme_strerror(errno));
+		nvme_show_perror("nvm identify namespace");
 
 	return err;
 }
 
-static int id_uuid(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+static int nvm_id_ns_lba_format(int argc, char **argv, struct command *cmd, struct plugin *plugin)
 {
-	const char *desc = "Send an Identify UUID List command to the "
-		"given device, returns list of supported Vendor Specific UUIDs "
-		"in either human-readable or binary format.";
-	const char *raw = "show uuid in binary format";
-	const char *human_readable = "show uuid in readable format";
+	const char *desc = "Send an NVM Command Set specific Identify Namespace "
+		"command to the given device, returns capability field properties of "
+		"the specified LBA Format index in the specified namespace in various formats.";
 
-	_cleanup_free_ struct nvme_id_uuid_list *uuid_list = NULL;
+	_cleanup_free_ struct nvme_nvm_id_ns *nvm_ns = NULL;
+	_cleanup_free_ struct nvme_id_ns *ns = NULL;
 	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
 	nvme_print_flags_t flags;
-	int err;
+	int err = -1;
 
 	struct config {
-		bool	raw_binary;
-		bool	human_readable;
+		__u16	lba_format_index;
+		__u8	uuid_index;
 	};
 
 	struct config cfg = {
-		.raw_binary	= false,
-		.human_readable	= false,
+		.lba_format_index	= 0,
+		.uuid_index		= NVME_UUID_NONE,
 	};
 
 	NVME_ARGS(opts,
-		  OPT_FLAG("raw-binary",     'b', &cfg.raw_binary,     raw),
-		  OPT_FLAG("human-readable", 'H', &cfg.human_readable, human_readable));
+		  OPT_UINT("lba-format-index", 'i', &cfg.lba_format_index, lba_format_index),
+		  OPT_BYTE("uuid-index",       'U', &cfg.uuid_index,       uuid_index));
 
 	err = parse_and_open(&dev, argc, argv, desc, opts);
 	if (err)
@@ -4060,238 +4560,273 @@ static int id_uuid(int argc, char **argv, struct command *cmd, struct plugin *pl
 		return err;
 	}
 
-	if (cfg.raw_binary)
-		flags = BINARY;
-
-	if (cfg.human_readable || argconfig_parse_seen(opts, "verbose"))
+	if (argconfig_parse_seen(opts, "verbose"))
 		flags |= VERBOSE;
 
-	uuid_list = nvme_alloc(sizeof(*uuid_list));
-	if (!uuid_list)
+	ns = nvme_alloc(sizeof(*ns));
+	if (!ns)
 		return -ENOMEM;
 
-	err = nvme_identify_uuid(dev_fd(dev), uuid_list);
+	err = nvme_cli_identify_ns(dev, NVME_NSID_ALL, ns);
+	if (err) {
+		ns->nlbaf = NVME_FEAT_LBA_RANGE_MAX - 1;
+		ns->nulbaf = 0;
+	}
+
+	nvm_ns = nvme_alloc(sizeof(*nvm_ns));
+	if (!nvm_ns)
+		return -ENOMEM;
+
+	err = nvme_identify_iocs_ns_csi_user_data_format(dev_fd(dev), cfg.lba_format_index,
+							 cfg.uuid_index, NVME_CSI_NVM, nvm_ns);
 	if (!err)
-		nvme_show_id_uuid_list(uuid_list, flags);
+		nvme_show_nvm_id_ns(nvm_ns, 0, ns, cfg.lba_format_index, true, flags);
 	else if (err > 0)
 		nvme_show_status(err);
 	else
-		nvme_show_error("identify UUID list: %s", nvme_strerror(errno));
+		nvme_show_perror("NVM identify namespace for specific LBA format");
 
 	return err;
 }
 
-static int id_iocs(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+static int ns_descs_identify(struct ns_sweep *sw, __u32 nsid, void *buf)
 {
-	const char *desc = "Send an Identify Command Set Data command to "
-		"the given device, returns properties of the specified controller "
-		"in either human-readable or binary format.";
-	const char *controller_id = "identifier of desired controller";
+	return nvme_cli_identify_ns_descs(sw->dev, nsid, buf);
+}
+
+static void ns_descs_show(struct ns_sweep *sw, __u32 nsid, void *buf,
+			  nvme_print_flags_t flags)
+{
+	nvme_show_id_ns_descs(buf, nsid, flags);
+}
+
+static int ns_descs(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Send Namespace Identification Descriptors command to the "
+		"given device, returns the namespace identification descriptors "
+		"of the specific namespace in either human-readable or binary format.";
+	const char *raw = "show descriptors in binary format";
 
-	_cleanup_free_ struct nvme_id_iocs *iocs = NULL;
 	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	_cleanup_free_ void *nsdescs = NULL;
+	nvme_print_flags_t flags;
 	int err;
 
 	struct config {
-		__u16	cntid;
+		__u32	namespace_id;
+		bool	raw_binary;
+		bool	all;
+		__u32	jobs;
 	};
 
 	struct config cfg = {
-		.cntid	= 0xffff,
+		.namespace_id	= 0,
+		.raw_binary	= false,
+		.all		= false,
+		.jobs		= NS_SWEEP_JOBS,
 	};
 
 	NVME_ARGS(opts,
-		  OPT_SHRT("controller-id", 'c', &cfg.cntid, controller_id));
+		  OPT_UINT("namespace-id",  'n', &cfg.namespace_id,  namespace_id_desired),
+		  OPT_FLAG("raw-binary",    'b', &cfg.raw_binary,    raw),
+		  OPT_FLAG("all",           'a', &cfg.all,           all_ns),
+		  OPT_UINT("jobs",          'j', &cfg.jobs,          jobs));
 
 	err = parse_and_open(&dev, argc, argv, desc, opts);
 	if (err)
 		return err;
 
-	iocs = nvme_alloc(sizeof(*iocs));
-	if (!iocs)
-		return -ENOMEM;
-
-	err = nvme_identify_iocs(dev_fd(dev), cfg.cntid, iocs);
-	if (!err) {
-		printf("NVMe Identify I/O Command Set:\n");
-		nvme_show_id_iocs(iocs, 0);
-	} else if (err > 0) {
-		nvme_show_status(err);
-	} else {
-		nvme_show_error("NVMe Identify I/O Command Set: %s", nvme_strerror(errno));
+	err = validate_output_format(nvme_cfg.output_format, &flags);
+	if (err < 0) {
+		nvme_show_error("Invalid output format");
+		return err;
 	}
 
-	return err;
-}
-
-static int id_domain(int argc, char **argv, struct command *cmd, struct plugin *plugin)
-{
-	const char *desc = "Send an Identify Domain List command to the "
-		"given device, returns properties of the specified domain "
-		"in either normal|json|binary format.";
-	const char *domain_id = "identifier of desired domain";
-
-	_cleanup_free_ struct nvme_id_domain_list *id_domain = NULL;
-	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	nvme_print_flags_t flags;
-	int err;
-
-	struct config {
-		__u16	dom_id;
-	};
+	if (cfg.raw_binary)
+		flags = BINARY;
 
-	struct config cfg = {
-		.dom_id		= 0xffff,
-	};
+	if (argconfig_parse_seen(opts, "verbose"))
+		flags |= VERBOSE;
 
-	NVME_ARGS(opts,
-		  OPT_SHRT("dom-id",         'd', &cfg.dom_id,         domain_id));
+	if (cfg.all) {
+		struct ns_sweep sw = {
+			.dev		= dev,
+			.size		= NVME_IDENTIFY_DATA_SIZE,
+			.identify	= ns_descs_identify,
+			.show		= ns_descs_show,
+		};
 
-	err = parse_and_open(&dev, argc, argv, desc, opts);
-	if (err)
-		return err;
+		return ns_sweep(&sw, false, cfg.jobs, flags);
+	}
 
-	err = validate_output_format(nvme_cfg.output_format, &flags);
-	if (err < 0) {
-		nvme_show_error("Invalid output format");
-		return err;
+	if (!cfg.namespace_id) {
+		err = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
+		if (err < 0) {
+			nvme_show_error("get-namespace-id: %s", nvme_strerror(errno));
+			return err;
+		}
 	}
 
-	id_domain = nvme_alloc(sizeof(*id_domain));
-	if (!id_domain)
+	nsdescs = nvme_alloc(NVME_IDENTIFY_DATA_SIZE);
+	if (!nsdescs)
 		return -ENOMEM;
 
-	err = nvme_identify_domain_list(dev_fd(dev), cfg.dom_id, id_domain);
-	if (!err) {
-		printf("NVMe Identify command for Domain List is successful:\n");
-		printf("NVMe Identify Domain List:\n");
-		nvme_show_id_domain_list(id_domain, flags);
-	} else if (err > 0) {
+	err = nvme_cli_identify_ns_descs(dev, cfg.namespace_id, nsdescs);
+	if (!err)
+		nvme_show_id_ns_descs(nsdescs, cfg.namespace_id, flags);
+	else if (err > 0)
 		nvme_show_status(err);
-	} else {
-		nvme_show_error("NVMe Identify Domain List: %s", nvme_strerror(errno));
-	}
+	else
+		nvme_show_error("identify namespace: %s", nvme_strerror(errno));
 
 	return err;
 }
 
-static int get_ns_id(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+static int id_ns_identify(struct ns_sweep *sw, __u32 nsid, void *buf)
 {
-	const char *desc = "Get namespace ID of a the block device.";
-
-	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	unsigned int nsid;
-	int err;
-
-	NVME_ARGS(opts);
-
-	err = parse_and_open(&dev, argc, argv, desc, opts);
-	if (err)
-		return err;
+	bool *force = sw->priv;
 
-	err = nvme_get_nsid(dev_fd(dev), &nsid);
-	if (err < 0) {
-		nvme_show_error("get namespace ID: %s", nvme_strerror(errno));
-		return -errno;
-	}
+	if (*force)
+		return nvme_cli_identify_allocated_ns(sw->dev, nsid, buf);
 
-	printf("%s: namespace-id:%d\n", dev->name, nsid);
+	return nvme_cli_identify_ns(sw->dev, nsid, buf);
+}
 
-	return 0;
+static void id_ns_show(struct ns_sweep *sw, __u32 nsid, void *buf,
+		       nvme_print_flags_t flags)
+{
+	nvme_show_id_ns(buf, nsid, 0, false, flags);
 }
 
-static int virtual_mgmt(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+static int id_ns(int argc, char **argv, struct command *cmd, struct plugin *plugin)
 {
-	const char *desc = "The Virtualization Management command is supported by primary controllers "
-		"that support the Virtualization Enhancements capability. This command is used for:\n"
-		"  1. Modifying Flexible Resource allocation for the primary controller\n"
-		"  2. Assigning Flexible Resources for secondary controllers\n"
-		"  3. Setting the Online and Offline state for secondary controllers";
-	const char *cntlid = "Controller Identifier(CNTLID)";
-	const char *rt = "Resource Type(RT): [0,1]\n"
-		"0h: VQ Resources\n"
-		"1h: VI Resources";
-	const char *act = "Action(ACT): [1,7,8,9]\n"
-		"1h: Primary Flexible\n"
-		"7h: Secondary Offline\n"
-		"8h: Secondary Assign\n"
-		"9h: Secondary Online";
-	const char *nr = "Number of Controller Resources(NR)";
+	const char *desc = "Send an Identify Namespace command to the "
+		"given device, returns properties of the specified namespace "
+		"in either human-readable or binary format. Can also return "
+		"binary vendor-specific namespace attributes.";
+	const char *force = "Return this namespace, even if not attached (1.2 devices only)";
+	const char *vendor_specific = "dump binary vendor fields";
 
 	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	__u32 result;
+	_cleanup_free_ struct nvme_id_ns *ns = NULL;
+	nvme_print_flags_t flags;
 	int err;
 
 	struct config {
-		__u16	cntlid;
-		__u8	rt;
-		__u8	act;
-		__u16	nr;
+		__u32	namespace_id;
+		bool	force;
+		bool	vendor_specific;
+		bool	raw_binary;
+		bool	human_readable;
+		bool	all;
+		__u32	jobs;
 	};
 
 	struct config cfg = {
-		.cntlid	= 0,
-		.rt	= 0,
-		.act	= 0,
-		.nr	= 0,
+		.namespace_id		= 0,
+		.force			= false,
+		.vendor_specific	= false,
+		.raw_binary		= false,
+		.human_readable		= false,
+		.all			= false,
+		.jobs			= NS_SWEEP_JOBS,
 	};
 
 	NVME_ARGS(opts,
-		  OPT_UINT("cntlid", 'c', &cfg.cntlid, cntlid),
-		  OPT_BYTE("rt",     'r', &cfg.rt,     rt),
-		  OPT_BYTE("act",    'a', &cfg.act,    act),
-		  OPT_SHRT("nr",     'n', &cfg.nr,     nr));
+		  OPT_UINT("namespace-id",    'n', &cfg.namespace_id,    namespace_id_desired),
+		  OPT_FLAG("force",             0, &cfg.force,           force),
+		  OPT_FLAG("vendor-specific", 'V', &cfg.vendor_specific, vendor_specific),
+		  OPT_FLAG("raw-binary",      'b', &cfg.raw_binary,      raw_identify),
+		  OPT_FLAG("human-readable",  'H', &cfg.human_readable,  human_readable_identify),
+		  OPT_FLAG("all",             'a', &cfg.all,             all_ns),
+		  OPT_UINT("jobs",            'j', &cfg.jobs,            jobs));
 
 	err = parse_and_open(&dev, argc, argv, desc, opts);
 	if (err)
 		return err;
 
-	struct nvme_virtual_mgmt_args args = {
-		.args_size	= sizeof(args),
-		.fd		= dev_fd(dev),
-		.act		= cfg.act,
-		.rt		= cfg.rt,
-		.cntlid		= cfg.cntlid,
-		.nr		= cfg.nr,
-		.timeout	= nvme_cfg.timeout,
-		.result		= &result,
-	};
-	err = nvme_virtual_mgmt(&args);
+	err = validate_output_format(nvme_cfg.output_format, &flags);
+	if (err < 0) {
+		nvme_show_error("Invalid output format");
+		return err;
+	}
+
+	if (cfg.raw_binary)
+		flags = BINARY;
+
+	if (cfg.vendor_specific)
+		flags |= VS;
+
+	if (cfg.human_readable || argconfig_parse_seen(opts, "verbose"))
+		flags |= VERBOSE;
+
+	if (cfg.all) {
+		struct ns_sweep sw = {
+			.dev		= dev,
+			.size		= sizeof(*ns),
+			.priv		= &cfg.force,
+			.identify	= id_ns_identify,
+			.show		= id_ns_show,
+		};
+
+		return ns_sweep(&sw, cfg.force, cfg.jobs, flags);
+	}
+
+	if (!cfg.namespace_id) {
+		err = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
+		if (err < 0) {
+			nvme_show_error("get-namespace-id: %s", nvme_strerror(errno));
+			return err;
+		}
+	}
+
+	ns = nvme_alloc(sizeof(*ns));
+	if (!ns)
+		return -ENOMEM;
+
+	if (cfg.force)
+		err = nvme_cli_identify_allocated_ns(dev, cfg.namespace_id, ns);
+	else
+		err = nvme_cli_identify_ns(dev, cfg.namespace_id, ns);
+
 	if (!err)
-		printf("success, Number of Controller Resources Modified (NRM):%#x\n", result);
+		nvme_show_id_ns(ns, cfg.namespace_id, 0, false, flags);
 	else if (err > 0)
 		nvme_show_status(err);
 	else
-		nvme_show_error("virt-mgmt: %s", nvme_strerror(errno));
+		nvme_show_error("identify namespace: %s", nvme_strerror(errno));
 
 	return err;
 }
 
-static int primary_ctrl_caps(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+static int cmd_set_independent_id_ns(int argc, char **argv, struct command *cmd,
+				     struct plugin *plugin)
 {
-	const char *cntlid = "Controller ID";
-	const char *desc = "Send an Identify Primary Controller Capabilities "
-		"command to the given device and report the information in a "
-		"decoded format (default), json or binary.";
+	const char *desc = "Send an I/O Command Set Independent Identify "
+		"Namespace command to the given device, returns properties of the "
+		"specified namespace in human-readable or binary or json format.";
 
-	_cleanup_free_ struct nvme_primary_ctrl_cap *caps = NULL;
+	_cleanup_free_ struct nvme_id_independent_id_ns *ns = NULL;
 	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
 	nvme_print_flags_t flags;
-	int err;
+	int err = -1;
 
 	struct config {
-		__u16	cntlid;
+		__u32	namespace_id;
+		bool	raw_binary;
 		bool	human_readable;
 	};
 
 	struct config cfg = {
-		.cntlid		= 0,
+		.namespace_id	= 0,
+		.raw_binary	= false,
 		.human_readable	= false,
 	};
 
 	NVME_ARGS(opts,
-		  OPT_UINT("cntlid",         'c', &cfg.cntlid, cntlid),
-		  OPT_FLAG("human-readable", 'H', &cfg.human_readable, human_readable_info));
+		  OPT_UINT("namespace-id",    'n', &cfg.namespace_id,    namespace_id_desired),
+		  OPT_FLAG("raw-binary",      'b', &cfg.raw_binary,      raw_identify),
+		  OPT_FLAG("human-readable",  'H', &cfg.human_readable,  human_readable_identify));
 
 	err = parse_and_open(&dev, argc, argv, desc, opts);
 	if (err)
@@ -4303,50 +4838,48 @@ static int primary_ctrl_caps(int argc, char **argv, struct command *cmd, struct
 		return err;
 	}
 
+	if (cfg.raw_binary)
+		flags = BINARY;
+
 	if (cfg.human_readable || argconfig_parse_seen(opts, "verbose"))
 		flags |= VERBOSE;
 
-	caps = nvme_alloc(sizeof(*caps));
-	if (!caps)
+	if (!cfg.namespace_id) {
+		err = cfg.namespace_id = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
+		if (err < 0) {
+			nvme_show_perror("get-namespace-id");
+			return err;
+		}
+	}
+
+	ns = nvme_alloc(sizeof(*ns));
+	if (!ns)
 		return -ENOMEM;
 
-	err = nvme_cli_identify_primary_ctrl(dev, cfg.cntlid, caps);
+	err = nvme_identify_independent_identify_ns(dev_fd(dev), cfg.namespace_id, ns);
 	if (!err)
-		nvme_show_primary_ctrl_cap(caps, flags);
+		nvme_show_cmd_set_independent_id_ns(ns, cfg.namespace_id, flags);
 	else if (err > 0)
 		nvme_show_status(err);
 	else
-		nvme_show_error("identify primary controller capabilities: %s",
+		nvme_show_error("I/O command set independent identify namespace: %s",
 				nvme_strerror(errno));
 
 	return err;
 }
 
-static int list_secondary_ctrl(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+static int id_ns_granularity(int argc, char **argv, struct command *cmd, struct plugin *plugin)
 {
-	const char *desc =
-	    "Show secondary controller list associated with the primary controller of the given device.";
-	const char *controller = "lowest controller identifier to display";
-	const char *num_entries = "number of entries to retrieve";
+	const char *desc = "Send an Identify Namespace Granularity List command to the "
+		"given device, returns namespace granularity list "
+		"in either human-readable or binary format.";
 
-	_cleanup_free_ struct nvme_secondary_ctrl_list *sc_list = NULL;
+	_cleanup_free_ struct nvme_id_ns_granularity_list *granularity_list = NULL;
 	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
 	nvme_print_flags_t flags;
 	int err;
 
-	struct config {
-		__u16	cntid;
-		__u32	num_entries;
-	};
-
-	struct config cfg = {
-		.cntid		= 0,
-		.num_entries	= ARRAY_SIZE(sc_list->sc_entry),
-	};
-
-	NVME_ARGS(opts,
-		  OPT_SHRT("cntid",        'c', &cfg.cntid,         controller),
-		  OPT_UINT("num-entries",  'e', &cfg.num_entries,   num_entries));
+	NVME_ARGS(opts);
 
 	err = parse_and_open(&dev, argc, argv, desc, opts);
 	if (err)
@@ -4358,253 +4891,96 @@ static int list_secondary_ctrl(int argc, char **argv, struct command *cmd, struc
 		return err;
 	}
 
-	if (!cfg.num_entries) {
-		nvme_show_error("non-zero num-entries is required param");
-		return -EINVAL;
-	}
-
-	sc_list = nvme_alloc(sizeof(*sc_list));
-	if (!sc_list)
+	granularity_list = nvme_alloc(NVME_IDENTIFY_DATA_SIZE);
+	if (!granularity_list)
 		return -ENOMEM;
 
-	err = nvme_cli_identify_secondary_ctrl_list(dev, cfg.cntid, sc_list);
+	err = nvme_identify_ns_granularity(dev_fd(dev), granularity_list);
 	if (!err)
-		nvme_show_list_secondary_ctrl(sc_list, cfg.num_entries, flags);
+		nvme_show_id_ns_granularity_list(granularity_list, flags);
 	else if (err > 0)
 		nvme_show_status(err);
 	else
-		nvme_show_error("id secondary controller list: %s", nvme_strerror(errno));
+		nvme_show_error("identify namespace granularity: %s", nvme_strerror(errno));
 
 	return err;
 }
 
-static void intr_self_test(int signum)
-{
-	printf("\nInterrupted device self-test operation by %s\n", strsignal(signum));
-
-	errno = EINTR;
-}
-
-static int sleep_self_test(unsigned int seconds)
-{
-	errno = 0;
-
-	sleep(seconds);
-
-	if (errno)
-		return -errno;
-
-	return 0;
-}
-
-static int wait_self_test(struct nvme_dev *dev)
-{
-	static const char spin[] = {'-', '\\', '|', '/' };
-	_cleanup_free_ struct nvme_self_test_log *log = NULL;
-	_cleanup_free_ struct nvme_id_ctrl *ctrl = NULL;
-	int err, i = 0, p = 0, cnt = 0;
-	int wthr;
-
-	signal(SIGINT, intr_self_test);
-
-	ctrl = nvme_alloc(sizeof(*ctrl));
-	if (!ctrl)
-		return -ENOMEM;
-
-	log = nvme_alloc(sizeof(*log));
-	if (!log)
-		return -ENOMEM;
-
-	err = nvme_cli_identify_ctrl(dev, ctrl);
-	if (err) {
-		nvme_show_error("identify-ctrl: %s", nvme_strerror(errno));
-		return err;
-	}
-
-	wthr = le16_to_cpu(ctrl->edstt) * 60 / 100 + 60;
-
-	printf("Waiting for self test completion...\n");
-	while (true) {
-		printf("\r[%.*s%c%.*s] %3d%%", p / 2, dash, spin[i % 4], 49 - p / 2, space, p);
-		fflush(stdout);
-		err = sleep_self_test(1);
-		if (err)
-			return err;
-
-		err = nvme_cli_get_log_device_self_test(dev, log);
-		if (err) {
-			printf("\n");
-			if (err < 0)
-				perror("self test log\n");
-			else
-				nvme_show_status(err);
-			return err;
-		}
-
-		if (++cnt > wthr) {
-			nvme_show_error("no progress for %d seconds, stop waiting", wthr);
-			return -EIO;
-		}
-
-		if (log->completion == 0 && p > 0) {
-			printf("\r[%.*s] %3d%%\n", 50, dash, 100);
-			break;
-		}
-
-		if (log->completion < p) {
-			printf("\n");
-				nvme_show_error("progress broken");
-				return -EIO;
-		} else if (log->completion != p) {
-			p = log->completion;
-			cnt = 0;
-		}
-
-		i++;
-	}
-
-	return 0;
-}
-
-static void abort_self_test(struct nvme_dev_self_test_args *args)
-{
-	int err;
-
-	args->stc = NVME_DST_STC_ABORT;
-
-	err = nvme_dev_self_test(args);
-	if (!err)
-		printf("Aborting device self-test operation\n");
-	else if (err > 0)
-		nvme_show_status(err);
-	else
-		nvme_show_error("Device self-test: %s", nvme_strerror(errno));
-}
-
-static int device_self_test(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+static int id_nvmset(int argc, char **argv, struct command *cmd, struct plugin *plugin)
 {
-	const char *desc = "Implementing the device self-test feature "
-		"which provides the necessary log to determine the state of the device";
-	const char *namespace_id =
-	    "Indicate the namespace in which the device self-test has to be carried out";
-	const char *self_test_code =
-		"This field specifies the action taken by the device self-test command :\n"
-		"0h Show current state of device self-test operation\n"
-		"1h Start a short device self-test operation\n"
-		"2h Start a extended device self-test operation\n"
-		"3h Start a Host-Initiated Refresh operation\n"
-		"eh Start a vendor specific device self-test operation\n"
-		"fh Abort the device self-test operation";
-	const char *wait = "Wait for the test to finish";
+	const char *desc = "Send an Identify NVM Set List command to the "
+		"given device, returns entries for NVM Set identifiers greater "
+		"than or equal to the value specified CDW11.NVMSETID "
+		"in either binary format or json format";
+	const char *nvmset_id = "NVM Set Identify value";
 
+	_cleanup_free_ struct nvme_id_nvmset_list *nvmset = NULL;
 	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	nvme_print_flags_t flags;
 	int err;
 
 	struct config {
-		__u32	namespace_id;
-		__u8	stc;
-		bool	wait;
+		__u16	nvmset_id;
 	};
 
 	struct config cfg = {
-		.namespace_id	= NVME_NSID_ALL,
-		.stc		= NVME_ST_CODE_RESERVED,
-		.wait		= false,
+		.nvmset_id	= 0,
 	};
 
 	NVME_ARGS(opts,
-		  OPT_UINT("namespace-id",   'n', &cfg.namespace_id, namespace_id),
-		  OPT_BYTE("self-test-code", 's', &cfg.stc,          self_test_code),
-		  OPT_FLAG("wait",           'w', &cfg.wait,         wait));
+		  OPT_SHRT("nvmset_id",    'i', &cfg.nvmset_id,     nvmset_id));
 
 	err = parse_and_open(&dev, argc, argv, desc, opts);
 	if (err)
 		return err;
 
-	if (cfg.stc == NVME_ST_CODE_RESERVED) {
-		_cleanup_free_ struct nvme_self_test_log *log = NULL;
-
-		log = nvme_alloc(sizeof(*log));
-		if (!log)
-			return -ENOMEM;
-
-		err = nvme_cli_get_log_device_self_test(dev, log);
-		if (err) {
-			printf("\n");
-			if (err < 0)
-				perror("self test log\n");
-			else
-				nvme_show_status(err);
-		}
-
-		if (log->completion == 0) {
-			printf("no self test running\n");
-		} else {
-			if (cfg.wait)
-				err = wait_self_test(dev);
-			else
-				printf("progress %d%%\n", log->completion);
-		}
-
-		goto check_abort;
+	err = validate_output_format(nvme_cfg.output_format, &flags);
+	if (err < 0) {
+		nvme_show_error("Invalid output format");
+		return err;
 	}
 
-	struct nvme_dev_self_test_args args = {
-		.args_size	= sizeof(args),
-		.fd		= dev_fd(dev),
-		.nsid		= cfg.namespace_id,
-		.stc		= cfg.stc,
-		.timeout	= nvme_cfg.timeout,
-		.result		= NULL,
-	};
-	err = nvme_dev_self_test(&args);
-	if (!err) {
-		if (cfg.stc == NVME_ST_CODE_ABORT)
-			printf("Aborting device self-test operation\n");
-		else if (cfg.stc == NVME_ST_CODE_EXTENDED)
-			printf("Extended Device self-test started\n");
-		else if (cfg.stc == NVME_ST_CODE_SHORT)
-			printf("Short Device self-test started\n");
-		else if (cfg.stc == NVME_ST_CODE_HOST_INIT)
-			printf("Host-Initiated Refresh started\n");
+	nvmset = nvme_alloc(sizeof(*nvmset));
+	if (!nvmset)
+		return -ENOMEM;
 
-		if (cfg.wait && cfg.stc != NVME_ST_CODE_ABORT)
-			err = wait_self_test(dev);
-	} else if (err > 0) {
+	err = nvme_identify_nvmset_list(dev_fd(dev), cfg.nvmset_id, nvmset);
+	if (!err)
+		nvme_show_id_nvmset(nvmset, cfg.nvmset_id, flags);
+	else if (err > 0)
 		nvme_show_status(err);
-	} else {
-		nvme_show_error("Device self-test: %s", nvme_strerror(errno));
-	}
-
-check_abort:
-	if (err == -EINTR)
-		abort_self_test(&args);
+	else
+		nvme_show_error("identify nvm set list: %s", nvme_strerror(errno));
 
 	return err;
 }
 
-static int self_test_log(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+static int id_uuid(int argc, char **argv, struct command *cmd, struct plugin *plugin)
 {
-	const char *desc = "Retrieve the self-test log for the given device and given test "
-		"(or optionally a namespace) in either decoded format (default) or binary.";
-	const char *dst_entries = "Indicate how many DST log entries to be retrieved, "
-		"by default all the 20 entries will be retrieved";
+	const char *desc = "Send an Identify UUID List command to the "
+		"given device, returns list of supported Vendor Specific UUIDs "
+		"in either human-readable or binary format.";
+	const char *raw = "show uuid in binary format";
+	const char *human_readable = "show uuid in readable format";
 
-	_cleanup_free_ struct nvme_self_test_log *log = NULL;
+	_cleanup_free_ struct nvme_id_uuid_list *uuid_list = NULL;
 	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
 	nvme_print_flags_t flags;
 	int err;
 
 	struct config {
-		__u8	dst_entries;
+		bool	raw_binary;
+		bool	human_readable;
 	};
 
 	struct config cfg = {
-		.dst_entries	= NVME_LOG_ST_MAX_RESULTS,
+		.raw_binary	= false,
+		.human_readable	= false,
 	};
 
 	NVME_ARGS(opts,
-		  OPT_BYTE("dst-entries",  'e', &cfg.dst_entries,   dst_entries));
+		  OPT_FLAG("raw-binary",     'b', &cfg.raw_binary,     raw),
+		  OPT_FLAG("human-readable", 'H', &cfg.human_readable, human_readable));
 
 	err = parse_and_open(&dev, argc, argv, desc, opts);
 	if (err)
@@ -4616,770 +4992,2950 @@ static int self_test_log(int argc, char **argv, struct command *cmd, struct plug
 		return err;
 	}
 
-	if (argconfig_parse_seen(opts, "verbose"))
+	if (cfg.raw_binary)
+		flags = BINARY;
+
+	if (cfg.human_readable || argconfig_parse_seen(opts, "verbose"))
 		flags |= VERBOSE;
 
-	log = nvme_alloc(sizeof(*log));
-	if (!log)
+	uuid_list = nvme_alloc(sizeof(*uuid_list));
+	if (!uuid_list)
 		return -ENOMEM;
 
-	err = nvme_cli_get_log_device_self_test(dev, log);
+	err = nvme_identify_uuid(dev_fd(dev), uuid_list);
 	if (!err)
-		nvme_show_self_test_log(log, cfg.dst_entries, 0, dev->name, flags);
+		nvme_show_id_uuid_list(uuid_list, flags);
 	else if (err > 0)
 		nvme_show_status(err);
 	else
-		nvme_show_error("self test log: %s", nvme_strerror(errno));
+		nvme_show_error("identify UUID list: %s", nvme_strerror(errno));
 
 	return err;
 }
 
-static int get_feature_id(struct nvme_dev *dev, struct feat_cfg *cfg,
-			  void **buf, __u32 *result)
+static int id_iocs(int argc, char **argv, struct command *cmd, struct plugin *plugin)
 {
-	if (!cfg->data_len)
-		nvme_get_feature_length(cfg->feature_id, cfg->cdw11,
-					&cfg->data_len);
-
-	/* check for Extended Host Identifier */
-	if (cfg->feature_id == NVME_FEAT_FID_HOST_ID && (cfg->cdw11 & 0x1))
-		cfg->data_len = 16;
-
-	if (cfg->feature_id == NVME_FEAT_FID_FDP_EVENTS) {
-		cfg->data_len = 0xff * sizeof(__u16);
-		cfg->cdw11 |= 0xff << 16;
-	}
+	const char *desc = "Send an Identify Command Set Data command to "
+		"the given device, returns properties of the specified controller "
+		"in either human-readable or binary format.";
+	const char *controller_id = "identifier of desired controller";
 
-	if (NVME_CHECK(cfg->sel, GET_FEATURES_SEL, SUPPORTED))
-		cfg->data_len = 0;
+	_cleanup_free_ struct nvme_id_iocs *iocs = NULL;
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	int err;
 
-	if (cfg->data_len) {
-		*buf = nvme_alloc(cfg->data_len - 1);
-		if (!*buf)
-			return -1;
-	}
+	struct config {
+		__u16	cntid;
+	};
 
-	struct nvme_get_features_args args = {
-		.args_size	= sizeof(args),
-		.fid		= cfg->feature_id,
-		.nsid		= cfg->namespace_id,
-		.sel		= cfg->sel,
-		.cdw11		= cfg->cdw11,
-		.uuidx		= cfg->uuid_index,
-		.data_len	= cfg->data_len,
-		.data		= *buf,
-		.timeout	= nvme_cfg.timeout,
-		.result		= result,
+	struct config cfg = {
+		.cntid	= 0xffff,
 	};
-	return nvme_cli_get_features(dev, &args);
-}
 
-static int filter_out_flags(int status)
-{
-	return status & (NVME_VAL(SCT) | NVME_VAL(SC));
-}
+	NVME_ARGS(opts,
+		  OPT_SHRT("controller-id", 'c', &cfg.cntid, controller_id));
 
-static void get_feature_id_print(struct feat_cfg cfg, int err, __u32 result, void *buf)
-{
-	int status = filter_out_flags(err);
-	enum nvme_status_type type = NVME_STATUS_TYPE_NVME;
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
 
+	iocs = nvme_alloc(sizeof(*iocs));
+	if (!iocs)
+		return -ENOMEM;
+
+	err = nvme_identify_iocs(dev_fd(dev), cfg.cntid, iocs);
 	if (!err) {
-		if (!cfg.raw_binary || !buf) {
-			nvme_feature_show(cfg.feature_id, cfg.sel, result);
-			if (NVME_CHECK(cfg.sel, GET_FEATURES_SEL, SUPPORTED))
-				nvme_show_select_result(cfg.feature_id, result);
-			else if (cfg.human_readable)
-				nvme_feature_show_fields(cfg.feature_id, result, buf);
-			else if (buf)
-				d(buf, cfg.data_len, 16, 1);
-		} else if (buf) {
-			d_raw(buf, cfg.data_len);
-		}
+		printf("NVMe Identify I/O Command Set:\n");
+		nvme_show_id_iocs(iocs, 0);
 	} else if (err > 0) {
-		if (!nvme_status_equals(status, type, NVME_SC_INVALID_FIELD) &&
-		    !nvme_status_equals(status, type, NVME_SC_INVALID_NS))
-			nvme_show_status(err);
+		nvme_show_status(err);
 	} else {
-		nvme_show_error("get-feature: %s", nvme_strerror(errno));
+		nvme_show_error("NVMe Identify I/O Command Set: %s", nvme_strerror(errno));
 	}
+
+	return err;
 }
 
-static int get_feature_id_changed(struct nvme_dev *dev, struct feat_cfg cfg)
+static int id_domain(int argc, char **argv, struct command *cmd, struct plugin *plugin)
 {
+	const char *desc = "Send an Identify Domain List command to the "
+		"given device, returns properties of the specified domain "
+		"in either normal|json|binary format.";
+	const char *domain_id = "identifier of desired domain";
+
+	_cleanup_free_ struct nvme_id_domain_list *id_domain = NULL;
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	nvme_print_flags_t flags;
 	int err;
-	int err_def = 0;
-	__u32 result;
-	__u32 result_def;
-	_cleanup_free_ void *buf = NULL;
-	_cleanup_free_ void *buf_def = NULL;
 
-	if (cfg.changed)
-		cfg.sel = NVME_GET_FEATURES_SEL_CURRENT;
+	struct config {
+		__u16	dom_id;
+	};
 
-	err = get_feature_id(dev, &cfg, &buf, &result);
+	struct config cfg = {
+		.dom_id		= 0xffff,
+	};
 
-	if (!err && cfg.changed) {
-		cfg.sel = NVME_GET_FEATURES_SEL_DEFAULT;
-		err_def = get_feature_id(dev, &cfg, &buf_def, &result_def);
+	NVME_ARGS(opts,
+		  OPT_SHRT("dom-id",         'd', &cfg.dom_id,         domain_id));
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	err = validate_output_format(nvme_cfg.output_format, &flags);
+	if (err < 0) {
+		nvme_show_error("Invalid output format");
+		return err;
 	}
 
-	if (err || !cfg.changed || err_def || result != result_def ||
-	    (buf && buf_def && !strcmp(buf, buf_def)))
-		get_feature_id_print(cfg, err, result, buf);
+	id_domain = nvme_alloc(sizeof(*id_domain));
+	if (!id_domain)
+		return -ENOMEM;
+
+	err = nvme_identify_domain_list(dev_fd(dev), cfg.dom_id, id_domain);
+	if (!err) {
+		printf("NVMe Identify command for Domain List is successful:\n");
+		printf("NVMe Identify Domain List:\n");
+		nvme_show_id_domain_list(id_domain, flags);
+	} else if (err > 0) {
+		nvme_show_status(err);
+	} else {
+		nvme_show_error("NVMe Identify Domain List: %s", nvme_strerror(errno));
+	}
 
 	return err;
 }
 
-static int get_feature_ids(struct nvme_dev *dev, struct feat_cfg cfg)
+static int get_ns_id(int argc, char **argv, struct command *cmd, struct plugin *plugin)
 {
-	int err = 0;
-	int i;
-	int feat_max = 0x100;
-	int feat_num = 0;
-	int status = 0;
-	enum nvme_status_type type = NVME_STATUS_TYPE_NVME;
+	const char *desc = "Get namespace ID of a the block device.";
 
-	if (cfg.feature_id)
-		feat_max = cfg.feature_id + 1;
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	unsigned int nsid;
+	int err;
 
-	for (i = cfg.feature_id; i < feat_max; i++, feat_num++) {
-		cfg.feature_id = i;
-		err = get_feature_id_changed(dev, cfg);
-		if (!err)
-			continue;
-		status = filter_out_flags(err);
-		if (nvme_status_equals(status, type, NVME_SC_INVALID_FIELD))
-			continue;
-		if (!nvme_status_equals(status, type, NVME_SC_INVALID_NS))
-			break;
-		nvme_show_error_status(err, "get-feature:%#0*x (%s)", cfg.feature_id ? 4 : 2,
-				       cfg.feature_id, nvme_feature_to_string(cfg.feature_id));
+	NVME_ARGS(opts);
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	err = nvme_get_nsid(dev_fd(dev), &nsid);
+	if (err < 0) {
+		nvme_show_error("get namespace ID: %s", nvme_strerror(errno));
+		return -errno;
 	}
 
-	if (feat_num == 1 && nvme_status_equals(status, type, NVME_SC_INVALID_FIELD))
-		nvme_show_status(err);
+	printf("%s: namespace-id:%d\n", dev->name, nsid);
 
-	return err;
+	return 0;
 }
 
-static int get_feature(int argc, char **argv, struct command *cmd,
-		       struct plugin *plugin)
+static int virtual_mgmt(int argc, char **argv, struct command *cmd, struct plugin *plugin)
 {
-	const char *desc = "Read operating parameters of the "
-		"specified controller. Operating parameters are grouped "
-		"and identified by Feature Identifiers; each Feature "
-		"Identifier contains one or more attributes that may affect "
-		"behavior of the feature. Each Feature has three possible "
-		"settings: default, saveable, and current. If a Feature is "
-		"saveable, it may be modified by set-feature. Default values "
-		"are vendor-specific and not changeable. Use set-feature to "
-		"change saveable Features.";
-	const char *raw = "show feature in binary format";
-	const char *feature_id = "feature identifier";
-	const char *sel = "[0-3]: current/default/saved/supported";
-	const char *cdw11 = "feature specific dword 11";
-	const char *human_readable = "show feature in readable format";
-	const char *changed = "show feature changed";
+	const char *desc = "The Virtualization Management command is supported by primary controllers "
+		"that support the Virtualization Enhancements capability. This command is used for:\n"
+		"  1. Modifying Flexible Resource allocation for the primary controller\n"
+		"  2. Assigning Flexible Resources for secondary controllers\n"
+		"  3. Setting the Online and Offline state for secondary controllers";
+	const char *cntlid = "Controller Identifier(CNTLID)";
+	const char *rt = "Resource Type(RT): [0,1]\n"
+		"0h: VQ Resources\n"
+		"1h: VI Resources";
+	const char *act = "Action(ACT): [1,7,8,9]\n"
+		"1h: Primary Flexible\n"
+		"7h: Secondary Offline\n"
+		"8h: Secondary Assign\n"
+		"9h: Secondary Online";
+	const char *nr = "Number of Controller Resources(NR)";
 
 	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	__u32 result;
 	int err;
 
-	struct feat_cfg cfg = {
-		.feature_id	= 0,
-		.namespace_id	= 0,
-		.sel		= NVME_GET_FEATURES_SEL_CURRENT,
-		.data_len	= 0,
-		.raw_binary	= false,
-		.cdw11		= 0,
-		.uuid_index	= 0,
-		.human_readable	= false,
+	struct config {
+		__u16	cntlid;
+		__u8	rt;
+		__u8	act;
+		__u16	nr;
+	};
+
+	struct config cfg = {
+		.cntlid	= 0,
+		.rt	= 0,
+		.act	= 0,
+		.nr	= 0,
 	};
 
 	NVME_ARGS(opts,
-		  OPT_BYTE("feature-id",     'f', &cfg.feature_id,     feature_id),
-		  OPT_UINT("namespace-id",   'n', &cfg.namespace_id,   namespace_id_desired),
-		  OPT_BYTE("sel",            's', &cfg.sel,            sel),
-		  OPT_UINT("data-len",       'l', &cfg.data_len,       buf_len),
-		  OPT_FLAG("raw-binary",     'b', &cfg.raw_binary,     raw),
-		  OPT_UINT("cdw11",          'c', &cfg.cdw11,          cdw11),
-		  OPT_BYTE("uuid-index",     'U', &cfg.uuid_index,     uuid_index_specify),
-		  OPT_FLAG("human-readable", 'H', &cfg.human_readable, human_readable),
-		  OPT_FLAG("changed",        'C', &cfg.changed,        changed));
+		  OPT_UINT("cntlid", 'c', &cfg.cntlid, cntlid),
+		  OPT_BYTE("rt",     'r', &cfg.rt,     rt),
+		  OPT_BYTE("act",    'a', &cfg.act,    act),
+		  OPT_SHRT("nr",     'n', &cfg.nr,     nr));
 
 	err = parse_and_open(&dev, argc, argv, desc, opts);
 	if (err)
 		return err;
 
-	if (!argconfig_parse_seen(opts, "namespace-id")) {
-		err = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
-		if (err < 0) {
-			if (errno != ENOTTY) {
-				nvme_show_error("get-namespace-id: %s", nvme_strerror(errno));
-				return err;
-			}
-			cfg.namespace_id = NVME_NSID_ALL;
-		}
-	}
+	struct nvme_virtual_mgmt_args args = {
+		.args_size	= sizeof(args),
+		.fd		= dev_fd(dev),
+		.act		= cfg.act,
+		.rt		= cfg.rt,
+		.cntlid		= cfg.cntlid,
+		.nr		= cfg.nr,
+		.timeout	= nvme_cfg.timeout,
+		.result		= &result,
+	};
+	err = nvme_virtual_mgmt(&args);
+	if (!err)
+		printf("success, Number of Controller Resources Modified (NRM):%#x\n", result);
+	else if (err > 0)
+		nvme_show_status(err);
+	else
+		nvme_show_error("virt-mgmt: %s", nvme_strerror(errno));
 
-	if (cfg.sel > NVME_GET_FEATURES_SEL_SUPPORTED) {
-		nvme_show_error("invalid 'select' param:%d", cfg.sel);
-		return -EINVAL;
-	}
+	return err;
+}
 
-	if (cfg.uuid_index > 127) {
-		nvme_show_error("invalid uuid index param: %u", cfg.uuid_index);
-		return -1;
+static int primary_ctrl_caps(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *cntlid = "Controller ID";
+	const char *desc = "Send an Identify Primary Controller Capabilities "
+		"command to the given device and report the information in a "
+		"decoded format (default), json or binary.";
+
+	_cleanup_free_ struct nvme_primary_ctrl_cap *caps = NULL;
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	nvme_print_flags_t flags;
+	int err;
+
+	struct config {
+		__u16	cntlid;
+		bool	human_readable;
+	};
+
+	struct config cfg = {
+		.cntlid		= 0,
+		.human_readable	= false,
+	};
+
+	NVME_ARGS(opts,
+		  OPT_UINT("cntlid",         'c', &cfg.cntlid, cntlid),
+		  OPT_FLAG("human-readable", 'H', &cfg.human_readable, human_readable_info));
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	err = validate_output_format(nvme_cfg.output_format, &flags);
+	if (err < 0) {
+		nvme_show_error("Invalid output format");
+		return err;
 	}
 
-	nvme_show_init();
+	if (cfg.human_readable || argconfig_parse_seen(opts, "verbose"))
+		flags |= VERBOSE;
 
-	err = get_feature_ids(dev, cfg);
+	caps = nvme_alloc(sizeof(*caps));
+	if (!caps)
+		return -ENOMEM;
 
-	nvme_show_finish();
+	err = nvme_cli_identify_primary_ctrl(dev, cfg.cntlid, caps);
+	if (!err)
+		nvme_show_primary_ctrl_cap(caps, flags);
+	else if (err > 0)
+		nvme_show_status(err);
+	else
+		nvme_show_error("identify primary controller capabilities: %s",
+				nvme_strerror(errno));
 
 	return err;
 }
 
-/*
- * Transfers one chunk of firmware to the device, and decodes & reports any
- * errors. Returns -1 on (fatal) error; signifying that the transfer should
- * be aborted.
- */
-static int fw_download_single(struct nvme_dev *dev, void *fw_buf,
-			      unsigned int fw_len, uint32_t offset,
-			      uint32_t len, bool progress, bool ignore_ovr)
+static int list_secondary_ctrl(int argc, char **argv, struct command *cmd, struct plugin *plugin)
 {
-	const unsigned int max_retries = 3;
-	bool retryable, ovr;
-	int err, try;
+	const char *desc =
+	    "Show secondary controller list associated with the primary controller of the given device.";
+	const char *controller = "lowest controller identifier to display";
+	const char *num_entries = "number of entries to retrieve";
 
-	if (progress) {
-		printf("Firmware download: transferring 0x%08x/0x%08x bytes: %03d%%\r",
-		       offset, fw_len, (int)(100 * offset / fw_len));
-	}
+	_cleanup_free_ struct nvme_secondary_ctrl_list *sc_list = NULL;
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	nvme_print_flags_t flags;
+	int err;
 
-	struct nvme_fw_download_args args = {
-		.args_size	= sizeof(args),
-		.offset		= offset,
-		.data_len	= len,
-		.data		= fw_buf,
-		.timeout	= nvme_cfg.timeout,
-		.result		= NULL,
+	struct config {
+		__u16	cntid;
+		__u32	num_entries;
 	};
 
-	for (try = 0; try < max_retries; try++) {
-		if (try > 0) {
-			fprintf(stderr, "retrying offset %x (%u/%u)\n",
-				offset, try, max_retries);
-		}
+	struct config cfg = {
+		.cntid		= 0,
+		.num_entries	= ARRAY_SIZE(sc_list->sc_entry),
+	};
 
-		err = nvme_cli_fw_download(dev, &args);
-		if (!err)
-			return 0;
+	NVME_ARGS(opts,
+		  OPT_SHRT("cntid",        'c', &cfg.cntid,         controller),
+		  OPT_UINT("num-entries",  'e', &cfg.num_entries,   num_entries));
 
-		/*
-		 * don't retry if the NVMe-type error indicates Do Not Resend.
-		 */
-		retryable = !((err > 0) &&
-			(nvme_status_get_type(err) == NVME_STATUS_TYPE_NVME) &&
-			(nvme_status_get_value(err) & NVME_SC_DNR));
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
 
-		/*
-		 * detect overwrite errors, which are handled differently
-		 * depending on ignore_ovr
-		 */
-		ovr = (err > 0) &&
-			(nvme_status_get_type(err) == NVME_STATUS_TYPE_NVME) &&
-			(NVME_GET(err, SCT) == NVME_SCT_CMD_SPECIFIC) &&
-			(NVME_GET(err, SC) == NVME_SC_OVERLAPPING_RANGE);
+	err = validate_output_format(nvme_cfg.output_format, &flags);
+	if (err < 0) {
+		nvme_show_error("Invalid output format");
+		return err;
+	}
 
-		if (ovr && ignore_ovr)
-			return 0;
+	if (!cfg.num_entries) {
+		nvme_show_error("non-zero num-entries is required param");
+		return -EINVAL;
+	}
 
-		/*
-		 * if we're printing progress, we'll need a newline to separate
-		 * error output from the progress data (which doesn't have a
-		 * \n), and flush before we write to stderr.
-		 */
-		if (progress) {
-			printf("\n");
-			fflush(stdout);
-		}
+	sc_list = nvme_alloc(sizeof(*sc_list));
+	if (!sc_list)
+		return -ENOMEM;
 
-		fprintf(stderr, "fw-download: error on offset 0x%08x/0x%08x\n",
-			offset, fw_len);
+	err = nvme_cli_identify_secondary_ctrl_list(dev, cfg.cntid, sc_list);
+	if (!err)
+		nvme_show_list_secondary_ctrl(sc_list, cfg.num_entries, flags);
+	else if (err > 0)
+		nvme_show_status(err);
+	else
+		nvme_show_error("id secondary controller list: %s", nvme_strerror(errno));
 
-		if (err < 0) {
-			fprintf(stderr, "fw-download: %s\n", nvme_strerror(errno));
-		} else {
-			nvme_show_status(err);
-			if (ovr) {
-				/*
-				 * non-ignored ovr error: print a little extra info
-				 * about recovering
-				 */
-				fprintf(stderr,
-					"Use --ignore-ovr to ignore overwrite errors\n");
+	return err;
+}
 
-				/*
-				 * We'll just be attempting more overwrites if
-				 * we retry. DNR will likely be set, but force
-				 * an exit anyway.
-				 */
-				retryable = false;
-			}
-		}
+#define SELF_TEST_SHORT_TIME	120	/* seconds, the limit for a short self-test */
+#define SELF_TEST_POLL_MAX	30
 
-		if (!retryable)
-			break;
-	}
+static void intr_self_test(int signum)
+{
+	printf("\nInterrupted device self-test operation by %s\n", strsignal(signum));
 
-	return -1;
+	errno = EINTR;
 }
 
-static int fw_download(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+static int sleep_self_test(unsigned int seconds)
 {
-	const char *desc = "Copy all or part of a firmware image to "
-		"a controller for future update. Optionally, specify how "
-		"many KiB of the firmware to transfer at once. The offset will "
-		"start at 0 and automatically adjust based on xfer size "
-		"unless fw is split across multiple files. May be submitted "
-		"while outstanding commands exist on the Admin and IO "
-		"Submission Queues. Activate downloaded firmware with "
-		"fw-activate, and then reset the device to apply the downloaded firmware.";
-	const char *fw = "firmware file (required)";
-	const char *xfer = "transfer chunksize limit";
-	const char *offset = "starting dword offset, default 0";
-	const char *progress = "display firmware transfer progress";
-	const char *ignore_ovr = "ignore overwrite errors";
+	errno = 0;
 
-	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	_cleanup_huge_ struct nvme_mem_huge mh = { 0, };
-	_cleanup_fd_ int fw_fd = -1;
-	unsigned int fw_size, pos;
-	int err;
-	struct stat sb;
-	void *fw_buf;
-	struct nvme_id_ctrl ctrl = { 0 };
+	sleep(seconds);
 
-	struct config {
-		char	*fw;
-		__u32	xfer;
-		__u32	offset;
-		bool	progress;
-		bool	ignore_ovr;
-	};
+	if (errno)
+		return -errno;
 
-	struct config cfg = {
-		.fw         = "",
-		.xfer       = 0,
-		.offset     = 0,
-		.progress   = false,
-		.ignore_ovr = false,
-	};
+	return 0;
+}
+
+static unsigned int self_test_duration(struct nvme_id_ctrl *ctrl, __u8 op)
+{
+	switch (op) {
+	case NVME_ST_CURR_OP_SHORT:
+		return SELF_TEST_SHORT_TIME;
+	case NVME_ST_CURR_OP_EXTENDED:
+		return le16_to_cpu(ctrl->edstt) * 60;
+	default:
+		return 0;
+	}
+}
+
+/*
+ * Seconds until the next self-test log read: a tenth of the remaining
+ * time, extrapolated from the progress seen since @p0 or taken from the
+ * expected @duration of the test before there is any.
+ */
+static unsigned int self_test_poll_interval(unsigned int elapsed, int p0, int p,
+					    unsigned int duration,
+					    __u32 *remaining)
+{
+	unsigned int left, interval;
+
+	if (p > p0 && elapsed)
+		left = elapsed * (100 - p) / (p - p0);
+	else
+		left = duration * (100 - p) / 100;
+
+	if (remaining)
+		*remaining = left;
+
+	interval = left / 10;
+	if (interval < 1)
+		interval = 1;
+	if (interval > SELF_TEST_POLL_MAX)
+		interval = SELF_TEST_POLL_MAX;
+
+	return interval;
+}
+
+static int wait_self_test(struct nvme_dev *dev)
+{
+	static const char spin[] = {'-', '\\', '|', '/' };
+	_cleanup_free_ struct nvme_self_test_log *log = NULL;
+	_cleanup_free_ struct nvme_id_ctrl *ctrl = NULL;
+	int err, i = 0, p = 0, p0 = -1, cnt = 0;
+	unsigned int secs = 0, t0 = 0, next = 1;
+	int wthr;
+	__u8 op;
+
+	signal(SIGINT, intr_self_test);
+
+	ctrl = nvme_alloc(sizeof(*ctrl));
+	if (!ctrl)
+		return -ENOMEM;
+
+	log = nvme_alloc(sizeof(*log));
+	if (!log)
+		return -ENOMEM;
+
+	err = nvme_cli_identify_ctrl(dev, ctrl);
+	if (err) {
+		nvme_show_error("identify-ctrl: %s", nvme_strerror(errno));
+		return err;
+	}
+
+	wthr = le16_to_cpu(ctrl->edstt) * 60 / 100 + 60;
+
+	printf("Waiting for self test completion...\n");
+	while (true) {
+		printf("\r[%.*s%c%.*s] %3d%%", p / 2, dash, spin[i++ % 4], 49 - p / 2, space, p);
+		fflush(stdout);
+		err = sleep_self_test(1);
+		if (err)
+			return err;
+
+		/* The log is only read when the adaptive interval has passed */
+		cnt++;
+		if (++secs < next)
+			continue;
+
+		err = nvme_cli_get_log_device_self_test(dev, log);
+		if (err) {
+			printf("\n");
+			if (err < 0)
+				perror("self test log\n");
+			else
+				nvme_show_status(err);
+			return err;
+		}
+
+		op = log->current_operation & NVME_ST_CURR_OP_MASK;
+		if (op == NVME_ST_CURR_OP_NOT_RUNNING) {
+			printf("\r[%.*s] %3d%%\n", 50, dash, 100);
+			break;
+		}
+
+		if (log->completion < p) {
+			printf("\n");
+				nvme_show_error("progress broken");
+				return -EIO;
+		} else if (log->completion != p) {
+			p = log->completion;
+			cnt = 0;
+		}
+
+		if (cnt > wthr) {
+			printf("\n");
+			nvme_show_error("no progress for %d seconds, stop waiting", wthr);
+			return -EIO;
+		}
+
+		if (p0 < 0) {
+			p0 = p;
+			t0 = secs;
+		}
+		next = secs + self_test_poll_interval(secs - t0, p0, p,
+						      self_test_duration(ctrl, op),
+						      NULL);
+	}
+
+	return 0;
+}
+
+static void abort_self_test(struct nvme_dev_self_test_args *args)
+{
+	int err;
+
+	args->stc = NVME_DST_STC_ABORT;
+
+	err = nvme_dev_self_test(args);
+	if (!err)
+		printf("Aborting device self-test operation\n");
+	else if (err > 0)
+		nvme_show_status(err);
+	else
+		nvme_show_error("Device self-test: %s", nvme_strerror(errno));
+}
+
+static int device_self_test(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Implementing the device self-test feature "
+		"which provides the necessary log to determine the state of the device";
+	const char *namespace_id =
+	    "Indicate the namespace in which the device self-test has to be carried out";
+	const char *self_test_code =
+		"This field specifies the action taken by the device self-test command :\n"
+		"0h Show current state of device self-test operation\n"
+		"1h Start a short device self-test operation\n"
+		"2h Start a extended device self-test operation\n"
+		"3h Start a Host-Initiated Refresh operation\n"
+		"eh Start a vendor specific device self-test operation\n"
+		"fh Abort the device self-test operation";
+	const char *wait = "Wait for the test to finish";
+
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	int err;
+
+	struct config {
+		__u32	namespace_id;
+		__u8	stc;
+		bool	wait;
+	};
+
+	struct config cfg = {
+		.namespace_id	= NVME_NSID_ALL,
+		.stc		= NVME_ST_CODE_RESERVED,
+		.wait		= false,
+	};
+
+	NVME_ARGS(opts,
+		  OPT_UINT("namespace-id",   'n', &cfg.namespace_id, namespace_id),
+		  OPT_BYTE("self-test-code", 's', &cfg.stc,          self_test_code),
+		  OPT_FLAG("wait",           'w', &cfg.wait,         wait));
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	if (cfg.stc == NVME_ST_CODE_RESERVED) {
+		_cleanup_free_ struct nvme_self_test_log *log = NULL;
+
+		log = nvme_alloc(sizeof(*log));
+		if (!log)
+			return -ENOMEM;
+
+		err = nvme_cli_get_log_device_self_test(dev, log);
+		if (err) {
+			printf("\n");
+			if (err < 0)
+				perror("self test log\n");
+			else
+				nvme_show_status(err);
+		}
+
+		if (log->completion == 0) {
+			printf("no self test running\n");
+		} else {
+			if (cfg.wait)
+				err = wait_self_test(dev);
+			else
+				printf("progress %d%%\n", log->completion);
+		}
+
+		goto check_abort;
+	}
+
+	struct nvme_dev_self_test_args args = {
+		.args_size	= sizeof(args),
+		.fd		= dev_fd(dev),
+		.nsid		= cfg.namespace_id,
+		.stc		= cfg.stc,
+		.timeout	= nvme_cfg.timeout,
+		.result		= NULL,
+	};
+	err = nvme_dev_self_test(&args);
+	if (!err) {
+		if (cfg.stc == NVME_ST_CODE_ABORT)
+			printf("Aborting device self-test operation\n");
+		else if (cfg.stc == NVME_ST_CODE_EXTENDED)
+			printf("Extended Device self-test started\n");
+		else if (cfg.stc == NVME_ST_CODE_SHORT)
+			printf("Short Device self-test started\n");
+		else if (cfg.stc == NVME_ST_CODE_HOST_INIT)
+			printf("Host-Initiated Refresh started\n");
+
+		if (cfg.wait && cfg.stc != NVME_ST_CODE_ABORT)
+			err = wait_self_test(dev);
+	} else if (err > 0) {
+		nvme_show_status(err);
+	} else {
+		nvme_show_error("Device self-test: %s", nvme_strerror(errno));
+	}
+
+check_abort:
+	if (err == -EINTR)
+		abort_self_test(&args);
+
+	return err;
+}
+
+static int self_test_log(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Retrieve the self-test log for the given device and given test "
+		"(or optionally a namespace) in either decoded format (default) or binary.";
+	const char *dst_entries = "Indicate how many DST log entries to be retrieved, "
+		"by default all the 20 entries will be retrieved";
+
+	_cleanup_free_ struct nvme_self_test_log *log = NULL;
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	nvme_print_flags_t flags;
+	int err;
+
+	struct config {
+		__u8	dst_entries;
+	};
+
+	struct config cfg = {
+		.dst_entries	= NVME_LOG_ST_MAX_RESULTS,
+	};
+
+	NVME_ARGS(opts,
+		  OPT_BYTE("dst-entries",  'e', &cfg.dst_entries,   dst_entries));
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	err = validate_output_format(nvme_cfg.output_format, &flags);
+	if (err < 0) {
+		nvme_show_error("Invalid output format");
+		return err;
+	}
+
+	if (argconfig_parse_seen(opts, "verbose"))
+		flags |= VERBOSE;
+
+	log = nvme_alloc(sizeof(*log));
+	if (!log)
+		return -ENOMEM;
+
+	err = nvme_cli_get_log_device_self_test(dev, log);
+	if (!err)
+		nvme_show_self_test_log(log, cfg.dst_entries, 0, dev->name, flags);
+	else if (err > 0)
+		nvme_show_status(err);
+	else
+		nvme_show_error("self test log: %s", nvme_strerror(errno));
+
+	return err;
+}
+
+static int get_feature_id(struct nvme_dev *dev, struct feat_cfg *cfg,
+			  void **buf, __u32 *result)
+{
+	if (!cfg->data_len)
+		nvme_get_feature_length(cfg->feature_id, cfg->cdw11,
+					&cfg->data_len);
+
+	/* check for Extended Host Identifier */
+	if (cfg->feature_id == NVME_FEAT_FID_HOST_ID && (cfg->cdw11 & 0x1))
+		cfg->data_len = 16;
+
+	if (cfg->feature_id == NVME_FEAT_FID_FDP_EVENTS) {
+		cfg->data_len = 0xff * sizeof(__u16);
+		cfg->cdw11 |= 0xff << 16;
+	}
+
+	if (NVME_CHECK(cfg->sel, GET_FEATURES_SEL, SUPPORTED))
+		cfg->data_len = 0;
+
+	if (cfg->data_len) {
+		*buf = nvme_alloc(cfg->data_len - 1);
+		if (!*buf)
+			return -1;
+	}
+
+	struct nvme_get_features_args args = {
+		.args_size	= sizeof(args),
+		.fid		= cfg->feature_id,
+		.nsid		= cfg->namespace_id,
+		.sel		= cfg->sel,
+		.cdw11		= cfg->cdw11,
+		.uuidx		= cfg->uuid_index,
+		.data_len	= cfg->data_len,
+		.data		= *buf,
+		.timeout	= nvme_cfg.timeout,
+		.result		= result,
+	};
+	return nvme_cli_get_features(dev, &args);
+}
+
+static int filter_out_flags(int status)
+{
+	return status & (NVME_VAL(SCT) | NVME_VAL(SC));
+}
+
+static void get_feature_id_print(struct feat_cfg cfg, int err, __u32 result, void *buf)
+{
+	int status = filter_out_flags(err);
+	enum nvme_status_type type = NVME_STATUS_TYPE_NVME;
+
+	if (!err) {
+		if (!cfg.raw_binary || !buf) {
+			nvme_feature_show(cfg.feature_id, cfg.sel, result);
+			if (NVME_CHECK(cfg.sel, GET_FEATURES_SEL, SUPPORTED))
+				nvme_show_select_result(cfg.feature_id, result);
+			else if (cfg.human_readable)
+				nvme_feature_show_fields(cfg.feature_id, result, buf);
+			else if (buf)
+				d(buf, cfg.data_len, 16, 1);
+		} else if (buf) {
+			d_raw(buf, cfg.data_len);
+		}
+	} else if (err > 0) {
+		if (!nvme_status_equals(status, type, NVME_SC_INVALID_FIELD) &&
+		    !nvme_status_equals(status, type, NVME_SC_INVALID_NS))
+			nvme_show_status(err);
+	} else {
+		nvme_show_error("get-feature: %s", nvme_strerror(errno));
+	}
+}
+
+static int get_feature_id_changed(struct nvme_dev *dev, struct feat_cfg cfg)
+{
+	int err;
+	int err_def = 0;
+	__u32 result;
+	__u32 result_def;
+	_cleanup_free_ void *buf = NULL;
+	_cleanup_free_ void *buf_def = NULL;
+
+	if (cfg.changed)
+		cfg.sel = NVME_GET_FEATURES_SEL_CURRENT;
+
+	err = get_feature_id(dev, &cfg, &buf, &result);
+
+	if (!err && cfg.changed) {
+		cfg.sel = NVME_GET_FEATURES_SEL_DEFAULT;
+		err_def = get_feature_id(dev, &cfg, &buf_def, &result_def);
+	}
+
+	if (err || !cfg.changed || err_def || result != result_def ||
+	    (buf && buf_def && !strcmp(buf, buf_def)))
+		get_feature_id_print(cfg, err, result, buf);
+
+	return err;
+}
+
+static int get_feature_ids(struct nvme_dev *dev, struct feat_cfg cfg)
+{
+	int err = 0;
+	int i;
+	int feat_max = 0x100;
+	int feat_num = 0;
+	int status = 0;
+	enum nvme_status_type type = NVME_STATUS_TYPE_NVME;
+
+	if (cfg.feature_id)
+		feat_max = cfg.feature_id + 1;
+
+	for (i = cfg.feature_id; i < feat_max; i++, feat_num++) {
+		cfg.feature_id = i;
+		err = get_feature_id_changed(dev, cfg);
+		if (!err)
+			continue;
+		status = filter_out_flags(err);
+		if (nvme_status_equals(status, type, NVME_SC_INVALID_FIELD))
+			continue;
+		if (!nvme_status_equals(status, type, NVME_SC_INVALID_NS))
+			break;
+		nvme_show_error_status(err, "get-feature:%#0*x (%s)", cfg.feature_id ? 4 : 2,
+				       cfg.feature_id, nvme_feature_to_string(cfg.feature_id));
+	}
+
+	if (feat_num == 1 && nvme_status_equals(status, type, NVME_SC_INVALID_FIELD))
+		nvme_show_status(err);
+
+	return err;
+}
+
+static int get_feature(int argc, char **argv, struct command *cmd,
+		       struct plugin *plugin)
+{
+	const char *desc = "Read operating parameters of the "
+		"specified controller. Operating parameters are grouped "
+		"and identified by Feature Identifiers; each Feature "
+		"Identifier contains one or more attributes that may affect "
+		"behavior of the feature. Each Feature has three possible "
+		"settings: default, saveable, and current. If a Feature is "
+		"saveable, it may be modified by set-feature. Default values "
+		"are vendor-specific and not changeable. Use set-feature to "
+		"change saveable Features.";
+	const char *raw = "show feature in binary format";
+	const char *feature_id = "feature identifier";
+	const char *sel = "[0-3]: current/default/saved/supported";
+	const char *cdw11 = "feature specific dword 11";
+	const char *human_readable = "show feature in readable format";
+	const char *changed = "show feature changed";
+
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	int err;
+
+	struct feat_cfg cfg = {
+		.feature_id	= 0,
+		.namespace_id	= 0,
+		.sel		= NVME_GET_FEATURES_SEL_CURRENT,
+		.data_len	= 0,
+		.raw_binary	= false,
+		.cdw11		= 0,
+		.uuid_index	= 0,
+		.human_readable	= false,
+	};
+
+	NVME_ARGS(opts,
+		  OPT_BYTE("feature-id",     'f', &cfg.feature_id,     feature_id),
+		  OPT_UINT("namespace-id",   'n', &cfg.namespace_id,   namespace_id_desired),
+		  OPT_BYTE("sel",            's', &cfg.sel,            sel),
+		  OPT_UINT("data-len",       'l', &cfg.data_len,       buf_len),
+		  OPT_FLAG("raw-binary",     'b', &cfg.raw_binary,     raw),
+		  OPT_UINT("cdw11",          'c', &cfg.cdw11,          cdw11),
+		  OPT_BYTE("uuid-index",     'U', &cfg.uuid_index,     uuid_index_specify),
+		  OPT_FLAG("human-readable", 'H', &cfg.human_readable, human_readable),
+		  OPT_FLAG("changed",        'C', &cfg.changed,        changed));
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	if (!argconfig_parse_seen(opts, "namespace-id")) {
+		err = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
+		if (err < 0) {
+			if (errno != ENOTTY) {
+				nvme_show_error("get-namespace-id: %s", nvme_strerror(errno));
+				return err;
+			}
+			cfg.namespace_id = NVME_NSID_ALL;
+		}
+	}
+
+	if (cfg.sel > NVME_GET_FEATURES_SEL_SUPPORTED) {
+		nvme_show_error("invalid 'select' param:%d", cfg.sel);
+		return -EINVAL;
+	}
+
+	if (cfg.uuid_index > 127) {
+		nvme_show_error("invalid uuid index param: %u", cfg.uuid_index);
+		return -1;
+	}
+
+	nvme_show_init();
+
+	err = get_feature_ids(dev, cfg);
+
+	nvme_show_finish();
+
+	return err;
+}
+
+/*
+ * Transfers one chunk of firmware to the device, and decodes & reports any
+ * errors. Returns the error of the last attempt on (fatal) error; signifying
+ * that the transfer should be aborted.
+ */
+static int fw_download_single(struct nvme_dev *dev, void *fw_buf,
+			      unsigned int fw_len, uint32_t offset,
+			      uint32_t len, bool progress, bool ignore_ovr)
+{
+	const unsigned int max_retries = 3;
+	bool retryable, ovr;
+	int err, try;
+
+	struct nvme_fw_download_args args = {
+		.args_size	= sizeof(args),
+		.offset		= offset,
+		.data_len	= len,
+		.data		= fw_buf,
+		.timeout	= nvme_cfg.timeout,
+		.result		= NULL,
+	};
+
+	for (try = 0; try < max_retries; try++) {
+		if (try > 0) {
+			fprintf(stderr, "retrying offset %x (%u/%u)\n",
+				offset, try, max_retries);
+		}
+
+		err = nvme_cli_fw_download(dev, &args);
+		if (!err)
+			return 0;
+
+		/*
+		 * don't retry if the NVMe-type error indicates Do Not Resend.
+		 */
+		retryable = !((err > 0) &&
+			(nvme_status_get_type(err) == NVME_STATUS_TYPE_NVME) &&
+			(nvme_status_get_value(err) & NVME_SC_DNR));
+
+		/*
+		 * detect overwrite errors, which are handled differently
+		 * depending on ignore_ovr
+		 */
+		ovr = (err > 0) &&
+			(nvme_status_get_type(err) == NVME_STATUS_TYPE_NVME) &&
+			(NVME_GET(err, SCT) == NVME_SCT_CMD_SPECIFIC) &&
+			(NVME_GET(err, SC) == NVME_SC_OVERLAPPING_RANGE);
+
+		if (ovr && ignore_ovr)
+			return 0;
+
+		/*
+		 * if we're printing progress, we'll need a newline to separate
+		 * error output from the progress data (which doesn't have a
+		 * \n), and flush before we write to stderr.
+		 */
+		if (progress) {
+			printf("\n");
+			fflush(stdout);
+		}
+
+		fprintf(stderr, "fw-download: error on offset 0x%08x/0x%08x\n",
+			offset, fw_len);
+
+		if (err < 0) {
+			fprintf(stderr, "fw-download: %s\n", nvme_strerror(errno));
+		} else {
+			nvme_show_status(err);
+			if (ovr) {
+				/*
+				 * non-ignored ovr error: print a little extra info
+				 * about recovering
+				 */
+				fprintf(stderr,
+					"Use --ignore-ovr to ignore overwrite errors\n");
+
+				/*
+				 * We'll just be attempting more overwrites if
+				 * we retry. DNR will likely be set, but force
+				 * an exit anyway.
+				 */
+				retryable = false;
+			}
+		}
+
+		if (!retryable)
+			break;
+	}
+
+	return err;
+}
+
+/*
+ * Chunks are sent from the page cache of the mmap'd image, the default
+ * transfer size is capped so that a chunk of discontiguous pages stays
+ * within the segment limit of the driver.
+ */
+#define FW_DOWNLOAD_MAX_XFER	(256 * 1024)
+
+/*
+ * A mmap'd image is not a snapshot, the file can still change underneath
+ * while a chunk is in flight. Each chunk is checked against the CRC taken
+ * before the download and resent if it changed.
+ */
+#define FW_DOWNLOAD_MAX_RESEND	3
+
+struct fw_download_ctx {
+	struct nvme_dev *dev;
+	void *buf;
+	unsigned int size;
+	unsigned int resume;
+	__u32 offset;
+	__u32 xfer;
+	bool progress;
+	bool ignore_ovr;
+	uint32_t *crc;
+	bool *sent;
+	uint64_t start_us;
+	unsigned int done;
+	int err;
+};
+
+static uint64_t fw_download_now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/*
+ * Largest chunk the controller accepts: MDTS (in units of the minimum
+ * memory page size, assumed to be 4 KiB) rounded down to the firmware
+ * update granularity if the controller reports one.
+ */
+static __u32 fw_download_xfer(struct nvme_id_ctrl *ctrl)
+{
+	__u32 xfer = FW_DOWNLOAD_MAX_XFER;
+	__u32 fwug;
+
+	if (ctrl->mdts && ctrl->mdts < 20)
+		xfer = min(xfer, (__u32)4096 << ctrl->mdts);
+
+	if (ctrl->fwug == 0 || ctrl->fwug == 0xff)
+		return xfer;
+
+	fwug = ctrl->fwug * 4096;
+	if (xfer < fwug)
+		return fwug;
+
+	return xfer - xfer % fwug;
+}
+
+static void fw_download_progress(struct fw_download_ctx *ctx, unsigned int done)
+{
+	uint64_t elapsed = fw_download_now_us() - ctx->start_us;
+	/* bytes per microsecond are MB/s */
+	double mbps = elapsed ? (double)done / elapsed : 0;
+	unsigned int eta = mbps > 0 ? (ctx->size - done) / mbps / 1000000 : 0;
+
+	printf("Firmware download: transferring 0x%08x/0x%08x bytes: %03d%% %8.2f MB/s ETA %us \r",
+	       done, ctx->size, (int)(100ULL * done / ctx->size), mbps, eta);
+	fflush(stdout);
+}
+
+static void fw_download_chunk(unsigned int idx, void *arg)
+{
+	struct fw_download_ctx *ctx = arg;
+	unsigned int pos = ctx->resume + idx * ctx->xfer;
+	__u32 len = min(ctx->xfer, ctx->size - pos);
+	unsigned char *data = ctx->buf + pos;
+	unsigned int done;
+	int err, try;
+
+	for (try = 0; try <= FW_DOWNLOAD_MAX_RESEND; try++) {
+		/* Chunks not yet started are skipped once one has failed */
+		if (__atomic_load_n(&ctx->err, __ATOMIC_RELAXED))
+			return;
+
+		err = fw_download_single(ctx->dev, data, ctx->size,
+					 ctx->offset + pos, len, ctx->progress,
+					 ctx->ignore_ovr);
+		if (err) {
+			__atomic_store_n(&ctx->err, err, __ATOMIC_RELAXED);
+			return;
+		}
+
+		if (crc32(0, data, len) == ctx->crc[idx])
+			break;
+
+		fprintf(stderr, "fw-download: image changed at offset 0x%08x, resending (%d/%d)\n",
+			pos, try + 1, FW_DOWNLOAD_MAX_RESEND);
+	}
+
+	if (try > FW_DOWNLOAD_MAX_RESEND) {
+		__atomic_store_n(&ctx->err, -EIO, __ATOMIC_RELAXED);
+		return;
+	}
+
+	ctx->sent[idx] = true;
+	done = __atomic_add_fetch(&ctx->done, len, __ATOMIC_RELAXED);
+	if (ctx->progress)
+		fw_download_progress(ctx, done);
+}
+
+static int fw_download(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Copy all or part of a firmware image to "
+		"a controller for future update. Optionally, specify how "
+		"many KiB of the firmware to transfer at once. The offset will "
+		"start at 0 and automatically adjust based on xfer size "
+		"unless fw is split across multiple files. May be submitted "
+		"while outstanding commands exist on the Admin and IO "
+		"Submission Queues. Activate downloaded firmware with "
+		"fw-activate, and then reset the device to apply the downloaded firmware.";
+	const char *fw = "firmware file (required)";
+	const char *xfer = "transfer chunksize limit";
+	const char *offset = "starting dword offset, default 0";
+	const char *progress = "display firmware transfer progress";
+	const char *ignore_ovr = "ignore overwrite errors";
+	const char *fw_jobs = "maximum number of chunks in flight";
+	const char *resume = "byte offset into the image to resume an interrupted download from";
+	const char *fw_crc = "expected CRC32 of the firmware image";
+
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	_cleanup_huge_ struct nvme_mem_huge mh = { 0, };
+	_cleanup_free_ uint32_t *chunk_crc = NULL;
+	_cleanup_free_ bool *chunk_sent = NULL;
+	_cleanup_fd_ int fw_fd = -1;
+	struct fw_download_ctx ctx = { 0 };
+	unsigned int fw_size, nr_chunks, i;
+	uint32_t image_crc = 0;
+	bool mapped = true;
+	int err;
+	struct stat sb;
+	void *fw_buf;
+	struct nvme_id_ctrl ctrl = { 0 };
+
+	struct config {
+		char	*fw;
+		__u32	xfer;
+		__u32	offset;
+		bool	progress;
+		bool	ignore_ovr;
+		__u32	jobs;
+		__u32	resume;
+		__u32	crc;
+	};
+
+	struct config cfg = {
+		.fw         = "",
+		.xfer       = 0,
+		.offset     = 0,
+		.progress   = false,
+		.ignore_ovr = false,
+		.jobs       = 1,
+		.resume     = 0,
+		.crc        = 0,
+	};
+
+	NVME_ARGS(opts,
+		  OPT_FILE("fw",         'f', &cfg.fw,         fw),
+		  OPT_UINT("xfer",       'x', &cfg.xfer,       xfer),
+		  OPT_UINT("offset",     'O', &cfg.offset,     offset),
+		  OPT_FLAG("progress",   'p', &cfg.progress,   progress),
+		  OPT_FLAG("ignore-ovr", 'i', &cfg.ignore_ovr, ignore_ovr),
+		  OPT_UINT("jobs",       'j', &cfg.jobs,       fw_jobs),
+		  OPT_UINT("resume",     'R', &cfg.resume,     resume),
+		  OPT_UINT("crc",        'C', &cfg.crc,        fw_crc));
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	fw_fd = open(cfg.fw, O_RDONLY);
+	cfg.offset <<= 2;
+	if (fw_fd < 0) {
+		nvme_show_error("Failed to open firmware file %s: %s", cfg.fw, strerror(errno));
+		return -EINVAL;
+	}
+
+	err = fstat(fw_fd, &sb);
+	if (err < 0) {
+		nvme_show_perror("fstat");
+		return err;
+	}
+
+	fw_size = sb.st_size;
+	if ((fw_size & 0x3) || (fw_size == 0)) {
+		nvme_show_error("Invalid size:%d for f/w image", fw_size);
+		return -EINVAL;
+	}
+
+	if ((cfg.resume & 0x3) || cfg.resume >= fw_size) {
+		nvme_show_error("Invalid resume offset 0x%x for f/w image of %u bytes",
+				cfg.resume, fw_size);
+		return -EINVAL;
+	}
+
+	if (cfg.xfer == 0) {
+		err = nvme_cli_identify_ctrl(dev, &ctrl);
+		if (err) {
+			nvme_show_error("identify-ctrl: %s", nvme_strerror(errno));
+			return err;
+		}
+		cfg.xfer = fw_download_xfer(&ctrl);
+	} else if (cfg.xfer % 4096)
+		cfg.xfer = 4096;
+
+	if (ctrl.fwug && ctrl.fwug != 0xff && fw_size % (ctrl.fwug * 4096))
+		nvme_show_error("WARNING: firmware file size %u not conform to FWUG alignment %u",
+				fw_size, ctrl.fwug * 4096);
+
+	fw_buf = mmap(NULL, fw_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE,
+		      fw_fd, 0);
+	if (fw_buf == MAP_FAILED) {
+		mapped = false;
+		fw_buf = nvme_alloc_huge(fw_size, &mh);
+		if (!fw_buf)
+			return -ENOMEM;
+
+		if (read(fw_fd, fw_buf, fw_size) != ((ssize_t)(fw_size))) {
+			err = -errno;
+			nvme_show_error("read :%s :%s", cfg.fw, strerror(errno));
+			return err;
+		}
+	}
+
+	/* The MI transport serializes commands on the endpoint */
+	if (dev->type != NVME_DEV_DIRECT || !cfg.jobs)
+		cfg.jobs = 1;
+
+	nr_chunks = (fw_size - cfg.resume + cfg.xfer - 1) / cfg.xfer;
+	chunk_crc = calloc(nr_chunks, sizeof(*chunk_crc));
+	chunk_sent = calloc(nr_chunks, sizeof(*chunk_sent));
+	if (!chunk_crc || !chunk_sent) {
+		err = -ENOMEM;
+		goto unmap;
+	}
+
+	/*
+	 * The image CRC covers the whole file, so that a resumed download
+	 * can be checked against the CRC reported by the interrupted one.
+	 */
+	image_crc = crc32(0, fw_buf, cfg.resume);
+	for (i = 0; i < nr_chunks; i++) {
+		unsigned int pos = cfg.resume + i * cfg.xfer;
+		__u32 len = min(cfg.xfer, fw_size - pos);
+
+		chunk_crc[i] = crc32(0, fw_buf + pos, len);
+		image_crc = crc32(image_crc, fw_buf + pos, len);
+	}
+
+	if (argconfig_parse_seen(opts, "crc") && image_crc != cfg.crc) {
+		nvme_show_error("firmware image CRC32 0x%08x does not match expected 0x%08x",
+				image_crc, cfg.crc);
+		err = -EINVAL;
+		goto unmap;
+	}
+
+	ctx.dev = dev;
+	ctx.buf = fw_buf;
+	ctx.size = fw_size;
+	ctx.resume = cfg.resume;
+	ctx.offset = cfg.offset;
+	ctx.xfer = cfg.xfer;
+	ctx.progress = cfg.progress;
+	ctx.ignore_ovr = cfg.ignore_ovr;
+	ctx.crc = chunk_crc;
+	ctx.sent = chunk_sent;
+	ctx.done = cfg.resume;
+	ctx.start_us = fw_download_now_us();
+
+	parallel_for_each(nr_chunks, cfg.jobs, fw_download_chunk, &ctx);
+	err = ctx.err;
+
+	if (err) {
+		/* Everything below the first chunk not sent is on the device */
+		for (i = 0; i < nr_chunks && chunk_sent[i]; i++)
+			;
+		if (cfg.progress)
+			printf("\n");
+		fprintf(stderr,
+			"fw-download: resume with --offset=0x%x --resume=0x%x --crc=0x%08x\n",
+			cfg.offset >> 2, cfg.resume + i * cfg.xfer, image_crc);
+	} else {
+		/* end the progress output */
+		if (cfg.progress) {
+			uint64_t elapsed = fw_download_now_us() - ctx.start_us;
+
+			printf("\n");
+			printf("Firmware download: %u bytes in %u chunks of %u bytes, %.2f s, %.2f MB/s\n",
+			       fw_size - cfg.resume, nr_chunks, cfg.xfer,
+			       elapsed / 1000000.0,
+			       elapsed ? (double)(fw_size - cfg.resume) / elapsed : 0);
+		}
+		printf("Firmware download success, image CRC32 0x%08x\n", image_crc);
+	}
+
+unmap:
+	if (mapped)
+		munmap(fw_buf, fw_size);
+
+	return err;
+}
+
+static char *nvme_fw_status_reset_type(__u16 status)
+{
+	switch (status & 0x7ff) {
+	case NVME_SC_FW_NEEDS_CONV_RESET:
+		return "conventional";
+	case NVME_SC_FW_NEEDS_SUBSYS_RESET:
+		return "subsystem";
+	case NVME_SC_FW_NEEDS_RESET:
+		return "any controller";
+	default:
+		return "unknown";
+	}
+}
+
+static bool fw_commit_support_mud(struct nvme_dev *dev)
+{
+	_cleanup_free_ struct nvme_id_ctrl *ctrl = NULL;
+	int err;
+
+	ctrl = nvme_alloc(sizeof(*ctrl));
+	if (!ctrl)
+		return false;
+
+	err = nvme_cli_identify_ctrl(dev, ctrl);
+
+	if (err)
+		nvme_show_error("identify-ctrl: %s", nvme_strerror(errno));
+	else if (ctrl->frmw >> 5 & 0x1)
+		return true;
+
+	return false;
+}
+
+static void fw_commit_print_mud(struct nvme_dev *dev, __u32 result)
+{
+	if (!fw_commit_support_mud(dev))
+		return;
+
+	printf("Multiple Update Detected (MUD) Value: %u\n", result);
+
+	if (result & 0x1)
+		printf("Detected an overlapping firmware/boot partition image update command\n"
+		       "sequence due to processing a command from an Admin SQ on a controller\n");
+
+	if (result >> 1 & 0x1)
+		printf("Detected an overlapping firmware/boot partition image update command\n"
+		       "sequence due to processing a command from a Management Endpoint\n");
+}
+
+static int fw_commit(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Verify downloaded firmware image and "
+		"commit to specific firmware slot. Device is not automatically "
+		"reset following firmware activation. A reset may be issued "
+		"with an 'echo 1 > /sys/class/nvme/nvmeX/reset_controller'. "
+		"Ensure nvmeX is the device you just activated before reset.";
+	const char *slot = "[0-7]: firmware slot for commit action";
+	const char *action = "[0-7]: commit action";
+	const char *bpid = "[0,1]: boot partition identifier, if applicable (default: 0)";
+
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	__u32 result;
+	int err;
+
+	struct config {
+		__u8	slot;
+		__u8	action;
+		__u8	bpid;
+	};
+
+	struct config cfg = {
+		.slot	= 0,
+		.action	= 0,
+		.bpid	= 0,
+	};
+
+	NVME_ARGS(opts,
+		  OPT_BYTE("slot",   's', &cfg.slot,   slot),
+		  OPT_BYTE("action", 'a', &cfg.action, action),
+		  OPT_BYTE("bpid",   'b', &cfg.bpid,   bpid));
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	if (cfg.slot > 7) {
+		nvme_show_error("invalid slot:%d", cfg.slot);
+		return -EINVAL;
+	}
+	if (cfg.action > 7 || cfg.action == 4 || cfg.action == 5) {
+		nvme_show_error("invalid action:%d", cfg.action);
+		return -EINVAL;
+	}
+	if (cfg.bpid > 1) {
+		nvme_show_error("invalid boot partition id:%d", cfg.bpid);
+		return -EINVAL;
+	}
+
+	struct nvme_fw_commit_args args = {
+		.args_size	= sizeof(args),
+		.slot		= cfg.slot,
+		.action		= cfg.action,
+		.bpid		= cfg.bpid,
+		.timeout	= nvme_cfg.timeout,
+		.result		= &result,
+	};
+	err = nvme_cli_fw_commit(dev, &args);
+
+	if (err < 0) {
+		nvme_show_error("fw-commit: %s", nvme_strerror(errno));
+	} else if (err != 0) {
+		__u32 val = nvme_status_get_value(err);
+		int type = nvme_status_get_type(err);
+
+		if (type == NVME_STATUS_TYPE_NVME) {
+			switch (val & 0x7ff) {
+			case NVME_SC_FW_NEEDS_CONV_RESET:
+			case NVME_SC_FW_NEEDS_SUBSYS_RESET:
+			case NVME_SC_FW_NEEDS_RESET:
+				printf("Success activating firmware action:%d slot:%d",
+				       cfg.action, cfg.slot);
+				if (cfg.action == 6 || cfg.action == 7)
+					printf(" bpid:%d", cfg.bpid);
+				printf(", but firmware requires %s reset\n",
+				       nvme_fw_status_reset_type(val));
+				break;
+			default:
+				nvme_show_status(err);
+				break;
+			}
+		} else {
+			nvme_show_status(err);
+		}
+	} else {
+		printf("Success committing firmware action:%d slot:%d",
+		       cfg.action, cfg.slot);
+		if (cfg.action == 6 || cfg.action == 7)
+			printf(" bpid:%d", cfg.bpid);
+		printf("\n");
+		fw_commit_print_mud(dev, result);
+	}
+
+	return err;
+}
+
+static bool ctrl_select_match(const char *pattern, const char *s)
+{
+	return !pattern || (s && !fnmatch(pattern, s, 0));
+}
+
+static bool ctrl_select_listed(const char *devices, const char *name)
+{
+	_cleanup_free_ char *list = NULL;
+	char *p, *l;
+
+	if (!devices)
+		return true;
+
+	list = l = strdup(devices);
+	if (!list)
+		return false;
+
+	while ((p = strsep(&l, ",")) != NULL) {
+		if (!strncmp(p, "/dev/", 5))
+			p += 5;
+		if (!strcmp(p, name))
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * Calls @add for the first controller of each subsystem matching the
+ * comma separated @devices list and the @model and @fw_rev globs.
+ */
+static int ctrl_select(nvme_root_t root, const char *devices,
+		       const char *model, const char *fw_rev,
+		       int (*add)(nvme_ctrl_t c, void *arg), void *arg)
+{
+	nvme_host_t h;
+	nvme_subsystem_t s;
+	nvme_ctrl_t c;
+	int err;
+
+	nvme_for_each_host(root, h) {
+		nvme_for_each_subsystem(h, s) {
+			nvme_subsystem_for_each_ctrl(s, c) {
+				if (!nvme_ctrl_get_name(c) ||
+				    !ctrl_select_listed(devices, nvme_ctrl_get_name(c)) ||
+				    !ctrl_select_match(model, nvme_ctrl_get_model(c)) ||
+				    !ctrl_select_match(fw_rev, nvme_ctrl_get_firmware(c)))
+					continue;
+
+				err = add(c, arg);
+				if (err)
+					return err;
+				break;
+			}
+		}
+	}
+
+	return 0;
+}
+
+#define FLEET_REPORT_US		10000000ULL
+
+/* Start of a fleet command and time of its last progress report */
+struct fleet_progress {
+	struct timeval start;
+	uint64_t last_report_us;
+};
+
+static struct nvme_fleet_entry *fleet_entry(void *entry, size_t size, int i)
+{
+	return (struct nvme_fleet_entry *)((char *)entry + i * size);
+}
+
+/*
+ * Appends a zeroed entry of @size bytes for @c to the @entry array and
+ * returns the new array. Each entry starts with a struct nvme_fleet_entry.
+ */
+static void *fleet_add(nvme_ctrl_t c, void *entry, int *nr, size_t size)
+{
+	struct nvme_fleet_entry *e;
+
+	entry = realloc(entry, (*nr + 1) * size);
+	if (!entry)
+		return NULL;
+
+	e = fleet_entry(entry, size, (*nr)++);
+	memset(e, 0, size);
+	snprintf(e->device, sizeof(e->device), "%s", nvme_ctrl_get_name(c));
+	snprintf(e->model, sizeof(e->model), "%s", nvme_ctrl_get_model(c) ? : "");
+	snprintf(e->serial, sizeof(e->serial), "%s", nvme_ctrl_get_serial(c) ? : "");
+
+	return entry;
+}
+
+/*
+ * Marks @e failed with @result. A positive @err is an NVMe status, a
+ * negative one takes the error from errno and zero keeps e->error.
+ */
+static void fleet_error(struct nvme_fleet_entry *e, const char *result, int err)
+{
+	e->result = result;
+	e->failed = true;
+	if (err > 0)
+		snprintf(e->error, sizeof(e->error), "%s",
+			 nvme_status_to_string(err, false));
+	else if (err < 0)
+		snprintf(e->error, sizeof(e->error), "%s",
+			 nvme_strerror(errno));
+}
+
+static void fleet_done(struct nvme_fleet_entry *e, struct timeval start)
+{
+	struct timeval end;
+
+	gettimeofday(&end, NULL);
+	e->elapsed_us = elapsed_utime(start, end);
+	__atomic_store_n(&e->done, true, __ATOMIC_RELAXED);
+}
+
+/* Aggregate progress on stderr, at most every FLEET_REPORT_US */
+static void fleet_report(struct fleet_progress *p, void *entry, int nr,
+			 size_t size)
+{
+	struct nvme_fleet_entry *e;
+	uint64_t now_us, last;
+	struct timeval now;
+	unsigned int done = 0;
+	__u32 left = 0, rem;
+	double pct = 0;
+	int i;
+
+	gettimeofday(&now, NULL);
+	now_us = elapsed_utime(p->start, now);
+	last = __atomic_load_n(&p->last_report_us, __ATOMIC_RELAXED);
+	if (now_us - last < FLEET_REPORT_US ||
+	    !__atomic_compare_exchange_n(&p->last_report_us, &last, now_us,
+					 false, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		return;
+
+	for (i = 0; i < nr; i++) {
+		e = fleet_entry(entry, size, i);
+		if (__atomic_load_n(&e->done, __ATOMIC_RELAXED)) {
+			done++;
+			pct += 100;
+			continue;
+		}
+		pct += __atomic_load_n(&e->progress, __ATOMIC_RELAXED) * 100.0 / 65536;
+		rem = __atomic_load_n(&e->remaining_s, __ATOMIC_RELAXED);
+		if (rem > left)
+			left = rem;
+	}
+
+	fprintf(stderr, "%8.1f s: %u of %d controller(s) done, %.1f%%",
+		now_us / 1000000.0, done, nr, pct / nr);
+	if (left)
+		fprintf(stderr, ", about %u s left", left);
+	fprintf(stderr, "\n");
+}
+
+struct fw_rollout_ctx {
+	struct nvme_fw_rollout *r;
+	void *buf;
+	unsigned int size;
+	__u32 xfer;
+	__u8 slot;
+	__u8 action;
+	__u8 bpid;
+};
+
+static void fw_rollout_str(char *dst, size_t len, const char *src, size_t n)
+{
+	if (n >= len)
+		n = len - 1;
+	memcpy(dst, src, n);
+	dst[n] = '\0';
+	while (n && dst[n - 1] == ' ')
+		dst[--n] = '\0';
+}
+
+/*
+ * Checks the firmware slot log against the commit action: a replaced or
+ * activated slot has to be the active slot (immediate activation) or the
+ * one activated at the next reset.
+ */
+static int fw_rollout_verify(struct nvme_dev *dev, struct fw_rollout_ctx *ctx,
+			     struct nvme_fw_rollout_entry *e)
+{
+	_cleanup_free_ struct nvme_firmware_slot *log = NULL;
+	__u8 slot;
+	int err;
+
+	log = nvme_alloc(sizeof(*log));
+	if (!log)
+		return -ENOMEM;
+
+	err = nvme_cli_get_log_fw_slot(dev, false, log);
+	if (err)
+		return err;
+
+	e->active_slot = log->afi & 0x7;
+	e->next_slot = (log->afi >> 4) & 0x7;
+
+	switch (ctx->action) {
+	case NVME_FW_COMMIT_CA_REPLACE:
+		slot = ctx->slot;
+		break;
+	case NVME_FW_COMMIT_CA_REPLACE_AND_ACTIVATE:
+	case NVME_FW_COMMIT_CA_SET_ACTIVE:
+		slot = e->next_slot;
+		if (ctx->slot && slot != ctx->slot)
+			return -EAGAIN;
+		break;
+	case NVME_FW_COMMIT_CA_REPLACE_AND_ACTIVATE_IMMEDIATE:
+		slot = e->next_slot ? e->next_slot : e->active_slot;
+		if (ctx->slot && slot != ctx->slot)
+			return -EAGAIN;
+		break;
+	default:
+		/* Boot partitions are not in the slot log */
+		return 0;
+	}
+
+	if (slot >= 1 && slot <= ARRAY_SIZE(log->frs))
+		fw_rollout_str(e->slot_fw, sizeof(e->slot_fw),
+			       log->frs[slot - 1], sizeof(log->frs[0]));
+
+	return 0;
+}
+
+static void fw_rollout_one(unsigned int idx, void *arg)
+{
+	struct fw_rollout_ctx *ctx = arg;
+	struct nvme_fw_rollout_entry *e = &ctx->r->entry[idx];
+	_cleanup_free_ struct nvme_id_ctrl *ctrl = NULL;
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	char path[PATH_MAX];
+	unsigned int pos;
+	uint64_t start;
+	__u32 xfer, result = 0;
+	int err;
+
+	snprintf(path, sizeof(path), "/dev/%s", e->fleet.device);
+	if (open_dev_direct(&dev, path, O_RDONLY, 0)) {
+		fleet_error(&e->fleet, "open-failed", -1);
+		return;
+	}
+
+	ctrl = nvme_alloc(sizeof(*ctrl));
+	if (!ctrl) {
+		errno = ENOMEM;
+		fleet_error(&e->fleet, "identify-failed", -1);
+		return;
+	}
+	err = nvme_cli_identify_ctrl(dev, ctrl);
+	if (err) {
+		fleet_error(&e->fleet, "identify-failed", err);
+		return;
+	}
+	fw_rollout_str(e->fw_before, sizeof(e->fw_before), ctrl->fr,
+		       sizeof(ctrl->fr));
+
+	xfer = ctx->xfer ? ctx->xfer : fw_download_xfer(ctrl);
+
+	start = fw_download_now_us();
+	for (pos = 0; pos < ctx->size; pos += xfer) {
+		err = fw_download_single(dev, ctx->buf + pos, ctx->size, pos,
+					 min(xfer, ctx->size - pos), false,
+					 false);
+		if (err)
+			break;
+	}
+	e->download_us = fw_download_now_us() - start;
+	if (err) {
+		fleet_error(&e->fleet, "download-failed", err);
+		return;
+	}
+
+	struct nvme_fw_commit_args args = {
+		.args_size	= sizeof(args),
+		.slot		= ctx->slot,
+		.action		= ctx->action,
+		.bpid		= ctx->bpid,
+		.timeout	= nvme_cfg.timeout,
+		.result		= &result,
+	};
+
+	start = fw_download_now_us();
+	err = nvme_cli_fw_commit(dev, &args);
+	e->commit_us = fw_download_now_us() - start;
+
+	if (err > 0 && nvme_status_get_type(err) == NVME_STATUS_TYPE_NVME) {
+		switch (nvme_status_get_value(err) & 0x7ff) {
+		case NVME_SC_FW_NEEDS_CONV_RESET:
+		case NVME_SC_FW_NEEDS_SUBSYS_RESET:
+		case NVME_SC_FW_NEEDS_RESET:
+			e->reset = nvme_fw_status_reset_type(nvme_status_get_value(err));
+			err = 0;
+			break;
+		}
+	}
+	if (err) {
+		fleet_error(&e->fleet, "commit-failed", err);
+		return;
+	}
+
+	/* Same check as fw_commit_print_mud(), without the identify */
+	if (ctrl->frmw >> 5 & 0x1 && result & 0x3) {
+		e->mud = result;
+		fleet_error(&e->fleet, "multiple-update-detected", 0);
+		return;
+	}
+
+	err = fw_rollout_verify(dev, ctx, e);
+	if (err == -EAGAIN) {
+		snprintf(e->fleet.error, sizeof(e->fleet.error),
+			 "slot %u not activated", ctx->slot);
+		fleet_error(&e->fleet, "verify-failed", 0);
+		return;
+	} else if (err) {
+		fleet_error(&e->fleet, "verify-failed", err);
+		return;
+	}
+
+	e->fleet.result = e->reset ? "reset-required" : "success";
+}
+
+/*
+ * One controller per subsystem: the firmware belongs to the subsystem and
+ * downloads through a second controller would overlap (MUD).
+ */
+static int fw_rollout_add(nvme_ctrl_t c, void *arg)
+{
+	struct nvme_fw_rollout *r = arg;
+	void *entry;
+
+	entry = fleet_add(c, r->entry, &r->nr, sizeof(*r->entry));
+	if (!entry)
+		return -ENOMEM;
+	r->entry = entry;
+
+	return 0;
+}
+
+static int fw_rollout(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Download a firmware image to a set of controllers "
+		"in parallel and commit it with the given action. Controllers "
+		"are selected by name or by model and firmware revision, one "
+		"controller per subsystem. The firmware slot log is checked "
+		"after the commit and a summary of all controllers is printed.";
+	const char *fw = "firmware file (required)";
+	const char *devices = "comma separated list of controllers (e.g. nvme0,nvme1)";
+	const char *model = "only controllers whose model matches this glob";
+	const char *fw_rev = "only controllers whose firmware revision matches this glob";
+	const char *xfer = "transfer chunksize limit";
+	const char *slot = "[0-7]: firmware slot for commit action";
+	const char *action = "[0-7]: commit action";
+	const char *bpid = "[0,1]: boot partition identifier, if applicable (default: 0)";
+	const char *rollout_jobs = "maximum number of controllers updated concurrently";
+
+	_cleanup_nvme_root_ nvme_root_t root = NULL;
+	_cleanup_free_ struct nvme_fw_rollout_entry *entries = NULL;
+	_cleanup_fd_ int fw_fd = -1;
+	struct nvme_fw_rollout r = { 0 };
+	struct fw_rollout_ctx ctx = { 0 };
+	nvme_print_flags_t flags;
+	uint64_t start;
+	struct stat sb;
+	void *fw_buf;
+	int i, err;
+
+	struct config {
+		char	*fw;
+		char	*devices;
+		char	*model;
+		char	*fw_rev;
+		__u32	xfer;
+		__u8	slot;
+		__u8	action;
+		__u8	bpid;
+		__u32	jobs;
+	};
+
+	struct config cfg = {
+		.fw		= NULL,
+		.devices	= NULL,
+		.model		= NULL,
+		.fw_rev		= NULL,
+		.xfer		= 0,
+		.slot		= 0,
+		.action		= 0,
+		.bpid		= 0,
+		.jobs		= 4,
+	};
+
+	NVME_ARGS(opts,
+		  OPT_FILE("fw",           'f', &cfg.fw,      fw),
+		  OPT_LIST("devices",      'd', &cfg.devices, devices),
+		  OPT_STRING("model",      'm', "GLOB", &cfg.model,  model),
+		  OPT_STRING("firmware-rev", 'r', "GLOB", &cfg.fw_rev, fw_rev),
+		  OPT_UINT("xfer",         'x', &cfg.xfer,    xfer),
+		  OPT_BYTE("slot",         's', &cfg.slot,    slot),
+		  OPT_BYTE("action",       'a', &cfg.action,  action),
+		  OPT_BYTE("bpid",         'b', &cfg.bpid,    bpid),
+		  OPT_UINT("jobs",         'j', &cfg.jobs,    rollout_jobs));
+
+	err = parse_args(argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	err = validate_output_format(nvme_cfg.output_format, &flags);
+	if (err < 0) {
+		nvme_show_error("Invalid output format");
+		return err;
+	}
+
+	if (!cfg.fw) {
+		nvme_show_error("required argument [--fw | -f] not specified");
+		return -EINVAL;
+	}
+	/* Firmware images are model specific, never update every controller */
+	if (!cfg.devices && !cfg.model) {
+		nvme_show_error("either [--devices | -d] or [--model | -m] is required");
+		return -EINVAL;
+	}
+	if (cfg.slot > 7) {
+		nvme_show_error("invalid slot:%d", cfg.slot);
+		return -EINVAL;
+	}
+	if (cfg.action > 7 || cfg.action == 4 || cfg.action == 5) {
+		nvme_show_error("invalid action:%d", cfg.action);
+		return -EINVAL;
+	}
+	if (cfg.bpid > 1) {
+		nvme_show_error("invalid boot partition id:%d", cfg.bpid);
+		return -EINVAL;
+	}
+	if (cfg.xfer % 4096)
+		cfg.xfer = 4096;
+
+	fw_fd = open(cfg.fw, O_RDONLY);
+	if (fw_fd < 0) {
+		nvme_show_error("Failed to open firmware file %s: %s", cfg.fw, strerror(errno));
+		return -EINVAL;
+	}
+	if (fstat(fw_fd, &sb) < 0) {
+		nvme_show_perror("fstat");
+		return -errno;
+	}
+	if ((sb.st_size & 0x3) || !sb.st_size || sb.st_size > UINT_MAX) {
+		nvme_show_error("Invalid size:%jd for f/w image", (intmax_t)sb.st_size);
+		return -EINVAL;
+	}
+
+	root = nvme_create_root(stderr, log_level);
+	if (!root) {
+		nvme_show_error("Failed to create topology root: %s", nvme_strerror(errno));
+		return -errno;
+	}
+	nvme_root_skip_namespaces(root);
+	err = nvme_scan_topology(root, NULL, NULL);
+	if (err < 0) {
+		nvme_show_error("Failed to scan topology: %s", nvme_strerror(errno));
+		return -errno;
+	}
+
+	err = ctrl_select(root, cfg.devices, cfg.model, cfg.fw_rev, fw_rollout_add, &r);
+	entries = r.entry;
+	if (err)
+		return err;
+	if (!r.nr) {
+		nvme_show_error("no controller matches");
+		return -ENODEV;
+	}
+
+	fw_buf = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE,
+		      fw_fd, 0);
+	if (fw_buf == MAP_FAILED) {
+		nvme_show_perror("mmap");
+		return -errno;
+	}
+
+	r.fw = cfg.fw;
+	r.slot = cfg.slot;
+	r.action = cfg.action;
+
+	ctx.r = &r;
+	ctx.buf = fw_buf;
+	ctx.size = sb.st_size;
+	ctx.xfer = cfg.xfer;
+	ctx.slot = cfg.slot;
+	ctx.action = cfg.action;
+	ctx.bpid = cfg.bpid;
+
+	start = fw_download_now_us();
+	parallel_for_each(r.nr, cfg.jobs ? cfg.jobs : 1, fw_rollout_one, &ctx);
+	r.elapsed_us = fw_download_now_us() - start;
+
+	munmap(fw_buf, sb.st_size);
+
+	nvme_show_fw_rollout(&r, flags);
+
+	for (i = 0; i < r.nr; i++)
+		if (r.entry[i].fleet.failed)
+			return -EIO;
+
+	return 0;
+}
+
+static int subsystem_reset(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Resets the NVMe subsystem";
+
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	int err;
+
+	NVME_ARGS(opts);
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	err = nvme_subsystem_reset(dev_fd(dev));
+	if (err < 0) {
+		if (errno == ENOTTY)
+			nvme_show_error("Subsystem-reset: NVM Subsystem Reset not supported.");
+		else
+			nvme_show_error("Subsystem-reset: %s", nvme_strerror(errno));
+	} else if (argconfig_parse_seen(opts, "verbose"))
+		printf("resetting subsystem through %s\n", dev->name);
+
+	return err;
+}
+
+static int reset(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Resets the NVMe controller\n";
+
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	int err;
+
+	NVME_ARGS(opts);
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	err = nvme_ctrl_reset(dev_fd(dev));
+	if (err < 0)
+		nvme_show_error("Reset: %s", nvme_strerror(errno));
+	else if (argconfig_parse_seen(opts, "verbose"))
+		printf("resetting controller %s\n", dev->name);
+
+	return err;
+}
+
+static int ns_rescan(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Rescans the NVMe namespaces\n";
+
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	int err;
+
+	NVME_ARGS(opts);
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	err = nvme_ns_rescan(dev_fd(dev));
+	if (err < 0)
+		nvme_show_error("Namespace Rescan: %s\n", nvme_strerror(errno));
+	else if (argconfig_parse_seen(opts, "verbose"))
+		printf("rescanning namespaces through %s\n", dev->name);
+
+	return err;
+}
+
+static int sanitize_cmd(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Send a sanitize command.";
+	const char *emvs_desc = "Enter media verification state.";
+	const char *no_dealloc_desc = "No deallocate after sanitize.";
+	const char *oipbp_desc = "Overwrite invert pattern between passes.";
+	const char *owpass_desc = "Overwrite pass count.";
+	const char *ause_desc = "Allow unrestricted sanitize exit.";
+	const char *sanact_desc = "Sanitize action: 1 = Exit failure mode, 2 = Start block erase,"
+				"3 = Start overwrite, 4 = Start crypto erase, 5 = Exit media verification";
+	const char *ovrpat_desc = "Overwrite pattern.";
+
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	int err;
+
+	struct config {
+		bool	no_dealloc;
+		bool	oipbp;
+		__u8	owpass;
+		bool	ause;
+		__u8	sanact;
+		__u32	ovrpat;
+		bool	emvs;
+	};
+
+	struct config cfg = {
+		.no_dealloc	= false,
+		.oipbp		= false,
+		.owpass		= 0,
+		.ause		= false,
+		.sanact		= 0,
+		.ovrpat		= 0,
+		.emvs		= false,
+	};
+
+	OPT_VALS(sanact) = {
+		VAL_BYTE("exit-failure", NVME_SANITIZE_SANACT_EXIT_FAILURE),
+		VAL_BYTE("start-block-erase", NVME_SANITIZE_SANACT_START_BLOCK_ERASE),
+		VAL_BYTE("start-overwrite", NVME_SANITIZE_SANACT_START_OVERWRITE),
+		VAL_BYTE("start-crypto-erase", NVME_SANITIZE_SANACT_START_CRYPTO_ERASE),
+		VAL_BYTE("exit-media-verification", NVME_SANITIZE_SANACT_EXIT_MEDIA_VERIF),
+		VAL_END()
+	};
+
+	NVME_ARGS(opts,
+		  OPT_FLAG("no-dealloc", 'd', &cfg.no_dealloc, no_dealloc_desc),
+		  OPT_FLAG("oipbp",      'i', &cfg.oipbp,      oipbp_desc),
+		  OPT_BYTE("owpass",     'n', &cfg.owpass,     owpass_desc),
+		  OPT_FLAG("ause",       'u', &cfg.ause,       ause_desc),
+		  OPT_BYTE("sanact",     'a', &cfg.sanact,     sanact_desc, sanact),
+		  OPT_UINT("ovrpat",     'p', &cfg.ovrpat,     ovrpat_desc),
+		  OPT_FLAG("emvs",       'e', &cfg.emvs,       emvs_desc));
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	switch (cfg.sanact) {
+	case NVME_SANITIZE_SANACT_EXIT_FAILURE:
+	case NVME_SANITIZE_SANACT_START_BLOCK_ERASE:
+	case NVME_SANITIZE_SANACT_START_OVERWRITE:
+	case NVME_SANITIZE_SANACT_START_CRYPTO_ERASE:
+	case NVME_SANITIZE_SANACT_EXIT_MEDIA_VERIF:
+		break;
+	default:
+		nvme_show_error("Invalid Sanitize Action");
+		return -EINVAL;
+	}
+
+	if (cfg.ause || cfg.no_dealloc) {
+		if (cfg.sanact == NVME_SANITIZE_SANACT_EXIT_FAILURE) {
+			nvme_show_error("SANACT is Exit Failure Mode");
+			return -EINVAL;
+		} else if (cfg.sanact == NVME_SANITIZE_SANACT_EXIT_MEDIA_VERIF) {
+			nvme_show_error("SANACT is Exit Media Verification State");
+			return -EINVAL;
+		}
+	}
+
+	if (cfg.sanact == NVME_SANITIZE_SANACT_START_OVERWRITE) {
+		if (cfg.owpass > 15) {
+			nvme_show_error("OWPASS out of range [0-15]");
+			return -EINVAL;
+		}
+	} else {
+		if (cfg.owpass || cfg.oipbp || cfg.ovrpat) {
+			nvme_show_error("SANACT is not Overwrite");
+			return -EINVAL;
+		}
+	}
+
+	struct nvme_sanitize_nvm_args args = {
+		.args_size	= sizeof(args),
+		.sanact		= cfg.sanact,
+		.ause		= cfg.ause,
+		.owpass		= cfg.owpass,
+		.oipbp		= cfg.oipbp,
+		.nodas		= cfg.no_dealloc,
+		.ovrpat		= cfg.ovrpat,
+		.result		= NULL,
+		.emvs		= cfg.emvs,
+	};
+
+	err = nvme_cli_sanitize_nvm(dev, &args);
+	if (err < 0)
+		nvme_show_error("sanitize: %s", nvme_strerror(errno));
+	else if (err > 0)
+		nvme_show_status(err);
+
+	return err;
+}
+
+#define WIPE_FORMAT		0
+#define WIPE_POLL_MIN_MS	1000
+
+struct wipe_ctx {
+	struct nvme_wipe *w;
+	__u8 action;
+	__u8 ses;
+	bool no_dealloc;
+	bool ause;
+	__u8 owpass;
+	__u32 ovrpat;
+	unsigned int max_poll_ms;
+	char **siblings;
+	struct fleet_progress progress;
+};
+
+struct wipe_ns {
+	struct nvme_dev *dev;
+	__u32 nsid;
+	__u8 flbas;
+	__u8 dps;
+};
+
+/*
+ * Time until the next sanitize log poll: a tenth of the remaining time,
+ * extrapolated from SPROG once the controller reports progress and taken
+ * from the estimated time of the sanitize action before that. Without
+ * either the interval doubles up to @max_ms.
+ */
+static unsigned int wipe_poll_interval(uint64_t elapsed_ms, __u16 sprog,
+				       __u32 estimate_s, unsigned int prev_ms,
+				       unsigned int max_ms, __u32 *remaining_s)
+{
+	uint64_t remaining_ms, ms;
+
+	if (sprog) {
+		remaining_ms = elapsed_ms * (65536 - sprog) / sprog;
+	} else if (estimate_s && estimate_s != 0xffffffff) {
+		remaining_ms = estimate_s * 1000ULL;
+		remaining_ms = remaining_ms > elapsed_ms ? remaining_ms - elapsed_ms : 0;
+	} else {
+		*remaining_s = 0;
+		ms = prev_ms ? prev_ms * 2ULL : WIPE_POLL_MIN_MS;
+		return ms < max_ms ? ms : max_ms;
+	}
+
+	*remaining_s = (remaining_ms + 999) / 1000;
+
+	ms = remaining_ms / 10;
+	if (ms < WIPE_POLL_MIN_MS)
+		ms = WIPE_POLL_MIN_MS;
+	if (ms > max_ms)
+		ms = max_ms;
+
+	return ms;
+}
+
+static __u32 wipe_estimate(struct nvme_sanitize_log_page *log, __u8 sanact,
+			   bool no_dealloc)
+{
+	switch (sanact) {
+	case NVME_SANITIZE_SANACT_START_BLOCK_ERASE:
+		return le32_to_cpu(no_dealloc ? log->etbend : log->etbe);
+	case NVME_SANITIZE_SANACT_START_OVERWRITE:
+		return le32_to_cpu(no_dealloc ? log->etond : log->eto);
+	case NVME_SANITIZE_SANACT_START_CRYPTO_ERASE:
+		return le32_to_cpu(no_dealloc ? log->etcend : log->etce);
+	default:
+		return 0;
+	}
+}
+
+static __u32 wipe_sanicap(__u8 sanact)
+{
+	switch (sanact) {
+	case NVME_SANITIZE_SANACT_START_BLOCK_ERASE:
+		return NVME_CTRL_SANICAP_BES;
+	case NVME_SANITIZE_SANACT_START_OVERWRITE:
+		return NVME_CTRL_SANICAP_OWS;
+	case NVME_SANITIZE_SANACT_START_CRYPTO_ERASE:
+		return NVME_CTRL_SANICAP_CES;
+	default:
+		return 0;
+	}
+}
 
-	NVME_ARGS(opts,
-		  OPT_FILE("fw",         'f', &cfg.fw,         fw),
-		  OPT_UINT("xfer",       'x', &cfg.xfer,       xfer),
-		  OPT_UINT("offset",     'O', &cfg.offset,     offset),
-		  OPT_FLAG("progress",   'p', &cfg.progress,   progress),
-		  OPT_FLAG("ignore-ovr", 'i', &cfg.ignore_ovr, ignore_ovr));
+static void wipe_sanitize(struct nvme_dev *dev, struct wipe_ctx *ctx,
+			  struct nvme_fleet_entry *e, struct nvme_id_ctrl *ctrl)
+{
+	_cleanup_free_ struct nvme_sanitize_log_page *log = NULL;
+	unsigned int interval = 0;
+	struct timeval start, now;
+	__u32 estimate, remaining;
+	__u16 sstat;
+	int err;
 
-	err = parse_and_open(&dev, argc, argv, desc, opts);
-	if (err)
-		return err;
+	if (!(le32_to_cpu(ctrl->sanicap) & wipe_sanicap(ctx->action))) {
+		snprintf(e->error, sizeof(e->error), "sanitize action not supported");
+		fleet_error(e, "not-supported", 0);
+		return;
+	}
 
-	fw_fd = open(cfg.fw, O_RDONLY);
-	cfg.offset <<= 2;
-	if (fw_fd < 0) {
-		nvme_show_error("Failed to open firmware file %s: %s", cfg.fw, strerror(errno));
-		return -EINVAL;
+	log = nvme_alloc(sizeof(*log));
+	if (!log) {
+		errno = ENOMEM;
+		fleet_error(e, "log-failed", -1);
+		return;
 	}
 
-	err = fstat(fw_fd, &sb);
-	if (err < 0) {
-		nvme_show_perror("fstat");
-		return err;
+	err = nvme_cli_get_log_sanitize(dev, false, log);
+	if (err) {
+		fleet_error(e, "log-failed", err);
+		return;
+	}
+	if ((le16_to_cpu(log->sstat) & NVME_SANITIZE_SSTAT_STATUS_MASK) ==
+	    NVME_SANITIZE_SSTAT_STATUS_IN_PROGESS) {
+		snprintf(e->error, sizeof(e->error), "sanitize already in progress");
+		fleet_error(e, "busy", 0);
+		return;
 	}
+	estimate = wipe_estimate(log, ctx->action, ctx->no_dealloc);
 
-	fw_size = sb.st_size;
-	if ((fw_size & 0x3) || (fw_size == 0)) {
-		nvme_show_error("Invalid size:%d for f/w image", fw_size);
-		return -EINVAL;
+	struct nvme_sanitize_nvm_args args = {
+		.args_size	= sizeof(args),
+		.sanact		= ctx->action,
+		.ause		= ctx->ause,
+		.owpass		= ctx->owpass,
+		.nodas		= ctx->no_dealloc,
+		.ovrpat		= ctx->ovrpat,
+		.result		= NULL,
+	};
+
+	gettimeofday(&start, NULL);
+	err = nvme_cli_sanitize_nvm(dev, &args);
+	if (err) {
+		fleet_error(e, "sanitize-failed", err);
+		return;
 	}
 
-	if (cfg.xfer == 0) {
-		err = nvme_cli_identify_ctrl(dev, &ctrl);
+	for (;;) {
+		gettimeofday(&now, NULL);
+		interval = wipe_poll_interval(elapsed_utime(start, now) / 1000,
+					      e->progress, estimate, interval,
+					      ctx->max_poll_ms, &remaining);
+		__atomic_store_n(&e->remaining_s, remaining, __ATOMIC_RELAXED);
+		usleep(interval * 1000);
+
+		err = nvme_cli_get_log_sanitize(dev, false, log);
+		e->polls++;
 		if (err) {
-			nvme_show_error("identify-ctrl: %s", nvme_strerror(errno));
-			return err;
+			fleet_error(e, "log-failed", err);
+			return;
 		}
-		if (ctrl.fwug == 0 || ctrl.fwug == 0xff)
-			cfg.xfer = 4096;
-		else
-			cfg.xfer = ctrl.fwug * 4096;
-	} else if (cfg.xfer % 4096)
-		cfg.xfer = 4096;
 
-	if (ctrl.fwug && ctrl.fwug != 0xff && fw_size % cfg.xfer)
-		nvme_show_error("WARNING: firmware file size %u not conform to FWUG alignment %lu",
-				fw_size, cfg.xfer);
+		sstat = le16_to_cpu(log->sstat);
+		switch (sstat & NVME_SANITIZE_SSTAT_STATUS_MASK) {
+		case NVME_SANITIZE_SSTAT_STATUS_IN_PROGESS:
+			__atomic_store_n(&e->progress, le16_to_cpu(log->sprog),
+					 __ATOMIC_RELAXED);
+			fleet_report(&ctx->progress, ctx->w->entry, ctx->w->nr,
+				     sizeof(*ctx->w->entry));
+			break;
+		case NVME_SANITIZE_SSTAT_STATUS_COMPLETE_SUCCESS:
+		case NVME_SANITIZE_SSTAT_STATUS_ND_COMPLETE_SUCCESS:
+			e->result = "success";
+			return;
+		case NVME_SANITIZE_SSTAT_STATUS_COMPLETED_FAILED:
+			snprintf(e->error, sizeof(e->error), "sanitize operation failed");
+			fleet_error(e, "sanitize-failed", 0);
+			return;
+		default:
+			snprintf(e->error, sizeof(e->error),
+				 "unexpected sanitize status %#x", sstat);
+			fleet_error(e, "sanitize-failed", 0);
+			return;
+		}
+	}
+}
 
-	fw_buf = nvme_alloc_huge(fw_size, &mh);
-	if (!fw_buf)
-		return -ENOMEM;
+/*
+ * Collects the active namespaces of @dev not seen on another controller
+ * of the subsystem yet, NSIDs are unique within the subsystem.
+ */
+static int wipe_ns_add(struct nvme_dev *dev, struct wipe_ns **nss,
+		       unsigned int *nr, struct nvme_id_ns *ns)
+{
+	_cleanup_free_ __u32 *nsids = NULL;
+	unsigned int n = 0, i, j;
+	struct wipe_ns *tmp;
+	int err;
 
-	if (read(fw_fd, fw_buf, fw_size) != ((ssize_t)(fw_size))) {
-		err = -errno;
-		nvme_show_error("read :%s :%s", cfg.fw, strerror(errno));
+	err = ns_sweep_list(dev, false, &nsids, &n);
+	if (err)
 		return err;
-	}
 
-	for (pos = 0; pos < fw_size; pos += cfg.xfer) {
-		cfg.xfer = min(cfg.xfer, fw_size - pos);
+	for (i = 0; i < n; i++) {
+		for (j = 0; j < *nr; j++)
+			if ((*nss)[j].nsid == nsids[i])
+				break;
+		if (j < *nr)
+			continue;
 
-		err = fw_download_single(dev, fw_buf + pos, fw_size,
-					 cfg.offset + pos, cfg.xfer,
-					 cfg.progress, cfg.ignore_ovr);
+		err = nvme_cli_identify_ns(dev, nsids[i], ns);
 		if (err)
-			break;
-	}
+			return err;
 
-	if (!err) {
-		/* end the progress output */
-		if (cfg.progress)
-			printf("\n");
-		printf("Firmware download success\n");
+		tmp = realloc(*nss, (*nr + 1) * sizeof(*tmp));
+		if (!tmp)
+			return -ENOMEM;
+		*nss = tmp;
+		tmp[*nr].dev = dev;
+		tmp[*nr].nsid = nsids[i];
+		tmp[*nr].flbas = ns->flbas;
+		tmp[*nr].dps = ns->dps;
+		(*nr)++;
 	}
 
-	return err;
+	return 0;
 }
 
-static char *nvme_fw_status_reset_type(__u16 status)
+/*
+ * Formats every active namespace of every controller of the subsystem
+ * with its current LBA format and protection settings. A single format of
+ * all namespaces is only sent when that keeps the settings: the
+ * controller formats all namespaces alike anyway, or the secure erase
+ * applies to all of them and they all share the same format.
+ */
+static void wipe_format(struct nvme_dev *dev, struct wipe_ctx *ctx,
+			struct nvme_fleet_entry *e, struct nvme_id_ctrl *ctrl,
+			const char *siblings)
 {
-	switch (status & 0x7ff) {
-	case NVME_SC_FW_NEEDS_CONV_RESET:
-		return "conventional";
-	case NVME_SC_FW_NEEDS_SUBSYS_RESET:
-		return "subsystem";
-	case NVME_SC_FW_NEEDS_RESET:
-		return "any controller";
-	default:
-		return "unknown";
+	_cleanup_free_ struct nvme_dev **devs = NULL;
+	_cleanup_free_ struct wipe_ns *nss = NULL;
+	_cleanup_free_ struct nvme_id_ns *ns = NULL;
+	_cleanup_free_ char *list = NULL;
+	unsigned int nr = 0, nr_devs = 0, i;
+	char path[PATH_MAX], *l, *name;
+	bool all = false;
+	__u8 lbaf;
+	int err;
+
+	ns = nvme_alloc(sizeof(*ns));
+	list = l = strdup(siblings ? : "");
+	devs = calloc(strlen(l) / 2 + 1, sizeof(*devs));
+	if (!ns || !list || !devs) {
+		errno = ENOMEM;
+		fleet_error(e, "identify-failed", -1);
+		return;
+	}
+
+	/* Private namespaces are only active on their own controller */
+	err = wipe_ns_add(dev, &nss, &nr, ns);
+	while (!err && (name = strsep(&l, ",")) != NULL) {
+		if (!*name)
+			continue;
+		snprintf(path, sizeof(path), "/dev/%s", name);
+		if (open_dev_direct(&devs[nr_devs], path, O_RDONLY, 0)) {
+			snprintf(e->error, sizeof(e->error), "%s: %s", name,
+				 nvme_strerror(errno));
+			fleet_error(e, "open-failed", 0);
+			goto out;
+		}
+		err = wipe_ns_add(devs[nr_devs++], &nss, &nr, ns);
+	}
+	if (err) {
+		fleet_error(e, "identify-failed", err);
+		goto out;
+	}
+
+	if (nr && !(ctrl->fna & NVME_CTRL_FNA_NSID_FFFFFFFF)) {
+		if (ctrl->fna & NVME_CTRL_FNA_FMT_ALL_NAMESPACES) {
+			all = true;
+		} else if (ctx->ses && ctrl->fna & NVME_CTRL_FNA_SEC_ALL_NAMESPACES) {
+			all = true;
+			for (i = 1; i < nr; i++)
+				if (nss[i].flbas != nss[0].flbas ||
+				    nss[i].dps != nss[0].dps)
+					all = false;
+		}
+	}
+	if (all) {
+		nss[0].dev = dev;
+		nr = 1;
+	}
+
+	for (i = 0; i < nr; i++) {
+		nvme_id_ns_flbas_to_lbaf_inuse(nss[i].flbas, &lbaf);
+
+		struct nvme_format_nvm_args args = {
+			.args_size	= sizeof(args),
+			.nsid		= all ? NVME_NSID_ALL : nss[i].nsid,
+			.lbafu		= (lbaf >> 4) & 0x3,
+			.lbaf		= lbaf & 0xf,
+			.mset		= !!(nss[i].flbas & NVME_NS_FLBAS_META_EXT),
+			.pi		= nss[i].dps & NVME_NS_DPS_PI_MASK,
+			.pil		= !!(nss[i].dps & NVME_NS_DPS_PI_FIRST),
+			.ses		= ctx->ses,
+			.timeout	= nvme_cfg.timeout,
+			.result		= NULL,
+		};
+
+		err = nvme_cli_format_nvm(nss[i].dev, &args);
+		if (err) {
+			fleet_error(e, "format-failed", err);
+			goto out;
+		}
+
+		__atomic_store_n(&e->progress, (i + 1) * 65535 / nr, __ATOMIC_RELAXED);
+		fleet_report(&ctx->progress, ctx->w->entry, ctx->w->nr,
+			     sizeof(*ctx->w->entry));
 	}
+
+	e->result = "success";
+out:
+	for (i = 0; i < nr_devs; i++)
+		dev_close(devs[i]);
 }
 
-static bool fw_commit_support_mud(struct nvme_dev *dev)
+static void wipe_one(unsigned int idx, void *arg)
 {
+	struct wipe_ctx *ctx = arg;
+	struct nvme_fleet_entry *e = &ctx->w->entry[idx];
 	_cleanup_free_ struct nvme_id_ctrl *ctrl = NULL;
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	struct timeval start;
+	char path[PATH_MAX];
 	int err;
 
-	ctrl = nvme_alloc(sizeof(*ctrl));
-	if (!ctrl)
-		return false;
+	gettimeofday(&start, NULL);
 
-	err = nvme_cli_identify_ctrl(dev, ctrl);
+	snprintf(path, sizeof(path), "/dev/%s", e->device);
+	if (open_dev_direct(&dev, path, O_RDONLY, 0)) {
+		fleet_error(e, "open-failed", -1);
+		goto out;
+	}
 
-	if (err)
-		nvme_show_error("identify-ctrl: %s", nvme_strerror(errno));
-	else if (ctrl->frmw >> 5 & 0x1)
-		return true;
+	ctrl = nvme_alloc(sizeof(*ctrl));
+	if (!ctrl) {
+		errno = ENOMEM;
+		fleet_error(e, "identify-failed", -1);
+		goto out;
+	}
+	err = nvme_cli_identify_ctrl(dev, ctrl);
+	if (err) {
+		fleet_error(e, "identify-failed", err);
+		goto out;
+	}
 
-	return false;
+	if (ctx->action == WIPE_FORMAT)
+		wipe_format(dev, ctx, e, ctrl, ctx->siblings[idx]);
+	else
+		wipe_sanitize(dev, ctx, e, ctrl);
+out:
+	fleet_done(e, start);
 }
 
-static void fw_commit_print_mud(struct nvme_dev *dev, __u32 result)
+/*
+ * Sanitize is subsystem wide, one controller per subsystem is enough. A
+ * format only reaches the namespaces attached to the controller it is
+ * sent to, so the other controllers of the subsystem are remembered for
+ * their private namespaces.
+ */
+static int wipe_add(nvme_ctrl_t c, void *arg)
 {
-	if (!fw_commit_support_mud(dev))
-		return;
+	struct wipe_ctx *ctx = arg;
+	struct nvme_wipe *w = ctx->w;
+	char **siblings, *p;
+	nvme_ctrl_t sc;
+	size_t len = 0;
+	void *entry;
 
-	printf("Multiple Update Detected (MUD) Value: %u\n", result);
+	siblings = realloc(ctx->siblings, (w->nr + 1) * sizeof(*siblings));
+	if (!siblings)
+		return -ENOMEM;
+	ctx->siblings = siblings;
+	siblings[w->nr] = NULL;
 
-	if (result & 0x1)
-		printf("Detected an overlapping firmware/boot partition image update command\n"
-		       "sequence due to processing a command from an Admin SQ on a controller\n");
+	entry = fleet_add(c, w->entry, &w->nr, sizeof(*w->entry));
+	if (!entry)
+		return -ENOMEM;
+	w->entry = entry;
 
-	if (result >> 1 & 0x1)
-		printf("Detected an overlapping firmware/boot partition image update command\n"
-		       "sequence due to processing a command from a Management Endpoint\n");
+	if (ctx->action != WIPE_FORMAT)
+		return 0;
+
+	nvme_subsystem_for_each_ctrl(nvme_ctrl_get_subsystem(c), sc) {
+		if (sc == c || !nvme_ctrl_get_name(sc))
+			continue;
+		p = realloc(siblings[w->nr - 1],
+			    len + strlen(nvme_ctrl_get_name(sc)) + 2);
+		if (!p)
+			return -ENOMEM;
+		len += sprintf(p + len, "%s%s", len ? "," : "",
+			       nvme_ctrl_get_name(sc));
+		siblings[w->nr - 1] = p;
+	}
+
+	return 0;
 }
 
-static int fw_commit(int argc, char **argv, struct command *cmd, struct plugin *plugin)
-{
-	const char *desc = "Verify downloaded firmware image and "
-		"commit to specific firmware slot. Device is not automatically "
-		"reset following firmware activation. A reset may be issued "
-		"with an 'echo 1 > /sys/class/nvme/nvmeX/reset_controller'. "
-		"Ensure nvmeX is the device you just activated before reset.";
-	const char *slot = "[0-7]: firmware slot for commit action";
-	const char *action = "[0-7]: commit action";
-	const char *bpid = "[0,1]: boot partition identifier, if applicable (default: 0)";
+static int wipe(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Erase all user data of a set of controllers "
+		"concurrently, either by formatting their namespaces or by a "
+		"sanitize operation. Sanitize progress is polled from the "
+		"sanitize log at intervals adapted to the remaining time, and "
+		"a summary of all controllers is printed at the end.";
+	const char *devices = "comma separated list of controllers (e.g. nvme0,nvme1)";
+	const char *model = "only controllers whose model matches this glob";
+	const char *action = "format, block-erase, overwrite or crypto-erase";
+	const char *ses = "[0-2]: secure erase setting of format (default: 1)";
+	const char *no_dealloc = "No deallocate after sanitize.";
+	const char *ause = "Allow unrestricted sanitize exit.";
+	const char *owpass = "Overwrite pass count.";
+	const char *ovrpat = "Overwrite pattern.";
+	const char *interval = "maximum seconds between sanitize log polls";
+	const char *wipe_jobs = "maximum number of controllers wiped concurrently "
+		"(default: all)";
+	const char *force = "The \"I know what I'm doing\" flag, skip confirmation before sending command";
 
-	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	__u32 result;
-	int err;
+	_cleanup_nvme_root_ nvme_root_t root = NULL;
+	_cleanup_free_ struct nvme_fleet_entry *entries = NULL;
+	struct nvme_wipe w = { 0 };
+	struct wipe_ctx ctx = { 0 };
+	nvme_print_flags_t flags;
+	struct timeval end;
+	int i, err;
 
 	struct config {
-		__u8	slot;
+		char	*devices;
+		char	*model;
 		__u8	action;
-		__u8	bpid;
+		__u8	ses;
+		bool	no_dealloc;
+		bool	ause;
+		__u8	owpass;
+		__u32	ovrpat;
+		__u32	interval;
+		__u32	jobs;
+		bool	force;
 	};
 
 	struct config cfg = {
-		.slot	= 0,
-		.action	= 0,
-		.bpid	= 0,
+		.devices	= NULL,
+		.model		= NULL,
+		.action		= 0xff,
+		.ses		= 1,
+		.no_dealloc	= false,
+		.ause		= false,
+		.owpass		= 0,
+		.ovrpat		= 0,
+		.interval	= 60,
+		.jobs		= 0,
+		.force		= false,
+	};
+
+	OPT_VALS(actions) = {
+		VAL_BYTE("format", WIPE_FORMAT),
+		VAL_BYTE("block-erase", NVME_SANITIZE_SANACT_START_BLOCK_ERASE),
+		VAL_BYTE("overwrite", NVME_SANITIZE_SANACT_START_OVERWRITE),
+		VAL_BYTE("crypto-erase", NVME_SANITIZE_SANACT_START_CRYPTO_ERASE),
+		VAL_END()
 	};
 
+	nvme_cfg.timeout = 600000;
+
 	NVME_ARGS(opts,
-		  OPT_BYTE("slot",   's', &cfg.slot,   slot),
-		  OPT_BYTE("action", 'a', &cfg.action, action),
-		  OPT_BYTE("bpid",   'b', &cfg.bpid,   bpid));
+		  OPT_LIST("devices",    'd', &cfg.devices,    devices),
+		  OPT_STRING("model",    'm', "GLOB", &cfg.model, model),
+		  OPT_BYTE("action",     'a', &cfg.action,     action, actions),
+		  OPT_BYTE("ses",        's', &cfg.ses,        ses),
+		  OPT_FLAG("no-dealloc", 'D', &cfg.no_dealloc, no_dealloc),
+		  OPT_FLAG("ause",       'u', &cfg.ause,       ause),
+		  OPT_BYTE("owpass",     'n', &cfg.owpass,     owpass),
+		  OPT_UINT("ovrpat",     'p', &cfg.ovrpat,     ovrpat),
+		  OPT_UINT("interval",   'i', &cfg.interval,   interval),
+		  OPT_UINT("jobs",       'j', &cfg.jobs,       wipe_jobs),
+		  OPT_FLAG("force",        0, &cfg.force,      force));
 
-	err = parse_and_open(&dev, argc, argv, desc, opts);
+	err = parse_args(argc, argv, desc, opts);
 	if (err)
 		return err;
 
-	if (cfg.slot > 7) {
-		nvme_show_error("invalid slot:%d", cfg.slot);
-		return -EINVAL;
-	}
-	if (cfg.action > 7 || cfg.action == 4 || cfg.action == 5) {
-		nvme_show_error("invalid action:%d", cfg.action);
-		return -EINVAL;
-	}
-	if (cfg.bpid > 1) {
-		nvme_show_error("invalid boot partition id:%d", cfg.bpid);
-		return -EINVAL;
-	}
-
-	struct nvme_fw_commit_args args = {
-		.args_size	= sizeof(args),
-		.slot		= cfg.slot,
-		.action		= cfg.action,
-		.bpid		= cfg.bpid,
-		.timeout	= nvme_cfg.timeout,
-		.result		= &result,
-	};
-	err = nvme_cli_fw_commit(dev, &args);
-
+	err = validate_output_format(nvme_cfg.output_format, &flags);
 	if (err < 0) {
-		nvme_show_error("fw-commit: %s", nvme_strerror(errno));
-	} else if (err != 0) {
-		__u32 val = nvme_status_get_value(err);
-		int type = nvme_status_get_type(err);
+		nvme_show_error("Invalid output format");
+		return err;
+	}
 
-		if (type == NVME_STATUS_TYPE_NVME) {
-			switch (val & 0x7ff) {
-			case NVME_SC_FW_NEEDS_CONV_RESET:
-			case NVME_SC_FW_NEEDS_SUBSYS_RESET:
-			case NVME_SC_FW_NEEDS_RESET:
-				printf("Success activating firmware action:%d slot:%d",
-				       cfg.action, cfg.slot);
-				if (cfg.action == 6 || cfg.action == 7)
-					printf(" bpid:%d", cfg.bpid);
-				printf(", but firmware requires %s reset\n",
-				       nvme_fw_status_reset_type(val));
-				break;
-			default:
-				nvme_show_status(err);
-				break;
-			}
-		} else {
-			nvme_show_status(err);
-		}
-	} else {
-		printf("Success committing firmware action:%d slot:%d",
-		       cfg.action, cfg.slot);
-		if (cfg.action == 6 || cfg.action == 7)
-			printf(" bpid:%d", cfg.bpid);
-		printf("\n");
-		fw_commit_print_mud(dev, result);
+	/* Never wipe every controller of the host by accident */
+	if (!cfg.devices && !cfg.model) {
+		nvme_show_error("either [--devices | -d] or [--model | -m] is required");
+		return -EINVAL;
+	}
+	if (cfg.action == 0xff) {
+		nvme_show_error("required argument [--action | -a] not specified");
+		return -EINVAL;
+	}
+	if (cfg.action == WIPE_FORMAT) {
+		if (cfg.ses > 7) {
+			nvme_show_error("invalid secure erase settings:%d", cfg.ses);
+			return -EINVAL;
+		}
+	} else if (cfg.action != NVME_SANITIZE_SANACT_START_OVERWRITE &&
+		   (cfg.owpass || cfg.ovrpat)) {
+		nvme_show_error("SANACT is not Overwrite");
+		return -EINVAL;
+	}
+	if (cfg.owpass > 15) {
+		nvme_show_error("OWPASS out of range [0-15]");
+		return -EINVAL;
 	}
+	if (!cfg.interval)
+		cfg.interval = 1;
 
-	return err;
-}
+	root = nvme_create_root(stderr, log_level);
+	if (!root) {
+		nvme_show_error("Failed to create topology root: %s", nvme_strerror(errno));
+		return -errno;
+	}
+	nvme_root_skip_namespaces(root);
+	err = nvme_scan_topology(root, NULL, NULL);
+	if (err < 0) {
+		nvme_show_error("Failed to scan topology: %s", nvme_strerror(errno));
+		return -errno;
+	}
 
-static int subsystem_reset(int argc, char **argv, struct command *cmd, struct plugin *plugin)
-{
-	const char *desc = "Resets the NVMe subsystem";
+	ctx.w = &w;
+	ctx.action = cfg.action;
+	ctx.ses = cfg.ses;
+	ctx.no_dealloc = cfg.no_dealloc;
+	ctx.ause = cfg.ause;
+	ctx.owpass = cfg.owpass;
+	ctx.ovrpat = cfg.ovrpat;
+	ctx.max_poll_ms = cfg.interval * 1000;
 
-	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	int err;
+	err = ctrl_select(root, cfg.devices, cfg.model, NULL, wipe_add, &ctx);
+	entries = w.entry;
+	if (err)
+		goto out;
+	if (!w.nr) {
+		nvme_show_error("no controller matches");
+		err = -ENODEV;
+		goto out;
+	}
 
-	NVME_ARGS(opts);
+	for (i = 0; actions[i].str; i++)
+		if (actions[i].val.byte == cfg.action)
+			w.action = actions[i].str;
 
-	err = parse_and_open(&dev, argc, argv, desc, opts);
-	if (err)
-		return err;
+	if (!cfg.force) {
+		fprintf(stderr, "You are about to %s %d controller(s):\n",
+			cfg.action == WIPE_FORMAT ? "format" : "sanitize", w.nr);
+		for (i = 0; i < w.nr; i++)
+			fprintf(stderr, "  %s %s %s%s%s%s\n", w.entry[i].device,
+				w.entry[i].model, w.entry[i].serial,
+				ctx.siblings[i] ? " (with " : "",
+				ctx.siblings[i] ? : "",
+				ctx.siblings[i] ? ")" : "");
+		fprintf(stderr,
+			"WARNING: This irrevocably deletes all data of these controllers.\n"
+			"You have 10 seconds to press Ctrl-C to cancel this operation.\n\n"
+			"Use the force [--force] option to suppress this warning.\n");
+		sleep(10);
+		fprintf(stderr, "Sending %s operations ...\n", w.action);
+	}
 
-	err = nvme_subsystem_reset(dev_fd(dev));
-	if (err < 0) {
-		if (errno == ENOTTY)
-			nvme_show_error("Subsystem-reset: NVM Subsystem Reset not supported.");
-		else
-			nvme_show_error("Subsystem-reset: %s", nvme_strerror(errno));
-	} else if (argconfig_parse_seen(opts, "verbose"))
-		printf("resetting subsystem through %s\n", dev->name);
+	gettimeofday(&ctx.progress.start, NULL);
+	parallel_for_each(w.nr, cfg.jobs ? cfg.jobs : w.nr, wipe_one, &ctx);
+	gettimeofday(&end, NULL);
+	w.elapsed_us = elapsed_utime(ctx.progress.start, end);
+
+	nvme_show_wipe(&w, flags);
+
+	for (i = 0; i < w.nr; i++)
+		if (w.entry[i].failed)
+			err = -EIO;
+out:
+	for (i = 0; ctx.siblings && i < w.nr; i++)
+		free(ctx.siblings[i]);
+	free(ctx.siblings);
 
 	return err;
 }
 
-static int reset(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+struct self_test_fleet_ctx {
+	struct nvme_self_test_fleet *f;
+	__u32 nsid;
+	__u8 stc;
+	struct fleet_progress progress;
+};
+
+/* The newest entry of the self-test log holds the result of our test */
+static void self_test_fleet_result(struct self_test_fleet_ctx *ctx,
+				   struct nvme_self_test_fleet_entry *e,
+				   struct nvme_self_test_log *log)
 {
-	const char *desc = "Resets the NVMe controller\n";
+	e->dsts = log->result[0].dsts;
+	e->seg = log->result[0].seg;
+
+	if ((e->dsts & NVME_ST_RESULT_MASK) == NVME_ST_RESULT_NOT_USED ||
+	    e->dsts >> NVME_ST_CODE_SHIFT != ctx->stc) {
+		snprintf(e->fleet.error, sizeof(e->fleet.error), "no self-test result logged");
+		fleet_error(&e->fleet, "no-result", 0);
+		return;
+	}
+
+	switch (e->dsts & NVME_ST_RESULT_MASK) {
+	case NVME_ST_RESULT_NO_ERR:
+		e->fleet.result = "passed";
+		return;
+	case NVME_ST_RESULT_FATAL_ERR:
+		fleet_error(&e->fleet, "fatal-error", 0);
+		return;
+	case NVME_ST_RESULT_UNKNOWN_SEG_FAIL:
+		fleet_error(&e->fleet, "failed", 0);
+		return;
+	case NVME_ST_RESULT_KNOWN_SEG_FAIL:
+		snprintf(e->fleet.error, sizeof(e->fleet.error), "segment %u failed", e->seg);
+		fleet_error(&e->fleet, "failed", 0);
+		return;
+	default:
+		fleet_error(&e->fleet, "aborted", 0);
+		return;
+	}
+}
 
+static void self_test_fleet_one(unsigned int idx, void *arg)
+{
+	struct self_test_fleet_ctx *ctx = arg;
+	struct nvme_self_test_fleet_entry *e = &ctx->f->entry[idx];
+	_cleanup_free_ struct nvme_self_test_log *log = NULL;
+	_cleanup_free_ struct nvme_id_ctrl *ctrl = NULL;
 	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	int err;
+	unsigned int secs = 0, t0 = 0, cnt = 0, wthr, interval = 1;
+	struct timeval start;
+	char path[PATH_MAX];
+	int err, p0 = -1, p = 0;
+	__u32 remaining;
+	__u8 op;
+
+	gettimeofday(&start, NULL);
+
+	snprintf(path, sizeof(path), "/dev/%s", e->fleet.device);
+	if (open_dev_direct(&dev, path, O_RDONLY, 0)) {
+		fleet_error(&e->fleet, "open-failed", -1);
+		goto out;
+	}
 
-	NVME_ARGS(opts);
+	ctrl = nvme_alloc(sizeof(*ctrl));
+	log = nvme_alloc(sizeof(*log));
+	if (!ctrl || !log) {
+		errno = ENOMEM;
+		fleet_error(&e->fleet, "identify-failed", -1);
+		goto out;
+	}
 
-	err = parse_and_open(&dev, argc, argv, desc, opts);
-	if (err)
-		return err;
+	err = nvme_cli_identify_ctrl(dev, ctrl);
+	if (err) {
+		fleet_error(&e->fleet, "identify-failed", err);
+		goto out;
+	}
+	if (!(le16_to_cpu(ctrl->oacs) & NVME_CTRL_OACS_SELF_TEST)) {
+		snprintf(e->fleet.error, sizeof(e->fleet.error), "device self-test not supported");
+		fleet_error(&e->fleet, "not-supported", 0);
+		goto out;
+	}
 
-	err = nvme_ctrl_reset(dev_fd(dev));
-	if (err < 0)
-		nvme_show_error("Reset: %s", nvme_strerror(errno));
-	else if (argconfig_parse_seen(opts, "verbose"))
-		printf("resetting controller %s\n", dev->name);
+	err = nvme_cli_get_log_device_self_test(dev, log);
+	if (err) {
+		fleet_error(&e->fleet, "log-failed", err);
+		goto out;
+	}
+	if ((log->current_operation & NVME_ST_CURR_OP_MASK) != NVME_ST_CURR_OP_NOT_RUNNING) {
+		snprintf(e->fleet.error, sizeof(e->fleet.error), "self-test already running");
+		fleet_error(&e->fleet, "busy", 0);
+		goto out;
+	}
 
-	return err;
-}
+	struct nvme_dev_self_test_args args = {
+		.args_size	= sizeof(args),
+		.fd		= dev_fd(dev),
+		.nsid		= ctx->nsid,
+		.stc		= ctx->stc,
+		.timeout	= nvme_cfg.timeout,
+		.result		= NULL,
+	};
+	err = nvme_dev_self_test(&args);
+	if (err) {
+		fleet_error(&e->fleet, "start-failed", err);
+		goto out;
+	}
 
-static int ns_rescan(int argc, char **argv, struct command *cmd, struct plugin *plugin)
-{
-	const char *desc = "Rescans the NVMe namespaces\n";
+	/* Same stall limit as device-self-test --wait */
+	wthr = le16_to_cpu(ctrl->edstt) * 60 / 100 + 60;
 
-	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	int err;
+	for (;;) {
+		sleep(interval);
+		secs += interval;
+		cnt += interval;
 
-	NVME_ARGS(opts);
+		err = nvme_cli_get_log_device_self_test(dev, log);
+		e->fleet.polls++;
+		if (err) {
+			fleet_error(&e->fleet, "log-failed", err);
+			goto out;
+		}
 
-	err = parse_and_open(&dev, argc, argv, desc, opts);
-	if (err)
-		return err;
+		op = log->current_operation & NVME_ST_CURR_OP_MASK;
+		if (op == NVME_ST_CURR_OP_NOT_RUNNING)
+			break;
 
-	err = nvme_ns_rescan(dev_fd(dev));
-	if (err < 0)
-		nvme_show_error("Namespace Rescan: %s\n", nvme_strerror(errno));
-	else if (argconfig_parse_seen(opts, "verbose"))
-		printf("rescanning namespaces through %s\n", dev->name);
+		if (log->completion < p) {
+			snprintf(e->fleet.error, sizeof(e->fleet.error), "progress broken");
+			fleet_error(&e->fleet, "log-failed", 0);
+			goto out;
+		} else if (log->completion != p) {
+			p = log->completion;
+			cnt = 0;
+		}
 
-	return err;
+		if (cnt > wthr) {
+			snprintf(e->fleet.error, sizeof(e->fleet.error),
+				 "no progress for %u seconds", wthr);
+			fleet_error(&e->fleet, "timeout", 0);
+			goto out;
+		}
+
+		if (p0 < 0) {
+			p0 = p;
+			t0 = secs;
+		}
+		interval = self_test_poll_interval(secs - t0, p0, p,
+						   self_test_duration(ctrl, op),
+						   &remaining);
+		__atomic_store_n(&e->fleet.progress, p * 65536 / 100, __ATOMIC_RELAXED);
+		__atomic_store_n(&e->fleet.remaining_s, remaining, __ATOMIC_RELAXED);
+		fleet_report(&ctx->progress, ctx->f->entry, ctx->f->nr,
+			     sizeof(*ctx->f->entry));
+	}
+
+	self_test_fleet_result(ctx, e, log);
+out:
+	fleet_done(&e->fleet, start);
 }
 
-static int sanitize_cmd(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+/* The self-test runs on the NVM subsystem, one controller per subsystem */
+static int self_test_fleet_add(nvme_ctrl_t c, void *arg)
 {
-	const char *desc = "Send a sanitize command.";
-	const char *emvs_desc = "Enter media verification state.";
-	const char *no_dealloc_desc = "No deallocate after sanitize.";
-	const char *oipbp_desc = "Overwrite invert pattern between passes.";
-	const char *owpass_desc = "Overwrite pass count.";
-	const char *ause_desc = "Allow unrestricted sanitize exit.";
-	const char *sanact_desc = "Sanitize action: 1 = Exit failure mode, 2 = Start block erase,"
-				"3 = Start overwrite, 4 = Start crypto erase, 5 = Exit media verification";
-	const char *ovrpat_desc = "Overwrite pattern.";
+	struct nvme_self_test_fleet *f = arg;
+	void *entry;
 
-	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	int err;
+	entry = fleet_add(c, f->entry, &f->nr, sizeof(*f->entry));
+	if (!entry)
+		return -ENOMEM;
+	f->entry = entry;
+
+	return 0;
+}
+
+static int fleet_self_test(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Run a short or extended device self-test on a set of "
+		"controllers in parallel and wait for all of them. The self-test "
+		"log is read at intervals adapted to the expected remaining time "
+		"and a summary of all controllers is printed at the end.";
+	const char *devices = "comma separated list of controllers (e.g. nvme0,nvme1)";
+	const char *model = "only controllers whose model matches this glob";
+	const char *namespace_id = "namespace to test (default: all namespaces)";
+	const char *self_test_code = "short or extended self-test";
+	const char *fleet_jobs = "maximum number of controllers tested concurrently "
+		"(default: all)";
+
+	_cleanup_nvme_root_ nvme_root_t root = NULL;
+	_cleanup_free_ struct nvme_self_test_fleet_entry *entries = NULL;
+	struct nvme_self_test_fleet f = { 0 };
+	struct self_test_fleet_ctx ctx = { 0 };
+	nvme_print_flags_t flags;
+	struct timeval end;
+	int i, err;
 
 	struct config {
-		bool	no_dealloc;
-		bool	oipbp;
-		__u8	owpass;
-		bool	ause;
-		__u8	sanact;
-		__u32	ovrpat;
-		bool	emvs;
+		char	*devices;
+		char	*model;
+		__u32	namespace_id;
+		__u8	stc;
+		__u32	jobs;
 	};
 
 	struct config cfg = {
-		.no_dealloc	= false,
-		.oipbp		= false,
-		.owpass		= 0,
-		.ause		= false,
-		.sanact		= 0,
-		.ovrpat		= 0,
-		.emvs		= false,
+		.devices	= NULL,
+		.model		= NULL,
+		.namespace_id	= NVME_NSID_ALL,
+		.stc		= NVME_ST_CODE_SHORT,
+		.jobs		= 0,
 	};
 
-	OPT_VALS(sanact) = {
-		VAL_BYTE("exit-failure", NVME_SANITIZE_SANACT_EXIT_FAILURE),
-		VAL_BYTE("start-block-erase", NVME_SANITIZE_SANACT_START_BLOCK_ERASE),
-		VAL_BYTE("start-overwrite", NVME_SANITIZE_SANACT_START_OVERWRITE),
-		VAL_BYTE("start-crypto-erase", NVME_SANITIZE_SANACT_START_CRYPTO_ERASE),
-		VAL_BYTE("exit-media-verification", NVME_SANITIZE_SANACT_EXIT_MEDIA_VERIF),
+	OPT_VALS(stcs) = {
+		VAL_BYTE("short", NVME_ST_CODE_SHORT),
+		VAL_BYTE("extended", NVME_ST_CODE_EXTENDED),
 		VAL_END()
 	};
 
 	NVME_ARGS(opts,
-		  OPT_FLAG("no-dealloc", 'd', &cfg.no_dealloc, no_dealloc_desc),
-		  OPT_FLAG("oipbp",      'i', &cfg.oipbp,      oipbp_desc),
-		  OPT_BYTE("owpass",     'n', &cfg.owpass,     owpass_desc),
-		  OPT_FLAG("ause",       'u', &cfg.ause,       ause_desc),
-		  OPT_BYTE("sanact",     'a', &cfg.sanact,     sanact_desc, sanact),
-		  OPT_UINT("ovrpat",     'p', &cfg.ovrpat,     ovrpat_desc),
-		  OPT_FLAG("emvs",       'e', &cfg.emvs,       emvs_desc));
+		  OPT_LIST("devices",        'd', &cfg.devices,      devices),
+		  OPT_STRING("model",        'm', "GLOB", &cfg.model, model),
+		  OPT_UINT("namespace-id",   'n', &cfg.namespace_id, namespace_id),
+		  OPT_BYTE("self-test-code", 's', &cfg.stc,          self_test_code, stcs),
+		  OPT_UINT("jobs",           'j', &cfg.jobs,         fleet_jobs));
 
-	err = parse_and_open(&dev, argc, argv, desc, opts);
+	err = parse_args(argc, argv, desc, opts);
 	if (err)
 		return err;
 
-	switch (cfg.sanact) {
-	case NVME_SANITIZE_SANACT_EXIT_FAILURE:
-	case NVME_SANITIZE_SANACT_START_BLOCK_ERASE:
-	case NVME_SANITIZE_SANACT_START_OVERWRITE:
-	case NVME_SANITIZE_SANACT_START_CRYPTO_ERASE:
-	case NVME_SANITIZE_SANACT_EXIT_MEDIA_VERIF:
-		break;
-	default:
-		nvme_show_error("Invalid Sanitize Action");
+	err = validate_output_format(nvme_cfg.output_format, &flags);
+	if (err < 0) {
+		nvme_show_error("Invalid output format");
+		return err;
+	}
+
+	if (cfg.stc != NVME_ST_CODE_SHORT && cfg.stc != NVME_ST_CODE_EXTENDED) {
+		nvme_show_error("invalid self-test code:%#x", cfg.stc);
 		return -EINVAL;
 	}
 
-	if (cfg.ause || cfg.no_dealloc) {
-		if (cfg.sanact == NVME_SANITIZE_SANACT_EXIT_FAILURE) {
-			nvme_show_error("SANACT is Exit Failure Mode");
-			return -EINVAL;
-		} else if (cfg.sanact == NVME_SANITIZE_SANACT_EXIT_MEDIA_VERIF) {
-			nvme_show_error("SANACT is Exit Media Verification State");
-			return -EINVAL;
-		}
+	root = nvme_create_root(stderr, log_level);
+	if (!root) {
+		nvme_show_error("Failed to create topology root: %s", nvme_strerror(errno));
+		return -errno;
+	}
+	nvme_root_skip_namespaces(root);
+	err = nvme_scan_topology(root, NULL, NULL);
+	if (err < 0) {
+		nvme_show_error("Failed to scan topology: %s", nvme_strerror(errno));
+		return -errno;
 	}
 
-	if (cfg.sanact == NVME_SANITIZE_SANACT_START_OVERWRITE) {
-		if (cfg.owpass > 15) {
-			nvme_show_error("OWPASS out of range [0-15]");
-			return -EINVAL;
-		}
-	} else {
-		if (cfg.owpass || cfg.oipbp || cfg.ovrpat) {
-			nvme_show_error("SANACT is not Overwrite");
-			return -EINVAL;
-		}
+	err = ctrl_select(root, cfg.devices, cfg.model, NULL, self_test_fleet_add, &f);
+	entries = f.entry;
+	if (err)
+		return err;
+	if (!f.nr) {
+		nvme_show_error("no controller matches");
+		return -ENODEV;
 	}
 
-	struct nvme_sanitize_nvm_args args = {
-		.args_size	= sizeof(args),
-		.sanact		= cfg.sanact,
-		.ause		= cfg.ause,
-		.owpass		= cfg.owpass,
-		.oipbp		= cfg.oipbp,
-		.nodas		= cfg.no_dealloc,
-		.ovrpat		= cfg.ovrpat,
-		.result		= NULL,
-		.emvs		= cfg.emvs,
-	};
+	f.stc = cfg.stc;
 
-	err = nvme_cli_sanitize_nvm(dev, &args);
-	if (err < 0)
-		nvme_show_error("sanitize: %s", nvme_strerror(errno));
-	else if (err > 0)
-		nvme_show_status(err);
+	ctx.f = &f;
+	ctx.nsid = cfg.namespace_id;
+	ctx.stc = cfg.stc;
 
-	return err;
+	gettimeofday(&ctx.progress.start, NULL);
+	parallel_for_each(f.nr, cfg.jobs ? cfg.jobs : f.nr, self_test_fleet_one, &ctx);
+	gettimeofday(&end, NULL);
+	f.elapsed_us = elapsed_utime(ctx.progress.start, end);
+
+	nvme_show_self_test_fleet(&f, flags);
+
+	for (i = 0; i < f.nr; i++)
+		if (f.entry[i].fleet.failed)
+			return -EIO;
+
+	return 0;
 }
 
 static int nvme_get_single_property(int fd, struct get_reg_config *cfg, __u64 *value)
@@ -9828,6 +12384,7 @@ static int show_topology_cmd(int argc, char **argv, struct command *command, str
 	nvme_print_flags_t flags;
 	_cleanup_nvme_root_ nvme_root_t r = NULL;
 	enum nvme_cli_topo_ranking rank;
+	char gen[TOPO_CACHE_GEN_LEN];
 	int err;
 
 	struct config {
@@ -9869,12 +12426,15 @@ static int show_topology_cmd(int argc, char **argv, struct command *command, str
 		return -errno;
 	}
 
+	if (topo_cache_generation(gen, sizeof(gen)))
+		gen[0] = '\0';
 	err = nvme_scan_topology(r, NULL, NULL);
 	if (err < 0) {
 		nvme_show_error("Failed to scan topology: %s", nvme_strerror(errno));
 		return err;
 	}
 
+	topo_cache_save(r, gen);
 	nvme_show_topology(r, rank, flags);
 
 	return err;
@@ -74,6 +74,144 @@ struct nvme_dev {
 
 #define dev_fd(d) __dev_fd(d, __func__, __LINE__)
 
+/*
+ * Per controller state shared by fw-rollout, wipe and fleet-self-test,
+ * the progress fields are updated while the command runs.
+ */
+struct nvme_fleet_entry {
+	char device[32];
+	char model[41];
+	char serial[21];
+	const char *result;
+	bool failed;
+	char error[64];
+	__u32 progress;		/* in units of 1/65536 */
+	__u32 remaining_s;
+	__u32 polls;
+	bool done;
+	uint64_t elapsed_us;
+};
+
+/* Per controller outcome of fw-rollout */
+struct nvme_fw_rollout_entry {
+	struct nvme_fleet_entry fleet;
+	char fw_before[9];
+	char slot_fw[9];
+	__u8 active_slot;
+	__u8 next_slot;
+	const char *reset;
+	__u32 mud;
+	uint64_t download_us;
+	uint64_t commit_us;
+};
+
+struct nvme_fw_rollout {
+	const char *fw;
+	__u8 slot;
+	__u8 action;
+	struct nvme_fw_rollout_entry *entry;
+	int nr;
+	uint64_t elapsed_us;
+};
+
+struct nvme_wipe {
+	const char *action;
+	struct nvme_fleet_entry *entry;
+	int nr;
+	uint64_t elapsed_us;
+};
+
+/* Per controller outcome of fleet-self-test */
+struct nvme_self_test_fleet_entry {
+	struct nvme_fleet_entry fleet;
+	__u8 dsts;
+	__u8 seg;
+};
+
+struct nvme_self_test_fleet {
+	__u8 stc;
+	struct nvme_self_test_fleet_entry *entry;
+	int nr;
+	uint64_t elapsed_us;
+};
+
+#define NVME_ZNS_FILL_BUCKETS	10
+
+struct nvme_zns_zone_fill {
+	__u64 zslba;
+	__u64 written;
+	__u64 cap;
+	__u8 state;
+};
+
+/* Zone counts and fill levels of a zoned namespace, see zns zone-summary */
+struct nvme_zns_zone_summary {
+	__u32 nsid;
+	__u64 nr_zones;
+	__u64 zsze;
+	__u64 state[16];
+	__u64 fill[NVME_ZNS_FILL_BUCKETS];
+	__u64 written;
+	__u64 capacity;
+	__u32 mor;
+	__u32 mar;
+	struct nvme_zns_zone_fill *emptiest;
+	struct nvme_zns_zone_fill *fullest;
+	int nr_top;
+};
+
+/* Running event counts of a reclaim unit handle, see fdp events --watch */
+struct nvme_fdp_ruh_events {
+	bool lv;
+	__u16 rgid;
+	__u8 ruhid;
+	__u64 events;
+	__u64 runfw;
+	__u64 realloc;
+	__u64 modify;
+	__u64 nlbam;
+};
+
+/* Reclaim unit handle usage over a sampling run, see fdp status --interval */
+struct nvme_fdp_ruh_usage {
+	__u16 pid;
+	__u16 ruhid;
+	__u64 ruamw;
+	__u32 earutr;
+	__u64 written;
+	double seconds;
+	__u32 switches;
+	double rate;
+	double ttl;
+};
+
+struct nvme_fdp_ruh_trend {
+	__u32 nsid;
+	__u32 samples;
+	double seconds;
+	struct nvme_fdp_ruh_usage *ruhs;
+	int nr;
+	double mean_rate;
+	double imbalance;
+	double spread;
+};
+
+/* Outcome of a placement write run, see fdp workload */
+struct nvme_fdp_workload {
+	__u32 nsid;
+	__u16 egid;
+	const char *mode;
+	unsigned short *pids;
+	int nr_pids;
+	__u64 *written;
+	__u64 writes;
+	__u64 bytes;
+	double seconds;
+	long double hbmw;
+	long double mbmw;
+	long double mbe;
+};
+
 struct nvme_config {
 	char *output_format;
 	int verbose;
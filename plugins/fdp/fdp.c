@@ -5,14 +5,18 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <signal.h>
 #include <inttypes.h>
 #include <linux/fs.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 
 #include "common.h"
 #include "nvme.h"
 #include "libnvme.h"
 #include "nvme-print.h"
+#include "util/cleanup.h"
+#include "util/parallel.h"
 
 #define CREATE_CMD
 #include "fdp.h"
@@ -237,12 +241,169 @@ out:
 	return err;
 }
 
+static volatile sig_atomic_t fdp_stop;
+
+static void fdp_signal(int signum)
+{
+	fdp_stop = 1;
+}
+
+struct fdp_events_watch {
+	struct nvme_fdp_ruh_events *ruhs;
+	int nr_ruhs;
+	__u64 last_ts;
+	unsigned int seen;
+	bool started;
+};
+
+static __u64 fdp_event_ts(struct nvme_fdp_event *event)
+{
+	return int48_to_long(event->ts.timestamp);
+}
+
+static struct nvme_fdp_ruh_events *fdp_events_ruh(struct fdp_events_watch *wt,
+						  struct nvme_fdp_event *event)
+{
+	bool lv = event->flags & NVME_FDP_EVENT_F_LV;
+	__u16 rgid = lv ? le16_to_cpu(event->rgid) : 0;
+	__u8 ruhid = lv ? event->ruhid : 0;
+	struct nvme_fdp_ruh_events *ruhs, *ruh;
+	int i;
+
+	for (i = 0; i < wt->nr_ruhs; i++) {
+		ruh = &wt->ruhs[i];
+		if (ruh->lv == lv && ruh->rgid == rgid && ruh->ruhid == ruhid)
+			return ruh;
+	}
+
+	ruhs = realloc(wt->ruhs, (wt->nr_ruhs + 1) * sizeof(*ruhs));
+	if (!ruhs)
+		return NULL;
+	wt->ruhs = ruhs;
+
+	ruh = &ruhs[wt->nr_ruhs++];
+	memset(ruh, 0, sizeof(*ruh));
+	ruh->lv = lv;
+	ruh->rgid = rgid;
+	ruh->ruhid = ruhid;
+
+	return ruh;
+}
+
+static void fdp_events_count(struct nvme_fdp_ruh_events *ruh, struct nvme_fdp_event *event)
+{
+	struct nvme_fdp_event_realloc *mr;
+
+	ruh->events++;
+
+	switch (event->type) {
+	case NVME_FDP_EVENT_RUNFW:
+		ruh->runfw++;
+		break;
+	case NVME_FDP_EVENT_REALLOC:
+		mr = (struct nvme_fdp_event_realloc *)&event->type_specific;
+		ruh->realloc++;
+		ruh->nlbam += le16_to_cpu(mr->nlbam);
+		break;
+	case NVME_FDP_EVENT_MODIFY:
+		ruh->modify++;
+		break;
+	default:
+		break;
+	}
+}
+
+/*
+ * Reads the events log and shows the events that came after the cursor,
+ * the newest timestamp seen so far plus how many events carried it. The
+ * log only keeps the most recent events, so anything older than what it
+ * holds at the next poll is lost.
+ */
+static int fdp_events_poll(int fd, __u16 egid, bool host_events,
+			   struct fdp_events_watch *wt, nvme_print_flags_t flags)
+{
+	struct nvme_fdp_events_log events;
+	struct nvme_fdp_event *order[ARRAY_SIZE(events.events)];
+	struct nvme_fdp_ruh_events *ruh;
+	unsigned int i, j, n, seen = 0;
+	__u64 ts;
+	int err;
+
+	err = nvme_get_log_fdp_events(fd, egid, host_events, 0, sizeof(events), &events);
+	if (err)
+		return err;
+
+	n = min(le32_to_cpu(events.n), ARRAY_SIZE(events.events));
+
+	for (i = 0; i < n; i++) {
+		ts = fdp_event_ts(&events.events[i]);
+		for (j = i; j > 0 && fdp_event_ts(order[j - 1]) > ts; j--)
+			order[j] = order[j - 1];
+		order[j] = &events.events[i];
+	}
+
+	if (wt->started && n == ARRAY_SIZE(events.events) &&
+	    fdp_event_ts(order[0]) > wt->last_ts)
+		fprintf(stderr, "events log wrapped, events may have been missed\n");
+
+	for (i = 0; i < n; i++) {
+		ts = fdp_event_ts(order[i]);
+		if (ts < wt->last_ts)
+			continue;
+		if (ts == wt->last_ts && seen++ < wt->seen)
+			continue;
+
+		ruh = fdp_events_ruh(wt, order[i]);
+		if (ruh)
+			fdp_events_count(ruh, order[i]);
+		nvme_show_fdp_event(order[i], ruh, flags);
+	}
+
+	if (n) {
+		wt->last_ts = fdp_event_ts(order[n - 1]);
+		for (wt->seen = 0, i = n; i > 0; i--) {
+			if (fdp_event_ts(order[i - 1]) != wt->last_ts)
+				break;
+			wt->seen++;
+		}
+	}
+	wt->started = true;
+
+	return 0;
+}
+
+static int fdp_events_watch(int fd, __u16 egid, bool host_events, __u32 interval,
+			    nvme_print_flags_t flags)
+{
+	struct fdp_events_watch wt = { 0 };
+	int err = 0;
+
+	signal(SIGINT, fdp_signal);
+	signal(SIGTERM, fdp_signal);
+
+	while (!fdp_stop) {
+		err = fdp_events_poll(fd, egid, host_events, &wt, flags);
+		if (err) {
+			nvme_show_status(err);
+			break;
+		}
+		sleep(interval);
+	}
+
+	nvme_show_fdp_ruh_events(wt.ruhs, wt.nr_ruhs, flags);
+	free(wt.ruhs);
+
+	return fdp_stop ? 0 : err;
+}
+
 static int fdp_events(int argc, char **argv, struct command *cmd, struct plugin *plugin)
 {
 	const char *desc = "Get Flexible Data Placement Events";
 	const char *egid = "Endurance group identifier";
 	const char *host_events = "Get host events";
 	const char *raw = "use binary output";
+	const char *watch = "keep polling the log and show new events as they appear";
+	const char *interval = "seconds between polls in watch mode";
 
 	nvme_print_flags_t flags;
 	struct nvme_dev *dev;
@@ -254,6 +415,8 @@ static int fdp_events(int argc, char **argv, struct command *cmd, struct plugin
 		bool	host_events;
 		char	*output_format;
 		bool	raw_binary;
+		bool	watch;
+		__u32	interval;
 	};
 
 	struct config cfg = {
@@ -261,6 +424,8 @@ static int fdp_events(int argc, char **argv, struct command *cmd, struct plugin
 		.host_events =	false,
 		.output_format	= "normal",
 		.raw_binary	= false,
+		.watch		= false,
+		.interval	= 1,
 	};
 
 	OPT_ARGS(opts) = {
@@ -268,6 +433,8 @@ static int fdp_events(int argc, char **argv, struct command *cmd, struct plugin
 		OPT_FLAG("host-events",  'E', &cfg.host_events,   host_events),
 		OPT_FMT("output-format", 'o', &cfg.output_format, output_format),
 		OPT_FLAG("raw-binary",   'b', &cfg.raw_binary,    raw),
+		OPT_FLAG("watch",        'w', &cfg.watch,         watch),
+		OPT_UINT("interval",     'i', &cfg.interval,      interval),
 		OPT_END()
 	};
 
@@ -288,6 +455,17 @@ static int fdp_events(int argc, char **argv, struct command *cmd, struct plugin
 		goto out;
 	}
 
+	if (cfg.watch) {
+		if (flags == BINARY || !cfg.interval) {
+			fprintf(stderr, "watch needs normal or json output and an interval\n");
+			err = -EINVAL;
+			goto out;
+		}
+		err = fdp_events_watch(dev_fd(dev), cfg.egid, cfg.host_events,
+				       cfg.interval, flags);
+		goto out;
+	}
+
 	memset(&events, 0x0, sizeof(events));
 
 	err = nvme_get_log_fdp_events(dev->direct.fd, cfg.egid,
@@ -305,15 +483,173 @@ out:
 	return err;
 }
 
+enum fdp_series_format {
+	FDP_SERIES_CSV,
+	FDP_SERIES_BINARY,
+};
+
+/* Record of a binary reclaim unit handle status series, little endian */
+struct fdp_ruh_sample {
+	__le64	ts;
+	__le16	pid;
+	__le16	ruhid;
+	__le32	earutr;
+	__le64	ruamw;
+};
+
+static void fdp_status_record(FILE *f, __u8 format, __u64 ts,
+			      struct nvme_fdp_ruh_status_desc *ruhs)
+{
+	struct fdp_ruh_sample s = {
+		.ts	= cpu_to_le64(ts),
+		.pid	= ruhs->pid,
+		.ruhid	= ruhs->ruhid,
+		.earutr	= ruhs->earutr,
+		.ruamw	= ruhs->ruamw,
+	};
+
+	if (format == FDP_SERIES_BINARY)
+		fwrite(&s, sizeof(s), 1, f);
+	else
+		fprintf(f, "%"PRIu64",%u,%u,%u,%"PRIu64"\n", (uint64_t)ts,
+			le16_to_cpu(ruhs->pid), le16_to_cpu(ruhs->ruhid),
+			le32_to_cpu(ruhs->earutr), (uint64_t)le64_to_cpu(ruhs->ruamw));
+}
+
+/*
+ * RUAMW counts down while a handle fills its reclaim unit and jumps up
+ * when the handle moves on to a new one. Only the intervals without such a
+ * switch tell how fast the handle is written.
+ */
+static void fdp_status_update(struct nvme_fdp_ruh_usage *u,
+			      struct nvme_fdp_ruh_status_desc *ruhs, double dt)
+{
+	__u64 ruamw = le64_to_cpu(ruhs->ruamw);
+
+	if (ruamw > u->ruamw) {
+		u->switches++;
+	} else {
+		u->written += u->ruamw - ruamw;
+		u->seconds += dt;
+	}
+	u->ruamw = ruamw;
+	u->earutr = le32_to_cpu(ruhs->earutr);
+}
+
+static void fdp_status_trend(struct nvme_fdp_ruh_trend *t)
+{
+	double sum = 0, rate_min = 0, rate_max = 0;
+	int i;
+
+	for (i = 0; i < t->nr; i++) {
+		struct nvme_fdp_ruh_usage *u = &t->ruhs[i];
+
+		u->rate = u->seconds ? u->written / u->seconds : 0;
+		u->ttl = u->rate ? u->ruamw / u->rate : -1;
+		if (u->earutr && (u->ttl < 0 || u->earutr < u->ttl))
+			u->ttl = u->earutr;
+
+		sum += u->rate;
+		rate_min = i ? min(rate_min, u->rate) : u->rate;
+		rate_max = max(rate_max, u->rate);
+	}
+
+	t->mean_rate = t->nr ? sum / t->nr : 0;
+	t->imbalance = t->mean_rate ? rate_max / t->mean_rate : 0;
+	t->spread = t->mean_rate ? (rate_max - rate_min) / t->mean_rate : 0;
+}
+
+static int fdp_status_sample(int fd, __u32 nsid, struct nvme_fdp_ruh_status *status,
+			     size_t len, __u32 interval, __u32 count, FILE *series,
+			     __u8 format, nvme_print_flags_t flags)
+{
+	__u16 nruhsd = le16_to_cpu(status->nruhsd);
+	_cleanup_free_ struct nvme_fdp_ruh_usage *ruhs = NULL;
+	struct nvme_fdp_ruh_trend t = { 0 };
+	struct timeval start, prev, now;
+	__u64 ts;
+	int i, err = 0;
+
+	ruhs = calloc(nruhsd, sizeof(*ruhs));
+	if (!ruhs)
+		return -ENOMEM;
+
+	t.nsid = nsid;
+	t.ruhs = ruhs;
+	t.nr = nruhsd;
+
+	if (series && format == FDP_SERIES_CSV)
+		fprintf(series, "timestamp_ms,pid,ruhid,earutr,ruamw\n");
+
+	signal(SIGINT, fdp_signal);
+	signal(SIGTERM, fdp_signal);
+
+	gettimeofday(&start, NULL);
+	prev = start;
+	now = start;
+
+	while (!fdp_stop) {
+		if (t.samples) {
+			err = nvme_fdp_reclaim_unit_handle_status(fd, nsid, len, status);
+			if (err) {
+				nvme_show_status(err);
+				break;
+			}
+			gettimeofday(&now, NULL);
+			if (le16_to_cpu(status->nruhsd) != nruhsd) {
+				fprintf(stderr, "number of reclaim unit handles changed\n");
+				err = -EAGAIN;
+				break;
+			}
+		}
+
+		ts = now.tv_sec * 1000ULL + now.tv_usec / 1000;
+		for (i = 0; i < nruhsd; i++) {
+			struct nvme_fdp_ruh_status_desc *d = &status->ruhss[i];
+
+			if (series)
+				fdp_status_record(series, format, ts, d);
+
+			if (t.samples) {
+				fdp_status_update(&ruhs[i], d,
+						  elapsed_utime(prev, now) / 1000000.0);
+			} else {
+				ruhs[i].pid = le16_to_cpu(d->pid);
+				ruhs[i].ruhid = le16_to_cpu(d->ruhid);
+				ruhs[i].ruamw = le64_to_cpu(d->ruamw);
+				ruhs[i].earutr = le32_to_cpu(d->earutr);
+			}
+		}
+		if (series)
+			fflush(series);
+
+		prev = now;
+		if (++t.samples == count)
+			break;
+		sleep(interval);
+	}
+
+	t.seconds = elapsed_utime(start, prev) / 1000000.0;
+	fdp_status_trend(&t);
+	nvme_show_fdp_ruh_trend(&t, flags);
+
+	return fdp_stop ? 0 : err;
+}
+
 static int fdp_status(int argc, char **argv, struct command *cmd, struct plugin *plugin)
 {
 	const char *desc = "Reclaim Unit Handle Status";
 	const char *namespace_id = "Namespace identifier";
 	const char *raw = "use binary output";
+	const char *interval = "sample the status every this many seconds and report usage trends";
+	const char *count = "number of samples to take, 0 until interrupted";
+	const char *series = "file to record every sample to";
+	const char *series_format = "format of the series file: csv or binary";
 
 	nvme_print_flags_t flags;
 	struct nvme_dev *dev;
 	struct nvme_fdp_ruh_status hdr;
+	_cleanup_file_ FILE *f = NULL;
 	size_t len;
 	void *buf = NULL;
 	int err = -1;
@@ -322,17 +658,32 @@ static int fdp_status(int argc, char **argv, struct command *cmd, struct plugin
 		__u32	namespace_id;
 		char	*output_format;
 		bool	raw_binary;
+		__u32	interval;
+		__u32	count;
+		char	*series;
+		__u8	series_format;
 	};
 
 	struct config cfg = {
 		.output_format	= "normal",
 		.raw_binary	= false,
+		.series_format	= FDP_SERIES_CSV,
+	};
+
+	OPT_VALS(series_formats) = {
+		VAL_BYTE("csv", FDP_SERIES_CSV),
+		VAL_BYTE("binary", FDP_SERIES_BINARY),
+		VAL_END()
 	};
 
 	OPT_ARGS(opts) = {
-		OPT_UINT("namespace-id", 'n', &cfg.namespace_id,  namespace_id),
-		OPT_FMT("output-format", 'o', &cfg.output_format, output_format),
-		OPT_FLAG("raw-binary",   'b', &cfg.raw_binary,    raw),
+		OPT_UINT("namespace-id",  'n', &cfg.namespace_id,  namespace_id),
+		OPT_FMT("output-format",  'o', &cfg.output_format, output_format),
+		OPT_FLAG("raw-binary",    'b', &cfg.raw_binary,    raw),
+		OPT_UINT("interval",      'i', &cfg.interval,      interval),
+		OPT_UINT("count",         'c', &cfg.count,         count),
+		OPT_FILE("series",        'f', &cfg.series,        series),
+		OPT_BYTE("series-format", 0,   &cfg.series_format, series_format, series_formats),
 		OPT_END()
 	};
 
@@ -347,6 +698,25 @@ static int fdp_status(int argc, char **argv, struct command *cmd, struct plugin
 	if (cfg.raw_binary)
 		flags = BINARY;
 
+	if (cfg.interval) {
+		if (flags == BINARY || cfg.count == 1 ||
+		    cfg.series_format > FDP_SERIES_BINARY) {
+			fprintf(stderr, "sampling needs normal or json output, a known "
+				"series format and more than one sample\n");
+			err = -EINVAL;
+			goto out;
+		}
+
+		if (cfg.series) {
+			f = fopen(cfg.series, "w");
+			if (!f) {
+				fprintf(stderr, "open %s: %s\n", cfg.series, strerror(errno));
+				err = -errno;
+				goto out;
+			}
+		}
+	}
+
 	if (!cfg.namespace_id) {
 		err = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
 		if (err < 0) {
@@ -377,7 +747,12 @@ static int fdp_status(int argc, char **argv, struct command *cmd, struct plugin
 		goto out;
 	}
 
-	nvme_show_fdp_ruh_status(buf, len, flags);
+	if (cfg.interval)
+		err = fdp_status_sample(dev_fd(dev), cfg.namespace_id, buf, len,
+					cfg.interval, cfg.count, f, cfg.series_format,
+					flags);
+	else
+		nvme_show_fdp_ruh_status(buf, len, flags);
 
 out:
 	free(buf);
@@ -551,3 +926,411 @@ out:
 
 	return err;
 }
+
+/* Directive type of the data placement directive (TP4146) */
+#define FDP_DTYPE	2
+
+enum fdp_workload_mode {
+	FDP_WORKLOAD_RR,
+	FDP_WORKLOAD_STREAM,
+	FDP_WORKLOAD_HOT_COLD,
+};
+
+static const char *fdp_workload_modes[] = {
+	[FDP_WORKLOAD_RR]	= "round-robin",
+	[FDP_WORKLOAD_STREAM]	= "stream",
+	[FDP_WORKLOAD_HOT_COLD]	= "hot-cold",
+};
+
+struct fdp_workload {
+	int fd;
+	__u32 nsid;
+	__u16 egid;
+	__u32 timeout;
+	enum fdp_workload_mode mode;
+	unsigned short *pids;
+	int nr_pids;
+	__u64 slba;
+	__u64 nr_slots;
+	__u64 hot_slots;
+	__u32 hot_writes;
+	__u32 nlb;
+	__u32 xfer;
+	__u32 seed;
+	__u64 nr_writes;
+	__u64 next;
+	__u64 done;
+	__u64 *written;
+	int err;
+	__u32 interval;
+	struct timeval start;
+	struct timeval last;
+	struct nvme_fdp_stats_log base;
+};
+
+static __u64 fdp_workload_hash(__u64 x)
+{
+	/* splitmix64, cheap and good enough to pick LBAs */
+	x += 0x9e3779b97f4a7c15ULL;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	return x ^ (x >> 31);
+}
+
+/*
+ * Maps the k-th write of the run to a slot (an xfer sized piece of the LBA
+ * range) and an index into the placement identifiers, -1 for none. The
+ * mapping only depends on k and the seed, so the writes can be issued from
+ * any number of jobs and a run can be repeated exactly.
+ */
+static void fdp_workload_target(struct fdp_workload *w, __u64 k, __u64 *slot, int *pid)
+{
+	__u64 streams, region, r;
+	bool hot;
+
+	switch (w->mode) {
+	case FDP_WORKLOAD_RR:
+	default:
+		*slot = k % w->nr_slots;
+		*pid = w->nr_pids ? k % w->nr_pids : -1;
+		break;
+	case FDP_WORKLOAD_STREAM:
+		streams = max(w->nr_pids, 1);
+		region = w->nr_slots / streams;
+		*slot = (k % streams) * region + (k / streams) % region;
+		*pid = w->nr_pids ? k % streams : -1;
+		break;
+	case FDP_WORKLOAD_HOT_COLD:
+		r = fdp_workload_hash(w->seed ^ k);
+		hot = r % 100 < w->hot_writes;
+		r = fdp_workload_hash(r);
+		if (hot)
+			*slot = r % w->hot_slots;
+		else
+			*slot = w->hot_slots + r % (w->nr_slots - w->hot_slots);
+		if (w->nr_pids < 2)
+			*pid = w->nr_pids - 1;
+		else
+			*pid = hot ? 0 : 1 + k % (w->nr_pids - 1);
+		break;
+	}
+}
+
+static long double fdp_stats_delta(__u8 *now, __u8 *base)
+{
+	return int128_to_double(now) - int128_to_double(base);
+}
+
+static void fdp_workload_progress(struct fdp_workload *w)
+{
+	struct nvme_fdp_stats_log stats;
+	struct timeval now;
+	long double hbmw, mbmw;
+	double secs;
+
+	gettimeofday(&now, NULL);
+	if (elapsed_utime(w->last, now) < w->interval * 1000000ULL)
+		return;
+	w->last = now;
+	secs = elapsed_utime(w->start, now) / 1000000.0;
+
+	fprintf(stderr, "%8.1f s: %"PRIu64" of %"PRIu64" writes, %.1f MiB/s",
+		secs, (uint64_t)__atomic_load_n(&w->done, __ATOMIC_RELAXED),
+		(uint64_t)w->nr_writes,
+		__atomic_load_n(&w->done, __ATOMIC_RELAXED) * w->xfer / secs / (1 << 20));
+
+	if (!nvme_get_log_fdp_stats(w->fd, w->egid, 0, sizeof(stats), &stats)) {
+		hbmw = fdp_stats_delta(stats.hbmw, w->base.hbmw);
+		mbmw = fdp_stats_delta(stats.mbmw, w->base.mbmw);
+		if (hbmw > 0)
+			fprintf(stderr, ", WAF %.3Lf", mbmw / hbmw);
+	}
+	fprintf(stderr, "\n");
+}
+
+static void fdp_workload_job(unsigned int idx, void *arg)
+{
+	struct fdp_workload *w = arg;
+	_cleanup_free_ unsigned char *buf = NULL;
+	unsigned int seed = w->seed + idx;
+	unsigned int i;
+	__u64 k, slot;
+	int pid, err, zero = 0;
+
+	buf = nvme_alloc(w->xfer);
+	if (!buf) {
+		__atomic_compare_exchange_n(&w->err, &zero, -ENOMEM, false,
+					    __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+		return;
+	}
+
+	/* incompressible data, so the media sees what the host wrote */
+	for (i = 0; i < w->xfer; i++)
+		buf[i] = rand_r(&seed);
+
+	while ((k = __atomic_fetch_add(&w->next, 1, __ATOMIC_RELAXED)) < w->nr_writes) {
+		if (__atomic_load_n(&w->err, __ATOMIC_RELAXED))
+			break;
+
+		fdp_workload_target(w, k, &slot, &pid);
+
+		struct nvme_io_args args = {
+			.args_size	= sizeof(args),
+			.fd		= w->fd,
+			.nsid		= w->nsid,
+			.slba		= w->slba + slot * w->nlb,
+			.nlb		= w->nlb - 1,
+			.control	= pid < 0 ? 0 : FDP_DTYPE << 4,
+			.dspec		= pid < 0 ? 0 : w->pids[pid],
+			.data_len	= w->xfer,
+			.data		= buf,
+			.timeout	= w->timeout,
+			.result		= NULL,
+		};
+
+		err = nvme_write(&args);
+		if (err) {
+			__atomic_compare_exchange_n(&w->err, &zero, err, false,
+						    __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+			break;
+		}
+
+		__atomic_add_fetch(&w->written[max(pid, 0)], w->xfer, __ATOMIC_RELAXED);
+		__atomic_add_fetch(&w->done, 1, __ATOMIC_RELAXED);
+
+		if (!idx && w->interval)
+			fdp_workload_progress(w);
+	}
+}
+
+static int fdp_workload(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Write a namespace with data placement directives and report "
+		"the write amplification the endurance group saw meanwhile";
+	const char *namespace_id = "Namespace identifier";
+	const char *egid = "Endurance group identifier (default: the namespace's)";
+	const char *_pids = "Comma-separated list of placement identifiers to write to "
+		"(default: no directive)";
+	const char *mode = "Placement mix: round-robin, stream or hot-cold";
+	const char *slba = "First LBA of the range to write";
+	const char *nr_lbas = "Number of LBAs in the range to write (default: up to the end)";
+	const char *data_size = "Total number of bytes to write";
+	const char *xfer_size = "Bytes per write command";
+	const char *hot_size = "hot-cold: percentage of the range that is hot";
+	const char *hot_writes = "hot-cold: percentage of the writes that go to the hot part";
+	const char *jobs = "Number of write commands in flight";
+	const char *seed = "Seed for the hot-cold LBA selection and the data";
+	const char *interval = "Print progress and WAF so far every this many seconds";
+
+	struct nvme_fdp_workload res = { 0 };
+	struct fdp_workload w = { 0 };
+	_cleanup_free_ __u64 *written = NULL;
+	struct nvme_fdp_stats_log stats;
+	struct nvme_id_ns id_ns;
+	unsigned short pids[128];
+	nvme_print_flags_t flags;
+	struct nvme_dev *dev;
+	struct timeval end;
+	__u64 nsze;
+	__u8 lbaf;
+	int err;
+
+	struct config {
+		__u32	namespace_id;
+		__u16	egid;
+		char	*pids;
+		__u8	mode;
+		__u64	slba;
+		__u64	nr_lbas;
+		__u64	data_size;
+		__u64	xfer_size;
+		__u32	hot_size;
+		__u32	hot_writes;
+		__u32	jobs;
+		__u32	seed;
+		__u32	interval;
+		char	*output_format;
+	};
+
+	struct config cfg = {
+		.pids		= "",
+		.mode		= FDP_WORKLOAD_RR,
+		.xfer_size	= 128 * 1024,
+		.hot_size	= 20,
+		.hot_writes	= 80,
+		.jobs		= 4,
+		.seed		= 1,
+		.output_format	= "normal",
+	};
+
+	OPT_VALS(modes) = {
+		VAL_BYTE("round-robin", FDP_WORKLOAD_RR),
+		VAL_BYTE("stream", FDP_WORKLOAD_STREAM),
+		VAL_BYTE("hot-cold", FDP_WORKLOAD_HOT_COLD),
+		VAL_END()
+	};
+
+	OPT_ARGS(opts) = {
+		OPT_UINT("namespace-id", 'n', &cfg.namespace_id,  namespace_id),
+		OPT_UINT("endgrp-id",    'e', &cfg.egid,          egid),
+		OPT_LIST("pids",         'p', &cfg.pids,          _pids),
+		OPT_BYTE("mode",         'm', &cfg.mode,          mode, modes),
+		OPT_SUFFIX("start-lba",  's', &cfg.slba,          slba),
+		OPT_SUFFIX("nr-lbas",    'l', &cfg.nr_lbas,       nr_lbas),
+		OPT_SUFFIX("data-size",  'z', &cfg.data_size,     data_size),
+		OPT_SUFFIX("xfer-size",  'x', &cfg.xfer_size,     xfer_size),
+		OPT_UINT("hot-size",     0,   &cfg.hot_size,      hot_size),
+		OPT_UINT("hot-writes",   0,   &cfg.hot_writes,    hot_writes),
+		OPT_UINT("jobs",         'j', &cfg.jobs,          jobs),
+		OPT_UINT("seed",         0,   &cfg.seed,          seed),
+		OPT_UINT("interval",     'i', &cfg.interval,      interval),
+		OPT_FMT("output-format", 'o', &cfg.output_format, output_format),
+		OPT_END()
+	};
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	err = validate_output_format(cfg.output_format, &flags);
+	if (err < 0)
+		goto out;
+
+	if (cfg.mode >= ARRAY_SIZE(fdp_workload_modes)) {
+		fprintf(stderr, "invalid mode %u\n", cfg.mode);
+		err = -EINVAL;
+		goto out;
+	}
+
+	w.nr_pids = argconfig_parse_comma_sep_array_short(cfg.pids, pids, ARRAY_SIZE(pids));
+	if (w.nr_pids < 0) {
+		perror("could not parse pids");
+		err = -EINVAL;
+		goto out;
+	}
+
+	if (!cfg.data_size || !cfg.jobs || cfg.hot_size < 1 || cfg.hot_size > 99 ||
+	    cfg.hot_writes > 100) {
+		fprintf(stderr, "data size, jobs or hot-cold percentages out of range\n");
+		err = -EINVAL;
+		goto out;
+	}
+
+	if (!cfg.namespace_id) {
+		err = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
+		if (err < 0) {
+			perror("get-namespace-id");
+			goto out;
+		}
+	}
+
+	err = nvme_identify_ns(dev_fd(dev), cfg.namespace_id, &id_ns);
+	if (err) {
+		nvme_show_status(err);
+		goto out;
+	}
+
+	nvme_id_ns_flbas_to_lbaf_inuse(id_ns.flbas, &lbaf);
+	if (id_ns.lbaf[lbaf].ms) {
+		fprintf(stderr, "formats with metadata are not supported\n");
+		err = -EINVAL;
+		goto out;
+	}
+
+	if (!cfg.egid)
+		cfg.egid = le16_to_cpu(id_ns.endgid);
+	if (!cfg.egid) {
+		fprintf(stderr, "endurance group identifier required\n");
+		err = -EINVAL;
+		goto out;
+	}
+
+	w.nlb = cfg.xfer_size >> id_ns.lbaf[lbaf].ds;
+	if (!w.nlb || w.nlb > 0x10000 || cfg.xfer_size != (__u64)w.nlb << id_ns.lbaf[lbaf].ds) {
+		fprintf(stderr, "xfer size must be a multiple of the LBA size, up to 64Ki LBAs\n");
+		err = -EINVAL;
+		goto out;
+	}
+
+	nsze = le64_to_cpu(id_ns.nsze);
+	if (!cfg.nr_lbas && cfg.slba < nsze)
+		cfg.nr_lbas = nsze - cfg.slba;
+	if (cfg.slba >= nsze || cfg.nr_lbas > nsze - cfg.slba) {
+		fprintf(stderr, "LBA range beyond the namespace size %"PRIu64"\n",
+			(uint64_t)nsze);
+		err = -EINVAL;
+		goto out;
+	}
+
+	w.fd = dev_fd(dev);
+	w.nsid = cfg.namespace_id;
+	w.egid = cfg.egid;
+	w.timeout = NVME_DEFAULT_IOCTL_TIMEOUT;
+	w.mode = cfg.mode;
+	w.pids = pids;
+	w.slba = cfg.slba;
+	w.nr_slots = cfg.nr_lbas / w.nlb;
+	w.hot_slots = w.nr_slots * cfg.hot_size / 100;
+	w.hot_writes = cfg.hot_writes;
+	w.xfer = cfg.xfer_size;
+	w.seed = cfg.seed;
+	w.nr_writes = (cfg.data_size + cfg.xfer_size - 1) / cfg.xfer_size;
+	w.interval = cfg.interval;
+
+	if (w.nr_slots < max(w.nr_pids, 2) ||
+	    (w.mode == FDP_WORKLOAD_HOT_COLD && !w.hot_slots)) {
+		fprintf(stderr, "LBA range too small for this mode\n");
+		err = -EINVAL;
+		goto out;
+	}
+
+	written = calloc(max(w.nr_pids, 1), sizeof(*written));
+	if (!written) {
+		err = -ENOMEM;
+		goto out;
+	}
+	w.written = written;
+
+	err = nvme_get_log_fdp_stats(w.fd, w.egid, 0, sizeof(w.base), &w.base);
+	if (err) {
+		nvme_show_status(err);
+		goto out;
+	}
+
+	gettimeofday(&w.start, NULL);
+	w.last = w.start;
+	parallel_for_each(cfg.jobs, cfg.jobs, fdp_workload_job, &w);
+	gettimeofday(&end, NULL);
+
+	if (w.err > 0)
+		nvme_show_status(w.err);
+	else if (w.err < 0)
+		fprintf(stderr, "write: %s\n", nvme_strerror(-w.err));
+
+	err = nvme_get_log_fdp_stats(w.fd, w.egid, 0, sizeof(stats), &stats);
+	if (err) {
+		nvme_show_status(err);
+		goto out;
+	}
+
+	res.nsid = w.nsid;
+	res.egid = w.egid;
+	res.mode = fdp_workload_modes[w.mode];
+	res.pids = pids;
+	res.nr_pids = w.nr_pids;
+	res.written = written;
+	res.writes = w.done;
+	res.bytes = w.done * w.xfer;
+	res.seconds = elapsed_utime(w.start, end) / 1000000.0;
+	res.hbmw = fdp_stats_delta(stats.hbmw, w.base.hbmw);
+	res.mbmw = fdp_stats_delta(stats.mbmw, w.base.mbmw);
+	res.mbe = fdp_stats_delta(stats.mbe, w.base.mbe);
+
+	nvme_show_fdp_workload(&res, flags);
+	err = w.err;
+
+out:
+	dev_close(dev);
+
+	return err;
+}
@@ -16,6 +16,7 @@ PLUGIN(NAME("fdp", "Manage Flexible Data Placement enabled devices", NVME_VERSIO
 		ENTRY("status", "Show reclaim unit handle status", fdp_status)
 		ENTRY("update", "Update a reclaim unit handle", fdp_update)
 		ENTRY("set-events", "Enabled or disable events", fdp_set_events)
+		ENTRY("workload", "Write with placement directives and measure write amplification", fdp_workload)
 	)
 );
 
@@ -5,6 +5,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <inttypes.h>
+#include <pthread.h>
 #include <linux/fs.h>
 #include <sys/stat.h>
 
@@ -13,6 +14,7 @@
 #include "libnvme.h"
 #include "nvme-print.h"
 #include "util/cleanup.h"
+#include "util/parallel.h"
 
 #define CREATE_CMD
 #include "zns.h"
@@ -223,12 +225,394 @@ close_dev:
 	return err;
 }
 
+/*
+ * Largest report transfer when the controller does not limit it by MDTS.
+ * Two of these are allocated, so this also bounds the memory used by a
+ * full report independent of the number of zones.
+ */
+#define ZNS_REPORT_MAX_XFER	(1024 * 1024)
+
+struct zns_report_fetch {
+	int fd;
+	__u32 nsid;
+	__u64 slba;
+	enum nvme_zns_report_options state;
+	bool extended;
+	bool partial;
+	__u32 len;
+	void *buf;
+	int err;
+};
+
+static void *zns_report_fetch(void *arg)
+{
+	struct zns_report_fetch *f = arg;
+
+	f->err = nvme_zns_report_zones(f->fd, f->nsid, f->slba, f->state,
+				       f->extended, f->partial, f->len, f->buf,
+				       NVME_DEFAULT_IOCTL_TIMEOUT, NULL);
+	return NULL;
+}
+
+static __u32 zns_report_xfer(int fd)
+{
+	struct nvme_id_ctrl ctrl;
+
+	if (nvme_identify_ctrl(fd, &ctrl) || !ctrl.mdts || ctrl.mdts >= 20)
+		return ZNS_REPORT_MAX_XFER;
+
+	/* MDTS is in units of the minimum memory page size, assume 4k */
+	return min(4096U << ctrl.mdts, (__u32)ZNS_REPORT_MAX_XFER);
+}
+
+static struct nvme_zns_desc *zns_report_desc(struct nvme_zone_report *report,
+					     unsigned int i, int zdes)
+{
+	return (void *)report + sizeof(*report) +
+		i * (sizeof(struct nvme_zns_desc) + zdes);
+}
+
+typedef int (*zns_report_fn)(struct nvme_zone_report *report,
+			     unsigned int descs, __u32 len, void *arg);
+
+/*
+ * Retrieves up to nr_zones descriptors starting at slba in chunks as
+ * large as MDTS allows and hands each chunk to fn. Two buffers are used,
+ * so that the next report is fetched while fn processes the previous one.
+ */
+static int zns_report_walk(int fd, __u32 nsid, __u64 slba, __u64 nr_zones,
+			   enum nvme_zns_report_options state, bool extended,
+			   bool partial, int zdes, __u64 zsze,
+			   zns_report_fn fn, void *arg)
+{
+	_cleanup_huge_ struct nvme_mem_huge mh = { 0, };
+	__u32 desc_size = sizeof(struct nvme_zns_desc) + zdes;
+	struct zns_report_fetch fetch[2], *cur, *next;
+	struct nvme_zone_report *report;
+	__u64 nr_chunk, retrieved = 0;
+	__u32 report_size, buf_size;
+	unsigned int descs;
+	pthread_t thread;
+	bool pending;
+	int i, err = 0;
+	void *bufs;
+
+	if (!nr_zones)
+		return 0;
+
+	/* As many descriptors as fit into the largest transfer */
+	nr_chunk = (zns_report_xfer(fd) - sizeof(*report)) / desc_size;
+	nr_chunk = min(nr_chunk, nr_zones);
+	report_size = sizeof(*report) + nr_chunk * desc_size;
+
+	buf_size = (report_size + 4095) & ~4095;
+	bufs = nvme_alloc_huge(2 * buf_size, &mh);
+	if (!bufs) {
+		perror("alloc");
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < 2; i++) {
+		fetch[i] = (struct zns_report_fetch) {
+			.fd		= fd,
+			.nsid		= nsid,
+			.state		= state,
+			.extended	= extended,
+			.partial	= partial,
+			.buf		= bufs + i * buf_size,
+		};
+	}
+
+	cur = &fetch[0];
+	cur->slba = slba;
+	cur->len = report_size;
+	zns_report_fetch(cur);
+
+	while (retrieved < nr_zones) {
+		err = cur->err;
+		if (err > 0) {
+			nvme_show_status(err);
+			break;
+		} else if (err < 0) {
+			perror("zns report-zones");
+			break;
+		}
+
+		/*
+		 * With a state filter or near the end of the namespace the
+		 * controller may return fewer descriptors than requested.
+		 */
+		report = cur->buf;
+		descs = (cur->len - sizeof(*report)) / desc_size;
+		if (le64_to_cpu(report->nr_zones) < descs)
+			descs = le64_to_cpu(report->nr_zones);
+		if (!descs)
+			break;
+
+		retrieved += descs;
+
+		pending = false;
+		next = cur == &fetch[0] ? &fetch[1] : &fetch[0];
+		if (retrieved < nr_zones) {
+			nr_chunk = min(nr_chunk, nr_zones - retrieved);
+			next->slba = le64_to_cpu(zns_report_desc(report, descs - 1, zdes)->zslba) + zsze;
+			next->len = sizeof(*report) + nr_chunk * desc_size;
+			pending = !pthread_create(&thread, NULL, zns_report_fetch, next);
+		}
+
+		err = fn(report, descs, cur->len, arg);
+
+		if (pending)
+			pthread_join(thread, NULL);
+		else if (!err && retrieved < nr_zones)
+			zns_report_fetch(next);
+		if (err)
+			break;
+		cur = next;
+	}
+
+	return err;
+}
+
+/*
+ * Bulk zone management: the zones to act on are resolved from a report of
+ * all zones, filtered by LBA range, state and fill level, and the command
+ * is sent to each of them with bounded concurrency. When the filter leaves
+ * every zone the select-all form would act on, that is used instead.
+ */
+struct zns_bulk {
+	int fd;
+	__u32 nsid;
+	enum nvme_zns_send_action zsa;
+	__u32 timeout;
+	__u64 slba;
+	__u64 elba;
+	__u8 state;
+	__u32 min_fill;
+	__u32 max_fill;
+	bool fill;
+	__u64 zsze;
+	__u64 *zslba;
+	unsigned int nr;
+	__u64 eligible;
+	unsigned int failed;
+};
+
+/* Report zones state filter values, as taken by --state */
+static const __u8 zns_bulk_states[] = {
+	[1] = NVME_ZNS_ZS_EMPTY,
+	[2] = NVME_ZNS_ZS_IMPL_OPEN,
+	[3] = NVME_ZNS_ZS_EXPL_OPEN,
+	[4] = NVME_ZNS_ZS_CLOSED,
+	[5] = NVME_ZNS_ZS_FULL,
+	[6] = NVME_ZNS_ZS_READ_ONLY,
+	[7] = NVME_ZNS_ZS_OFFLINE,
+};
+
+/* The zones the select-all form of a zone send action applies to */
+static bool zns_bulk_select_all(enum nvme_zns_send_action zsa, __u8 zs)
+{
+	bool open = zs == NVME_ZNS_ZS_IMPL_OPEN || zs == NVME_ZNS_ZS_EXPL_OPEN;
+
+	switch (zsa) {
+	case NVME_ZNS_ZSA_CLOSE:
+		return open;
+	case NVME_ZNS_ZSA_FINISH:
+		return open || zs == NVME_ZNS_ZS_CLOSED;
+	case NVME_ZNS_ZSA_RESET:
+		return open || zs == NVME_ZNS_ZS_CLOSED || zs == NVME_ZNS_ZS_FULL;
+	case NVME_ZNS_ZSA_OFFLINE:
+		return zs == NVME_ZNS_ZS_READ_ONLY;
+	default:
+		return false;
+	}
+}
+
+static bool zns_bulk_match(struct zns_bulk *b, struct nvme_zns_desc *desc)
+{
+	__u64 zslba = le64_to_cpu(desc->zslba);
+	__u64 zcap = le64_to_cpu(desc->zcap);
+	__u8 zs = desc->zs >> 4;
+	__u32 fill;
+
+	if (zslba < b->slba || zslba > b->elba)
+		return false;
+	if (b->state && zns_bulk_states[b->state] != zs)
+		return false;
+	if (!b->fill)
+		return true;
+
+	switch (zs) {
+	case NVME_ZNS_ZS_EMPTY:
+		fill = 0;
+		break;
+	case NVME_ZNS_ZS_IMPL_OPEN:
+	case NVME_ZNS_ZS_EXPL_OPEN:
+	case NVME_ZNS_ZS_CLOSED:
+		fill = zcap ? (le64_to_cpu(desc->wp) - zslba) * 100 / zcap : 0;
+		break;
+	case NVME_ZNS_ZS_FULL:
+		fill = 100;
+		break;
+	default:
+		/* no write pointer, no fill level */
+		return false;
+	}
+
+	return fill >= b->min_fill && fill <= b->max_fill;
+}
+
+static int zns_bulk_add(struct nvme_zone_report *report, unsigned int descs,
+			__u32 len, void *arg)
+{
+	struct zns_bulk *b = arg;
+	struct nvme_zns_desc *desc;
+	__u64 *zslba;
+	unsigned int i;
+
+	zslba = realloc(b->zslba, (b->nr + descs) * sizeof(*zslba));
+	if (!zslba)
+		return -ENOMEM;
+	b->zslba = zslba;
+
+	for (i = 0; i < descs; i++) {
+		desc = zns_report_desc(report, i, 0);
+		if (!zns_bulk_select_all(b->zsa, desc->zs >> 4))
+			continue;
+
+		b->eligible++;
+		if (zns_bulk_match(b, desc))
+			b->zslba[b->nr++] = le64_to_cpu(desc->zslba);
+	}
+
+	return 0;
+}
+
+static void zns_bulk_send(unsigned int idx, void *arg)
+{
+	struct zns_bulk *b = arg;
+	struct nvme_zns_mgmt_send_args args = {
+		.args_size	= sizeof(args),
+		.fd		= b->fd,
+		.nsid		= b->nsid,
+		.slba		= b->zslba[idx],
+		.zsa		= b->zsa,
+		.timeout	= b->timeout,
+	};
+	int err;
+
+	err = nvme_zns_mgmt_send(&args);
+	if (!err)
+		return;
+
+	__atomic_add_fetch(&b->failed, 1, __ATOMIC_RELAXED);
+	fprintf(stderr, "zone %#"PRIx64": ", (uint64_t)b->zslba[idx]);
+	if (err > 0)
+		nvme_show_status(err);
+	else
+		perror("zns zone-mgmt-send");
+}
+
+static int zns_mgmt_send_bulk(struct zns_bulk *b, const char *command,
+			      unsigned int jobs, bool dry_run)
+{
+	struct timeval start_time, end_time;
+	struct nvme_zone_report report;
+	struct nvme_zns_id_ns id_zns;
+	struct nvme_id_ns id_ns;
+	unsigned long long elapsed;
+	unsigned int i;
+	__u8 lbaf;
+	int err;
+
+	err = nvme_identify_ns(b->fd, b->nsid, &id_ns);
+	if (!err)
+		err = nvme_zns_identify_ns(b->fd, b->nsid, &id_zns);
+	if (err) {
+		nvme_show_status(err);
+		return err;
+	}
+	nvme_id_ns_flbas_to_lbaf_inuse(id_ns.flbas, &lbaf);
+
+	err = nvme_zns_report_zones(b->fd, b->nsid, 0, NVME_ZNS_ZRAS_REPORT_ALL,
+				    false, false, sizeof(report), &report,
+				    NVME_DEFAULT_IOCTL_TIMEOUT, NULL);
+	if (err > 0) {
+		nvme_show_status(err);
+		return err;
+	} else if (err < 0) {
+		perror("zns report-zones");
+		return err;
+	}
+
+	err = zns_report_walk(b->fd, b->nsid, 0, le64_to_cpu(report.nr_zones),
+			      NVME_ZNS_ZRAS_REPORT_ALL, false, false, 0,
+			      le64_to_cpu(id_zns.lbafe[lbaf].zsze),
+			      zns_bulk_add, b);
+	if (err)
+		goto free;
+
+	if (dry_run) {
+		for (i = 0; i < b->nr; i++)
+			printf("%s: zone:%"PRIx64"\n", command, (uint64_t)b->zslba[i]);
+		printf("%s: %u zones match\n", command, b->nr);
+		goto free;
+	}
+
+	if (!b->nr) {
+		printf("%s: no zones match\n", command);
+		goto free;
+	}
+
+	gettimeofday(&start_time, NULL);
+	if (b->nr == b->eligible && b->nr > 1) {
+		struct nvme_zns_mgmt_send_args args = {
+			.args_size	= sizeof(args),
+			.fd		= b->fd,
+			.nsid		= b->nsid,
+			.zsa		= b->zsa,
+			.select_all	= true,
+			.timeout	= b->timeout,
+		};
+
+		err = nvme_zns_mgmt_send(&args);
+		if (err > 0)
+			nvme_show_status(err);
+		else if (err < 0)
+			perror("zns zone-mgmt-send");
+		if (err)
+			b->failed = b->nr;
+	} else {
+		parallel_for_each(b->nr, jobs, zns_bulk_send, b);
+		if (b->failed)
+			err = -EIO;
+	}
+	gettimeofday(&end_time, NULL);
+
+	elapsed = elapsed_utime(start_time, end_time);
+	printf("%s: %u of %u zones%s in %.2f s, %.0f ops/s\n", command,
+	       b->nr - b->failed, b->nr,
+	       b->nr == b->eligible && b->nr > 1 ? " (select-all)" : "",
+	       elapsed / 1000000.0,
+	       elapsed ? (b->nr - b->failed) * 1000000.0 / elapsed : 0);
+
+free:
+	free(b->zslba);
+	return err;
+}
+
 static int zns_mgmt_send(int argc, char **argv, struct command *cmd, struct plugin *plugin,
 	const char *desc, enum nvme_zns_send_action zsa)
 {
 	const char *zslba = "starting LBA of the zone for this command";
 	const char *select_all = "send command to all zones";
 	const char *timeout = "timeout value, in milliseconds";
+	const char *end_lba = "with a zone filter, last zone start LBA to act on";
+	const char *state = "with a zone filter, only act on zones in this report zones state";
+	const char *min_fill = "with a zone filter, only act on zones at least this many percent written";
+	const char *max_fill = "with a zone filter, only act on zones at most this many percent written";
+	const char *jobs = "maximum number of commands in flight";
+	const char *dry_run = "only list the zones that would be acted on";
 	struct nvme_dev *dev;
 	int err, zcapc = 0;
 	char *command;
@@ -239,17 +623,33 @@ static int zns_mgmt_send(int argc, char **argv, struct command *cmd, struct plug
 		__u32	namespace_id;
 		bool	select_all;
 		__u32	timeout;
+		__u64	elba;
+		__u32	state;
+		__u32	min_fill;
+		__u32	max_fill;
+		__u32	jobs;
+		bool	dry_run;
 	};
 
-	struct config cfg = {};
+	struct config cfg = {
+		.max_fill	= 100,
+		.jobs		= 8,
+	};
 
 	OPT_ARGS(opts) = {
 		OPT_UINT("namespace-id", 'n', &cfg.namespace_id,  namespace_id),
 		OPT_SUFFIX("start-lba",  's', &cfg.zslba,         zslba),
 		OPT_FLAG("select-all",   'a', &cfg.select_all,    select_all),
 		OPT_UINT("timeout",      't', &cfg.timeout,       timeout),
+		OPT_SUFFIX("end-lba",    'e', &cfg.elba,          end_lba),
+		OPT_UINT("state",        'S', &cfg.state,         state),
+		OPT_UINT("min-fill",     0,   &cfg.min_fill,      min_fill),
+		OPT_UINT("max-fill",     0,   &cfg.max_fill,      max_fill),
+		OPT_UINT("jobs",         'j', &cfg.jobs,          jobs),
+		OPT_FLAG("dry-run",      0,   &cfg.dry_run,       dry_run),
 		OPT_END()
 	};
+	bool filter;
 
 	err = parse_and_open(&dev, argc, argv, desc, opts);
 	if (err)
@@ -267,6 +667,41 @@ static int zns_mgmt_send(int argc, char **argv, struct command *cmd, struct plug
 		}
 	}
 
+	filter = argconfig_parse_seen(opts, "end-lba") ||
+		argconfig_parse_seen(opts, "state") ||
+		argconfig_parse_seen(opts, "min-fill") ||
+		argconfig_parse_seen(opts, "max-fill");
+	/* Never let --dry-run or --jobs fall through to the real command */
+	if (filter || argconfig_parse_seen(opts, "dry-run") ||
+	    argconfig_parse_seen(opts, "jobs")) {
+		struct zns_bulk b = {
+			.fd		= dev_fd(dev),
+			.nsid		= cfg.namespace_id,
+			.zsa		= zsa,
+			.timeout	= cfg.timeout,
+			.slba		= cfg.select_all ? 0 : cfg.zslba,
+			.elba		= argconfig_parse_seen(opts, "end-lba") ?
+					  cfg.elba : filter || cfg.select_all ?
+					  UINT64_MAX : cfg.zslba,
+			.state		= cfg.state,
+			.min_fill	= cfg.min_fill,
+			.max_fill	= cfg.max_fill,
+			.fill		= argconfig_parse_seen(opts, "min-fill") ||
+					  argconfig_parse_seen(opts, "max-fill"),
+		};
+
+		if ((cfg.select_all && filter) ||
+		    cfg.state >= ARRAY_SIZE(zns_bulk_states) ||
+		    cfg.min_fill > cfg.max_fill) {
+			fprintf(stderr, "invalid zone filter\n");
+			err = -EINVAL;
+			goto free;
+		}
+
+		err = zns_mgmt_send_bulk(&b, command, cfg.jobs, cfg.dry_run);
+		goto free;
+	}
+
 	struct nvme_zns_mgmt_send_args args = {
 		.args_size	= sizeof(args),
 		.fd		= dev_fd(dev),
@@ -820,6 +1255,22 @@ close_dev:
 	return err;
 }
 
+struct zns_report_show {
+	int zdes;
+	struct json_object *zone_list;
+	nvme_print_flags_t flags;
+};
+
+static int zns_report_show(struct nvme_zone_report *report, unsigned int descs,
+			   __u32 len, void *arg)
+{
+	struct zns_report_show *show = arg;
+
+	nvme_show_zns_report_zones(report, descs, show->zdes, len,
+				   show->zone_list, show->flags);
+	return 0;
+}
+
 static int report_zones(int argc, char **argv, struct command *cmd, struct plugin *plugin)
 {
 	const char *desc = "Retrieve the Report Zones data structure";
@@ -833,21 +1284,15 @@ static int report_zones(int argc, char **argv, struct command *cmd, struct plugi
 	nvme_print_flags_t flags;
 	int zdes = 0, err = -1;
 	struct nvme_dev *dev;
-	__u32 report_size;
-	struct nvme_zone_report *report, *buff;
-	_cleanup_huge_ struct nvme_mem_huge mh = { 0, };
+	struct nvme_zone_report *buff;
+	struct zns_report_show show;
 
-	unsigned int nr_zones_chunks = 1024,   /* 1024 entries * 64 bytes per entry = 64k byte transfer */
-			nr_zones_retrieved = 0,
-			nr_zones,
-			log_len;
-	__u64 offset;
+	unsigned int log_len;
 	int total_nr_zones = 0;
 	struct nvme_zns_id_ns id_zns;
 	struct nvme_id_ns id_ns;
 	uint8_t lbaf;
 	__le64	zsze;
-	struct json_object *zone_list = NULL;
 
 	struct config {
 		char *output_format;
@@ -943,57 +1388,710 @@ static int report_zones(int argc, char **argv, struct command *cmd, struct plugi
 	if (cfg.num_descs == -1)
 		cfg.num_descs = total_nr_zones;
 
-	nr_zones = cfg.num_descs;
-	if (nr_zones < nr_zones_chunks)
-		nr_zones_chunks = nr_zones;
+	show.zdes = zdes;
+	show.flags = flags;
+	nvme_zns_start_zone_list(total_nr_zones, &show.zone_list, flags);
 
-	log_len = sizeof(struct nvme_zone_report) + ((sizeof(struct nvme_zns_desc) * nr_zones_chunks) + (nr_zones_chunks * zdes));
-	report_size = log_len;
+	err = zns_report_walk(dev_fd(dev), cfg.namespace_id, cfg.zslba,
+			      (unsigned int)cfg.num_descs, cfg.state,
+			      cfg.extended, cfg.partial, zdes, zsze,
+			      zns_report_show, &show);
 
-	report = nvme_alloc_huge(report_size, &mh);
-	if (!report) {
-		perror("alloc");
-		err = -ENOMEM;
+	nvme_zns_finish_zone_list(total_nr_zones, show.zone_list, flags);
+
+free_buff:
+	free(buff);
+close_dev:
+	dev_close(dev);
+	return err;
+}
+
+/*
+ * Compact zone map: one bit per zone and state, plus the written LBAs and
+ * the capacity of every zone in packed arrays, indexed by zslba / zsze.
+ */
+enum {
+	ZNS_MAP_EMPTY,
+	ZNS_MAP_IMPL_OPEN,
+	ZNS_MAP_EXPL_OPEN,
+	ZNS_MAP_CLOSED,
+	ZNS_MAP_READ_ONLY,
+	ZNS_MAP_FULL,
+	ZNS_MAP_OFFLINE,
+	ZNS_MAP_STATES,
+};
+
+static const __u8 zns_map_states[ZNS_MAP_STATES] = {
+	[ZNS_MAP_EMPTY]		= NVME_ZNS_ZS_EMPTY,
+	[ZNS_MAP_IMPL_OPEN]	= NVME_ZNS_ZS_IMPL_OPEN,
+	[ZNS_MAP_EXPL_OPEN]	= NVME_ZNS_ZS_EXPL_OPEN,
+	[ZNS_MAP_CLOSED]	= NVME_ZNS_ZS_CLOSED,
+	[ZNS_MAP_READ_ONLY]	= NVME_ZNS_ZS_READ_ONLY,
+	[ZNS_MAP_FULL]		= NVME_ZNS_ZS_FULL,
+	[ZNS_MAP_OFFLINE]	= NVME_ZNS_ZS_OFFLINE,
+};
+
+struct zns_zone_map {
+	__u64 nr_zones;
+	__u64 zsze;
+	__u64 *state[ZNS_MAP_STATES];
+	__u32 *written;
+	__u32 *cap;
+};
+
+static int zns_zone_map_alloc(struct zns_zone_map *map, __u64 nr_zones,
+			      __u64 zsze)
+{
+	size_t words = (nr_zones + 63) / 64;
+	int i;
+
+	map->nr_zones = nr_zones;
+	map->zsze = zsze;
+	for (i = 0; i < ZNS_MAP_STATES; i++) {
+		map->state[i] = calloc(words, sizeof(__u64));
+		if (!map->state[i])
+			return -ENOMEM;
+	}
+
+	map->written = calloc(nr_zones, sizeof(__u32));
+	map->cap = calloc(nr_zones, sizeof(__u32));
+	if (!map->written || !map->cap)
+		return -ENOMEM;
+
+	return 0;
+}
+
+static void zns_zone_map_free(struct zns_zone_map *map)
+{
+	int i;
+
+	for (i = 0; i < ZNS_MAP_STATES; i++)
+		free(map->state[i]);
+	free(map->written);
+	free(map->cap);
+}
+
+static int zns_zone_map_state(__u8 zs)
+{
+	int i;
+
+	for (i = 0; i < ZNS_MAP_STATES; i++)
+		if (zns_map_states[i] == zs)
+			return i;
+	return -1;
+}
+
+static bool zns_zone_map_test(struct zns_zone_map *map, int state, __u64 zone)
+{
+	return map->state[state][zone / 64] & (1ULL << (zone % 64));
+}
+
+static int zns_zone_map_add(struct nvme_zone_report *report, unsigned int descs,
+			    __u32 len, void *arg)
+{
+	struct zns_zone_map *map = arg;
+	struct nvme_zns_desc *desc;
+	__u64 zslba, zone;
+	unsigned int i;
+	int state;
+
+	for (i = 0; i < descs; i++) {
+		desc = zns_report_desc(report, i, 0);
+		zslba = le64_to_cpu(desc->zslba);
+		zone = zslba / map->zsze;
+		state = zns_zone_map_state(desc->zs >> 4);
+		if (zone >= map->nr_zones || state < 0)
+			continue;
+
+		map->state[state][zone / 64] |= 1ULL << (zone % 64);
+		map->cap[zone] = le64_to_cpu(desc->zcap);
+
+		/* The write pointer is only valid for empty, open and closed zones */
+		switch (desc->zs >> 4) {
+		case NVME_ZNS_ZS_IMPL_OPEN:
+		case NVME_ZNS_ZS_EXPL_OPEN:
+		case NVME_ZNS_ZS_CLOSED:
+			map->written[zone] = le64_to_cpu(desc->wp) - zslba;
+			break;
+		case NVME_ZNS_ZS_FULL:
+			map->written[zone] = map->cap[zone];
+			break;
+		default:
+			break;
+		}
+	}
+
+	return 0;
+}
+
+static int zns_zone_fill_cmp(const void *a, const void *b)
+{
+	const struct nvme_zns_zone_fill *za = a, *zb = b;
+	__u64 fa = za->written * zb->cap, fb = zb->written * za->cap;
+
+	if (fa != fb)
+		return fa < fb ? -1 : 1;
+	return za->zslba < zb->zslba ? -1 : za->zslba > zb->zslba;
+}
+
+/*
+ * The emptiest and fullest of the zones that are partially written, i.e.
+ * open or closed. Empty and full zones are all alike.
+ */
+static int zns_zone_summary_top(struct zns_zone_map *map,
+				struct nvme_zns_zone_summary *s, int top)
+{
+	_cleanup_free_ struct nvme_zns_zone_fill *zones = NULL;
+	__u64 zone, nr = 0;
+	int i, state;
+
+	for (i = ZNS_MAP_IMPL_OPEN; i <= ZNS_MAP_CLOSED; i++)
+		nr += s->state[zns_map_states[i]];
+	if (!nr || !top)
+		return 0;
+
+	zones = calloc(nr, sizeof(*zones));
+	s->emptiest = calloc(top, sizeof(*s->emptiest));
+	s->fullest = calloc(top, sizeof(*s->fullest));
+	if (!zones || !s->emptiest || !s->fullest)
+		return -ENOMEM;
+
+	for (nr = 0, zone = 0; zone < map->nr_zones; zone++) {
+		for (state = ZNS_MAP_IMPL_OPEN; state <= ZNS_MAP_CLOSED; state++)
+			if (zns_zone_map_test(map, state, zone))
+				break;
+		if (state > ZNS_MAP_CLOSED)
+			continue;
+
+		zones[nr++] = (struct nvme_zns_zone_fill) {
+			.zslba		= zone * map->zsze,
+			.written	= map->written[zone],
+			.cap		= map->cap[zone],
+			.state		= zns_map_states[state],
+		};
+	}
+
+	qsort(zones, nr, sizeof(*zones), zns_zone_fill_cmp);
+
+	s->nr_top = min((__u64)top, nr);
+	for (i = 0; i < s->nr_top; i++) {
+		s->emptiest[i] = zones[i];
+		s->fullest[i] = zones[nr - 1 - i];
+	}
+
+	return 0;
+}
+
+static void zns_zone_summary_fill(struct zns_zone_map *map,
+				  struct nvme_zns_zone_summary *s)
+{
+	__u64 zone, bucket;
+	int i;
+
+	for (i = 0; i < ZNS_MAP_STATES; i++) {
+		__u64 words = (map->nr_zones + 63) / 64, w;
+
+		for (w = 0; w < words; w++)
+			s->state[zns_map_states[i]] +=
+				__builtin_popcountll(map->state[i][w]);
+	}
+
+	for (zone = 0; zone < map->nr_zones; zone++) {
+		/* read only and offline zones have no usable capacity */
+		if (!map->cap[zone] ||
+		    zns_zone_map_test(map, ZNS_MAP_READ_ONLY, zone) ||
+		    zns_zone_map_test(map, ZNS_MAP_OFFLINE, zone))
+			continue;
+
+		s->written += map->written[zone];
+		s->capacity += map->cap[zone];
+
+		bucket = (__u64)map->written[zone] * NVME_ZNS_FILL_BUCKETS /
+			map->cap[zone];
+		s->fill[min(bucket, (__u64)NVME_ZNS_FILL_BUCKETS - 1)]++;
+	}
+}
+
+static int zone_summary(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Summarize the zones of a zoned namespace: zones per state, "
+		"a fill level histogram and open/active zone resources";
+	const char *top = "also list the N emptiest and fullest open or closed zones";
+
+	struct nvme_zns_zone_summary s = { 0 };
+	struct zns_zone_map map = { 0 };
+	struct nvme_zone_report report;
+	struct nvme_zns_id_ns id_zns;
+	struct nvme_id_ns id_ns;
+	nvme_print_flags_t flags;
+	struct nvme_dev *dev;
+	__u8 lbaf;
+	int err;
+
+	struct config {
+		__u32	namespace_id;
+		__u32	top;
+		char	*output_format;
+	};
+
+	struct config cfg = {
+		.namespace_id	= 0,
+		.top		= 0,
+		.output_format	= "normal",
+	};
+
+	OPT_ARGS(opts) = {
+		OPT_UINT("namespace-id",  'n', &cfg.namespace_id,   namespace_id),
+		OPT_UINT("top",           'N', &cfg.top,            top),
+		OPT_FMT("output-format",  'o', &cfg.output_format,  output_format),
+		OPT_END()
+	};
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return errno;
+
+	err = validate_output_format(cfg.output_format, &flags);
+	if (err < 0)
+		goto close_dev;
+
+	if (!cfg.namespace_id) {
+		err = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
+		if (err < 0) {
+			perror("get-namespace-id");
+			goto close_dev;
+		}
+	}
+
+	err = nvme_identify_ns(dev_fd(dev), cfg.namespace_id, &id_ns);
+	if (err) {
+		nvme_show_status(err);
 		goto close_dev;
 	}
 
-	offset = cfg.zslba;
+	err = nvme_zns_identify_ns(dev_fd(dev), cfg.namespace_id, &id_zns);
+	if (err) {
+		nvme_show_status(err);
+		goto close_dev;
+	}
+
+	nvme_id_ns_flbas_to_lbaf_inuse(id_ns.flbas, &lbaf);
+	s.nsid = cfg.namespace_id;
+	s.zsze = le64_to_cpu(id_zns.lbafe[lbaf].zsze);
+	s.mor = le32_to_cpu(id_zns.mor);
+	s.mar = le32_to_cpu(id_zns.mar);
+	if (!s.zsze || s.zsze > UINT32_MAX) {
+		fprintf(stderr, "unsupported zone size %#"PRIx64"\n", (uint64_t)s.zsze);
+		err = -EINVAL;
+		goto close_dev;
+	}
+
+	err = nvme_zns_report_zones(dev_fd(dev), cfg.namespace_id, 0,
+				    NVME_ZNS_ZRAS_REPORT_ALL, false, false,
+				    sizeof(report), &report,
+				    NVME_DEFAULT_IOCTL_TIMEOUT, NULL);
+	if (err > 0) {
+		nvme_show_status(err);
+		goto close_dev;
+	} else if (err < 0) {
+		perror("zns report-zones");
+		goto close_dev;
+	}
+
+	s.nr_zones = le64_to_cpu(report.nr_zones);
+
+	err = zns_zone_map_alloc(&map, s.nr_zones, s.zsze);
+	if (err) {
+		perror("alloc");
+		goto free_map;
+	}
+
+	err = zns_report_walk(dev_fd(dev), cfg.namespace_id, 0, s.nr_zones,
+			      NVME_ZNS_ZRAS_REPORT_ALL, false, false, 0,
+			      s.zsze, zns_zone_map_add, &map);
+	if (err)
+		goto free_map;
+
+	zns_zone_summary_fill(&map, &s);
+
+	err = zns_zone_summary_top(&map, &s, cfg.top);
+	if (err) {
+		perror("alloc");
+		goto free_top;
+	}
+
+	nvme_show_zns_zone_summary(&s, flags);
+
+free_top:
+	free(s.emptiest);
+	free(s.fullest);
+free_map:
+	zns_zone_map_free(&map);
+close_dev:
+	dev_close(dev);
+	return err;
+}
+
+/*
+ * Throughput mode of zone-append: the data is appended in data-size pieces
+ * to several zones at once, with queue-depth appends in flight per zone.
+ * Every zone slot is served by its own threads. A zone that can't take the
+ * next append is finished and the slot moves on to the next empty zone.
+ */
+struct zns_append_zone {
+	__u64 zslba;
+	__u64 remaining;	/* LBAs not yet reserved */
+	unsigned int inflight;
+	bool retired;
+};
+
+struct zns_append_stream {
+	int fd;
+	__u32 nsid;
+	int dfd;
+	__u32 data_size;
+	unsigned int lba_size;
+	__u16 control;
+	__u64 ref_tag;
+	__u16 lbat;
+	__u16 lbatm;
+	FILE *log;
+
+	/* protects everything below */
+	pthread_mutex_t lock;
+	struct zns_append_zone *zones;
+	unsigned int nr_zones;
+	unsigned int next_zone;
+	struct zns_append_zone **slot;
+	__u64 offset;
+	bool eof;
+	int err;
+
+	__u64 appends;
+	__u64 bytes;
+	__u64 lat_min;
+	__u64 lat_max;
+	__u64 lat_total;
+};
+
+struct zns_append_worker {
+	struct zns_append_stream *st;
+	unsigned int slot;
+	void *buf;
+	pthread_t thread;
+};
+
+static int zns_append_add_zones(struct nvme_zone_report *report,
+				unsigned int descs, __u32 len, void *arg)
+{
+	struct zns_append_stream *st = arg;
+	struct nvme_zns_desc *desc;
+	struct zns_append_zone *zones;
+	unsigned int i;
+
+	zones = realloc(st->zones, (st->nr_zones + descs) * sizeof(*zones));
+	if (!zones)
+		return -ENOMEM;
+	st->zones = zones;
+
+	for (i = 0; i < descs; i++) {
+		desc = zns_report_desc(report, i, 0);
+		zones[st->nr_zones++] = (struct zns_append_zone) {
+			.zslba		= le64_to_cpu(desc->zslba),
+			.remaining	= le64_to_cpu(desc->zcap),
+		};
+	}
+
+	return 0;
+}
+
+static int zns_append_zone_send(struct zns_append_stream *st,
+				struct zns_append_zone *z,
+				enum nvme_zns_send_action zsa)
+{
+	struct nvme_zns_mgmt_send_args args = {
+		.args_size	= sizeof(args),
+		.fd		= st->fd,
+		.nsid		= st->nsid,
+		.slba		= z->zslba,
+		.zsa		= zsa,
+		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
+	};
+	int err;
+
+	err = nvme_zns_mgmt_send(&args);
+	if (err > 0) {
+		fprintf(stderr, "zone %#"PRIx64": ", (uint64_t)z->zslba);
+		nvme_show_status(err);
+	} else if (err < 0) {
+		perror("zns zone-mgmt-send");
+	}
+
+	return err;
+}
+
+/* Finishes a zone that was left for a new one, once nothing is in flight */
+static void zns_append_retire(struct zns_append_stream *st,
+			      struct zns_append_zone *z)
+{
+	int err;
+
+	if (!z->retired || z->inflight || !z->remaining)
+		return;
+
+	err = zns_append_zone_send(st, z, NVME_ZNS_ZSA_FINISH);
+	if (err && !st->err)
+		st->err = err;
+}
+
+/*
+ * Reserves nlb LBAs in the zone of the slot, moving the slot to the next
+ * empty zone if they don't fit anymore. Called with the lock held.
+ */
+static struct zns_append_zone *zns_append_reserve(struct zns_append_stream *st,
+						  unsigned int slot, __u32 nlb)
+{
+	struct zns_append_zone *z = st->slot[slot];
+	int err;
 
-	nvme_zns_start_zone_list(total_nr_zones, &zone_list, flags);
+	if (!z || z->remaining < nlb) {
+		if (z) {
+			z->retired = true;
+			zns_append_retire(st, z);
+		}
 
-	while (nr_zones_retrieved < nr_zones) {
-		if (nr_zones_retrieved >= nr_zones)
+		do {
+			if (st->next_zone >= st->nr_zones) {
+				fprintf(stderr, "zns zone-append: no empty zones left\n");
+				st->err = -ENOSPC;
+				return NULL;
+			}
+			z = &st->zones[st->next_zone++];
+		} while (z->remaining < nlb);
+
+		err = zns_append_zone_send(st, z, NVME_ZNS_ZSA_OPEN);
+		if (err) {
+			st->err = err;
+			return NULL;
+		}
+		st->slot[slot] = z;
+	}
+
+	z->remaining -= nlb;
+	z->inflight++;
+	return z;
+}
+
+static ssize_t zns_append_read(int fd, void *buf, size_t len)
+{
+	size_t done = 0;
+	ssize_t n;
+
+	while (done < len) {
+		n = read(fd, buf + done, len - done);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		if (!n)
 			break;
+		done += n;
+	}
+
+	return done;
+}
 
-		if (nr_zones_retrieved + nr_zones_chunks > nr_zones) {
-			nr_zones_chunks = nr_zones - nr_zones_retrieved;
-			log_len = sizeof(struct nvme_zone_report) + ((sizeof(struct nvme_zns_desc) * nr_zones_chunks) + (nr_zones_chunks * zdes));
+static void *zns_append_work(void *arg)
+{
+	struct zns_append_worker *w = arg;
+	struct zns_append_stream *st = w->st;
+	struct timeval start_time, end_time;
+	struct zns_append_zone *z;
+	__u64 offset, result, lat;
+	ssize_t len;
+	__u32 nlb;
+	int err;
+
+	for (;;) {
+		pthread_mutex_lock(&st->lock);
+		if (st->err || st->eof) {
+			pthread_mutex_unlock(&st->lock);
+			break;
 		}
 
-		err = nvme_zns_report_zones(dev_fd(dev), cfg.namespace_id,
-					    offset,
-					    cfg.state, cfg.extended,
-					    cfg.partial, log_len, report,
-					    NVME_DEFAULT_IOCTL_TIMEOUT, NULL);
-		if (err > 0) {
-			nvme_show_status(err);
+		len = zns_append_read(st->dfd, w->buf, st->data_size);
+		if (len <= 0) {
+			if (len < 0) {
+				errno = -len;
+				perror("read-data");
+				st->err = len;
+			}
+			st->eof = true;
+			pthread_mutex_unlock(&st->lock);
 			break;
 		}
 
-		if (!err)
-			nvme_show_zns_report_zones(report, nr_zones_chunks,
-						   zdes, log_len, zone_list, flags);
+		/* pad the tail of the stream to a full LBA */
+		nlb = (len + st->lba_size - 1) / st->lba_size;
+		memset(w->buf + len, 0, nlb * st->lba_size - len);
+		offset = st->offset;
+		st->offset += len;
 
-		nr_zones_retrieved += nr_zones_chunks;
-		offset = le64_to_cpu(report->entries[nr_zones_chunks-1].zslba) + zsze;
+		z = zns_append_reserve(st, w->slot, nlb);
+		pthread_mutex_unlock(&st->lock);
+		if (!z)
+			break;
+
+		struct nvme_zns_append_args args = {
+			.args_size	= sizeof(args),
+			.fd		= st->fd,
+			.nsid		= st->nsid,
+			.zslba		= z->zslba,
+			.nlb		= nlb - 1,
+			.control	= st->control,
+			.ilbrt_u64	= st->ref_tag,
+			.lbat		= st->lbat,
+			.lbatm		= st->lbatm,
+			.data_len	= nlb * st->lba_size,
+			.data		= w->buf,
+			.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
+			.result		= &result,
+		};
+
+		gettimeofday(&start_time, NULL);
+		err = nvme_zns_append(&args);
+		gettimeofday(&end_time, NULL);
+		lat = elapsed_utime(start_time, end_time);
+
+		pthread_mutex_lock(&st->lock);
+		z->inflight--;
+		if (err) {
+			if (!st->err) {
+				fprintf(stderr, "zone %#"PRIx64": ", (uint64_t)z->zslba);
+				if (err > 0)
+					nvme_show_status(err);
+				else
+					perror("zns zone-append");
+				st->err = err;
+			}
+		} else {
+			st->appends++;
+			st->bytes += len;
+			st->lat_total += lat;
+			st->lat_min = st->appends == 1 ? lat : min(st->lat_min, lat);
+			st->lat_max = max(st->lat_max, lat);
+			if (st->log)
+				fprintf(st->log, "%#"PRIx64" %#"PRIx64" %u\n",
+					(uint64_t)offset, (uint64_t)result, nlb);
+		}
+		zns_append_retire(st, z);
+		pthread_mutex_unlock(&st->lock);
 	}
 
-	nvme_zns_finish_zone_list(total_nr_zones, zone_list, flags);
+	return NULL;
+}
 
-free_buff:
-	free(buff);
-close_dev:
-	dev_close(dev);
+static int zone_append_stream(struct zns_append_stream *st, __u8 lbaf,
+			      __u64 zslba, unsigned int nr_slots,
+			      unsigned int qd, bool latency)
+{
+	_cleanup_free_ struct zns_append_worker *workers = NULL;
+	unsigned int nr_workers = nr_slots * qd, started = 0, i;
+	struct timeval start_time, end_time;
+	struct nvme_zone_report report;
+	struct nvme_zns_id_ns id_zns;
+	__u64 elapsed;
+	int err;
+
+	err = nvme_zns_identify_ns(st->fd, st->nsid, &id_zns);
+	if (err) {
+		nvme_show_status(err);
+		return err;
+	}
+
+	err = nvme_zns_report_zones(st->fd, st->nsid, zslba,
+				    NVME_ZNS_ZRAS_REPORT_EMPTY, false, false,
+				    sizeof(report), &report,
+				    NVME_DEFAULT_IOCTL_TIMEOUT, NULL);
+	if (err > 0) {
+		nvme_show_status(err);
+		return err;
+	} else if (err < 0) {
+		perror("zns report-zones");
+		return err;
+	}
+
+	err = zns_report_walk(st->fd, st->nsid, zslba,
+			      le64_to_cpu(report.nr_zones),
+			      NVME_ZNS_ZRAS_REPORT_EMPTY, false, false, 0,
+			      le64_to_cpu(id_zns.lbafe[lbaf].zsze),
+			      zns_append_add_zones, st);
+	if (err)
+		goto free_zones;
+
+	if (st->nr_zones < nr_slots) {
+		fprintf(stderr, "only %u empty zones for %u zones to append to\n",
+			st->nr_zones, nr_slots);
+		err = -ENOSPC;
+		goto free_zones;
+	}
+
+	st->slot = calloc(nr_slots, sizeof(*st->slot));
+	workers = calloc(nr_workers, sizeof(*workers));
+	if (!st->slot || !workers) {
+		err = -ENOMEM;
+		goto free_slots;
+	}
+
+	pthread_mutex_init(&st->lock, NULL);
+	gettimeofday(&start_time, NULL);
+
+	for (i = 0; i < nr_workers; i++) {
+		workers[i].st = st;
+		workers[i].slot = i % nr_slots;
+		if (posix_memalign(&workers[i].buf, getpagesize(),
+				   st->data_size + st->lba_size))
+			break;
+		if (pthread_create(&workers[i].thread, NULL, zns_append_work,
+				   &workers[i])) {
+			free(workers[i].buf);
+			break;
+		}
+		started++;
+	}
+
+	if (!started) {
+		fprintf(stderr, "failed to start zone append workers\n");
+		err = -ENOMEM;
+	}
+
+	for (i = 0; i < started; i++) {
+		pthread_join(workers[i].thread, NULL);
+		free(workers[i].buf);
+	}
+
+	gettimeofday(&end_time, NULL);
+	pthread_mutex_destroy(&st->lock);
+
+	if (!err)
+		err = st->err;
+
+	elapsed = elapsed_utime(start_time, end_time);
+	printf("Appended %"PRIu64" bytes in %"PRIu64" appends to %u zones, %.2f s, %.2f MB/s, %.0f IOPS\n",
+	       (uint64_t)st->bytes, (uint64_t)st->appends, st->next_zone,
+	       elapsed / 1000000.0,
+	       elapsed ? (double)st->bytes / elapsed : 0,
+	       elapsed ? st->appends * 1000000.0 / elapsed : 0);
+	if (latency && st->appends)
+		printf(" latency: zone append: min %"PRIu64" avg %"PRIu64" max %"PRIu64" us\n",
+		       (uint64_t)st->lat_min, (uint64_t)(st->lat_total / st->appends),
+		       (uint64_t)st->lat_max);
+
+free_slots:
+	free(st->slot);
+free_zones:
+	free(st->zones);
 	return err;
 }
 
@@ -1015,6 +2113,9 @@ static int zone_append(int argc, char **argv, struct command *cmd, struct plugin
 	const char *metadata_size = "size of metadata in bytes";
 	const char *data_size = "size of data in bytes";
 	const char *latency = "output latency statistics";
+	const char *zones = "append the data stream to this many zones at once";
+	const char *qd = "appends in flight per zone with --zones";
+	const char *extent_log = "file to log data offset, LBA and length of every append to with --zones";
 
 	int err = -1, dfd = STDIN_FILENO, mfd = STDIN_FILENO;
 	unsigned int lba_size, meta_size;
@@ -1042,9 +2143,14 @@ static int zone_append(int argc, char **argv, struct command *cmd, struct plugin
 		__u8   prinfo;
 		bool   piremap;
 		bool   latency;
+		__u32  zones;
+		__u32  qd;
+		char  *extent_log;
 	};
 
-	struct config cfg = {};
+	struct config cfg = {
+		.qd = 4,
+	};
 
 	OPT_ARGS(opts) = {
 		OPT_UINT("namespace-id", 'n', &cfg.namespace_id,  namespace_id),
@@ -1061,6 +2167,9 @@ static int zone_append(int argc, char **argv, struct command *cmd, struct plugin
 		OPT_BYTE("prinfo",            'p', &cfg.prinfo,        prinfo),
 		OPT_FLAG("piremap",           'P', &cfg.piremap,       piremap),
 		OPT_FLAG("latency",           't', &cfg.latency,       latency),
+		OPT_UINT("zones",             'Z', &cfg.zones,         zones),
+		OPT_UINT("queue-depth",       'q', &cfg.qd,            qd),
+		OPT_FILE("extent-log",        'L', &cfg.extent_log,    extent_log),
 		OPT_END()
 	};
 
@@ -1114,6 +2223,14 @@ static int zone_append(int argc, char **argv, struct command *cmd, struct plugin
 		goto close_dev;
 	}
 
+	control |= (cfg.prinfo << 10);
+	if (cfg.limited_retry)
+		control |= NVME_IO_LR;
+	if (cfg.fua)
+		control |= NVME_IO_FUA;
+	if (cfg.piremap)
+		control |= NVME_IO_ZNS_APPEND_PIREMAP;
+
 	if (cfg.data) {
 		dfd = open(cfg.data, O_RDONLY);
 		if (dfd < 0) {
@@ -1122,6 +2239,48 @@ static int zone_append(int argc, char **argv, struct command *cmd, struct plugin
 		}
 	}
 
+	if (cfg.zones) {
+		_cleanup_file_ FILE *log = NULL;
+		struct zns_append_stream st = {
+			.fd		= dev_fd(dev),
+			.nsid		= cfg.namespace_id,
+			.dfd		= dfd,
+			.data_size	= cfg.data_size,
+			.lba_size	= lba_size,
+			.control	= control,
+			.ref_tag	= cfg.ref_tag,
+			.lbat		= cfg.lbat,
+			.lbatm		= cfg.lbatm,
+		};
+
+		if (meta_size || cfg.metadata) {
+			fprintf(stderr, "Metadata is not supported with --zones\n");
+			err = -EINVAL;
+			goto close_dfd;
+		}
+
+		if (cfg.data_size / lba_size > 0x10000) {
+			fprintf(stderr, "Data size:%#"PRIx64" exceeds 65536 LBAs\n",
+				(uint64_t)cfg.data_size);
+			err = -EINVAL;
+			goto close_dfd;
+		}
+
+		if (cfg.extent_log) {
+			log = fopen(cfg.extent_log, "w");
+			if (!log) {
+				perror(cfg.extent_log);
+				err = -errno;
+				goto close_dfd;
+			}
+			st.log = log;
+		}
+
+		err = zone_append_stream(&st, lba_index, cfg.zslba, cfg.zones,
+					 cfg.qd ? cfg.qd : 1, cfg.latency);
+		goto close_dfd;
+	}
+
 	if (posix_memalign(&buf, getpagesize(), cfg.data_size)) {
 		fprintf(stderr, "No memory for data size:%"PRIx64"\n",
 			(uint64_t)cfg.data_size);
@@ -1161,13 +2320,6 @@ static int zone_append(int argc, char **argv, struct command *cmd, struct plugin
 	}
 
 	nblocks = (cfg.data_size / lba_size) - 1;
-	control |= (cfg.prinfo << 10);
-	if (cfg.limited_retry)
-		control |= NVME_IO_LR;
-	if (cfg.fua)
-		control |= NVME_IO_FUA;
-	if (cfg.piremap)
-		control |= NVME_IO_ZNS_APPEND_PIREMAP;
 
 	struct nvme_zns_append_args args = {
 		.args_size	= sizeof(args),
@@ -13,6 +13,7 @@ PLUGIN(NAME("zns", "Zoned Namespace Command Set", NVME_VERSION),
 		ENTRY("id-ctrl", "Send NVMe Identify Zoned Namespace Controller, display structure", id_ctrl)
 		ENTRY("id-ns", "Send NVMe Identify Zoned Namespace Namespace, display structure", id_ns)
 		ENTRY("report-zones", "Report zones associated to a Zoned Namespace", report_zones)
+		ENTRY("zone-summary", "Summarize zone states and fill levels of a Zoned Namespace", zone_summary)
 		ENTRY("reset-zone", "Reset one or more zones", reset_zone)
 		ENTRY("close-zone", "Close one or more zones", close_zone)
 		ENTRY("finish-zone", "Finish one or more zones", finish_zone)
@@ -0,0 +1,285 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: GPL-2.0-or-later
+#
+# This file is part of nvme-cli
+#
+""" Fabrics scaling benchmark against a local nvmet loop target
+
+Configures an nvmet loop port through configfs with N subsystems, each
+with file backed namespaces, and times 'nvme discover', 'nvme
+connect-all', 'nvme list' and 'nvme disconnect-all' against it for every
+requested subsystem count. The results are written as JSON and can be
+compared against a previous run to catch scaling regressions:
+
+    # python3 tests/nvme_loop_bench.py --subsystems 1,16,128,512 \\
+          --output after.json --baseline before.json
+
+Needs root, configfs and the nvmet and nvme-loop modules. All loop
+controllers of the host are disconnected by the benchmark.
+"""
+
+import argparse
+import json
+import os
+import platform
+import shutil
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+from typing import Any, Dict, List, Optional
+
+NVMET_CONFIGFS = "/sys/kernel/config/nvmet"
+NQN_PREFIX = "nqn.2014-08.org.nvmexpress:nvme-cli-bench"
+COMMANDS = ["discover", "connect-all", "list", "disconnect-all"]
+
+
+class LoopTarget:
+
+    """
+    nvmet loop port with a number of subsystems, created in configfs
+    and removed again on teardown.
+    """
+
+    def __init__(self, port_id: int, backing_dir: str,
+                 ns_per_subsys: int, ns_size: int) -> None:
+        self.port = os.path.join(NVMET_CONFIGFS, "ports", str(port_id))
+        self.backing_dir = backing_dir
+        self.ns_per_subsys = ns_per_subsys
+        self.ns_size = ns_size
+        self.subsystems: List[str] = []
+
+    @staticmethod
+    def write(path: str, value: str) -> None:
+        with open(path, "w") as f:
+            f.write(value)
+
+    def setup_port(self) -> None:
+        if os.path.exists(self.port):
+            raise RuntimeError(f"nvmet port {self.port} already exists")
+        os.mkdir(self.port)
+        self.write(os.path.join(self.port, "addr_trtype"), "loop")
+
+    def add_subsystem(self) -> None:
+        nqn = f"{NQN_PREFIX}-{len(self.subsystems)}"
+        subsys = os.path.join(NVMET_CONFIGFS, "subsystems", nqn)
+        os.mkdir(subsys)
+        self.subsystems.append(nqn)
+        self.write(os.path.join(subsys, "attr_allow_any_host"), "1")
+
+        for nsid in range(1, self.ns_per_subsys + 1):
+            backing = os.path.join(self.backing_dir, f"{nqn}-{nsid}.img")
+            with open(backing, "wb") as f:
+                f.truncate(self.ns_size)
+            ns = os.path.join(subsys, "namespaces", str(nsid))
+            os.mkdir(ns)
+            self.write(os.path.join(ns, "device_path"), backing)
+            self.write(os.path.join(ns, "enable"), "1")
+
+        os.symlink(subsys, os.path.join(self.port, "subsystems", nqn))
+
+    def resize(self, nr: int) -> None:
+        while len(self.subsystems) < nr:
+            self.add_subsystem()
+
+    def teardown(self) -> None:
+        for nqn in reversed(self.subsystems):
+            subsys = os.path.join(NVMET_CONFIGFS, "subsystems", nqn)
+            link = os.path.join(self.port, "subsystems", nqn)
+            if os.path.islink(link):
+                os.unlink(link)
+            for nsid in range(1, self.ns_per_subsys + 1):
+                ns = os.path.join(subsys, "namespaces", str(nsid))
+                if os.path.isdir(ns):
+                    self.write(os.path.join(ns, "enable"), "0")
+                    os.rmdir(ns)
+            os.rmdir(subsys)
+        self.subsystems = []
+        if os.path.isdir(self.port):
+            os.rmdir(self.port)
+
+
+class Bench:
+
+    """ Runs and times the nvme-cli commands against the loop target. """
+
+    def __init__(self, nvme_bin: str, connect_args: List[str]) -> None:
+        self.nvme_bin = nvme_bin
+        self.connect_args = connect_args
+
+    def argv(self, cmd: str) -> List[str]:
+        if cmd == "discover":
+            return [self.nvme_bin, "discover", "--transport=loop",
+                    "--output-format=json"]
+        if cmd == "connect-all":
+            return [self.nvme_bin, "connect-all", "--transport=loop"] + \
+                self.connect_args
+        if cmd == "list":
+            return [self.nvme_bin, "list", "--output-format=json"]
+        return [self.nvme_bin, "disconnect-all", "--transport=loop"]
+
+    def run(self, cmd: str) -> float:
+        start = time.monotonic()
+        proc = subprocess.run(self.argv(cmd), stdout=subprocess.DEVNULL,
+                              stderr=subprocess.PIPE, text=True)
+        elapsed = time.monotonic() - start
+        if proc.returncode:
+            raise RuntimeError(f"'nvme {cmd}' failed: {proc.stderr.strip()}")
+        return elapsed
+
+    @staticmethod
+    def loop_ctrls() -> int:
+        nr = 0
+        for ctrl in os.listdir("/sys/class/nvme"):
+            try:
+                with open(f"/sys/class/nvme/{ctrl}/transport") as f:
+                    if f.read().strip() == "loop":
+                        nr += 1
+            except OSError:
+                pass
+        return nr
+
+    @staticmethod
+    def summary(runs: List[float]) -> Dict[str, Any]:
+        return {
+            "runs": [round(r, 6) for r in runs],
+            "min": round(min(runs), 6),
+            "median": round(statistics.median(runs), 6),
+            "max": round(max(runs), 6),
+        }
+
+    def measure(self, nr_subsys: int, repeat: int) -> Dict[str, Any]:
+        runs: Dict[str, List[float]] = {cmd: [] for cmd in COMMANDS}
+        connected = 0
+
+        for _ in range(repeat):
+            runs["discover"].append(self.run("discover"))
+            runs["connect-all"].append(self.run("connect-all"))
+            connected = self.loop_ctrls()
+            runs["list"].append(self.run("list"))
+            runs["disconnect-all"].append(self.run("disconnect-all"))
+
+        result: Dict[str, Any] = {
+            "subsystems": nr_subsys,
+            "connected": connected,
+        }
+        for cmd in COMMANDS:
+            result[cmd] = self.summary(runs[cmd])
+        return result
+
+
+def nvme_version(nvme_bin: str) -> str:
+    proc = subprocess.run([nvme_bin, "version"], stdout=subprocess.PIPE,
+                          stderr=subprocess.DEVNULL, text=True)
+    return proc.stdout.strip()
+
+
+def compare(results: List[Dict[str, Any]], baseline: Dict[str, Any],
+            threshold: float) -> List[str]:
+    """ Returns the commands whose median got slower than the threshold """
+    base = {r["subsystems"]: r for r in baseline.get("results", [])}
+    regressions = []
+
+    for r in results:
+        b = base.get(r["subsystems"])
+        if not b:
+            continue
+        for cmd in COMMANDS:
+            if cmd not in b:
+                continue
+            old = b[cmd]["median"]
+            new = r[cmd]["median"]
+            if old > 0 and new > old * threshold:
+                regressions.append(
+                    f"{cmd} with {r['subsystems']} subsystems: "
+                    f"{old:.3f}s -> {new:.3f}s")
+    return regressions
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(
+        description="nvme-cli fabrics scaling benchmark on nvmet loop")
+    parser.add_argument("--nvme", default=shutil.which("nvme") or "nvme",
+                        help="nvme binary to benchmark")
+    parser.add_argument("--subsystems", default="1,16,128,512",
+                        help="comma separated subsystem counts")
+    parser.add_argument("--namespaces", type=int, default=1,
+                        help="namespaces per subsystem")
+    parser.add_argument("--ns-size", type=int, default=16 << 20,
+                        help="size of each (sparse) namespace in bytes")
+    parser.add_argument("--repeat", type=int, default=3,
+                        help="runs per command and subsystem count")
+    parser.add_argument("--port", type=int, default=4242,
+                        help="nvmet port id to create")
+    parser.add_argument("--connect-args", default="",
+                        help="extra arguments for connect-all")
+    parser.add_argument("--output", help="JSON result file (default stdout)")
+    parser.add_argument("--baseline", help="previous JSON result to compare")
+    parser.add_argument("--threshold", type=float, default=1.2,
+                        help="allowed slowdown factor against the baseline")
+    args = parser.parse_args()
+
+    if os.geteuid():
+        print("must be run as root", file=sys.stderr)
+        return 1
+
+    for mod in ["nvmet", "nvme-loop"]:
+        subprocess.run(["modprobe", mod], check=False)
+    if not os.path.isdir(NVMET_CONFIGFS):
+        print(f"{NVMET_CONFIGFS} not available", file=sys.stderr)
+        return 1
+
+    counts = sorted({int(n) for n in args.subsystems.split(",")})
+    bench = Bench(args.nvme, args.connect_args.split())
+    results: List[Dict[str, Any]] = []
+    baseline: Optional[Dict[str, Any]] = None
+
+    if args.baseline:
+        with open(args.baseline) as f:
+            baseline = json.load(f)
+
+    backing_dir = tempfile.mkdtemp(prefix="nvme-loop-bench-")
+    target = LoopTarget(args.port, backing_dir, args.namespaces, args.ns_size)
+    try:
+        target.setup_port()
+        bench.run("disconnect-all")
+        for nr in counts:
+            target.resize(nr)
+            results.append(bench.measure(nr, args.repeat))
+            print(f"{nr} subsystems done", file=sys.stderr)
+    finally:
+        subprocess.run(bench.argv("disconnect-all"), check=False,
+                       stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+        target.teardown()
+        shutil.rmtree(backing_dir, ignore_errors=True)
+
+    report = {
+        "kernel": platform.release(),
+        "nvme": nvme_version(args.nvme),
+        "namespaces_per_subsystem": args.namespaces,
+        "repeat": args.repeat,
+        "connect_args": args.connect_args,
+        "results": results,
+    }
+
+    if args.output:
+        with open(args.output, "w") as f:
+            json.dump(report, f, indent=2)
+            f.write("\n")
+    else:
+        json.dump(report, sys.stdout, indent=2)
+        print()
+
+    if baseline:
+        regressions = compare(results, baseline, args.threshold)
+        for r in regressions:
+            print(f"regression: {r}", file=sys.stderr)
+        if regressions:
+            return 1
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
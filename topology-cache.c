@@ -0,0 +1,314 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Topology snapshot cache.
+ *
+ * Rebuilding the topology from sysfs dominates the runtime of the
+ * fabrics commands once a host has a few hundred controllers. The
+ * snapshot stored in the run directory records the live controllers
+ * together with a generation string. The generation is made of the
+ * mtime of a stamp file, which the nvme udev rule touches on every
+ * controller or subsystem event, and of the sysfs class directories.
+ * Without the stamp file (udev rule not installed) the snapshot is
+ * never trusted and every invocation falls back to a full scan.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <libnvme.h>
+
+#include "common.h"
+#include "topology-cache.h"
+#include "util/cleanup.h"
+
+#define TOPO_CACHE_DIR		RUNDIR "/nvme"
+#define TOPO_CACHE_FILE		TOPO_CACHE_DIR "/topology.snapshot"
+#define TOPO_CACHE_STAMP	TOPO_CACHE_DIR "/topology.gen"
+#define TOPO_CACHE_MAGIC	"nvme-topology-snapshot"
+#define TOPO_CACHE_VERSION	1
+#define TOPO_CACHE_MAX_SIZE	(16 * 1024 * 1024)
+
+static const char * const topo_cache_sysfs[] = {
+	"/sys/class/nvme",
+	"/sys/class/nvme-subsystem",
+};
+
+enum {
+	TOPO_HOSTNQN,
+	TOPO_NAME,
+	TOPO_TRANSPORT,
+	TOPO_TRADDR,
+	TOPO_TRSVCID,
+	TOPO_SUBSYSNQN,
+	TOPO_HOST_TRADDR,
+	TOPO_HOST_IFACE,
+	TOPO_NR_FIELDS,
+};
+
+struct topo_cache_entry {
+	const char *field[TOPO_NR_FIELDS];
+};
+
+struct topo_cache {
+	nvme_root_t r;
+	char *buf;
+	int nr_entries;
+	struct topo_cache_entry *entries;
+};
+
+int topo_cache_generation(char *gen, size_t len)
+{
+	struct stat st;
+	size_t n;
+	int i;
+
+	if (stat(TOPO_CACHE_STAMP, &st))
+		return -errno;
+
+	n = snprintf(gen, len, "%ld.%09ld", (long)st.st_mtim.tv_sec,
+		     st.st_mtim.tv_nsec);
+
+	for (i = 0; i < ARRAY_SIZE(topo_cache_sysfs) && n < len; i++) {
+		/* The class directories are missing until the modules load */
+		if (stat(topo_cache_sysfs[i], &st))
+			memset(&st, 0, sizeof(st));
+		n += snprintf(gen + n, len - n, ":%ld.%09ld",
+			      (long)st.st_mtim.tv_sec, st.st_mtim.tv_nsec);
+	}
+
+	return n < len ? 0 : -ENAMETOOLONG;
+}
+
+static const char *topo_cache_field(const char *s)
+{
+	return s && *s ? s : "";
+}
+
+int topo_cache_save(nvme_root_t r, const char *gen)
+{
+	_cleanup_free_ char *tmp = NULL;
+	_cleanup_file_ FILE *f = NULL;
+	nvme_host_t h;
+	nvme_subsystem_t s;
+	nvme_ctrl_t c;
+	int fd;
+
+	if (!gen || !*gen)
+		return -EINVAL;
+
+	if (asprintf(&tmp, "%s.%d", TOPO_CACHE_FILE, getpid()) < 0)
+		return -ENOMEM;
+
+	fd = open(tmp, O_CREAT | O_WRONLY | O_TRUNC, 0600);
+	if (fd < 0)
+		return -errno;
+
+	f = fdopen(fd, "w");
+	if (!f) {
+		close(fd);
+		unlink(tmp);
+		return -errno;
+	}
+
+	fprintf(f, "%s %d %s\n", TOPO_CACHE_MAGIC, TOPO_CACHE_VERSION, gen);
+
+	nvme_for_each_host(r, h) {
+		nvme_for_each_subsystem(h, s) {
+			nvme_subsystem_for_each_ctrl(s, c) {
+				if (!nvme_ctrl_get_name(c))
+					continue;
+				fprintf(f, "%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\n",
+					topo_cache_field(nvme_host_get_hostnqn(h)),
+					nvme_ctrl_get_name(c),
+					topo_cache_field(nvme_ctrl_get_transport(c)),
+					topo_cache_field(nvme_ctrl_get_traddr(c)),
+					topo_cache_field(nvme_ctrl_get_trsvcid(c)),
+					topo_cache_field(nvme_ctrl_get_subsysnqn(c)),
+					topo_cache_field(nvme_ctrl_get_host_traddr(c)),
+					topo_cache_field(nvme_ctrl_get_host_iface(c)));
+			}
+		}
+	}
+
+	if (fflush(f) || ferror(f) || rename(tmp, TOPO_CACHE_FILE)) {
+		unlink(tmp);
+		return -EIO;
+	}
+
+	return 0;
+}
+
+static int topo_cache_parse(struct topo_cache *tc, char *p)
+{
+	struct topo_cache_entry *e;
+	char *line, *field;
+	int nr = 0, i;
+
+	for (line = p; *line; line++)
+		if (*line == '\n')
+			nr++;
+
+	tc->entries = calloc(nr ? nr : 1, sizeof(*tc->entries));
+	if (!tc->entries)
+		return -ENOMEM;
+
+	while ((line = strsep(&p, "\n")) != NULL) {
+		if (!*line)
+			continue;
+
+		e = &tc->entries[tc->nr_entries];
+		for (i = 0; i < TOPO_NR_FIELDS; i++) {
+			field = strsep(&line, "\t");
+			if (!field)
+				return -EINVAL;
+			e->field[i] = *field ? field : NULL;
+		}
+		if (!e->field[TOPO_NAME])
+			return -EINVAL;
+		tc->nr_entries++;
+	}
+
+	return 0;
+}
+
+/*
+ * Returns the snapshot if it matches the current generation, NULL
+ * otherwise. @gen receives the current generation (an empty string when
+ * the cache is not in use) so that the caller can save a fresh snapshot
+ * after rescanning without racing against events during the scan.
+ */
+struct topo_cache *topo_cache_load(nvme_root_t r, char *gen)
+{
+	_cleanup_free_ char *buf = NULL;
+	_cleanup_fd_ int fd = -1;
+	struct topo_cache *tc;
+	char *p, *hdr;
+	struct stat st;
+	ssize_t len;
+
+	if (topo_cache_generation(gen, TOPO_CACHE_GEN_LEN)) {
+		gen[0] = '\0';
+		return NULL;
+	}
+
+	fd = open(TOPO_CACHE_FILE, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+
+	if (fstat(fd, &st) || !st.st_size || st.st_size > TOPO_CACHE_MAX_SIZE)
+		return NULL;
+
+	buf = malloc(st.st_size + 1);
+	if (!buf)
+		return NULL;
+
+	len = read(fd, buf, st.st_size);
+	if (len != st.st_size)
+		return NULL;
+	buf[len] = '\0';
+
+	p = buf;
+	hdr = strsep(&p, "\n");
+	if (!p || strncmp(hdr, TOPO_CACHE_MAGIC " ", strlen(TOPO_CACHE_MAGIC) + 1))
+		return NULL;
+	hdr += strlen(TOPO_CACHE_MAGIC) + 1;
+	if (atoi(hdr) != TOPO_CACHE_VERSION)
+		return NULL;
+	hdr = strchr(hdr, ' ');
+	if (!hdr || strcmp(hdr + 1, gen))
+		return NULL;
+
+	tc = calloc(1, sizeof(*tc));
+	if (!tc)
+		return NULL;
+
+	if (topo_cache_parse(tc, p)) {
+		free(tc->entries);
+		free(tc);
+		return NULL;
+	}
+
+	tc->r = r;
+	tc->buf = buf;
+	buf = NULL;
+
+	return tc;
+}
+
+static bool topo_cache_match(const char *a, const char *b)
+{
+	/* Unset lookup keys match anything */
+	if (!a)
+		return true;
+	return b && !strcmp(a, b);
+}
+
+/*
+ * Looks up a live controller in the snapshot and instantiates only that
+ * controller in the tree, the rest of the topology stays unscanned.
+ */
+nvme_ctrl_t topo_cache_lookup(struct topo_cache *tc, nvme_host_t h,
+			      struct tr_config *trcfg)
+{
+	const char *hostnqn = nvme_host_get_hostnqn(h);
+	struct topo_cache_entry *e;
+	int i;
+
+	for (i = 0; i < tc->nr_entries; i++) {
+		e = &tc->entries[i];
+
+		if (!topo_cache_match(hostnqn, e->field[TOPO_HOSTNQN]) ||
+		    !topo_cache_match(trcfg->transport, e->field[TOPO_TRANSPORT]) ||
+		    !topo_cache_match(trcfg->subsysnqn, e->field[TOPO_SUBSYSNQN]) ||
+		    !topo_cache_match(trcfg->traddr, e->field[TOPO_TRADDR]) ||
+		    !topo_cache_match(trcfg->trsvcid, e->field[TOPO_TRSVCID]) ||
+		    !topo_cache_match(trcfg->host_traddr, e->field[TOPO_HOST_TRADDR]) ||
+		    !topo_cache_match(trcfg->host_iface, e->field[TOPO_HOST_IFACE]))
+			continue;
+
+		return nvme_scan_ctrl(tc->r, e->field[TOPO_NAME]);
+	}
+
+	return NULL;
+}
+
+/*
+ * Instantiates every live fabrics controller of the snapshot, so that
+ * walking the tree sees the same controllers as after a full scan.
+ */
+void topo_cache_scan_fabrics(struct topo_cache *tc)
+{
+	const char *transport;
+	int i;
+
+	for (i = 0; i < tc->nr_entries; i++) {
+		transport = tc->entries[i].field[TOPO_TRANSPORT];
+		if (!transport || (strcmp(transport, "tcp") &&
+				   strcmp(transport, "rdma") &&
+				   strcmp(transport, "fc")))
+			continue;
+		nvme_scan_ctrl(tc->r, tc->entries[i].field[TOPO_NAME]);
+	}
+}
+
+void topo_cache_invalidate(void)
+{
+	if (unlink(TOPO_CACHE_FILE) && errno != ENOENT)
+		fprintf(stderr, "failed to remove %s: %s\n", TOPO_CACHE_FILE,
+			strerror(errno));
+}
+
+void topo_cache_free(struct topo_cache *tc)
+{
+	if (!tc)
+		return;
+	free(tc->entries);
+	free(tc->buf);
+	free(tc);
+}
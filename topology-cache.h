@@ -0,0 +1,22 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+#ifndef _TOPOLOGY_CACHE_H
+#define _TOPOLOGY_CACHE_H
+
+#include <libnvme.h>
+
+#include "fabrics.h"
+
+#define TOPO_CACHE_GEN_LEN	128
+
+struct topo_cache;
+
+int topo_cache_generation(char *gen, size_t len);
+struct topo_cache *topo_cache_load(nvme_root_t r, char *gen);
+int topo_cache_save(nvme_root_t r, const char *gen);
+nvme_ctrl_t topo_cache_lookup(struct topo_cache *tc, nvme_host_t h,
+			      struct tr_config *trcfg);
+void topo_cache_scan_fabrics(struct topo_cache *tc);
+void topo_cache_invalidate(void);
+void topo_cache_free(struct topo_cache *tc);
+
+#endif /* _TOPOLOGY_CACHE_H */
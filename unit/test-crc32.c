@@ -0,0 +1,102 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../util/crc32.h"
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof(a[0]))
+
+static int test_rc;
+
+struct crc32_test {
+	const char *data;
+	uint32_t exp;
+};
+
+static struct crc32_test crc32_tests[] = {
+	{ "", 0x00000000 },
+	{ "a", 0xe8b7be43 },
+	{ "123456789", 0xcbf43926 },
+	{ "The quick brown fox jumps over the lazy dog", 0x414fa339 },
+};
+
+/* Bitwise reference implementation of the reflected 0xedb88320 CRC */
+static uint32_t crc32_ref(uint32_t crc, const unsigned char *buf, size_t len)
+{
+	int i;
+
+	crc = ~crc;
+	while (len--) {
+		crc ^= *buf++;
+		for (i = 0; i < 8; i++)
+			crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+	}
+	return ~crc;
+}
+
+static void crc32_vector_test(struct crc32_test *test)
+{
+	uint32_t crc;
+
+	crc = crc32(0, (const unsigned char *)test->data, strlen(test->data));
+	if (crc != test->exp) {
+		printf("ERROR: crc32(\"%s\") = 0x%08x, expected 0x%08x\n",
+		       test->data, crc, test->exp);
+		test_rc = 1;
+	}
+}
+
+/*
+ * Compare against the reference for every length and alignment around
+ * the slice-by-8 boundaries, and check that a CRC computed in two parts
+ * matches the one-shot CRC.
+ */
+static void crc32_buffer_test(void)
+{
+	unsigned char buf[512];
+	uint32_t crc, exp;
+	size_t off, len, split;
+
+	srand(1);
+	for (len = 0; len < sizeof(buf); len++)
+		buf[len] = rand();
+
+	for (off = 0; off < 8; off++) {
+		for (len = 0; len < sizeof(buf) - off; len++) {
+			exp = crc32_ref(0, buf + off, len);
+			crc = crc32(0, buf + off, len);
+			if (crc != exp) {
+				printf("ERROR: offset %zu length %zu: 0x%08x, expected 0x%08x\n",
+				       off, len, crc, exp);
+				test_rc = 1;
+				return;
+			}
+
+			split = len / 3;
+			crc = crc32(crc32(0, buf + off, split), buf + off + split,
+				    len - split);
+			if (crc != exp) {
+				printf("ERROR: offset %zu length %zu split %zu: 0x%08x, expected 0x%08x\n",
+				       off, len, split, crc, exp);
+				test_rc = 1;
+				return;
+			}
+		}
+	}
+}
+
+int main(void)
+{
+	unsigned int i;
+
+	test_rc = 0;
+
+	for (i = 0; i < ARRAY_SIZE(crc32_tests); i++)
+		crc32_vector_test(&crc32_tests[i]);
+
+	crc32_buffer_test();
+
+	return test_rc ? EXIT_FAILURE : EXIT_SUCCESS;
+}
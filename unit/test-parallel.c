@@ -0,0 +1,75 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../util/parallel.h"
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof(a[0]))
+
+static int test_rc;
+
+struct parallel_test {
+	unsigned int nr;
+	unsigned int max_workers;
+	int exp_workers;
+};
+
+static struct parallel_test parallel_tests[] = {
+	{ 0, 8, 1 },
+	{ 1, 8, 1 },
+	{ 100, 0, 1 },
+	{ 100, 1, 1 },
+	{ 3, 8, 3 },
+	{ 1000, 8, 8 },
+};
+
+static void count_item(unsigned int idx, void *arg)
+{
+	unsigned int *visited = arg;
+
+	__atomic_fetch_add(&visited[idx], 1, __ATOMIC_RELAXED);
+}
+
+static void parallel_test(struct parallel_test *test)
+{
+	unsigned int *visited;
+	unsigned int i;
+	int workers;
+
+	visited = calloc(test->nr + 1, sizeof(*visited));
+	if (!visited) {
+		test_rc = 1;
+		return;
+	}
+
+	workers = parallel_for_each(test->nr, test->max_workers, count_item,
+				    visited);
+	if (workers != test->exp_workers) {
+		printf("ERROR: nr %u max %u, got %d workers, expected %d\n",
+		       test->nr, test->max_workers, workers, test->exp_workers);
+		test_rc = 1;
+	}
+
+	for (i = 0; i < test->nr; i++) {
+		if (visited[i] == 1)
+			continue;
+		printf("ERROR: nr %u max %u, index %u visited %u times\n",
+		       test->nr, test->max_workers, i, visited[i]);
+		test_rc = 1;
+	}
+
+	free(visited);
+}
+
+int main(void)
+{
+	unsigned int i;
+
+	test_rc = 0;
+
+	for (i = 0; i < ARRAY_SIZE(parallel_tests); i++)
+		parallel_test(&parallel_tests[i]);
+
+	return test_rc ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,91 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../util/ratelimit.h"
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof(a[0]))
+
+static int test_rc;
+
+struct reserve_test {
+	uint64_t now_us;
+	uint64_t exp_delay_us;
+};
+
+/* 10 tokens per second with a burst of 3 */
+static struct reserve_test reserve_tests[] = {
+	{ 1000000, 0 },
+	{ 1000000, 0 },
+	{ 1000000, 0 },
+	{ 1000000, 100000 },
+	{ 1000000, 200000 },
+	{ 1050000, 250000 },
+	/* idle long enough to refill the bucket */
+	{ 5000000, 0 },
+	{ 5000000, 0 },
+	{ 5000000, 0 },
+	{ 5000000, 100000 },
+};
+
+static void reserve_test(void)
+{
+	struct ratelimit rl;
+	uint64_t delay;
+	unsigned int i;
+
+	ratelimit_init(&rl, 10, 3);
+	for (i = 0; i < ARRAY_SIZE(reserve_tests); i++) {
+		delay = ratelimit_reserve(&rl, reserve_tests[i].now_us);
+		if (delay == reserve_tests[i].exp_delay_us)
+			continue;
+		printf("ERROR: reserve %u at %llu, got delay %llu, expected %llu\n",
+		       i, (unsigned long long)reserve_tests[i].now_us,
+		       (unsigned long long)delay,
+		       (unsigned long long)reserve_tests[i].exp_delay_us);
+		test_rc = 1;
+	}
+
+	ratelimit_init(&rl, 0, 0);
+	for (i = 0; i < 100; i++) {
+		if (!ratelimit_reserve(&rl, 0))
+			continue;
+		printf("ERROR: unlimited rate delayed reserve %u\n", i);
+		test_rc = 1;
+		break;
+	}
+}
+
+static void backoff_test(void)
+{
+	unsigned int attempt, i, seed = 1;
+	uint64_t delay, exp;
+
+	for (attempt = 0; attempt < 12; attempt++) {
+		exp = 100000ULL << attempt;
+		if (exp > 5000000)
+			exp = 5000000;
+		for (i = 0; i < 100; i++) {
+			delay = backoff_jitter_us(attempt, 100000, 5000000, &seed);
+			if (delay >= exp / 2 && delay <= exp)
+				continue;
+			printf("ERROR: attempt %u, got backoff %llu, expected %llu..%llu\n",
+			       attempt, (unsigned long long)delay,
+			       (unsigned long long)exp / 2,
+			       (unsigned long long)exp);
+			test_rc = 1;
+			break;
+		}
+	}
+}
+
+int main(void)
+{
+	test_rc = 0;
+
+	reserve_test();
+	backoff_test();
+
+	return test_rc ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,92 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../util/uevent.h"
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof(a[0]))
+
+/* The messages are NUL separated, sizeof() accounts for the final NUL */
+#define MSG(s) s, sizeof(s)
+
+static int test_rc;
+
+struct uevent_test {
+	const char *msg;
+	size_t len;
+	int ret;
+	const char *action;
+	const char *subsystem;
+	const char *devname;
+	const char *nvme_event;
+};
+
+static struct uevent_test uevent_tests[] = {
+	{ MSG("add@/devices/virtual/nvme-fabrics/ctl/nvme3\0ACTION=add\0"
+	      "DEVPATH=/devices/virtual/nvme-fabrics/ctl/nvme3\0"
+	      "SUBSYSTEM=nvme\0MAJOR=240\0MINOR=3\0DEVNAME=nvme3\0SEQNUM=4242"),
+	  0, "add", "nvme", "nvme3", NULL },
+	{ MSG("change@/devices/virtual/nvme-fabrics/ctl/nvme3\0ACTION=change\0"
+	      "DEVPATH=/devices/virtual/nvme-fabrics/ctl/nvme3\0"
+	      "SUBSYSTEM=nvme\0NVME_EVENT=connected\0DEVNAME=nvme3"),
+	  0, "change", "nvme", "nvme3", "connected" },
+	{ MSG("remove@/devices/virtual/nvme-subsystem/nvme-subsys3/nvme3n1\0"
+	      "ACTION=remove\0DEVPATH=/devices/virtual/nvme-subsystem/nvme-subsys3/nvme3n1\0"
+	      "SUBSYSTEM=block\0DEVNAME=nvme3n1\0DEVTYPE=disk"),
+	  0, "remove", "block", "nvme3n1", NULL },
+	{ MSG("libudev\0ACTION=add\0DEVPATH=/devices/foo\0SUBSYSTEM=nvme"),
+	  -EINVAL },
+	{ MSG("add@/devices/foo\0DEVPATH=/devices/foo\0SUBSYSTEM=nvme"),
+	  -EINVAL },
+	{ "", 0, -EINVAL },
+};
+
+static void check_str(struct uevent_test *test, const char *field,
+		      const char *exp, const char *val)
+{
+	if (!exp && !val)
+		return;
+	if (exp && val && !strcmp(exp, val))
+		return;
+
+	printf("ERROR: parsing {%s}, %s is '%s', expected '%s'\n",
+	       test->msg, field, val ? val : "(null)", exp ? exp : "(null)");
+	test_rc = 1;
+}
+
+static void uevent_test(struct uevent_test *test)
+{
+	struct uevent ev;
+	int ret;
+
+	memcpy(ev.buf, test->msg, test->len);
+	ret = uevent_parse(&ev, test->len);
+	if (ret != test->ret) {
+		printf("ERROR: parsing {%s}, returned %d, expected %d\n",
+		       test->msg, ret, test->ret);
+		test_rc = 1;
+		return;
+	}
+	if (ret)
+		return;
+
+	check_str(test, "action", test->action, ev.action);
+	check_str(test, "subsystem", test->subsystem, ev.subsystem);
+	check_str(test, "devname", test->devname, ev.devname);
+	check_str(test, "nvme_event", test->nvme_event, ev.nvme_event);
+}
+
+int main(void)
+{
+	unsigned int i;
+
+	test_rc = 0;
+
+	for (i = 0; i < ARRAY_SIZE(uevent_tests); i++)
+		uevent_test(&uevent_tests[i]);
+
+	return test_rc ? EXIT_FAILURE : EXIT_SUCCESS;
+}
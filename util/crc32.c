@@ -31,6 +31,8 @@
 
 /* https://sourceware.org/git/?p=elfutils.git;a=blob;f=lib/crc32.c;hb=575198c29a427392823cc8f2400579a23d06a875 */
 
+#include <pthread.h>
+
 #include "crc32.h"
 
 /* Table computed with Mark Adler's makecrc.c utility.  */
@@ -89,12 +91,60 @@ static const uint32_t crc32_table[256] = {
 	0x2d02ef8d
 };
 
-uint32_t crc32(uint32_t crc, unsigned char *buf, size_t len)
+/*
+ * Slice-by-8: crc32_slices[k][i] is the CRC of byte i followed by k zero
+ * bytes, so eight input bytes are folded in with eight independent table
+ * lookups. The tables are derived from crc32_table on first use.
+ */
+static uint32_t crc32_slices[8][256];
+static pthread_once_t crc32_slices_once = PTHREAD_ONCE_INIT;
+
+static void crc32_init_slices(void)
+{
+	uint32_t crc;
+	int i, k;
+
+	for (i = 0; i < 256; i++) {
+		crc = crc32_table[i];
+		crc32_slices[0][i] = crc;
+		for (k = 1; k < 8; k++) {
+			crc = crc32_table[crc & 0xff] ^ (crc >> 8);
+			crc32_slices[k][i] = crc;
+		}
+	}
+}
+
+static inline uint32_t crc32_le32(const unsigned char *p)
+{
+	return (uint32_t)p[0] | (uint32_t)p[1] << 8 |
+		(uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+uint32_t crc32(uint32_t crc, const unsigned char *buf, size_t len)
 {
-	unsigned char *end;
+	const unsigned char *end = buf + len;
+	uint32_t lo, hi;
 
 	crc = ~crc;
-	for (end = buf + len; buf < end; ++buf)
+
+	if (len >= 16) {
+		pthread_once(&crc32_slices_once, crc32_init_slices);
+
+		for (; end - buf >= 8; buf += 8) {
+			lo = crc32_le32(buf) ^ crc;
+			hi = crc32_le32(buf + 4);
+			crc = crc32_slices[7][lo & 0xff] ^
+				crc32_slices[6][(lo >> 8) & 0xff] ^
+				crc32_slices[5][(lo >> 16) & 0xff] ^
+				crc32_slices[4][lo >> 24] ^
+				crc32_slices[3][hi & 0xff] ^
+				crc32_slices[2][(hi >> 8) & 0xff] ^
+				crc32_slices[1][(hi >> 16) & 0xff] ^
+				crc32_slices[0][hi >> 24];
+		}
+	}
+
+	for (; buf < end; ++buf)
 		crc = crc32_table[(crc ^ *buf) & 0xff] ^ (crc >> 8);
 	return ~crc;
 }
@@ -0,0 +1,66 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "parallel.h"
+
+struct parallel_ctx {
+	unsigned int nr;
+	unsigned int next;
+	parallel_fn_t fn;
+	void *arg;
+};
+
+static void *parallel_worker(void *data)
+{
+	struct parallel_ctx *ctx = data;
+	unsigned int idx;
+
+	while ((idx = __atomic_fetch_add(&ctx->next, 1, __ATOMIC_RELAXED)) < ctx->nr)
+		ctx->fn(idx, ctx->arg);
+
+	return NULL;
+}
+
+/*
+ * Calls @fn for every index in [0, @nr) from up to @max_workers threads,
+ * the calling thread included. Indices are handed out one at a time so a
+ * slow item does not hold back the remaining ones. If threads cannot be
+ * created the remaining workers (at least the caller) still process every
+ * index. Returns the number of threads which took part.
+ */
+int parallel_for_each(unsigned int nr, unsigned int max_workers,
+		      parallel_fn_t fn, void *arg)
+{
+	struct parallel_ctx ctx = {
+		.nr	= nr,
+		.next	= 0,
+		.fn	= fn,
+		.arg	= arg,
+	};
+	pthread_t *threads = NULL;
+	unsigned int i, nr_threads = 0;
+
+	if (max_workers > nr)
+		max_workers = nr;
+
+	if (max_workers > 1)
+		threads = calloc(max_workers - 1, sizeof(*threads));
+
+	if (threads) {
+		for (i = 0; i < max_workers - 1; i++) {
+			if (pthread_create(&threads[nr_threads], NULL,
+					   parallel_worker, &ctx))
+				break;
+			nr_threads++;
+		}
+	}
+
+	parallel_worker(&ctx);
+
+	for (i = 0; i < nr_threads; i++)
+		pthread_join(threads[i], NULL);
+	free(threads);
+
+	return nr_threads + 1;
+}
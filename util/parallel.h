@@ -0,0 +1,10 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+#ifndef PARALLEL_H_
+#define PARALLEL_H_
+
+typedef void (*parallel_fn_t)(unsigned int idx, void *arg);
+
+int parallel_for_each(unsigned int nr, unsigned int max_workers,
+		      parallel_fn_t fn, void *arg);
+
+#endif /* PARALLEL_H_ */
@@ -0,0 +1,77 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ratelimit.h"
+
+/*
+ * Token bucket holding up to @burst tokens and refilled with @rate tokens
+ * per second, kept as the theoretical arrival time of the next token so
+ * that no refill timer is needed. A @rate of 0 disables the limit.
+ */
+void ratelimit_init(struct ratelimit *rl, unsigned int rate,
+		    unsigned int burst)
+{
+	pthread_mutex_init(&rl->lock, NULL);
+	rl->interval_us = rate ? 1000000 / rate : 0;
+	rl->burst_us = burst > 1 ? (burst - 1) * rl->interval_us : 0;
+	rl->tat_us = 0;
+}
+
+/*
+ * Takes a token at @now_us and returns how long the caller has to wait
+ * before using it.
+ */
+uint64_t ratelimit_reserve(struct ratelimit *rl, uint64_t now_us)
+{
+	uint64_t delay = 0;
+
+	if (!rl->interval_us)
+		return 0;
+
+	pthread_mutex_lock(&rl->lock);
+	if (rl->tat_us < now_us)
+		rl->tat_us = now_us;
+	if (rl->tat_us > now_us + rl->burst_us)
+		delay = rl->tat_us - now_us - rl->burst_us;
+	rl->tat_us += rl->interval_us;
+	pthread_mutex_unlock(&rl->lock);
+
+	return delay;
+}
+
+void ratelimit_wait(struct ratelimit *rl)
+{
+	struct timespec ts;
+	uint64_t delay;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	delay = ratelimit_reserve(rl, (uint64_t)ts.tv_sec * 1000000 +
+				  ts.tv_nsec / 1000);
+
+	while (delay) {
+		uint64_t d = delay > 1000000 ? 1000000 : delay;
+
+		usleep(d);
+		delay -= d;
+	}
+}
+
+/*
+ * Exponential backoff for retry @attempt (starting at 0), capped at
+ * @max_us. Half of the delay is randomized so that clients which failed
+ * at the same time do not retry in lockstep.
+ */
+uint64_t backoff_jitter_us(unsigned int attempt, uint64_t base_us,
+			   uint64_t max_us, unsigned int *seed)
+{
+	uint64_t delay = base_us;
+
+	while (attempt-- && delay < max_us)
+		delay <<= 1;
+	if (delay > max_us)
+		delay = max_us;
+
+	return delay / 2 + (uint64_t)rand_r(seed) % (delay / 2 + 1);
+}
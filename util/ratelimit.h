@@ -0,0 +1,22 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+#ifndef RATELIMIT_H_
+#define RATELIMIT_H_
+
+#include <pthread.h>
+#include <stdint.h>
+
+struct ratelimit {
+	pthread_mutex_t lock;
+	uint64_t interval_us;
+	uint64_t burst_us;
+	uint64_t tat_us;
+};
+
+void ratelimit_init(struct ratelimit *rl, unsigned int rate,
+		    unsigned int burst);
+uint64_t ratelimit_reserve(struct ratelimit *rl, uint64_t now_us);
+void ratelimit_wait(struct ratelimit *rl);
+uint64_t backoff_jitter_us(unsigned int attempt, uint64_t base_us,
+			   uint64_t max_us, unsigned int *seed);
+
+#endif /* RATELIMIT_H_ */
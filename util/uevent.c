@@ -0,0 +1,121 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Minimal kernel uevent listener.
+ *
+ * Subscribes to the kernel multicast group of the kobject uevent netlink
+ * family directly, so no dependency on udevd or libudev is needed and
+ * the events arrive before udev has processed its rules.
+ */
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/socket.h>
+#include <linux/netlink.h>
+
+#include "uevent.h"
+
+#define UEVENT_KERNEL_GROUP	1
+#define UEVENT_RCVBUF		(1024 * 1024)
+
+int uevent_open(void)
+{
+	struct sockaddr_nl addr = {
+		.nl_family = AF_NETLINK,
+		.nl_groups = UEVENT_KERNEL_GROUP,
+	};
+	int rcvbuf = UEVENT_RCVBUF;
+	int fd;
+
+	fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+	if (fd < 0)
+		return -errno;
+
+	/* Hot-plugging a full enclosure produces bursts of events */
+	setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr))) {
+		int err = -errno;
+
+		close(fd);
+		return err;
+	}
+
+	return fd;
+}
+
+/*
+ * Parses the @len bytes in @ev->buf, an "ACTION@DEVPATH" header followed
+ * by NUL separated KEY=VALUE pairs. The fields point into @ev->buf.
+ */
+int uevent_parse(struct uevent *ev, size_t len)
+{
+	char *p = ev->buf, *end;
+
+	if (!len || len >= sizeof(ev->buf))
+		return -EINVAL;
+	ev->buf[len] = '\0';
+	end = ev->buf + len;
+
+	ev->action = NULL;
+	ev->devpath = NULL;
+	ev->subsystem = NULL;
+	ev->devtype = NULL;
+	ev->devname = NULL;
+	ev->nvme_event = NULL;
+
+	if (!strchr(p, '@'))
+		return -EINVAL;
+
+	for (p += strlen(p) + 1; p < end; p += strlen(p) + 1) {
+		if (!strncmp(p, "ACTION=", 7))
+			ev->action = p + 7;
+		else if (!strncmp(p, "DEVPATH=", 8))
+			ev->devpath = p + 8;
+		else if (!strncmp(p, "SUBSYSTEM=", 10))
+			ev->subsystem = p + 10;
+		else if (!strncmp(p, "DEVTYPE=", 8))
+			ev->devtype = p + 8;
+		else if (!strncmp(p, "DEVNAME=", 8))
+			ev->devname = p + 8;
+		else if (!strncmp(p, "NVME_EVENT=", 11))
+			ev->nvme_event = p + 11;
+	}
+
+	if (!ev->action || !ev->devpath || !ev->subsystem)
+		return -EINVAL;
+
+	return 0;
+}
+
+/*
+ * Receives one event. Messages not sent by the kernel are dropped and
+ * reported as -EAGAIN, as are malformed ones.
+ */
+int uevent_recv(int fd, struct uevent *ev)
+{
+	struct sockaddr_nl addr;
+	struct iovec iov = {
+		.iov_base = ev->buf,
+		.iov_len = sizeof(ev->buf) - 1,
+	};
+	struct msghdr msg = {
+		.msg_name = &addr,
+		.msg_namelen = sizeof(addr),
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+	};
+	ssize_t len;
+
+	len = recvmsg(fd, &msg, 0);
+	if (len < 0)
+		return -errno;
+
+	if (addr.nl_pid || (msg.msg_flags & MSG_TRUNC))
+		return -EAGAIN;
+
+	if (uevent_parse(ev, len))
+		return -EAGAIN;
+
+	return 0;
+}
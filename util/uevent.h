@@ -0,0 +1,23 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+#ifndef UEVENT_H_
+#define UEVENT_H_
+
+#include <stddef.h>
+
+#define UEVENT_BUF_SIZE		8192
+
+struct uevent {
+	const char *action;
+	const char *devpath;
+	const char *subsystem;
+	const char *devtype;
+	const char *devname;
+	const char *nvme_event;
+	char buf[UEVENT_BUF_SIZE];
+};
+
+int uevent_open(void);
+int uevent_parse(struct uevent *ev, size_t len);
+int uevent_recv(int fd, struct uevent *ev);
+
+#endif /* UEVENT_H_ */